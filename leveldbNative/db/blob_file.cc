@@ -0,0 +1,115 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include <assert.h>
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+	void BlobIndex::EncodeTo(std::string* dst) const {
+		PutVarint64(dst, file_number);
+		PutVarint64(dst, offset);
+		PutVarint64(dst, size);
+		PutFixed32(dst, crc);
+	}
+
+	Status BlobIndex::DecodeFrom(const Slice& _input) {
+		Slice input = _input;
+		if (GetVarint64(&input, &file_number) &&
+			GetVarint64(&input, &offset) &&
+			GetVarint64(&input, &size) &&
+			input.size() == 4) {
+			crc = DecodeFixed32(input.data());
+			return Status::OK();
+		}
+		return Status::Corruption("bad blob index");
+	}
+
+	Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+		std::string* value) {
+		const size_t n = static_cast<size_t>(index.size);
+		value->resize(n);
+		Slice result;
+		Status s = file->Read(index.offset, n, &result, n > 0 ? &(*value)[0] : NULL);
+		if (!s.ok()) {
+			return s;
+		}
+		if (result.size() != n) {
+			return Status::Corruption("truncated blob read");
+		}
+		if (crc32c::Unmask(index.crc) != crc32c::Value(result.data(), n)) {
+			return Status::Corruption("blob checksum mismatch");
+		}
+		if (result.data() != value->data()) {
+			// File implementation gave us pointer to some other data.
+			value->assign(result.data(), n);
+		}
+		return s;
+	}
+
+	BlobFileBuilder::BlobFileBuilder(Env* env, const std::string& dbname,
+		uint64_t number)
+		: env_(env),
+		fname_(BlobFileName(dbname, number)),
+		number_(number),
+		file_(NULL),
+		offset_(0),
+		finished_(false),
+		status_() {
+	}
+
+	BlobFileBuilder::~BlobFileBuilder() {
+		if (file_ != NULL) {
+			delete file_;
+			env_->DeleteFile(fname_);
+		}
+	}
+
+	Status BlobFileBuilder::Add(const Slice& value, std::string* index) {
+		assert(!finished_);
+		if (status_.ok() && file_ == NULL) {
+			status_ = env_->NewWritableFile(fname_, &file_);
+		}
+		if (status_.ok()) {
+			status_ = file_->Append(value);
+		}
+		if (status_.ok()) {
+			BlobIndex bi;
+			bi.file_number = number_;
+			bi.offset = offset_;
+			bi.size = value.size();
+			bi.crc = crc32c::Mask(crc32c::Value(value.data(), value.size()));
+			index->clear();
+			bi.EncodeTo(index);
+			offset_ += value.size();
+		}
+		return status_;
+	}
+
+	Status BlobFileBuilder::Finish() {
+		assert(!finished_);
+		finished_ = true;
+		if (file_ != NULL) {
+			if (status_.ok()) {
+				status_ = file_->Sync();
+			}
+			if (status_.ok()) {
+				status_ = file_->Close();
+			}
+			delete file_;
+			file_ = NULL;
+			if (!status_.ok()) {
+				env_->DeleteFile(fname_);
+				offset_ = 0;
+			}
+		}
+		return status_;
+	}
+
+}  // namespace leveldb
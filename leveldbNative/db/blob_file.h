@@ -0,0 +1,86 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Blob files hold the large values of a database (see
+// Options::min_blob_size), so that compactions only move small references
+// to them around.  A blob file is nothing but values appended back to
+// back; it is written once, by a memtable flush or a compaction, and
+// never changed.  The tables refer to a value with a kTypeBlobIndex entry
+// whose value is an encoded BlobIndex.
+//
+// Once every entry referring into a blob file has been dropped or
+// rewritten by compactions, the VersionSet forgets the file (see
+// VersionEdit::AddBlobGarbage) and it is deleted.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+	class Env;
+	class RandomAccessFile;
+	class WritableFile;
+
+	struct BlobIndex {
+		uint64_t file_number;
+		uint64_t offset;
+		uint64_t size;
+		uint32_t crc;           // Masked crc32c of the value
+
+		BlobIndex() : file_number(0), offset(0), size(0), crc(0) { }
+
+		void EncodeTo(std::string* dst) const;
+		Status DecodeFrom(const Slice& input);
+	};
+
+	// Read the value "index" locates from "file" into *value, and check
+	// it against the CRC.
+	extern Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+		std::string* value);
+
+	class BlobFileBuilder {
+	public:
+		// Build the blob file with the given number.  The file is only
+		// created by the first Add().
+		BlobFileBuilder(Env* env, const std::string& dbname, uint64_t number);
+
+		// Deletes the file if Finish() was not called.  A finished file
+		// that ends up unused is left to DBImpl::DeleteObsoleteFiles().
+		~BlobFileBuilder();
+
+		// Append "value" and store the encoded BlobIndex locating it in
+		// *index.
+		// REQUIRES: Finish() has not been called
+		Status Add(const Slice& value, std::string* index);
+
+		// Sync and close the file, if any.
+		Status Finish();
+
+		uint64_t number() const { return number_; }
+
+		// Bytes appended so far; zero if there is no file.
+		uint64_t size() const { return offset_; }
+
+	private:
+		Env* const env_;
+		const std::string fname_;
+		const uint64_t number_;
+		WritableFile* file_;
+		uint64_t offset_;
+		bool finished_;
+		Status status_;
+
+		// No copying allowed
+		BlobFileBuilder(const BlobFileBuilder&);
+		void operator=(const BlobFileBuilder&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
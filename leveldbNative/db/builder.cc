@@ -4,6 +4,7 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
 #include "db/table_cache.h"
@@ -11,6 +12,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/coding.h"
 
 namespace leveldb {
 
@@ -19,7 +21,8 @@ namespace leveldb {
 		const Options& options,
 		TableCache* table_cache,
 		Iterator* iter,
-		FileMetaData* meta) {
+		FileMetaData* meta,
+		BlobFileBuilder* blobs) {
 		Status s;
 		meta->file_size = 0;
 		iter->SeekToFirst();
@@ -33,15 +36,55 @@ namespace leveldb {
 			}
 
 			TableBuilder* builder = new TableBuilder(options, file);
-			meta->smallest.DecodeFrom(iter->key());
+			SequenceNumber max_sequence = 0;
+			uint64_t min_expiry = ~static_cast<uint64_t>(0);
+			std::string blob_key;
+			std::string blob_index;
 			for (; iter->Valid(); iter->Next()) {
 				Slice key = iter->key();
+				Slice value = iter->value();
+				ParsedInternalKey ikey;
+				if (ParseInternalKey(key, &ikey)) {
+					if (ikey.sequence > max_sequence) {
+						max_sequence = ikey.sequence;
+					}
+					if (ikey.type == kTypeValueWithExpiry &&
+						ExtractExpiry(value) < min_expiry) {
+						min_expiry = ExtractExpiry(value);
+					}
+					if (blobs != NULL && ikey.type == kTypeValue &&
+						value.size() >= options.min_blob_size) {
+						s = blobs->Add(value, &blob_index);
+						if (!s.ok()) {
+							break;
+						}
+						blob_key.clear();
+						AppendInternalKey(&blob_key,
+							ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeBlobIndex));
+						key = blob_key;
+						value = blob_index;
+					}
+				}
+				if (builder->NumEntries() == 0) {
+					meta->smallest.DecodeFrom(key);
+				}
 				meta->largest.DecodeFrom(key);
-				builder->Add(key, iter->value());
+				builder->Add(key, value);
 			}
 
 			// Finish and check for builder errors
 			if (s.ok()) {
+				std::string encoded;
+				PutVarint64(&encoded, max_sequence);
+				builder->AddProperty(kPropertyMaxSequence, encoded);
+				encoded.clear();
+				PutVarint64(&encoded, env->NowMicros() / 1000000);
+				builder->AddProperty(kPropertyCreationTime, encoded);
+				if (min_expiry != ~static_cast<uint64_t>(0)) {
+					encoded.clear();
+					PutVarint64(&encoded, min_expiry);
+					builder->AddProperty(kPropertyMinExpiry, encoded);
+				}
 				s = builder->Finish();
 				if (s.ok()) {
 					meta->file_size = builder->FileSize();
@@ -12,6 +12,7 @@ namespace leveldb {
 	struct Options;
 	struct FileMetaData;
 
+	class BlobFileBuilder;
 	class Env;
 	class Iterator;
 	class TableCache;
@@ -22,12 +23,17 @@ namespace leveldb {
 	// *meta will be filled with metadata about the generated table.
 	// If no data is present in *iter, meta->file_size will be set to
 	// zero, and no Table file will be produced.
+	//
+	// If "blobs" is non-NULL, values of at least options.min_blob_size
+	// bytes are appended to it and the table refers to them instead.  The
+	// caller finishes *blobs.
 	extern Status BuildTable(const std::string& dbname,
 		Env* env,
 		const Options& options,
 		TableCache* table_cache,
 		Iterator* iter,
-		FileMetaData* meta);
+		FileMetaData* meta,
+		BlobFileBuilder* blobs = NULL);
 
 }  // namespace leveldb
 
@@ -0,0 +1,93 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/column_family.h"
+
+#include "db/db_impl.h"
+#include "db/memtable.h"
+#include "db/table_cache.h"
+#include "db/version_set.h"
+
+namespace leveldb {
+
+	ColumnFamilyHandleImpl::~ColumnFamilyHandleImpl() {
+	}
+
+	const std::string& ColumnFamilyHandleImpl::GetName() const {
+		return cfd_->name;
+	}
+
+	uint32_t ColumnFamilyHandleImpl::GetID() const {
+		return cfd_->id;
+	}
+
+	// The options of a column family with the fields that concern the
+	// whole database taken from the DB's.
+	static Options ColumnFamilyOptions(const Options& db_options,
+		const Options& cf_options) {
+		Options result = cf_options;
+		result.env = db_options.env;
+		result.info_log = db_options.info_log;
+		result.create_if_missing = db_options.create_if_missing;
+		result.error_if_exists = db_options.error_if_exists;
+		result.paranoid_checks = db_options.paranoid_checks;
+		result.statistics = db_options.statistics;
+		result.listener = db_options.listener;
+		result.manual_garbage_collection = db_options.manual_garbage_collection;
+		result.max_file_opening_threads = db_options.max_file_opening_threads;
+		result.warm_table_cache = db_options.warm_table_cache;
+		if (result.block_cache == NULL) {
+			result.block_cache = db_options.block_cache;
+		}
+		return result;
+	}
+
+	ColumnFamilyData::ColumnFamilyData(uint32_t _id, const std::string& _name,
+		const std::string& _dir, const Options& db_options, const Options& cf_options)
+		: id(_id),
+		name(_name),
+		dir(_dir),
+		internal_comparator(cf_options.comparator),
+		internal_filter_policy(cf_options.filter_policy),
+		options(SanitizeOptions(_dir, &internal_comparator, &internal_filter_policy,
+			ColumnFamilyOptions(db_options, cf_options))),
+		owns_info_log(options.info_log != db_options.info_log),
+		table_cache(NULL),
+		versions(NULL),
+		mem(new MemTable(internal_comparator)),
+		imm(NULL),
+		mem_log_number(0),
+		pending_outputs(),
+		dropped(false),
+		handle(this) {
+		mem->Ref();
+		for (unsigned i = 0; i < config::kNumLevels; ++i) {
+			levels_locked[i] = false;
+		}
+	}
+
+	ColumnFamilyData::~ColumnFamilyData() {
+		delete versions;
+		if (mem != NULL) mem->Unref();
+		if (imm != NULL) imm->Unref();
+		delete table_cache;
+		if (owns_info_log) {
+			delete options.info_log;
+		}
+	}
+
+	bool ColumnFamilyData::OldestLogWithEntries(uint64_t* number) const {
+		if (imm != NULL) {
+			// Everything since the last flush is still to be written
+			*number = versions->LogNumber();
+			return true;
+		}
+		if (mem->NumEntries() > 0 || mem->IsShared()) {
+			*number = mem_log_number;
+			return true;
+		}
+		return false;
+	}
+
+}  // namespace leveldb
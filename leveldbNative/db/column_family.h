@@ -0,0 +1,102 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The state DBImpl keeps for each of its column families.  Every column
+// family has its own memtables, options and VersionSet; the default one
+// keeps its files in the database directory, the others in a directory
+// each (see ColumnFamilyDirName()) with a MANIFEST of their own.  The log
+// files, the writer queue and the background threads are shared by all
+// of them.
+//
+// The default column family's descriptor records which other column
+// families exist (see VersionEdit::AddColumnFamily).
+
+#ifndef STORAGE_LEVELDB_DB_COLUMN_FAMILY_H_
+#define STORAGE_LEVELDB_DB_COLUMN_FAMILY_H_
+
+#include <set>
+#include <string>
+#include "db/dbformat.h"
+#include "leveldb/db.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+	class MemTable;
+	class TableCache;
+	class VersionSet;
+	struct ColumnFamilyData;
+
+	class ColumnFamilyHandleImpl : public ColumnFamilyHandle {
+	public:
+		explicit ColumnFamilyHandleImpl(ColumnFamilyData* cfd) : cfd_(cfd) { }
+		virtual ~ColumnFamilyHandleImpl();
+
+		virtual const std::string& GetName() const;
+		virtual uint32_t GetID() const;
+
+		ColumnFamilyData* cfd() const { return cfd_; }
+
+	private:
+		ColumnFamilyData* const cfd_;
+
+		// No copying allowed
+		ColumnFamilyHandleImpl(const ColumnFamilyHandleImpl&);
+		void operator=(const ColumnFamilyHandleImpl&);
+	};
+
+	// Members that are not const are guarded by DBImpl::mutex_.
+	struct ColumnFamilyData {
+		// The options of the column family are "cf_options", sanitized, with
+		// the fields that concern the whole database taken from
+		// "db_options" (see ColumnFamilyDescriptor::options).  The caller
+		// sets table_cache and versions.
+		ColumnFamilyData(uint32_t id, const std::string& name, const std::string& dir,
+			const Options& db_options, const Options& cf_options);
+
+		// Unrefs the memtables and deletes versions and table_cache.
+		~ColumnFamilyData();
+
+		const uint32_t id;
+		const std::string name;
+		const std::string dir;          // Directory of its tables and MANIFEST
+		const InternalKeyComparator internal_comparator;
+		const InternalFilterPolicy internal_filter_policy;
+		const Options options;          // options.comparator == &internal_comparator
+		const bool owns_info_log;
+
+		// table_cache provides its own synchronization
+		TableCache* table_cache;
+		VersionSet* versions;
+
+		MemTable* mem;
+		MemTable* imm;                  // Memtable being flushed, or NULL
+		uint64_t mem_log_number;        // Log that was current when mem was created
+
+		// Table and blob files to protect from deletion because they are
+		// being written
+		std::set<uint64_t> pending_outputs;
+		bool levels_locked[config::kNumLevels];
+		bool dropped;
+
+		ColumnFamilyHandleImpl handle;
+
+		const Comparator* user_comparator() const {
+			return internal_comparator.user_comparator();
+		}
+
+		// Store in *number the first log that may hold entries of this
+		// column family that are not in its tables yet, and return true;
+		// return false if there are none.
+		bool OldestLogWithEntries(uint64_t* number) const;
+
+	private:
+		// No copying allowed
+		ColumnFamilyData(const ColumnFamilyData&);
+		void operator=(const ColumnFamilyData&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_COLUMN_FAMILY_H_
@@ -0,0 +1,382 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/compaction_pipeline.h"
+
+#include <assert.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "port/port.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+	namespace {
+
+		// Batches the producer may fill before the consumer catches up
+		static const size_t kMaxPrefetchBatches = 4;
+
+		// Buffered bytes handed to the writer at a time, and how many
+		// such chunks may wait for it
+		static const size_t kWriteChunkSize = 1 << 20;
+		static const size_t kMaxWriteChunks = 4;
+
+		class PrefetchIterator : public Iterator {
+		public:
+			PrefetchIterator(Env* env, Iterator* input, size_t batch_bytes)
+				: env_(env),
+				input_(input),
+				batch_bytes_(batch_bytes),
+				mu_(),
+				cv_(&mu_),
+				ready_(),
+				started_(false),
+				input_started_(false),
+				producer_running_(false),
+				producer_done_(false),
+				stop_(false),
+				current_(NULL),
+				pos_(0),
+				status_() {
+			}
+
+			virtual ~PrefetchIterator() {
+				{
+					MutexLock l(&mu_);
+					stop_ = true;
+					cv_.SignalAll();
+					while (producer_running_) {
+						cv_.Wait();
+					}
+				}
+				delete current_;
+				for (size_t i = 0; i < ready_.size(); i++) {
+					delete ready_[i];
+				}
+				delete input_;
+			}
+
+			virtual bool Valid() const {
+				return current_ != NULL;
+			}
+
+			virtual void SeekToFirst() {
+				assert(!started_);
+				if (started_) {
+					Unsupported();
+					return;
+				}
+				started_ = true;
+				{
+					MutexLock l(&mu_);
+					producer_running_ = true;
+				}
+				env_->ScheduleWork(&PrefetchIterator::ProducerWrapper, this);
+				NextBatch();
+			}
+
+			virtual void SeekToLast() {
+				Unsupported();
+			}
+
+			virtual void Seek(const Slice&) {
+				Unsupported();
+			}
+
+			virtual void Next() {
+				assert(Valid());
+				++pos_;
+				if (pos_ == current_->entries.size()) {
+					NextBatch();
+				}
+			}
+
+			virtual void Prev() {
+				Unsupported();
+			}
+
+			virtual Slice key() const {
+				assert(Valid());
+				const Entry& e = current_->entries[pos_];
+				return Slice(current_->data.data() + e.offset, e.key_size);
+			}
+
+			virtual Slice value() const {
+				assert(Valid());
+				const Entry& e = current_->entries[pos_];
+				return Slice(current_->data.data() + e.offset + e.key_size, e.value_size);
+			}
+
+			virtual const Status& status() const {
+				return status_;
+			}
+
+		private:
+			struct Entry {
+				size_t offset;
+				size_t key_size;
+				size_t value_size;
+			};
+
+			// Consecutive entries copied out of input_, and input_'s status
+			// once they had been read
+			struct Batch {
+				std::string data;
+				std::vector<Entry> entries;
+				Status status;
+			};
+
+			static void ProducerWrapper(void* arg) {
+				reinterpret_cast<PrefetchIterator*>(arg)->Produce();
+			}
+
+			// Runs on the Env's work pool.  Fills batches until the buffer is
+			// full or the input ends, then returns; NextBatch() schedules it
+			// again once there is room.  It never waits for the consumer, so
+			// it cannot hold up other work queued on the pool.
+			void Produce() {
+				if (!input_started_) {
+					input_->SeekToFirst();
+					input_started_ = true;
+				}
+				bool done = false;
+				while (!done) {
+					Batch* b = new Batch;
+					b->data.reserve(batch_bytes_);
+					for (; input_->Valid() && b->data.size() < batch_bytes_; input_->Next()) {
+						Slice k = input_->key();
+						Slice v = input_->value();
+						Entry e;
+						e.offset = b->data.size();
+						e.key_size = k.size();
+						e.value_size = v.size();
+						b->data.append(k.data(), k.size());
+						b->data.append(v.data(), v.size());
+						b->entries.push_back(e);
+					}
+					b->status = input_->status();
+					done = !input_->Valid();
+
+					MutexLock l(&mu_);
+					if (stop_) {
+						delete b;
+						break;
+					}
+					ready_.push_back(b);
+					cv_.SignalAll();
+					if (!done && ready_.size() >= kMaxPrefetchBatches) {
+						producer_running_ = false;
+						return;
+					}
+				}
+				MutexLock l(&mu_);
+				producer_done_ = true;
+				producer_running_ = false;
+				cv_.SignalAll();
+			}
+
+			// Drop the current batch and move to the first entry of the next
+			// non-empty one, or become invalid at the end of the input.
+			void NextBatch() {
+				delete current_;
+				current_ = NULL;
+				pos_ = 0;
+				MutexLock l(&mu_);
+				while (true) {
+					while (ready_.empty() && !producer_done_) {
+						cv_.Wait();
+					}
+					if (ready_.empty()) {
+						return;
+					}
+					Batch* b = ready_.front();
+					ready_.pop_front();
+					if (!producer_running_ && !producer_done_) {
+						producer_running_ = true;
+						env_->ScheduleWork(&PrefetchIterator::ProducerWrapper, this);
+					}
+					status_ = b->status;
+					if (!b->entries.empty()) {
+						current_ = b;
+						return;
+					}
+					delete b;
+				}
+			}
+
+			void Unsupported() {
+				delete current_;
+				current_ = NULL;
+				status_ = Status::NotSupported("prefetch iterator only moves forward");
+			}
+
+			Env* const env_;
+			Iterator* const input_;
+			const size_t batch_bytes_;
+
+			port::Mutex mu_;
+			port::CondVar cv_;
+			std::deque<Batch*> ready_;    // Guarded by mu_
+			bool started_;
+			bool input_started_;          // Only touched by Produce()
+			bool producer_running_;       // Scheduled or running; guarded by mu_
+			bool producer_done_;          // Guarded by mu_
+			bool stop_;                   // Guarded by mu_
+
+			// Consumer state
+			Batch* current_;
+			size_t pos_;
+			Status status_;
+
+			// No copying allowed
+			PrefetchIterator(const PrefetchIterator&);
+			void operator=(const PrefetchIterator&);
+		};
+
+		class BackgroundWritableFile : public WritableFile {
+		public:
+			BackgroundWritableFile(Env* env, WritableFile* target)
+				: env_(env),
+				target_(target),
+				buffer_(),
+				mu_(),
+				cv_(&mu_),
+				queue_(),
+				status_(),
+				writer_running_(false) {
+			}
+
+			virtual ~BackgroundWritableFile() {
+				Drain();
+				delete target_;
+			}
+
+			virtual Status Append(const Slice& data) {
+				Status s = CurrentStatus();
+				if (s.ok()) {
+					buffer_.append(data.data(), data.size());
+					if (buffer_.size() >= kWriteChunkSize) {
+						Handoff();
+					}
+				}
+				return s;
+			}
+
+			// Chunks are written as soon as they fill up; there is nothing
+			// more to push to the OS without waiting for the writer.
+			virtual Status Flush() {
+				return CurrentStatus();
+			}
+
+			virtual Status Sync() {
+				Status s = Drain();
+				if (s.ok()) {
+					s = target_->Sync();
+				}
+				return s;
+			}
+
+			virtual Status Close() {
+				Status s = Drain();
+				Status c = target_->Close();
+				return s.ok() ? c : s;
+			}
+
+		private:
+			static void WriterWrapper(void* arg) {
+				reinterpret_cast<BackgroundWritableFile*>(arg)->WriteChunks();
+			}
+
+			// Runs on the Env's work pool until the queue is empty; Handoff()
+			// schedules it again for the next chunk.
+			void WriteChunks() {
+				MutexLock l(&mu_);
+				while (!queue_.empty()) {
+					std::string* chunk = queue_.front();
+					bool write = status_.ok();
+					mu_.Unlock();
+					Status s;
+					if (write) {
+						s = target_->Append(*chunk);
+					}
+					delete chunk;
+					mu_.Lock();
+					// Popped only now so that Handoff() sees the chunk being
+					// written as still taking up room
+					queue_.pop_front();
+					if (status_.ok() && !s.ok()) {
+						status_ = s;
+					}
+					cv_.SignalAll();
+				}
+				writer_running_ = false;
+				cv_.SignalAll();
+			}
+
+			Status CurrentStatus() {
+				MutexLock l(&mu_);
+				return status_;
+			}
+
+			// Queue buffer_ for the writer, waiting while it is too far behind.
+			void Handoff() {
+				if (buffer_.empty()) {
+					return;
+				}
+				std::string* chunk = new std::string;
+				chunk->swap(buffer_);
+				MutexLock l(&mu_);
+				while (queue_.size() >= kMaxWriteChunks) {
+					cv_.Wait();
+				}
+				queue_.push_back(chunk);
+				if (!writer_running_) {
+					writer_running_ = true;
+					env_->ScheduleWork(&BackgroundWritableFile::WriterWrapper, this);
+				}
+			}
+
+			// Wait until everything appended so far has reached target_.
+			Status Drain() {
+				Handoff();
+				MutexLock l(&mu_);
+				while (writer_running_) {
+					cv_.Wait();
+				}
+				return status_;
+			}
+
+			Env* const env_;
+			WritableFile* const target_;
+			std::string buffer_;          // Appended data not yet queued
+
+			port::Mutex mu_;
+			port::CondVar cv_;
+			std::deque<std::string*> queue_;  // Guarded by mu_
+			Status status_;               // First error from target_; guarded by mu_
+			bool writer_running_;         // Scheduled or running; guarded by mu_
+
+			// No copying allowed
+			BackgroundWritableFile(const BackgroundWritableFile&);
+			void operator=(const BackgroundWritableFile&);
+		};
+
+	}  // namespace
+
+	// Each stage keeps at most one item on the pool at a time; two threads
+	// let the reading and the writing stage of a compaction overlap.
+	Iterator* NewPrefetchIterator(Env* env, Iterator* input, size_t batch_bytes) {
+		env->ReserveWorkThreads(2);
+		return new PrefetchIterator(env, input, batch_bytes);
+	}
+
+	WritableFile* NewBackgroundWritableFile(Env* env, WritableFile* target) {
+		env->ReserveWorkThreads(2);
+		return new BackgroundWritableFile(env, target);
+	}
+
+}  // namespace leveldb
@@ -0,0 +1,45 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Stages that let a compaction spread over several threads (see
+// Options::pipelined_compaction).  The compaction thread itself keeps
+// deciding what to keep and building the output tables; reading and
+// merging the inputs runs ahead of it, and the output bytes are written
+// behind it.  Both stages run as items on Env::ScheduleWork(), so no
+// thread is started per compaction or per file.
+
+#ifndef STORAGE_LEVELDB_DB_COMPACTION_PIPELINE_H_
+#define STORAGE_LEVELDB_DB_COMPACTION_PIPELINE_H_
+
+#include <stddef.h>
+
+namespace leveldb {
+
+	class Env;
+	class Iterator;
+	class WritableFile;
+
+	// Return an iterator that walks "input" from front to back on the
+	// Env's work pool, handing the entries over in batches of about
+	// batch_bytes each.  At most a few batches are buffered ahead of the
+	// caller.  The result takes ownership of "input".
+	//
+	// Only SeekToFirst() and Next() are supported, and SeekToFirst() may
+	// only be called once; the other positioning calls make the iterator
+	// invalid with a NotSupported status.  An error from "input" is
+	// reported by status() once the entries read before it have been
+	// consumed.
+	extern Iterator* NewPrefetchIterator(Env* env, Iterator* input,
+		size_t batch_bytes);
+
+	// Return a file that buffers appended data and writes it to "target"
+	// from the Env's work pool.  Append() and Flush() return at once; an
+	// error from "target" is returned by the next call after it happened,
+	// and by Sync() and Close(), which first wait for everything buffered
+	// to be written.  The result takes ownership of "target".
+	extern WritableFile* NewBackgroundWritableFile(Env* env, WritableFile* target);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_COMPACTION_PIPELINE_H_
@@ -320,6 +320,31 @@ namespace leveldb {
 		ASSERT_EQ("v6", v);
 	}
 
+	TEST(CorruptionTest, SequenceNumberRecoveryFromTables) {
+		// Several tables plus a log, repaired on multiple threads.  Table
+		// metadata comes from the properties block rather than a scan.
+		DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+		std::string key_space;
+		for (int i = 1; i <= 5; i++) {
+			char v[10];
+			snprintf(v, sizeof(v), "v%d", i);
+			ASSERT_OK(db_->Put(WriteOptions(), "foo", v));
+			ASSERT_OK(db_->Put(WriteOptions(), Key(i, &key_space), v));
+			dbi->TEST_CompactMemTable();
+		}
+		ASSERT_OK(db_->Put(WriteOptions(), "foo", "v6"));
+		options_.max_file_opening_threads = 4;
+		RepairDB();
+		Reopen();
+		std::string v;
+		ASSERT_OK(db_->Get(ReadOptions(), "foo", &v));
+		ASSERT_EQ("v6", v);
+		ASSERT_OK(db_->Put(WriteOptions(), "foo", "v7"));
+		Reopen();
+		ASSERT_OK(db_->Get(ReadOptions(), "foo", &v));
+		ASSERT_EQ("v7", v);
+	}
+
 	TEST(CorruptionTest, CorruptedDescriptor) {
 		ASSERT_OK(db_->Put(WriteOptions(), "foo", "hello"));
 		DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
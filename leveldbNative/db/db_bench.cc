@@ -3,8 +3,11 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include <sys/types.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 #include "db/db_impl.h"
 #include "db/version_set.h"
 #include "leveldb/cache.h"
@@ -13,6 +16,7 @@
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
@@ -29,6 +33,13 @@
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
 //      readhot       -- read N times in random order from 1% section of DB
+//      readwhilewriting -- 1 writer, N threads doing random reads
+//      seekrandom    -- N random seeks, each followed by --seek_nexts Next()s
+//      multireadrandom -- N random reads in sorted batches of
+//                       --multiread_batch_size keys sharing a snapshot
+//      mixgraph      -- N operations per thread, mixing gets, puts and seeks
+//                       in the proportions --mix_get_ratio, --mix_put_ratio
+//                       and --mix_seek_ratio
 //      crc32c        -- repeated crc32c of 4K of data
 //      acquireload   -- load N*1000 times
 //   Meta operations:
@@ -93,6 +104,40 @@ static bool FLAGS_use_existing_db = false;
 // Use the db with the following name.
 static const char* FLAGS_db = "/tmp/dbbench";
 
+// Distribution of the keys picked by the random benchmarks:
+//   uniform -- every key is equally likely
+//   zipfian -- key popularity follows a Zipf law with exponent --zipf_theta,
+//              which must be in (0,1); the popular keys are scattered over
+//              the key space
+//   hotspot -- --hotspot_access of the operations go to the first
+//              --hotspot_fraction of the key space
+static const char* FLAGS_key_dist = "uniform";
+static double FLAGS_zipf_theta = 0.99;
+static double FLAGS_hotspot_fraction = 0.2;
+static double FLAGS_hotspot_access = 0.8;
+
+// Number of Next() calls after each Seek() in seekrandom and mixgraph.
+static int FLAGS_seek_nexts = 0;
+
+// Number of keys read under one snapshot by multireadrandom.
+static int FLAGS_multiread_batch_size = 16;
+
+// Relative weights of the operations issued by mixgraph.
+static double FLAGS_mix_get_ratio = 1.0;
+static double FLAGS_mix_put_ratio = 0.0;
+static double FLAGS_mix_seek_ratio = 0.0;
+
+// If positive, limit all writing threads together to this many bytes of
+// keys and values per second.
+static long long FLAGS_benchmark_write_rate_limit = 0;
+
+// If positive, print the throughput and latency percentiles of the running
+// benchmark every this many seconds.
+static int FLAGS_stats_interval_seconds = 0;
+
+// Print results as one JSON object per line instead of text.
+static bool FLAGS_json = false;
+
 namespace leveldb {
 
 namespace {
@@ -149,6 +194,137 @@ static void AppendWithSpace(std::string* str, Slice msg) {
   str->append(msg.data(), msg.size());
 }
 
+// NowMicros() only has millisecond resolution on Windows, which is too
+// coarse for per-operation latencies.
+static double NowMicros() {
+  return Env::Default()->NowNanos() / 1e3;
+}
+
+static std::string JsonEscape(const Slice& s) {
+  std::string result;
+  for (size_t i = 0; i < s.size(); i++) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      result.push_back('\\');
+      result.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[10];
+      snprintf(buf, sizeof(buf), "\\u%04x", static_cast<int>(c));
+      result.append(buf);
+    } else {
+      result.push_back(c);
+    }
+  }
+  return result;
+}
+
+// Return a uniformly distributed value in [0,1).
+static double RandomDouble(Random* rnd) {
+  return (rnd->Next() - 1) / 2147483646.0;
+}
+
+// Picks keys in [0,FLAGS_num) according to --key_dist.  All randomness
+// comes from the caller, so one generator serves every thread.
+class KeyGenerator {
+ public:
+  KeyGenerator() : num_(FLAGS_num), zetan_(0), eta_(0), alpha_(0), zeta2_(0) {
+    if (strcmp(FLAGS_key_dist, "zipfian") == 0) {
+      dist_ = kZipfian;
+      // Gray et al., "Quickly generating billion-record synthetic
+      // databases", as used by YCSB.  Only valid for 0 < theta < 1.
+      const double theta = FLAGS_zipf_theta;
+      zeta2_ = Zeta(2, theta);
+      zetan_ = Zeta(num_, theta);
+      alpha_ = 1.0 / (1.0 - theta);
+      eta_ = (1 - pow(2.0 / num_, 1 - theta)) / (1 - zeta2_ / zetan_);
+    } else if (strcmp(FLAGS_key_dist, "hotspot") == 0) {
+      dist_ = kHotspot;
+    } else {
+      dist_ = kUniform;
+    }
+  }
+
+  int Next(Random* rnd) const {
+    switch (dist_) {
+      case kZipfian: {
+        const double u = RandomDouble(rnd);
+        const double uz = u * zetan_;
+        uint64_t rank;
+        if (uz < 1.0) {
+          rank = 0;
+        } else if (uz < 1.0 + pow(0.5, FLAGS_zipf_theta)) {
+          rank = 1;
+        } else {
+          rank = static_cast<uint64_t>(num_ * pow(eta_ * u - eta_ + 1, alpha_));
+        }
+        // Spread the popular keys over the key space.
+        char buf[8];
+        EncodeFixed64(buf, rank);
+        return Hash(buf, sizeof(buf), 0) % num_;
+      }
+      case kHotspot: {
+        const int hot = std::max(1, static_cast<int>(num_ * FLAGS_hotspot_fraction));
+        if (hot >= num_ || RandomDouble(rnd) < FLAGS_hotspot_access) {
+          return rnd->Next() % hot;
+        }
+        return hot + rnd->Next() % (num_ - hot);
+      }
+      default:
+        return rnd->Next() % num_;
+    }
+  }
+
+ private:
+  enum Distribution { kUniform, kZipfian, kHotspot };
+
+  static double Zeta(int n, double theta) {
+    double sum = 0;
+    for (int i = 1; i <= n; i++) {
+      sum += 1.0 / pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  Distribution dist_;
+  const int num_;
+  double zetan_;
+  double eta_;
+  double alpha_;
+  double zeta2_;
+};
+
+// Paces the writes of all threads so that together they stay under
+// --benchmark_write_rate_limit bytes per second.
+class RateLimiter {
+ public:
+  explicit RateLimiter(long long bytes_per_second)
+      : micros_per_byte_(1e6 / bytes_per_second),
+        next_(0) {
+  }
+
+  // Block until "bytes" more bytes may be written.
+  void Request(int64_t bytes) {
+    double wait;
+    {
+      MutexLock l(&mu_);
+      const double now = NowMicros();
+      if (next_ < now) {
+        next_ = now;
+      }
+      wait = next_ - now;
+      next_ += bytes * micros_per_byte_;
+    }
+    if (wait >= 1) {
+      Env::Default()->SleepForMicroseconds(static_cast<int>(wait));
+    }
+  }
+
+ private:
+  port::Mutex mu_;
+  const double micros_per_byte_;
+  double next_;   // when the next request may proceed
+};
+
 class Stats {
  private:
   double start_;
@@ -160,19 +336,25 @@ class Stats {
   double last_op_finish_;
   Histogram hist_;
   std::string message_;
+  ConcurrentHistogram* interval_;   // shared by all threads; may be NULL
 
  public:
-  Stats() { Start(); }
+  Stats() : interval_(NULL) { Start(); }
+
+  // Also record the latency of every operation in "*interval".
+  void SetInterval(ConcurrentHistogram* interval) {
+    interval_ = interval;
+  }
 
   void Start() {
     next_report_ = 100;
-    last_op_finish_ = start_;
     hist_.Clear();
     done_ = 0;
     bytes_ = 0;
     seconds_ = 0;
-    start_ = Env::Default()->NowMicros();
+    start_ = NowMicros();
     finish_ = start_;
+    last_op_finish_ = start_;
     message_.clear();
   }
 
@@ -189,7 +371,7 @@ class Stats {
   }
 
   void Stop() {
-    finish_ = Env::Default()->NowMicros();
+    finish_ = NowMicros();
     seconds_ = (finish_ - start_) * 1e-6;
   }
 
@@ -198,13 +380,18 @@ class Stats {
   }
 
   void FinishedSingleOp() {
-    if (FLAGS_histogram) {
-      double now = Env::Default()->NowMicros();
+    if (FLAGS_histogram || interval_ != NULL) {
+      double now = NowMicros();
       double micros = now - last_op_finish_;
-      hist_.Add(micros);
-      if (micros > 20000) {
-        fprintf(stderr, "long op: %.1f micros%30s\r", micros, "");
-        fflush(stderr);
+      if (FLAGS_histogram) {
+        hist_.Add(micros);
+        if (micros > 20000 && !FLAGS_json) {
+          fprintf(stderr, "long op: %.1f micros%30s\r", micros, "");
+          fflush(stderr);
+        }
+      }
+      if (interval_ != NULL) {
+        interval_->Add(static_cast<uint64_t>(micros));
       }
       last_op_finish_ = now;
     }
@@ -232,6 +419,11 @@ class Stats {
     // that does not call FinishedSingleOp().
     if (done_ < 1) done_ = 1;
 
+    if (FLAGS_json) {
+      ReportJson(name);
+      return;
+    }
+
     std::string extra;
     if (bytes_ > 0) {
       // Rate is computed on actual elapsed time, not the sum of per-thread
@@ -254,6 +446,31 @@ class Stats {
     }
     fflush(stdout);
   }
+
+  void ReportJson(const Slice& name) {
+    double elapsed = (finish_ - start_) * 1e-6;
+    if (elapsed <= 0) elapsed = 1e-6;
+    char buf[300];
+    snprintf(buf, sizeof(buf),
+             "{\"benchmark\": \"%s\", \"ops\": %d, \"micros_per_op\": %.3f, "
+             "\"ops_per_sec\": %.1f, \"mb_per_sec\": %.1f",
+             JsonEscape(name).c_str(),
+             done_,
+             seconds_ * 1e6 / done_,
+             done_ / elapsed,
+             (bytes_ / 1048576.0) / elapsed);
+    std::string json = buf;
+    if (FLAGS_histogram) {
+      snprintf(buf, sizeof(buf),
+               ", \"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f",
+               hist_.Median(), hist_.Percentile(99), hist_.Percentile(99.9),
+               hist_.Max());
+      json.append(buf);
+    }
+    json.append(", \"message\": \"" + JsonEscape(message_) + "\"}");
+    fprintf(stdout, "%s\n", json.c_str());
+    fflush(stdout);
+  }
 };
 
 // State shared by all concurrent executions of the same benchmark.
@@ -272,7 +489,11 @@ struct SharedState {
   int num_done;
   bool start;
 
-  SharedState() : cv(&mu) { }
+  // Shared by the writing threads; NULL unless
+  // --benchmark_write_rate_limit is set.
+  RateLimiter* write_limiter;
+
+  SharedState() : cv(&mu), write_limiter(NULL) { }
 };
 
 // Per-thread state for concurrent executions of the same benchmark.
@@ -300,6 +521,7 @@ class Benchmark {
   WriteOptions write_options_;
   int reads_;
   int heap_counter_;
+  KeyGenerator key_gen_;
 
   void PrintHeader() {
     const int kKeySize = 16;
@@ -465,6 +687,12 @@ class Benchmark {
       } else if (name == Slice("readwhilewriting")) {
         num_threads++;  // Add extra thread for writing
         method = &Benchmark::ReadWhileWriting;
+      } else if (name == Slice("seekrandom")) {
+        method = &Benchmark::SeekRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
+      } else if (name == Slice("mixgraph")) {
+        method = &Benchmark::MixGraph;
       } else if (name == Slice("compact")) {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
@@ -547,6 +775,13 @@ class Benchmark {
     shared.num_initialized = 0;
     shared.num_done = 0;
     shared.start = false;
+    if (FLAGS_benchmark_write_rate_limit > 0) {
+      shared.write_limiter = new RateLimiter(FLAGS_benchmark_write_rate_limit);
+    }
+    ConcurrentHistogram* interval = NULL;
+    if (FLAGS_stats_interval_seconds > 0) {
+      interval = new ConcurrentHistogram;
+    }
 
     ThreadArg* arg = new ThreadArg[n];
     for (int i = 0; i < n; i++) {
@@ -555,6 +790,7 @@ class Benchmark {
       arg[i].shared = &shared;
       arg[i].thread = new ThreadState(i);
       arg[i].thread->shared = &shared;
+      arg[i].thread->stats.SetInterval(interval);
       Env::Default()->StartThread(ThreadBody, &arg[i]);
     }
 
@@ -565,10 +801,16 @@ class Benchmark {
 
     shared.start = true;
     shared.cv.SignalAll();
-    while (shared.num_done < n) {
-      shared.cv.Wait();
+    if (interval == NULL) {
+      while (shared.num_done < n) {
+        shared.cv.Wait();
+      }
+    } else {
+      ReportIntervals(name, &shared, interval);
     }
     shared.mu.Unlock();
+    delete interval;
+    delete shared.write_limiter;
 
     for (int i = 1; i < n; i++) {
       arg[0].thread->stats.Merge(arg[i].thread->stats);
@@ -581,6 +823,41 @@ class Benchmark {
     delete[] arg;
   }
 
+  // Print throughput and latency percentiles every
+  // --stats_interval_seconds until all n threads are done.  Called and
+  // returns with shared->mu held.
+  void ReportIntervals(const Slice& name, SharedState* shared,
+                       ConcurrentHistogram* interval) {
+    const double period = FLAGS_stats_interval_seconds * 1e6;
+    double last = NowMicros();
+    while (shared->num_done < shared->total) {
+      shared->mu.Unlock();
+      Env::Default()->SleepForMicroseconds(100000);
+      const double now = NowMicros();
+      if (now - last >= period) {
+        Histogram hist;
+        interval->MergeInto(&hist);
+        interval->Clear();
+        const double ops_per_sec = hist.Count() / ((now - last) * 1e-6);
+        if (FLAGS_json) {
+          fprintf(stdout, "{\"benchmark\": \"%s\", \"interval\": true, "
+                  "\"ops_per_sec\": %.1f, \"p50\": %.1f, \"p99\": %.1f, "
+                  "\"p999\": %.1f}\n",
+                  JsonEscape(name).c_str(), ops_per_sec, hist.Median(),
+                  hist.Percentile(99), hist.Percentile(99.9));
+        } else {
+          fprintf(stdout, "%-12s : %11.1f ops/sec; p50 %.1f p99 %.1f "
+                  "p999 %.1f micros (interval)\n",
+                  name.ToString().c_str(), ops_per_sec, hist.Median(),
+                  hist.Percentile(99), hist.Percentile(99.9));
+        }
+        fflush(stdout);
+        last = now;
+      }
+      shared->mu.Lock();
+    }
+  }
+
   void Crc32c(ThreadState* thread) {
     // Checksum about 500MB of data total
     const int size = 4096;
@@ -697,14 +974,18 @@ class Benchmark {
     int64_t bytes = 0;
     for (int i = 0; i < num_; i += entries_per_batch_) {
       batch.Clear();
+      const int64_t batch_start = bytes;
       for (int j = 0; j < entries_per_batch_; j++) {
-        const int k = seq ? i+j : (thread->rand.Next() % FLAGS_num);
+        const int k = seq ? i+j : key_gen_.Next(&thread->rand);
         char key[100];
         snprintf(key, sizeof(key), "%016d", k);
         batch.Put(key, gen.Generate(value_size_));
         bytes += value_size_ + strlen(key);
         thread->stats.FinishedSingleOp();
       }
+      if (thread->shared->write_limiter != NULL) {
+        thread->shared->write_limiter->Request(bytes - batch_start);
+      }
       s = db_->Write(write_options_, &batch);
       if (!s.ok()) {
         fprintf(stderr, "put error: %s\n", s.ToString().c_str());
@@ -745,7 +1026,7 @@ class Benchmark {
     std::string value;
     for (int i = 0; i < reads_; i++) {
       char key[100];
-      const int k = thread->rand.Next() % FLAGS_num;
+      const int k = key_gen_.Next(&thread->rand);
       snprintf(key, sizeof(key), "%016d", k);
       db_->Get(options, key, &value);
       thread->stats.FinishedSingleOp();
@@ -780,9 +1061,12 @@ class Benchmark {
           }
         }
 
-        const int k = thread->rand.Next() % FLAGS_num;
+        const int k = key_gen_.Next(&thread->rand);
         char key[100];
         snprintf(key, sizeof(key), "%016d", k);
+        if (thread->shared->write_limiter != NULL) {
+          thread->shared->write_limiter->Request(value_size_ + strlen(key));
+        }
         Status s = db_->Put(write_options_, key, gen.Generate(value_size_));
         if (!s.ok()) {
           fprintf(stderr, "put error: %s\n", s.ToString().c_str());
@@ -795,6 +1079,119 @@ class Benchmark {
     }
   }
 
+  void SeekRandom(ThreadState* thread) {
+    ReadOptions options;
+    int found = 0;
+    int64_t bytes = 0;
+    for (int i = 0; i < reads_; i++) {
+      Iterator* iter = db_->NewIterator(options);
+      char key[100];
+      const int k = key_gen_.Next(&thread->rand);
+      snprintf(key, sizeof(key), "%016d", k);
+      iter->Seek(key);
+      if (iter->Valid() && iter->key() == key) found++;
+      for (int j = 0; j < FLAGS_seek_nexts && iter->Valid(); j++) {
+        bytes += iter->key().size() + iter->value().size();
+        iter->Next();
+      }
+      delete iter;
+      thread->stats.FinishedSingleOp();
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+    thread->stats.AddMessage(msg);
+    thread->stats.AddBytes(bytes);
+  }
+
+  // There is no batched Get(), so each batch is read in key order against
+  // a single snapshot, which is what a batched lookup would amount to.
+  void MultiReadRandom(ThreadState* thread) {
+    const int batch_size = std::max(1, FLAGS_multiread_batch_size);
+    std::vector<int> keys(batch_size);
+    std::string value;
+    int found = 0;
+    int i = 0;
+    while (i < reads_) {
+      const int n = std::min(batch_size, reads_ - i);
+      for (int j = 0; j < n; j++) {
+        keys[j] = key_gen_.Next(&thread->rand);
+      }
+      std::sort(keys.begin(), keys.begin() + n);
+      ReadOptions options;
+      options.snapshot = db_->GetSnapshot();
+      for (int j = 0; j < n; j++) {
+        char key[100];
+        snprintf(key, sizeof(key), "%016d", keys[j]);
+        if (db_->Get(options, key, &value).ok()) found++;
+        thread->stats.FinishedSingleOp();
+      }
+      db_->ReleaseSnapshot(options.snapshot);
+      i += n;
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found, batch %d)",
+             found, reads_, batch_size);
+    thread->stats.AddMessage(msg);
+  }
+
+  // Each thread issues a mix of gets, puts and seeks in the proportions
+  // given by --mix_{get,put,seek}_ratio.
+  void MixGraph(ThreadState* thread) {
+    double get_ratio = std::max(0.0, FLAGS_mix_get_ratio);
+    double put_ratio = std::max(0.0, FLAGS_mix_put_ratio);
+    double seek_ratio = std::max(0.0, FLAGS_mix_seek_ratio);
+    const double total = get_ratio + put_ratio + seek_ratio;
+    if (total <= 0) {
+      thread->stats.AddMessage("(all mix ratios are zero)");
+      return;
+    }
+    get_ratio /= total;
+    put_ratio /= total;
+
+    ReadOptions options;
+    RandomGenerator gen;
+    std::string value;
+    int gets = 0, puts = 0, seeks = 0;
+    int64_t bytes = 0;
+    for (int i = 0; i < reads_; i++) {
+      char key[100];
+      const int k = key_gen_.Next(&thread->rand);
+      snprintf(key, sizeof(key), "%016d", k);
+      const double op = RandomDouble(&thread->rand);
+      if (op < get_ratio) {
+        if (db_->Get(options, key, &value).ok()) {
+          bytes += strlen(key) + value.size();
+        }
+        gets++;
+      } else if (op < get_ratio + put_ratio) {
+        if (thread->shared->write_limiter != NULL) {
+          thread->shared->write_limiter->Request(value_size_ + strlen(key));
+        }
+        Status s = db_->Put(write_options_, key, gen.Generate(value_size_));
+        if (!s.ok()) {
+          fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+          exit(1);
+        }
+        bytes += strlen(key) + value_size_;
+        puts++;
+      } else {
+        Iterator* iter = db_->NewIterator(options);
+        iter->Seek(key);
+        for (int j = 0; j < FLAGS_seek_nexts && iter->Valid(); j++) {
+          bytes += iter->key().size() + iter->value().size();
+          iter->Next();
+        }
+        delete iter;
+        seeks++;
+      }
+      thread->stats.FinishedSingleOp();
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(gets:%d puts:%d seeks:%d)", gets, puts, seeks);
+    thread->stats.AddMessage(msg);
+    thread->stats.AddBytes(bytes);
+  }
+
   void Compact(ThreadState* thread) {
     DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
     dbi->TEST_CompactMemTable();
@@ -808,7 +1205,7 @@ class Benchmark {
       }
     }
     for (int level = 0; level < max_level_with_files; level++) {
-      dbi->TEST_CompactRange(level, "", "~");
+      dbi->TEST_CompactRange(level, NULL, NULL);
     }
   }
 
@@ -851,6 +1248,7 @@ int main(int argc, char** argv) {
   for (int i = 1; i < argc; i++) {
     double d;
     int n;
+    long long ll;
     char junk;
     if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
       FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
@@ -878,6 +1276,42 @@ int main(int argc, char** argv) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
+    } else if (strncmp(argv[i], "--key_dist=", 11) == 0) {
+      FLAGS_key_dist = argv[i] + 11;
+      if (strcmp(FLAGS_key_dist, "uniform") != 0 &&
+          strcmp(FLAGS_key_dist, "zipfian") != 0 &&
+          strcmp(FLAGS_key_dist, "hotspot") != 0) {
+        fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+        exit(1);
+      }
+    } else if (sscanf(argv[i], "--zipf_theta=%lf%c", &d, &junk) == 1 &&
+               d > 0 && d < 1) {
+      FLAGS_zipf_theta = d;
+    } else if (sscanf(argv[i], "--hotspot_fraction=%lf%c", &d, &junk) == 1 &&
+               d > 0 && d <= 1) {
+      FLAGS_hotspot_fraction = d;
+    } else if (sscanf(argv[i], "--hotspot_access=%lf%c", &d, &junk) == 1 &&
+               d >= 0 && d <= 1) {
+      FLAGS_hotspot_access = d;
+    } else if (sscanf(argv[i], "--seek_nexts=%d%c", &n, &junk) == 1) {
+      FLAGS_seek_nexts = n;
+    } else if (sscanf(argv[i], "--multiread_batch_size=%d%c", &n, &junk) == 1) {
+      FLAGS_multiread_batch_size = n;
+    } else if (sscanf(argv[i], "--mix_get_ratio=%lf%c", &d, &junk) == 1) {
+      FLAGS_mix_get_ratio = d;
+    } else if (sscanf(argv[i], "--mix_put_ratio=%lf%c", &d, &junk) == 1) {
+      FLAGS_mix_put_ratio = d;
+    } else if (sscanf(argv[i], "--mix_seek_ratio=%lf%c", &d, &junk) == 1) {
+      FLAGS_mix_seek_ratio = d;
+    } else if (sscanf(argv[i], "--benchmark_write_rate_limit=%lld%c",
+                      &ll, &junk) == 1) {
+      FLAGS_benchmark_write_rate_limit = ll;
+    } else if (sscanf(argv[i], "--stats_interval_seconds=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_stats_interval_seconds = n;
+    } else if (sscanf(argv[i], "--json=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_json = n;
     } else {
       fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
       exit(1);
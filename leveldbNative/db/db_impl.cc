@@ -7,12 +7,15 @@
 #include "db/db_impl.h"
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
+#include "db/blob_file.h"
 #include "db/builder.h"
+#include "db/compaction_pipeline.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
@@ -23,6 +26,7 @@
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/replay_iterator.h"
@@ -31,11 +35,15 @@
 #include "leveldb/table_builder.h"
 #include "port/port.h"
 #include "table/block.h"
+#include "table/format.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/parallel.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics.h"
 #include "util/atomic.h"
 
 #include <iostream>
@@ -57,7 +65,7 @@ namespace leveldb {
 		uint64_t micros_;
 		uint64_t start_sequence_;
 		uint64_t end_sequence_;
-		MemTable* mem_;
+		ColumnFamilyMemTables mems_;    // Each one Ref'd
 		SHARED_PTR<WritableFile> logfile_;
 		SHARED_PTR<log::Writer> log_;
 
@@ -72,7 +80,7 @@ namespace leveldb {
 			micros_(0),
 			start_sequence_(0),
 			end_sequence_(0),
-			mem_(NULL),
+			mems_(),
 			logfile_(),
 			log_() {
 		}
@@ -85,8 +93,8 @@ namespace leveldb {
 			}
 
 			// safe because Unref is synchronized internally
-			if (mem_) {
-				mem_->Unref();
+			for (size_t i = 0; i < mems_.size(); i++) {
+				mems_[i].second->Unref();
 			}
 		}
 	private:
@@ -95,20 +103,40 @@ namespace leveldb {
 	};
 
 	struct DBImpl::CompactionState {
+		ColumnFamilyData* const cfd;
 		Compaction* const compaction;
 
 		// Sequence numbers < smallest_snapshot are not significant since we
 		// will never have to service a snapshot below smallest_snapshot.
-		// Therefore if we have seen a sequence number S <= smallest_snapshot,
-		// we can drop all entries for the same key with sequence numbers < S.
+		// Therefore every reader sees a deletion marker at or below
+		// smallest_snapshot, and the compaction filter may rewrite such
+		// entries without readers disagreeing.
 		SequenceNumber smallest_snapshot;
 
+		// Sequence numbers of all live snapshots, oldest first.  They split
+		// the versions of a key into stripes: the versions no newer than
+		// snapshots[0], the ones after it up to snapshots[1], and so on,
+		// with everything after the newest snapshot in a last stripe.  The
+		// readers that see one version of a stripe see them all, so only the
+		// newest version of each stripe needs to be kept.
+		std::vector<SequenceNumber> snapshots;
+
+		// Return the snapshot that bounds the stripe holding "seq", or
+		// kMaxSequenceNumber for the last stripe.
+		SequenceNumber StripeOf(SequenceNumber seq) const {
+			std::vector<SequenceNumber>::const_iterator it =
+				std::lower_bound(snapshots.begin(), snapshots.end(), seq);
+			return it == snapshots.end() ? kMaxSequenceNumber : *it;
+		}
+
 		// Files produced by compaction
 		struct Output {
-			Output() : number(), file_size(), smallest(), largest() {}
+			Output() : number(), file_size(), smallest(), largest(), max_sequence(), min_expiry() {}
 			uint64_t number;
 			uint64_t file_size;
 			InternalKey smallest, largest;
+			SequenceNumber max_sequence;
+			uint64_t min_expiry;        // ~0 if no entry expires
 		};
 		std::vector<Output> outputs;
 
@@ -118,15 +146,62 @@ namespace leveldb {
 
 		uint64_t total_bytes;
 
+		CompactionReason reason;
+
+		// Number for the first output, taken when the compaction was picked
+		// (see VersionSet::PickUniversalCompaction); 0 if none.
+		uint64_t reserved_output;
+
+		// Blob file taking the large values of the outputs; created on
+		// first use (see Options::min_blob_size)
+		BlobFileBuilder* blobs;
+
+		// Blob files as of the start of the compaction, and the bytes of
+		// each that the compaction dropped or moved to "blobs"
+		std::map<uint64_t, BlobFileMetaData> blob_files;
+		std::map<uint64_t, uint64_t> blob_garbage;
+
 		Output* current_output() { return &outputs[outputs.size() - 1]; }
 
-		explicit CompactionState(Compaction* c)
-			: compaction(c),
+		CompactionState(ColumnFamilyData* f, Compaction* c, CompactionReason r)
+			: cfd(f),
+			compaction(c),
 			smallest_snapshot(),
+			snapshots(),
 			outputs(),
 			outfile(NULL),
 			builder(NULL),
-			total_bytes(0) {
+			total_bytes(0),
+			reason(r),
+			reserved_output(0),
+			blobs(NULL),
+			blob_files(),
+			blob_garbage() {
+		}
+
+		// Record that the blob value "blob_index" refers to is no longer
+		// used by the output.
+		void AddBlobGarbage(const Slice& blob_index) {
+			BlobIndex bi;
+			if (bi.DecodeFrom(blob_index).ok()) {
+				blob_garbage[bi.file_number] += bi.size;
+			}
+		}
+
+		// Return true if the blob file "blob_index" refers into was less
+		// than gc_percent live when the compaction started.
+		bool ShouldRewriteBlob(const Slice& blob_index, int gc_percent) const {
+			BlobIndex bi;
+			if (gc_percent <= 0 || !bi.DecodeFrom(blob_index).ok()) {
+				return false;
+			}
+			std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+				blob_files.find(bi.file_number);
+			if (it == blob_files.end()) {
+				return false;
+			}
+			const uint64_t live = it->second.total_bytes - it->second.garbage_bytes;
+			return live * 100 < it->second.total_bytes * static_cast<uint64_t>(gc_percent);
 		}
 	private:
 		CompactionState(const CompactionState&);
@@ -149,6 +224,9 @@ namespace leveldb {
 		ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
 		ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
 		ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+		ClipToRange(&result.universal_size_ratio, 0, 1 << 20);
+		ClipToRange(&result.universal_min_merge_width, 2, 1 << 20);
+		ClipToRange(&result.universal_max_size_amplification_percent, 0, 1 << 20);
 		if (result.info_log == NULL) {
 			// Open a log file in the same directory as the db
 			src.env->CreateDir(dbname);  // In case it does not exist
@@ -165,7 +243,28 @@ namespace leveldb {
 		return result;
 	}
 
-	DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
+	// What the methods that would change the DB return when it was
+	// opened read-only
+	static Status ReadOnlyError() {
+		return Status::NotSupported("the DB was opened read-only");
+	}
+
+	// Delete the files of a dropped column family and its directory.
+	static void DeleteColumnFamilyDir(Env* env, const std::string& dir) {
+		std::vector<std::string> filenames;
+		env->GetChildren(dir, &filenames);  // Ignoring errors on purpose
+		uint64_t number;
+		FileType type;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			if (ParseFileName(filenames[i], &number, &type)) {
+				env->DeleteFile(dir + "/" + filenames[i]);
+			}
+		}
+		env->DeleteDir(dir);  // Ignore error in case dir contains other files
+	}
+
+	DBImpl::DBImpl(const Options& raw_options, const std::string& dbname,
+		const Options& default_cf_options, OpenMode mode)
 		: env_(raw_options.env),
 		internal_comparator_(raw_options.comparator),
 		internal_filter_policy_(raw_options.filter_policy),
@@ -174,12 +273,12 @@ namespace leveldb {
 		owns_info_log_(options_.info_log != raw_options.info_log),
 		owns_cache_(options_.block_cache != raw_options.block_cache),
 		dbname_(dbname),
-		table_cache_(),
+		open_mode_(mode),
 		db_lock_(NULL),
+		catch_up_mutex_(),
+		create_cf_mutex_(),
 		mutex_(),
 		shutting_down_(NULL),
-		mem_(new MemTable(internal_comparator_)),
-		imm_(NULL),
 		has_imm_(),
 		logfile_(),
 		logfile_number_(0),
@@ -189,7 +288,11 @@ namespace leveldb {
 		writers_upper_(0),
 		writers_tail_(NULL),
 		snapshots_(),
-		pending_outputs_(),
+		default_cf_(NULL),
+		column_families_(),
+		dropped_column_families_(),
+		read_only_cf_options_(),
+		next_compaction_family_(0),
 		allow_background_activity_(false),
 		num_bg_threads_(0),
 		bg_fg_cv_(&mutex_),
@@ -208,24 +311,25 @@ namespace leveldb {
 		backup_waiters_(0),
 		backup_waiter_has_it_(false),
 		backup_deferred_delete_(),
-		bg_error_() {
+		bg_error_(),
+		pending_deleted_files_(),
+		pending_stall_changes_(),
+		pending_bg_errors_(),
+		stall_condition_(kStallNormal),
+		stall_memtable_micros_(0),
+		stall_level0_micros_(0) {
 		mutex_.Lock();
-		mem_->Ref();
 		has_imm_.Release_Store(NULL);
 		backup_in_progress_.Release_Store(NULL);
-		env_->StartThread(&DBImpl::CompactMemTableWrapper, this);
-		env_->StartThread(&DBImpl::CompactLevelWrapper, this);
-		num_bg_threads_ = 2;
-
-		// Reserve ten files or so for other uses and give the rest to TableCache.
-		const int table_cache_size = options_.max_open_files - kNumNonTableCacheFiles;
-		table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
-		versions_ = new VersionSet(dbname_, &options_, table_cache_,
-			&internal_comparator_);
-
-		for (unsigned i = 0; i < leveldb::config::kNumLevels; ++i) {
-			levels_locked_[i] = false;
+		if (open_mode_ == kOpenReadWrite) {
+			env_->StartThread(&DBImpl::CompactMemTableWrapper, this);
+			env_->StartThread(&DBImpl::CompactLevelWrapper, this);
+			num_bg_threads_ = 2;
 		}
+
+		default_cf_ = NewColumnFamilyData(0, kDefaultColumnFamilyName, default_cf_options);
+		column_families_[0] = default_cf_;
+		versions_ = default_cf_->versions;
 		mutex_.Unlock();
 		writers_mutex_.Lock();
 		writers_mutex_.Unlock();
@@ -240,18 +344,30 @@ namespace leveldb {
 		while (num_bg_threads_ > 0) {
 			bg_fg_cv_.Wait();
 		}
+		NotifyDeferredEvents();
 		mutex_.Unlock();
 
+		for (std::map<uint32_t, ColumnFamilyData*>::iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			delete it->second;
+		}
+		// The descriptor records the drops, so the files can go even while
+		// another process may be waiting for the lock.
+		for (size_t i = 0; i < dropped_column_families_.size(); i++) {
+			const std::string dir = dropped_column_families_[i]->dir;
+			delete dropped_column_families_[i];
+			if (db_lock_ != NULL) {
+				DeleteColumnFamilyDir(env_, dir);
+			}
+		}
+
 		if (db_lock_ != NULL) {
 			env_->UnlockFile(db_lock_);
 		}
 
-		delete versions_;
-		if (mem_ != NULL) mem_->Unref();
-		if (imm_ != NULL) imm_->Unref();
 		log_.reset();
 		logfile_.reset();
-		delete table_cache_;
 
 		if (owns_info_log_) {
 			delete options_.info_log;
@@ -261,14 +377,33 @@ namespace leveldb {
 		}
 	}
 
-	Status DBImpl::NewDB() {
+	ColumnFamilyData* DBImpl::NewColumnFamilyData(uint32_t id, const std::string& name,
+		const Options& options) {
+		const std::string dir = (id == 0) ? dbname_ : ColumnFamilyDirName(dbname_, id);
+		ColumnFamilyData* cfd = new ColumnFamilyData(id, name, dir, options_, options);
+		// Reserve ten files or so for other uses and give the rest to TableCache.
+		const int table_cache_size = cfd->options.max_open_files - kNumNonTableCacheFiles;
+		cfd->table_cache = new TableCache(cfd->dir, &cfd->options, table_cache_size);
+		cfd->versions = new VersionSet(cfd->dir, &cfd->options, cfd->table_cache,
+			&cfd->internal_comparator);
+		return cfd;
+	}
+
+	ColumnFamilyData* DBImpl::GetColumnFamilyData(ColumnFamilyHandle* column_family) const {
+		if (column_family == NULL) {
+			return default_cf_;
+		}
+		return reinterpret_cast<ColumnFamilyHandleImpl*>(column_family)->cfd();
+	}
+
+	Status DBImpl::NewDB(ColumnFamilyData* cfd, uint64_t log_number) {
 		VersionEdit new_db;
-		new_db.SetComparatorName(user_comparator()->Name());
-		new_db.SetLogNumber(0);
-		new_db.SetNextFile(2);
+		new_db.SetComparatorName(cfd->user_comparator()->Name());
+		new_db.SetLogNumber(log_number);
+		new_db.SetNextFile(std::max(log_number + 1, static_cast<uint64_t>(2)));
 		new_db.SetLastSequence(0);
 
-		const std::string manifest = DescriptorFileName(dbname_, 1);
+		const std::string manifest = DescriptorFileName(cfd->dir, 1);
 		ConcurrentWritableFile* file;
 		Status s = env_->NewConcurrentWritableFile(manifest, &file);
 		if (!s.ok()) {
@@ -286,7 +421,7 @@ namespace leveldb {
 		delete file;
 		if (s.ok()) {
 			// Make "CURRENT" file that points to the new manifest file.
-			s = SetCurrentFile(env_, dbname_, 1);
+			s = SetCurrentFile(env_, cfd->dir, 1);
 		}
 		else {
 			env_->DeleteFile(manifest);
@@ -304,6 +439,30 @@ namespace leveldb {
 		}
 	}
 
+	uint64_t DBImpl::MinLogNumberToKeep() {
+		mutex_.AssertHeld();
+		uint64_t min_log = logfile_number_;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			uint64_t number;
+			if (it->second->OldestLogWithEntries(&number) && number < min_log) {
+				min_log = number;
+			}
+		}
+		return min_log;
+	}
+
+	Status DBImpl::LogAndApply(ColumnFamilyData* cfd, VersionEdit* edit) {
+		mutex_.AssertHeld();
+		if (cfd != default_cf_) {
+			// Log numbers come from the default column family's counter
+			cfd->versions->SetLastSequence(versions_->LastSequence());
+			cfd->versions->MarkFileNumberUsed(logfile_number_);
+		}
+		return cfd->versions->LogAndApply(edit, &mutex_, &bg_log_cv_, &bg_log_occupied_);
+	}
+
 	void DBImpl::DeleteObsoleteFiles() {
 		// Defer if there's background activity
 		mutex_.AssertHeld();
@@ -321,73 +480,101 @@ namespace leveldb {
 			return;
 		}
 
-		// Make a set of all of the live files
-		std::set<uint64_t> live = pending_outputs_;
-		versions_->AddLiveFiles(&live);
+		const uint64_t min_log = MinLogNumberToKeep();
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			ColumnFamilyData* cfd = it->second;
 
-		std::vector<std::string> filenames;
-		env_->GetChildren(dbname_, &filenames); // Ignoring errors on purpose
-		uint64_t number;
-		FileType type;
-		for (size_t i = 0; i < filenames.size(); i++) {
-			if (ParseFileName(filenames[i], &number, &type)) {
-				bool keep = true;
-				switch (type) {
-				case kLogFile:
-					keep = ((number >= versions_->LogNumber()) ||
-						(number == versions_->PrevLogNumber()));
-					break;
-				case kDescriptorFile:
-					// Keep my manifest file, and any newer incarnations'
-					// (in case there is a race that allows other incarnations)
-					keep = (number >= versions_->ManifestFileNumber());
-					break;
-				case kTableFile:
-					keep = (live.find(number) != live.end());
-					break;
-				case kTempFile:
-					// Any temp files that are currently being written to must
-					// be recorded in pending_outputs_, which is inserted into "live"
-					keep = (live.find(number) != live.end());
-					break;
-				case kCurrentFile:
-				case kDBLockFile:
-				case kInfoLogFile:
-					keep = true;
-					break;
-				default:
-					keep = true;
-					break;
-				}
+			// Make a set of all of the live files
+			std::set<uint64_t> live = cfd->pending_outputs;
+			cfd->versions->AddLiveFiles(&live);
+
+			std::vector<std::string> filenames;
+			env_->GetChildren(cfd->dir, &filenames); // Ignoring errors on purpose
+			uint64_t number;
+			FileType type;
+			for (size_t i = 0; i < filenames.size(); i++) {
+				if (ParseFileName(filenames[i], &number, &type)) {
+					bool keep = true;
+					switch (type) {
+					case kLogFile:
+						keep = cfd != default_cf_ ||
+							(number >= min_log) ||
+							(number == versions_->PrevLogNumber());
+						break;
+					case kDescriptorFile:
+						// Keep my manifest file, and any newer incarnations'
+						// (in case there is a race that allows other incarnations)
+						keep = (number >= cfd->versions->ManifestFileNumber());
+						break;
+					case kTableFile:
+					case kBlobFile:
+						keep = (live.find(number) != live.end());
+						break;
+					case kTempFile:
+						// Any temp files that are currently being written to must
+						// be recorded in pending_outputs, which is inserted into "live"
+						keep = (live.find(number) != live.end());
+						break;
+					case kCurrentFile:
+					case kDBLockFile:
+					case kInfoLogFile:
+						keep = true;
+						break;
+					default:
+						keep = true;
+						break;
+					}
 
-				if (!keep) {
-					if (type == kTableFile) {
-						table_cache_->Evict(number);
+					if (!keep) {
+						if (type == kTableFile || type == kBlobFile) {
+							cfd->table_cache->Evict(number);
+						}
+						Log(options_.info_log, "Delete type=%d #%lld\n",
+							int(type),
+							static_cast<unsigned long long>(number));
+						const std::string fname = cfd->dir + "/" + filenames[i];
+						Status s = env_->DeleteFile(fname);
+						if (type == kTableFile && options_.listener != NULL) {
+							TableFileInfo info;
+							info.db_name = dbname_;
+							info.file_path = fname;
+							info.file_number = number;
+							info.status = s;
+							pending_deleted_files_.push_back(info);
+						}
 					}
-					Log(options_.info_log, "Delete type=%d #%lld\n",
-						int(type),
-						static_cast<unsigned long long>(number));
-					env_->DeleteFile(dbname_ + "/" + filenames[i]);
 				}
 			}
 		}
 	}
 
-	Status DBImpl::Recover(VersionEdit* edit) {
+	Status DBImpl::Recover(const std::map<std::string, Options>& cf_options,
+		std::map<uint32_t, VersionEdit>* edits) {
 		mutex_.AssertHeld();
-		// Ignore error from CreateDir since the creation of the DB is
-		// committed only when the descriptor is created, and this directory
-		// may already exist from a previous failed creation attempt.
-		env_->CreateDir(dbname_);
-		assert(db_lock_ == NULL);
-		Status s = env_->LockFile(LockFileName(dbname_), &db_lock_);
-		if (!s.ok()) {
-			return s;
+		// A read-only instance leaves the directory to the process that has
+		// the lock, and neither creates nor deletes anything in it.
+		const bool read_only = open_mode_ != kOpenReadWrite;
+		Status s;
+		if (!read_only) {
+			// Ignore error from CreateDir since the creation of the DB is
+			// committed only when the descriptor is created, and this directory
+			// may already exist from a previous failed creation attempt.
+			env_->CreateDir(dbname_);
+			assert(db_lock_ == NULL);
+			s = env_->LockFile(LockFileName(dbname_), &db_lock_);
+			if (!s.ok()) {
+				return s;
+			}
 		}
 
 		if (!env_->FileExists(CurrentFileName(dbname_))) {
-			if (options_.create_if_missing) {
-				s = NewDB();
+			if (read_only) {
+				return Status::InvalidArgument(dbname_, "does not exist");
+			}
+			else if (options_.create_if_missing) {
+				s = NewDB(default_cf_, 0);
 				if (!s.ok()) {
 					return s;
 				}
@@ -405,32 +592,80 @@ namespace leveldb {
 		}
 
 		s = versions_->Recover();
-		if (s.ok()) {
-			SequenceNumber max_sequence(0);
-
-			// Recover from all newer log files than the ones named in the
-			// descriptor (new log files may have been added by the previous
-			// incarnation without registering them in the descriptor).
-			//
-			// Note that PrevLogNumber() is no longer used, but we pay
-			// attention to it in case we are recovering a database
-			// produced by an older version of leveldb.
-			const uint64_t min_log = versions_->LogNumber();
-			const uint64_t prev_log = versions_->PrevLogNumber();
+		if (!s.ok()) {
+			return s;
+		}
+
+		// Every column family the default one's descriptor names must be
+		// opened; a read-only instance opens them in CatchUp().  One whose
+		// directory has no descriptor was being created when the previous
+		// incarnation stopped, so it cannot have entries in any log.
+		const std::map<uint32_t, std::string>& families = versions_->ColumnFamilies();
+		for (std::map<uint32_t, std::string>::const_iterator it = families.begin();
+			it != families.end();
+			++it) {
+			std::map<std::string, Options>::const_iterator opt = cf_options.find(it->second);
+			if (opt == cf_options.end() && read_only) {
+				continue;
+			}
+			else if (opt == cf_options.end()) {
+				return Status::InvalidArgument(it->second, "column family not opened");
+			}
+			ColumnFamilyData* cfd = NewColumnFamilyData(it->first, it->second, opt->second);
+			column_families_[cfd->id] = cfd;
+			if (!env_->FileExists(CurrentFileName(cfd->dir))) {
+				env_->CreateDir(cfd->dir);
+				s = NewDB(cfd, versions_->LogNumber());
+			}
+			if (s.ok()) {
+				s = cfd->versions->Recover();
+			}
+			if (!s.ok()) {
+				return s;
+			}
+		}
+		const std::set<uint32_t>& dropped = versions_->DroppedColumnFamilies();
+		for (std::set<uint32_t>::const_iterator it = dropped.begin();
+			!read_only && it != dropped.end();
+			++it) {
+			DeleteColumnFamilyDir(env_, ColumnFamilyDirName(dbname_, *it));
+		}
+
+		SequenceNumber max_sequence(0);
+
+		// Recover from all newer log files than the ones named in the
+		// descriptors (new log files may have been added by the previous
+		// incarnation without registering them in the descriptor).
+		//
+		// Note that PrevLogNumber() is no longer used, but we pay
+		// attention to it in case we are recovering a database
+		// produced by an older version of leveldb.
+		uint64_t min_log = versions_->LogNumber();
+		const uint64_t prev_log = versions_->PrevLogNumber();
+		std::vector<uint64_t> logs;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			ColumnFamilyData* cfd = it->second;
+			min_log = std::min(min_log, cfd->versions->LogNumber());
+			if (max_sequence < cfd->versions->LastSequence()) {
+				max_sequence = cfd->versions->LastSequence();
+			}
+
 			std::vector<std::string> filenames;
-			s = env_->GetChildren(dbname_, &filenames);
+			s = env_->GetChildren(cfd->dir, &filenames);
 			if (!s.ok()) {
 				return s;
 			}
 			std::set<uint64_t> expected;
-			versions_->AddLiveFiles(&expected);
+			cfd->versions->AddLiveFiles(&expected);
 			uint64_t number;
 			FileType type;
-			std::vector<uint64_t> logs;
 			for (size_t i = 0; i < filenames.size(); i++) {
-				if (ParseFileName(filenames[i], &number, &type)) {
+				if (ParseFileName(filenames[i], &number, &type) &&
+					type != kColumnFamilyDir) {
 					expected.erase(number);
-					if (type == kLogFile && ((number >= min_log) || (number == prev_log)))
+					if (cfd == default_cf_ && type == kLogFile)
 						logs.push_back(number);
 				}
 			}
@@ -438,33 +673,191 @@ namespace leveldb {
 				char buf[50];
 				snprintf(buf, sizeof(buf), "%d missing files; e.g.",
 					static_cast<int>(expected.size()));
-				return Status::Corruption(buf, TableFileName(dbname_, *(expected.begin())));
+				return Status::Corruption(buf, TableFileName(cfd->dir, *(expected.begin())));
+			}
+			if (options_.paranoid_checks) {
+				s = VerifyTableFiles(cfd);
+				if (!s.ok()) {
+					return s;
+				}
 			}
+		}
 
-			// Recover in the order in which the logs were generated
-			std::sort(logs.begin(), logs.end());
-			for (size_t i = 0; i < logs.size(); i++) {
-				s = RecoverLogFile(logs[i], edit, &max_sequence);
+		if (read_only) {
+			// The logs are replayed by CatchUp(), which keeps them in memory
+			versions_->SetLastSequence(max_sequence);
+			return s;
+		}
 
-				// The previous incarnation may not have written any MANIFEST
-				// records after allocating this log number.  So we manually
-				// update the file number allocation counter in VersionSet.
-				versions_->MarkFileNumberUsed(logs[i]);
+		// Recover in the order in which the logs were generated
+		std::sort(logs.begin(), logs.end());
+		for (size_t i = 0; i < logs.size(); i++) {
+			if (logs[i] < min_log && logs[i] != prev_log) {
+				continue;
 			}
+			s = RecoverLogFile(logs[i], edits, &max_sequence);
 
-			if (s.ok()) {
-				if (versions_->LastSequence() < max_sequence) {
-					versions_->SetLastSequence(max_sequence);
-				}
+			// The previous incarnation may not have written any MANIFEST
+			// records after allocating this log number.  So we manually
+			// update the file number allocation counter in VersionSet.
+			versions_->MarkFileNumberUsed(logs[i]);
+		}
+
+		if (s.ok()) {
+			if (versions_->LastSequence() < max_sequence) {
+				versions_->SetLastSequence(max_sequence);
 			}
 		}
 
 		return s;
 	}
 
-	Status DBImpl::RecoverLogFile(uint64_t log_number,
-		VersionEdit* edit,
-		SequenceNumber* max_sequence) {
+	namespace {
+
+		// The live tables of a version, flattened lowest level first, for
+		// the bulk operations run through ParallelFor.
+		struct TableFileList {
+			TableFileList(Env* e, TableCache* tc, const std::string& name)
+				: env(e),
+				table_cache(tc),
+				dbname(name),
+				files(),
+				statuses(),
+				loaded(),
+				shutting_down(NULL) {
+			}
+
+			Env* const env;
+			TableCache* const table_cache;
+			const std::string& dbname;
+			std::vector<FileMetaData*> files;
+			std::vector<Status> statuses;
+			std::vector<char> loaded;               // Set by LoadTableFile on success
+			port::AtomicPointer* shutting_down;    // Checked between files; may be NULL
+
+			void Collect(Version* v) {
+				std::vector<FileMetaData*> level_files;
+				for (unsigned level = 0; level < config::kNumLevels; level++) {
+					v->GetOverlappingInputs(level, NULL, NULL, &level_files);
+					files.insert(files.end(), level_files.begin(), level_files.end());
+				}
+			}
+
+			void Truncate(size_t n) {
+				if (files.size() > n) {
+					files.resize(n);
+				}
+				statuses.resize(files.size());
+				loaded.resize(files.size(), 0);
+			}
+
+		private:
+			TableFileList(const TableFileList&);
+			TableFileList& operator = (const TableFileList&);
+		};
+
+		void VerifyTableFile(void* arg, int i) {
+			TableFileList* list = reinterpret_cast<TableFileList*>(arg);
+			const FileMetaData* f = list->files[i];
+			std::string fname = TableFileName(list->dbname, f->number);
+			uint64_t size = 0;
+			Status s = list->env->GetFileSize(fname, &size);
+			if (!s.ok()) {
+				fname = LDBTableFileName(list->dbname, f->number);
+				s = list->env->GetFileSize(fname, &size);
+			}
+			if (s.ok() && size != f->file_size) {
+				char buf[80];
+				snprintf(buf, sizeof(buf), "table file has %llu bytes, expected %llu",
+					(unsigned long long) size,
+					(unsigned long long) f->file_size);
+				s = Status::Corruption(buf, fname);
+			}
+			list->statuses[i] = s;
+		}
+
+		void LoadTableFile(void* arg, int i) {
+			TableFileList* list = reinterpret_cast<TableFileList*>(arg);
+			if (list->shutting_down != NULL && list->shutting_down->Acquire_Load()) {
+				return;
+			}
+			const FileMetaData* f = list->files[i];
+			list->statuses[i] = list->table_cache->Load(f->number, f->file_size);
+			list->loaded[i] = list->statuses[i].ok();
+		}
+
+	}  // namespace
+
+	Status DBImpl::VerifyTableFiles(ColumnFamilyData* cfd) {
+		mutex_.AssertHeld();
+		const uint64_t start_micros = env_->NowMicros();
+		TableFileList list(env_, cfd->table_cache, cfd->dir);
+		list.Collect(cfd->versions->current());
+		list.Truncate(list.files.size());
+		// Nothing else runs during recovery, so the lock is simply kept
+		// while the workers stat the files.
+		ParallelFor(env_, options_.max_file_opening_threads,
+			static_cast<int>(list.files.size()), &VerifyTableFile, &list);
+		for (size_t i = 0; i < list.statuses.size(); i++) {
+			if (!list.statuses[i].ok()) {
+				return list.statuses[i];
+			}
+		}
+		Log(options_.info_log, "Verified %d table files of column family %s in %llu ms",
+			static_cast<int>(list.files.size()), cfd->name.c_str(),
+			(unsigned long long) (env_->NowMicros() - start_micros) / 1000);
+		return Status::OK();
+	}
+
+	void DBImpl::WarmTableCacheThread() {
+		// Column families are only deleted with the DB, which waits for
+		// this thread.
+		std::vector<ColumnFamilyData*> families;
+		mutex_.Lock();
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			families.push_back(it->second);
+		}
+		mutex_.Unlock();
+
+		for (size_t f = 0; f < families.size() && !shutting_down_.Acquire_Load(); f++) {
+			ColumnFamilyData* cfd = families[f];
+			const uint64_t start_micros = env_->NowMicros();
+			TableFileList list(env_, cfd->table_cache, cfd->dir);
+			list.shutting_down = &shutting_down_;
+			mutex_.Lock();
+			Version* current = cfd->versions->current();
+			current->Ref();
+			list.Collect(current);
+			mutex_.Unlock();
+
+			// Opening more tables than the cache holds would only evict the
+			// ones opened first.
+			list.Truncate(cfd->options.max_open_files - kNumNonTableCacheFiles);
+			ParallelFor(env_, options_.max_file_opening_threads,
+				static_cast<int>(list.files.size()), &LoadTableFile, &list);
+			int opened = 0;
+			for (size_t i = 0; i < list.loaded.size(); i++) {
+				opened += list.loaded[i];
+			}
+			Log(options_.info_log, "Table cache warm-up of column family %s: opened %d of %d tables in %llu ms",
+				cfd->name.c_str(), opened, static_cast<int>(list.files.size()),
+				(unsigned long long) (env_->NowMicros() - start_micros) / 1000);
+
+			mutex_.Lock();
+			current->Unref();
+			mutex_.Unlock();
+		}
+
+		mutex_.Lock();
+		--num_bg_threads_;
+		bg_fg_cv_.SignalAll();
+		mutex_.Unlock();
+	}
+
+	namespace {
+
 		struct LogReporter : public log::Reader::Reporter {
 			LogReporter()
 				: env(),
@@ -475,7 +868,7 @@ namespace leveldb {
 			Env* env;
 			Logger* info_log;
 			const char* fname;
-			Status* status;  // NULL if options_.paranoid_checks==false
+			Status* status;  // NULL if errors are to be ignored
 			virtual void Corruption(size_t bytes, const Status& s) {
 				Log(info_log, "%s%s: dropping %d bytes; %s",
 					(this->status == NULL ? "(ignoring error) " : ""),
@@ -487,6 +880,11 @@ namespace leveldb {
 			LogReporter& operator = (const LogReporter&);
 		};
 
+	}  // namespace
+
+	Status DBImpl::RecoverLogFile(uint64_t log_number,
+		std::map<uint32_t, VersionEdit>* edits,
+		SequenceNumber* max_sequence) {
 		mutex_.AssertHeld();
 
 		// Open the log file
@@ -513,11 +911,25 @@ namespace leveldb {
 		Log(options_.info_log, "Recovering log #%llu",
 			(unsigned long long) log_number);
 
-		// Read all the records and add to a memtable
+		// Only the column families whose tables may lack entries of this
+		// log get a memtable; the entries of the others are skipped.
+		ColumnFamilyMemTables mems;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			ColumnFamilyData* cfd = it->second;
+			if (log_number >= cfd->versions->LogNumber() ||
+				(cfd == default_cf_ && log_number == versions_->PrevLogNumber())) {
+				MemTable* mem = new MemTable(cfd->internal_comparator);
+				mem->Ref();
+				mems.push_back(std::make_pair(cfd->id, mem));
+			}
+		}
+
+		// Read all the records and add to the memtables
 		std::string scratch;
 		Slice record;
 		WriteBatch batch;
-		MemTable* mem = NULL;
 		while (reader.ReadRecord(&record, &scratch) &&
 			status.ok()) {
 			if (record.size() < 12) {
@@ -527,11 +939,7 @@ namespace leveldb {
 			}
 			WriteBatchInternal::SetContents(&batch, record);
 
-			if (mem == NULL) {
-				mem = new MemTable(internal_comparator_);
-				mem->Ref();
-			}
-			status = WriteBatchInternal::InsertInto(&batch, mem);
+			status = WriteBatchInternal::InsertInto(&batch, mems);
 			MaybeIgnoreError(&status);
 			if (!status.ok()) {
 				break;
@@ -543,76 +951,385 @@ namespace leveldb {
 				*max_sequence = last_seq;
 			}
 
-			if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
-				status = WriteLevel0Table(mem, edit, NULL, NULL);
-				if (!status.ok()) {
-					// Reflect errors immediately so that conditions like full
-					// file-systems cause the DB::Open() to fail.
-					break;
+			for (size_t i = 0; i < mems.size(); i++) {
+				ColumnFamilyData* cfd = column_families_[mems[i].first];
+				if (mems[i].second->ApproximateMemoryUsage() > cfd->options.write_buffer_size) {
+					status = WriteLevel0Table(cfd, mems[i].second, &(*edits)[cfd->id],
+						NULL, NULL, NULL);
+					if (!status.ok()) {
+						// Reflect errors immediately so that conditions like full
+						// file-systems cause the DB::Open() to fail.
+						break;
+					}
+					mems[i].second->Unref();
+					mems[i].second = new MemTable(cfd->internal_comparator);
+					mems[i].second->Ref();
 				}
-				mem->Unref();
-				mem = NULL;
 			}
 		}
 
-		if (status.ok() && mem != NULL) {
-			status = WriteLevel0Table(mem, edit, NULL, NULL);
-			// Reflect errors immediately so that conditions like full
-			// file-systems cause the DB::Open() to fail.
+		for (size_t i = 0; i < mems.size(); i++) {
+			if (status.ok() && mems[i].second->NumEntries() > 0) {
+				ColumnFamilyData* cfd = column_families_[mems[i].first];
+				status = WriteLevel0Table(cfd, mems[i].second, &(*edits)[cfd->id],
+					NULL, NULL, NULL);
+				// Reflect errors immediately so that conditions like full
+				// file-systems cause the DB::Open() to fail.
+			}
+			mems[i].second->Unref();
 		}
-
-		if (mem != NULL) mem->Unref();
 		delete file;
 		return status;
 	}
 
-	Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-		Version* base, uint64_t* number) {
-		mutex_.AssertHeld();
-		const uint64_t start_micros = env_->NowMicros();
-		FileMetaData meta;
-		meta.number = versions_->NewFileNumber();
-		if (number) {
-			*number = meta.number;
-		}
-		pending_outputs_.insert(meta.number);
-		Iterator* iter = mem->NewIterator();
-		Log(options_.info_log, "Level-0 table #%llu: started",
-			(unsigned long long) meta.number);
-
-		Status s;
-		{
-			mutex_.Unlock();
-			s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
-			mutex_.Lock();
+	Status DBImpl::ReplayLogFile(uint64_t log_number, const ColumnFamilyMemTables& mems,
+		SequenceNumber* max_sequence) {
+		const std::string fname = LogFileName(dbname_, log_number);
+		SequentialFile* file;
+		Status status = env_->NewSequentialFile(fname, &file);
+		if (!status.ok()) {
+			if (!env_->FileExists(fname)) {
+				// The primary deleted it once its entries were in tables
+				return Status::OK();
+			}
+			return status;
 		}
 
-		Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
-			(unsigned long long) meta.number,
-			(unsigned long long) meta.file_size,
-			s.ToString().c_str());
-		delete iter;
+		// The primary may be writing the log, so a torn or unwritten record
+		// at its end is expected: errors are only logged.
+		LogReporter reporter;
+		reporter.env = env_;
+		reporter.info_log = options_.info_log;
+		reporter.fname = fname.c_str();
+		reporter.status = NULL;
+		log::Reader reader(file, &reporter, true/*checksum*/,
+			0/*initial_offset*/);
 
-		// Note that if file_size is zero, the file has been deleted and
-		// should not be added to the manifest.
-		int level = 0;
-		if (s.ok() && meta.file_size > 0) {
-			const Slice min_user_key = meta.smallest.user_key();
-			const Slice max_user_key = meta.largest.user_key();
-			if (base != NULL) {
-				level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
-				while (level > 0 && levels_locked_[level]) {
-					--level;
-				}
+		std::string scratch;
+		Slice record;
+		WriteBatch batch;
+		while (reader.ReadRecord(&record, &scratch)) {
+			if (record.size() < 12) {
+				reporter.Corruption(
+					record.size(), Status::Corruption("log record too small"));
+				continue;
+			}
+			WriteBatchInternal::SetContents(&batch, record);
+			Status s = WriteBatchInternal::InsertInto(&batch, mems);
+			if (!s.ok()) {
+				reporter.Corruption(record.size(), s);
+				continue;
+			}
+			const SequenceNumber last_seq =
+				WriteBatchInternal::Sequence(&batch) +
+				WriteBatchInternal::Count(&batch) - 1;
+			if (last_seq > *max_sequence) {
+				*max_sequence = last_seq;
 			}
-			edit->AddFile(level, meta.number, meta.file_size,
-				meta.smallest, meta.largest);
 		}
+		delete file;
+		return status;
+	}
 
-		CompactionStats stats;
-		stats.micros = env_->NowMicros() - start_micros;
-		stats.bytes_written = meta.file_size;
-		stats_[level].Add(stats);
+	Status DBImpl::CatchUp() {
+		mutex_.AssertHeld();
+		assert(open_mode_ != kOpenReadWrite);
+		std::vector<ColumnFamilyData*> families;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			families.push_back(it->second);
+		}
+		Status s = CatchUpFamilies(families);
+		std::vector<ColumnFamilyData*> added;
+		if (s.ok()) {
+			s = UpdateColumnFamilies(&added);
+		}
+		if (s.ok() && !added.empty()) {
+			// The new families have no memtables yet, so all of them are
+			// caught up again for the entries of every family to be as of
+			// the same point in the logs.
+			families.clear();
+			for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+				it != column_families_.end();
+				++it) {
+				families.push_back(it->second);
+			}
+			families.insert(families.end(), added.begin(), added.end());
+			s = CatchUpFamilies(families);
+		}
+		for (size_t i = 0; i < added.size(); i++) {
+			if (s.ok()) {
+				column_families_[added[i]->id] = added[i];
+			}
+			else {
+				delete added[i];
+			}
+		}
+		return s;
+	}
+
+	Status DBImpl::CatchUpFamilies(const std::vector<ColumnFamilyData*>& families) {
+		mutex_.AssertHeld();
+		assert(families[0] == default_cf_);
+
+		// Replay the logs first, from the oldest the current version may
+		// lack.  That may be more than the descriptor read below needs,
+		// but never less, and the new version and memtables then replace
+		// the old ones at once.
+		uint64_t min_log = versions_->LogNumber();
+		for (size_t i = 0; i < families.size(); i++) {
+			min_log = std::min(min_log, families[i]->versions->LogNumber());
+		}
+		const uint64_t prev_log = versions_->PrevLogNumber();
+		std::vector<std::string> filenames;
+		Status s = env_->GetChildren(dbname_, &filenames);
+		if (!s.ok()) {
+			return s;
+		}
+		std::vector<uint64_t> logs;
+		uint64_t number;
+		FileType type;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			if (ParseFileName(filenames[i], &number, &type) && type == kLogFile &&
+				(number >= min_log || number == prev_log)) {
+				logs.push_back(number);
+			}
+		}
+		std::sort(logs.begin(), logs.end());
+
+		ColumnFamilyMemTables mems;
+		std::vector<ColumnFamilyMemTables> log_mems(logs.size());
+		for (size_t f = 0; f < families.size(); f++) {
+			ColumnFamilyData* cfd = families[f];
+			MemTable* mem = new MemTable(cfd->internal_comparator);
+			mem->Ref();
+			mems.push_back(std::make_pair(cfd->id, mem));
+			for (size_t i = 0; i < logs.size(); i++) {
+				if (logs[i] >= cfd->versions->LogNumber() ||
+					(cfd == default_cf_ && logs[i] == prev_log)) {
+					log_mems[i].push_back(mems.back());
+				}
+			}
+		}
+
+		SequenceNumber max_sequence = 0;
+		mutex_.Unlock();
+		for (size_t i = 0; s.ok() && i < logs.size(); i++) {
+			s = ReplayLogFile(logs[i], log_mems[i], &max_sequence);
+		}
+		mutex_.Lock();
+
+		// The default descriptor goes first, so that the families it has
+		// dropped, whose directories the primary may have deleted, are
+		// skipped; UpdateColumnFamilies() retires them.
+		for (size_t i = 0; s.ok() && i < families.size(); i++) {
+			if (i > 0 && versions_->ColumnFamilies().count(families[i]->id) == 0) {
+				continue;
+			}
+			bool changed;
+			s = families[i]->versions->CatchUp(&mutex_, &changed);
+		}
+		if (s.ok()) {
+			for (size_t i = 0; i < families.size(); i++) {
+				families[i]->mem->Unref();
+				families[i]->mem = mems[i].second;
+				families[i]->mem_log_number = logs.empty() ? 0 : logs.back();
+			}
+			versions_->SetLastSequence(max_sequence);
+		}
+		else {
+			for (size_t i = 0; i < mems.size(); i++) {
+				mems[i].second->Unref();
+			}
+		}
+		return s;
+	}
+
+	Status DBImpl::UpdateColumnFamilies(std::vector<ColumnFamilyData*>* added) {
+		mutex_.AssertHeld();
+		const std::map<uint32_t, std::string> registered = versions_->ColumnFamilies();
+		std::map<uint32_t, ColumnFamilyData*>::iterator it = column_families_.begin();
+		while (it != column_families_.end()) {
+			ColumnFamilyData* cfd = it->second;
+			if (cfd != default_cf_ && registered.count(cfd->id) == 0) {
+				cfd->dropped = true;
+				dropped_column_families_.push_back(cfd);
+				column_families_.erase(it++);
+				Log(options_.info_log, "Column family %s (id %u) was dropped",
+					cfd->name.c_str(), static_cast<unsigned>(cfd->id));
+			}
+			else {
+				++it;
+			}
+		}
+
+		Status s;
+		for (std::map<uint32_t, std::string>::const_iterator r = registered.begin();
+			s.ok() && r != registered.end();
+			++r) {
+			if (column_families_.count(r->first) > 0) {
+				continue;
+			}
+			// Without a descriptor the primary is still creating it
+			const std::string dir = ColumnFamilyDirName(dbname_, r->first);
+			if (!env_->FileExists(CurrentFileName(dir))) {
+				continue;
+			}
+			ColumnFamilyData* cfd = NewColumnFamilyData(r->first, r->second,
+				read_only_cf_options_);
+			mutex_.Unlock();
+			s = cfd->versions->Recover();
+			mutex_.Lock();
+			if (s.ok()) {
+				added->push_back(cfd);
+				Log(options_.info_log, "Opened column family %s (id %u)",
+					cfd->name.c_str(), static_cast<unsigned>(cfd->id));
+			}
+			else {
+				delete cfd;
+			}
+		}
+		if (!s.ok()) {
+			for (size_t i = 0; i < added->size(); i++) {
+				delete (*added)[i];
+			}
+			added->clear();
+		}
+		return s;
+	}
+
+	Status DBImpl::TryCatchUpWithPrimary() {
+		if (open_mode_ != kOpenSecondary) {
+			return Status::NotSupported("not a secondary instance");
+		}
+		MutexLock c(&catch_up_mutex_);
+		MutexLock l(&mutex_);
+		return CatchUp();
+	}
+
+	void DBImpl::CatchUpThread() {
+		const uint64_t period_micros = options_.secondary_catch_up_millis * 1000;
+		uint64_t next_micros = env_->NowMicros() + period_micros;
+		while (!shutting_down_.Acquire_Load()) {
+			// Short naps, so that closing the DB does not wait for a whole
+			// period
+			const uint64_t now = env_->NowMicros();
+			if (now < next_micros) {
+				env_->SleepForMicroseconds(static_cast<int>(
+					std::min<uint64_t>(next_micros - now, 10000)));
+				continue;
+			}
+			Status s = TryCatchUpWithPrimary();
+			if (!s.ok()) {
+				Log(options_.info_log, "Catching up with the primary: %s",
+					s.ToString().c_str());
+			}
+			next_micros = env_->NowMicros() + period_micros;
+		}
+		MutexLock l(&mutex_);
+		num_bg_threads_ -= 1;
+		bg_fg_cv_.SignalAll();
+	}
+
+	Status DBImpl::WriteLevel0Table(ColumnFamilyData* cfd, MemTable* mem,
+		VersionEdit* edit, Version* base,
+		TableFileInfo* info, uint64_t* blob_number) {
+		mutex_.AssertHeld();
+		const uint64_t start_micros = env_->NowMicros();
+		FileMetaData meta;
+		meta.number = cfd->versions->NewFileNumber();
+		cfd->pending_outputs.insert(meta.number);
+		BlobFileBuilder* blobs = NULL;
+		if (cfd->options.min_blob_size > 0) {
+			blobs = new BlobFileBuilder(env_, cfd->dir, cfd->versions->NewFileNumber());
+			cfd->pending_outputs.insert(blobs->number());
+		}
+		if (blob_number != NULL) {
+			*blob_number = (blobs != NULL) ? blobs->number() : 0;
+		}
+		Iterator* iter = mem->NewIterator();
+		Log(options_.info_log, "Level-0 table #%llu: started",
+			(unsigned long long) meta.number);
+
+		Status s;
+		{
+			mutex_.Unlock();
+			s = BuildTable(cfd->dir, env_, cfd->options, cfd->table_cache, iter, &meta, blobs);
+			if (blobs != NULL) {
+				Status bs = blobs->Finish();
+				if (s.ok()) {
+					s = bs;
+				}
+			}
+			mutex_.Lock();
+		}
+
+		uint64_t blob_file = 0;
+		uint64_t blob_bytes = 0;
+		if (blobs != NULL) {
+			blob_file = blobs->number();
+			blob_bytes = blobs->size();
+			if (blob_bytes > 0) {
+				Log(options_.info_log, "Level-0 table #%llu: blob file #%llu: %lld bytes",
+					(unsigned long long) meta.number,
+					(unsigned long long) blob_file,
+					(unsigned long long) blob_bytes);
+			}
+			delete blobs;
+		}
+		Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
+			(unsigned long long) meta.number,
+			(unsigned long long) meta.file_size,
+			s.ToString().c_str());
+		delete iter;
+
+		// Note that if file_size is zero, the file has been deleted and
+		// should not be added to the manifest.
+		int level = 0;
+		if (s.ok() && meta.file_size > 0) {
+			const Slice min_user_key = meta.smallest.user_key();
+			const Slice max_user_key = meta.largest.user_key();
+			if (base != NULL && cfd->options.compaction_style == kCompactionStyleLevel) {
+				level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+				while (level > 0 && cfd->levels_locked[level]) {
+					--level;
+				}
+			}
+			edit->AddFile(level, meta.number, meta.file_size,
+				meta.smallest, meta.largest);
+			if (blob_bytes > 0) {
+				edit->AddBlobFile(blob_file, blob_bytes);
+			}
+		}
+
+		CompactionStats stats;
+		stats.count = 1;
+		stats.micros = env_->NowMicros() - start_micros;
+		stats.bytes_written = meta.file_size + blob_bytes;
+		stats.bytes_flushed = meta.file_size + blob_bytes;
+		stats.files_written = meta.file_size > 0 ? 1 : 0;
+		stats_[level].Add(stats);
+		flush_stats_.Add(stats);
+		RecordTick(options_.statistics, kFlushBytesWritten, meta.file_size);
+
+		TableFileInfo created;
+		created.db_name = dbname_;
+		created.file_path = TableFileName(cfd->dir, meta.number);
+		created.file_number = meta.number;
+		created.file_size = meta.file_size;
+		created.level = level;
+		created.status = s;
+		if (options_.listener != NULL && (!s.ok() || meta.file_size > 0)) {
+			// meta.number is still in pending_outputs, so the file cannot be
+			// collected while we are unlocked.
+			mutex_.Unlock();
+			options_.listener->OnTableFileCreated(created);
+			mutex_.Lock();
+		}
+		if (info != NULL) {
+			*info = created;
+		}
 		return s;
 	}
 
@@ -622,19 +1339,48 @@ namespace leveldb {
 			bg_memtable_cv_.Wait();
 		}
 		while (!shutting_down_.Acquire_Load()) {
-			while (!shutting_down_.Acquire_Load() && imm_ == NULL) {
+			if (NotifyDeferredEvents()) {
+				// Re-check the state we waited on; it may have changed while the
+				// listener ran.
+				continue;
+			}
+			ColumnFamilyData* cfd = NULL;
+			while (!shutting_down_.Acquire_Load()) {
+				for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+					cfd == NULL && it != column_families_.end();
+					++it) {
+					if (it->second->imm != NULL) {
+						cfd = it->second;
+					}
+				}
+				if (cfd != NULL) {
+					break;
+				}
 				bg_memtable_cv_.Wait();
 			}
 			if (shutting_down_.Acquire_Load()) {
 				break;
 			}
 
+			// cfd->imm can only be replaced by this thread, so it stays put
+			// while the listener runs unlocked.
+			FlushJobInfo flush;
+			const uint64_t flush_start = env_->NowMicros();
+			if (options_.listener != NULL) {
+				flush.db_name = dbname_;
+				flush.memtable_bytes = cfd->imm->ApproximateMemoryUsage();
+				mutex_.Unlock();
+				options_.listener->OnFlushBegin(flush);
+				mutex_.Lock();
+			}
+
 			// Save the contents of the memtable as a new Table
 			VersionEdit edit;
-			Version* base = versions_->current();
+			Version* base = cfd->versions->current();
 			base->Ref();
-			uint64_t number;
-			Status s = WriteLevel0Table(imm_, &edit, base, &number);
+			TableFileInfo table;
+			uint64_t blob_number = 0;
+			Status s = WriteLevel0Table(cfd, cfd->imm, &edit, base, &table, &blob_number);
 			base->Unref(); base = NULL;
 
 			if (s.ok() && shutting_down_.Acquire_Load()) {
@@ -644,23 +1390,43 @@ namespace leveldb {
 			// Replace immutable memtable with the generated Table
 			if (s.ok()) {
 				edit.SetPrevLogNumber(0);
-				edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-				s = versions_->LogAndApply(&edit, &mutex_, &bg_log_cv_, &bg_log_occupied_);
+				// Earlier logs no longer hold entries of this column family;
+				// other column families may have switched logs since cfd->mem
+				// was created, so logfile_number_ would be too late.
+				edit.SetLogNumber(cfd->mem_log_number);
+				s = LogAndApply(cfd, &edit);
 			}
 
-			pending_outputs_.erase(number);
+			cfd->pending_outputs.erase(table.file_number);
+			cfd->pending_outputs.erase(blob_number);
 
 			if (s.ok()) {
 				// Commit to the new state
-				imm_->Unref();
-				imm_ = NULL;
-				has_imm_.Release_Store(NULL);
+				cfd->imm->Unref();
+				cfd->imm = NULL;
+				has_imm_.Release_Store(AnyImmutableMemTable());
 				bg_fg_cv_.SignalAll();
 				bg_compaction_cv_.Signal();
 				DeleteObsoleteFiles();
+				UpdateStallCondition();
 			}
 			else {
-				RecordBackgroundError(s);
+				RecordBackgroundError(kErrorFlush, s);
+			}
+
+			if (options_.listener != NULL) {
+				if (table.file_size > 0) {
+					flush.file_number = table.file_number;
+					flush.file_size = table.file_size;
+					flush.level = table.level;
+				}
+				flush.micros = env_->NowMicros() - flush_start;
+				flush.status = s;
+				mutex_.Unlock();
+				options_.listener->OnFlushCompleted(flush);
+				mutex_.Lock();
+			}
+			if (!s.ok()) {
 				continue;
 			}
 
@@ -685,28 +1451,48 @@ namespace leveldb {
 	}
 
 	void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
+		CompactRange(NULL, begin, end);
+	}
+
+	void DBImpl::CompactRange(ColumnFamilyHandle* column_family,
+		const Slice* begin, const Slice* end) {
+		if (open_mode_ != kOpenReadWrite) {
+			return;
+		}
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
+		if (cfd->options.compaction_style == kCompactionStyleFIFO) {
+			// Merging would take the files out of level-0, where FIFO
+			// compaction no longer sees them.
+			FlushMemTable(cfd);
+			return;
+		}
 		int max_level_with_files = 1;
 		{
 			MutexLock l(&mutex_);
-			Version* base = versions_->current();
+			Version* base = cfd->versions->current();
 			for (unsigned level = 1; level < config::kNumLevels; level++) {
 				if (base->OverlapInLevel(level, begin, end)) {
 					max_level_with_files = level;
 				}
 			}
 		}
-		TEST_CompactMemTable(); // TODO(sanjay): Skip if memtable does not overlap
+		FlushMemTable(cfd); // TODO(sanjay): Skip if memtable does not overlap
 		for (int level = 0; level < max_level_with_files; level++) {
-			TEST_CompactRange(level, begin, end);
+			TEST_CompactRange(level, begin, end, column_family);
 		}
 	}
 
-	void DBImpl::TEST_CompactRange(unsigned level, const Slice* begin, const Slice* end) {
+	void DBImpl::TEST_CompactRange(unsigned level, const Slice* begin, const Slice* end,
+		ColumnFamilyHandle* column_family) {
 		assert(level + 1 < config::kNumLevels);
+		if (open_mode_ != kOpenReadWrite) {
+			return;
+		}
 
 		InternalKey begin_storage, end_storage;
 
 		ManualCompaction manual;
+		manual.cfd = GetColumnFamilyData(column_family);
 		manual.level = level;
 		manual.done = false;
 		if (begin == NULL) {
@@ -742,15 +1528,23 @@ namespace leveldb {
 	}
 
 	Status DBImpl::TEST_CompactMemTable() {
+		return FlushMemTable(default_cf_);
+	}
+
+	Status DBImpl::Flush(ColumnFamilyHandle* column_family) {
+		return FlushMemTable(GetColumnFamilyData(column_family));
+	}
+
+	Status DBImpl::FlushMemTable(ColumnFamilyData* cfd) {
 		// NULL batch means just wait for earlier writes to be done
-		Status s = Write(WriteOptions(), NULL);
+		Status s = WriteInternal(WriteOptions(), NULL, cfd);
 		if (s.ok()) {
 			// Wait until the compaction completes
 			MutexLock l(&mutex_);
-			while (imm_ != NULL && bg_error_.ok()) {
+			while (cfd->imm != NULL && bg_error_.ok()) {
 				bg_fg_cv_.Wait();
 			}
-			if (imm_ != NULL) {
+			if (cfd->imm != NULL) {
 				s = bg_error_;
 			}
 		}
@@ -763,9 +1557,9 @@ namespace leveldb {
 			bg_compaction_cv_.Wait();
 		}
 		while (!shutting_down_.Acquire_Load()) {
+			ColumnFamilyData* cfd = NULL;
 			while (!shutting_down_.Acquire_Load() &&
-				manual_compaction_ == NULL &&
-				!versions_->NeedsCompaction(levels_locked_, straight_reads_ > kStraightReads)) {
+				(cfd = PickCompactionFamily()) == NULL) {
 				bg_compaction_cv_.Wait();
 			}
 			if (shutting_down_.Acquire_Load()) {
@@ -773,9 +1567,10 @@ namespace leveldb {
 			}
 
 			assert(manual_compaction_ == NULL || num_bg_threads_ == 2);
-			Status s = BackgroundCompaction();
+			Status s = BackgroundCompaction(cfd);
 			bg_fg_cv_.SignalAll(); // before the backoff In case a waiter
 								   // can proceed despite the error
+			NotifyDeferredEvents();
 
 			if (s.ok()) {
 				// Success
@@ -801,22 +1596,120 @@ namespace leveldb {
 		bg_fg_cv_.SignalAll();
 	}
 
-	void DBImpl::RecordBackgroundError(const Status& s) {
+	ColumnFamilyData* DBImpl::PickCompactionFamily() {
+		mutex_.AssertHeld();
+		if (manual_compaction_ != NULL) {
+			return manual_compaction_->cfd;
+		}
+		// Take turns, so that a busy column family does not starve the others
+		const bool seek_driven = straight_reads_ > kStraightReads;
+		std::map<uint32_t, ColumnFamilyData*>::const_iterator it =
+			column_families_.lower_bound(next_compaction_family_);
+		for (size_t n = 0; n < column_families_.size(); n++, ++it) {
+			if (it == column_families_.end()) {
+				it = column_families_.begin();
+			}
+			ColumnFamilyData* cfd = it->second;
+			if (cfd->versions->NeedsCompaction(cfd->levels_locked, seek_driven, cfd->imm != NULL)) {
+				next_compaction_family_ = cfd->id + 1;
+				return cfd;
+			}
+		}
+		return NULL;
+	}
+
+	MemTable* DBImpl::AnyImmutableMemTable() const {
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			if (it->second->imm != NULL) {
+				return it->second->imm;
+			}
+		}
+		return NULL;
+	}
+
+	void DBImpl::RecordBackgroundError(BackgroundErrorReason reason, const Status& s) {
 		mutex_.AssertHeld();
 		if (bg_error_.ok()) {
 			bg_error_ = s;
 			bg_fg_cv_.SignalAll();
+			if (options_.listener != NULL) {
+				pending_bg_errors_.push_back(std::make_pair(reason, s));
+			}
+		}
+	}
+
+	void DBImpl::UpdateStallCondition() {
+		mutex_.AssertHeld();
+		if (options_.listener == NULL) {
+			return;
+		}
+		// Mirrors the checks in SequenceWriteBegin and SequenceWriteEnd,
+		// for the column family that holds writers back the most.
+		WriteStallCondition current = kStallNormal;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end() && current != kStallStopped;
+			++it) {
+			const ColumnFamilyData* cfd = it->second;
+			if (cfd->imm != NULL &&
+				cfd->mem->ApproximateMemoryUsage() > cfd->options.write_buffer_size) {
+				current = kStallStopped;
+			}
+			else if (cfd->options.compaction_style != kCompactionStyleFIFO &&
+				cfd->versions->NumLevelFiles(0) > static_cast<int>(config::kL0_SlowdownWritesTrigger)) {
+				current = kStallDelayed;
+			}
+		}
+		if (current != stall_condition_) {
+			WriteStallInfo info;
+			info.db_name = dbname_;
+			info.previous = stall_condition_;
+			info.current = current;
+			pending_stall_changes_.push_back(info);
+			stall_condition_ = current;
+		}
+	}
+
+	bool DBImpl::NotifyDeferredEvents() {
+		mutex_.AssertHeld();
+		if (pending_deleted_files_.empty() &&
+			pending_stall_changes_.empty() &&
+			pending_bg_errors_.empty()) {
+			return false;
+		}
+		std::vector<TableFileInfo> deleted_files;
+		std::vector<WriteStallInfo> stall_changes;
+		std::vector<std::pair<BackgroundErrorReason, Status> > bg_errors;
+		deleted_files.swap(pending_deleted_files_);
+		stall_changes.swap(pending_stall_changes_);
+		bg_errors.swap(pending_bg_errors_);
+
+		mutex_.Unlock();
+		EventListener* listener = options_.listener;
+		for (size_t i = 0; i < bg_errors.size(); i++) {
+			listener->OnBackgroundError(bg_errors[i].first, bg_errors[i].second);
 		}
+		for (size_t i = 0; i < stall_changes.size(); i++) {
+			listener->OnStallConditionsChanged(stall_changes[i]);
+		}
+		for (size_t i = 0; i < deleted_files.size(); i++) {
+			listener->OnTableFileDeleted(deleted_files[i]);
+		}
+		mutex_.Lock();
+		return true;
 	}
 
-	Status DBImpl::BackgroundCompaction() {
+	Status DBImpl::BackgroundCompaction(ColumnFamilyData* cfd) {
 		mutex_.AssertHeld();
 		Compaction* c = NULL;
 		bool is_manual = (manual_compaction_ != NULL);
+		CompactionReason reason = kReasonManual;
+		uint64_t reserved_output = 0;
 		InternalKey manual_end;
 		if (is_manual) {
 			ManualCompaction* m = manual_compaction_;
-			c = versions_->CompactRange(m->level, m->begin, m->end);
+			c = cfd->versions->CompactRange(m->level, m->begin, m->end);
 			m->done = (c == NULL);
 			if (c != NULL) {
 				manual_end = c->input(0, c->num_input_files(0) - 1)->largest;
@@ -828,35 +1721,103 @@ namespace leveldb {
 				(m->end ? m->end->DebugString().c_str() : "(end)"),
 				(m->done ? "(end)" : manual_end.DebugString().c_str()));
 		}
+		else if (cfd->options.compaction_style == kCompactionStyleUniversal) {
+			// Waiting out a running memtable flush keeps its file number below
+			// the one reserved here.
+			bool by_count = false;
+			if (cfd->imm == NULL && !cfd->levels_locked[0] && !cfd->levels_locked[1]) {
+				c = cfd->versions->PickUniversalCompaction(cfd->versions->current(), &by_count);
+				reason = by_count ? kReasonLevel0 : kReasonSize;
+			}
+			if (c) {
+				if (c->output_level() == 0) {
+					reserved_output = cfd->versions->NewFileNumber();
+					cfd->pending_outputs.insert(reserved_output);
+				}
+				cfd->levels_locked[c->level() + 0] = true;
+				cfd->levels_locked[c->level() + 1] = true;
+			}
+		}
+		else if (cfd->options.compaction_style == kCompactionStyleFIFO) {
+			if (!cfd->levels_locked[0] && !cfd->levels_locked[1]) {
+				cfd->versions->LoadTableTimes(cfd->versions->current(), &mutex_);
+				c = cfd->versions->PickFIFOCompaction(cfd->versions->current());
+				reason = kReasonSize;
+			}
+			if (c) {
+				cfd->levels_locked[c->level() + 0] = true;
+				cfd->levels_locked[c->level() + 1] = true;
+			}
+		}
 		else {
-			unsigned level = versions_->PickCompactionLevel(levels_locked_, straight_reads_ > kStraightReads);
+			cfd->versions->LoadTableTimes(cfd->versions->current(), &mutex_);
+			bool by_seek = false;
+			unsigned level = cfd->versions->PickCompactionLevel(cfd->levels_locked,
+				straight_reads_ > kStraightReads, &by_seek);
 			if (level != config::kNumLevels) {
-				c = versions_->PickCompaction(versions_->current(), level);
+				c = cfd->versions->PickCompaction(cfd->versions->current(), level);
+				reason = by_seek ? kReasonSeek : level == 0 ? kReasonLevel0 : kReasonSize;
+			}
+			else if (cfd->options.compact_expired_files) {
+				c = cfd->versions->PickExpiredCompaction(cfd->versions->current(), cfd->levels_locked);
+				reason = kReasonExpiry;
 			}
 			if (c) {
-				assert(!levels_locked_[c->level() + 0]);
-				assert(!levels_locked_[c->level() + 1]);
-				levels_locked_[c->level() + 0] = true;
-				levels_locked_[c->level() + 1] = true;
+				assert(!cfd->levels_locked[c->level() + 0]);
+				assert(!cfd->levels_locked[c->level() + 1]);
+				cfd->levels_locked[c->level() + 0] = true;
+				cfd->levels_locked[c->level() + 1] = true;
 			}
 		}
 
 		Status status;
+		const bool did_compaction = c != NULL;
+		const bool trivial_move = did_compaction && !is_manual && c->IsTrivialMove();
+		const bool deletion_only = did_compaction && c->IsDeletionCompaction();
+
+		CompactionJobInfo job;
+		const uint64_t job_start = env_->NowMicros();
+		if (c != NULL && options_.listener != NULL) {
+			job.db_name = dbname_;
+			job.level = c->level();
+			job.output_level = c->output_level();
+			job.is_manual = is_manual;
+			job.is_trivial_move = trivial_move;
+			for (int which = 0; which < 2; which++) {
+				for (size_t i = 0; i < c->num_input_files(which); i++) {
+					job.input_files.push_back(c->input(which, i)->number);
+					if (!trivial_move && !deletion_only) {
+						job.bytes_read += c->input(which, i)->file_size;
+					}
+				}
+			}
+			mutex_.Unlock();
+			options_.listener->OnCompactionBegin(job);
+			mutex_.Lock();
+		}
 
 		if (c == NULL) {
 			// Nothing to do
 		}
-		else if (!is_manual && c->IsTrivialMove() && c->level() > 0) {
+		else if (trivial_move) {
 			// Move file to next level
 			for (size_t i = 0; i < c->num_input_files(0); ++i) {
 				FileMetaData* f = c->input(0, i);
 				c->edit()->DeleteFileVer(c->level(), f->number);
 				c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-					f->smallest, f->largest);
+					f->smallest, f->largest, f->global_sequence);
 			}
-			status = versions_->LogAndApply(c->edit(), &mutex_, &bg_log_cv_, &bg_log_occupied_);
+			status = LogAndApply(cfd, c->edit());
 			if (!status.ok()) {
-				RecordBackgroundError(status);
+				RecordBackgroundError(kErrorCompaction, status);
+			}
+			else {
+				CompactionStats stats;
+				stats.count = 1;
+				for (size_t i = 0; i < c->num_input_files(0); ++i) {
+					stats.bytes_moved += c->input(0, i)->file_size;
+				}
+				RecordCompactionStats(c->level() + 1, reason, stats);
 			}
 			VersionSet::LevelSummaryStorage tmp;
 			for (size_t i = 0; i < c->num_input_files(0); ++i) {
@@ -866,14 +1827,48 @@ namespace leveldb {
 					c->level() + 1,
 					static_cast<unsigned long long>(f->file_size),
 					status.ToString().c_str(),
-					versions_->LevelSummary(&tmp));
+					cfd->versions->LevelSummary(&tmp));
+			}
+		}
+		else if (deletion_only) {
+			c->AddInputDeletions(c->edit());
+			status = AddDroppedBlobGarbage(cfd, c);
+			if (status.ok()) {
+				status = LogAndApply(cfd, c->edit());
+			}
+			if (!status.ok()) {
+				RecordBackgroundError(kErrorCompaction, status);
+			}
+			else {
+				CompactionStats stats;
+				stats.count = 1;
+				RecordCompactionStats(c->level(), reason, stats);
+			}
+			VersionSet::LevelSummaryStorage tmp;
+			for (size_t i = 0; i < c->num_input_files(0); ++i) {
+				FileMetaData* f = c->input(0, i);
+				Log(options_.info_log, "Dropped #%lld from level-%d %lld bytes %s: %s\n",
+					static_cast<unsigned long long>(f->number),
+					c->level(),
+					static_cast<unsigned long long>(f->file_size),
+					status.ToString().c_str(),
+					cfd->versions->LevelSummary(&tmp));
 			}
+			c->ReleaseInputs();
+			DeleteObsoleteFiles();
 		}
 		else {
-			CompactionState* compact = new CompactionState(c);
+			CompactionState* compact = new CompactionState(cfd, c, reason);
+			compact->reserved_output = reserved_output;
 			status = DoCompactionWork(compact);
 			if (!status.ok()) {
-				RecordBackgroundError(status);
+				RecordBackgroundError(kErrorCompaction, status);
+			}
+			if (options_.listener != NULL) {
+				for (size_t i = 0; i < compact->outputs.size(); i++) {
+					job.output_files.push_back(compact->outputs[i].number);
+					job.bytes_written += compact->outputs[i].file_size;
+				}
 			}
 			CleanupCompaction(compact);
 			c->ReleaseInputs();
@@ -881,8 +1876,8 @@ namespace leveldb {
 		}
 
 		if (c) {
-			levels_locked_[c->level() + 0] = false;
-			levels_locked_[c->level() + 1] = false;
+			cfd->levels_locked[c->level() + 0] = false;
+			cfd->levels_locked[c->level() + 1] = false;
 			delete c;
 		}
 
@@ -910,11 +1905,25 @@ namespace leveldb {
 			}
 			manual_compaction_ = NULL;
 		}
+
+		if (did_compaction) {
+			UpdateStallCondition();
+		}
+		if (did_compaction && options_.listener != NULL) {
+			// Not before this point: once manual_compaction_ is cleared and the
+			// mutex released, the manual compaction's owner may return.
+			job.micros = env_->NowMicros() - job_start;
+			job.status = status;
+			mutex_.Unlock();
+			options_.listener->OnCompactionCompleted(job);
+			mutex_.Lock();
+		}
 		return status;
 	}
 
 	void DBImpl::CleanupCompaction(CompactionState* compact) {
 		mutex_.AssertHeld();
+		ColumnFamilyData* const cfd = compact->cfd;
 		if (compact->builder != NULL) {
 			// May happen if we get a shutdown call in the middle of compaction
 			compact->builder->Abandon();
@@ -926,32 +1935,97 @@ namespace leveldb {
 		delete compact->outfile;
 		for (size_t i = 0; i < compact->outputs.size(); i++) {
 			const CompactionState::Output& out = compact->outputs[i];
-			pending_outputs_.erase(out.number);
+			cfd->pending_outputs.erase(out.number);
+		}
+		if (compact->reserved_output != 0) {
+			// Everything was dropped; the number was never used
+			cfd->pending_outputs.erase(compact->reserved_output);
+		}
+		if (compact->blobs != NULL) {
+			cfd->pending_outputs.erase(compact->blobs->number());
+			delete compact->blobs;
 		}
 		delete compact;
 	}
 
+	Status DBImpl::AddDroppedBlobGarbage(ColumnFamilyData* cfd, Compaction* c) {
+		mutex_.AssertHeld();
+		if (cfd->versions->current()->BlobFiles().empty()) {
+			return Status::OK();
+		}
+		// The inputs' level is locked, so they stay put while we read them
+		std::map<uint64_t, uint64_t> garbage;
+		Status s;
+		mutex_.Unlock();
+		for (size_t i = 0; s.ok() && i < c->num_input_files(0); i++) {
+			const FileMetaData* f = c->input(0, i);
+			Iterator* iter = cfd->table_cache->NewIterator(ReadOptions(), f->number,
+				f->file_size, NULL, f->global_sequence);
+			for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+				BlobIndex bi;
+				if (ExtractValueType(iter->key()) == kTypeBlobIndex &&
+					bi.DecodeFrom(iter->value()).ok()) {
+					garbage[bi.file_number] += bi.size;
+				}
+			}
+			s = iter->status();
+			delete iter;
+		}
+		mutex_.Lock();
+		for (std::map<uint64_t, uint64_t>::const_iterator it = garbage.begin();
+			it != garbage.end();
+			++it) {
+			c->edit()->AddBlobGarbage(it->first, it->second);
+		}
+		return s;
+	}
+
+	Status DBImpl::AddCompactionBlob(CompactionState* compact, const Slice& value,
+		std::string* blob_index) {
+		ColumnFamilyData* const cfd = compact->cfd;
+		if (compact->blobs == NULL) {
+			mutex_.Lock();
+			const uint64_t file_number = cfd->versions->NewFileNumber();
+			cfd->pending_outputs.insert(file_number);
+			mutex_.Unlock();
+			compact->blobs = new BlobFileBuilder(env_, cfd->dir, file_number);
+		}
+		return compact->blobs->Add(value, blob_index);
+	}
+
 	Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
 		assert(compact != NULL);
 		assert(compact->builder == NULL);
+		ColumnFamilyData* const cfd = compact->cfd;
 		uint64_t file_number;
 		{
 			mutex_.Lock();
-			file_number = versions_->NewFileNumber();
-			pending_outputs_.insert(file_number);
+			if (compact->reserved_output != 0) {
+				file_number = compact->reserved_output;
+				compact->reserved_output = 0;
+			}
+			else {
+				file_number = cfd->versions->NewFileNumber();
+				cfd->pending_outputs.insert(file_number);
+			}
 			CompactionState::Output out;
 			out.number = file_number;
 			out.smallest.Clear();
 			out.largest.Clear();
+			out.max_sequence = 0;
+			out.min_expiry = ~static_cast<uint64_t>(0);
 			compact->outputs.push_back(out);
 			mutex_.Unlock();
 		}
 
 		// Make the output file
-		std::string fname = TableFileName(dbname_, file_number);
+		std::string fname = TableFileName(cfd->dir, file_number);
 		Status s = env_->NewWritableFile(fname, &compact->outfile);
 		if (s.ok()) {
-			compact->builder = new TableBuilder(options_, compact->outfile);
+			if (cfd->options.pipelined_compaction) {
+				compact->outfile = NewBackgroundWritableFile(env_, compact->outfile);
+			}
+			compact->builder = new TableBuilder(cfd->options, compact->outfile);
 		}
 		return s;
 	}
@@ -961,6 +2035,7 @@ namespace leveldb {
 		assert(compact != NULL);
 		assert(compact->outfile != NULL);
 		assert(compact->builder != NULL);
+		ColumnFamilyData* const cfd = compact->cfd;
 
 		const uint64_t output_number = compact->current_output()->number;
 		assert(output_number != 0);
@@ -969,6 +2044,14 @@ namespace leveldb {
 		Status s = input->status();
 		const uint64_t current_entries = compact->builder->NumEntries();
 		if (s.ok()) {
+			std::string encoded;
+			PutVarint64(&encoded, compact->current_output()->max_sequence);
+			compact->builder->AddProperty(kPropertyMaxSequence, encoded);
+			if (compact->current_output()->min_expiry != ~static_cast<uint64_t>(0)) {
+				encoded.clear();
+				PutVarint64(&encoded, compact->current_output()->min_expiry);
+				compact->builder->AddProperty(kPropertyMinExpiry, encoded);
+			}
 			s = compact->builder->Finish();
 		}
 		else {
@@ -992,7 +2075,7 @@ namespace leveldb {
 
 		if (s.ok() && current_entries > 0) {
 			// Verify that the table is usable
-			Iterator* iter = table_cache_->NewIterator(ReadOptions(),
+			Iterator* iter = cfd->table_cache->NewIterator(ReadOptions(),
 				output_number,
 				current_bytes);
 			s = iter->status();
@@ -1005,12 +2088,24 @@ namespace leveldb {
 					(unsigned long long) current_bytes);
 			}
 		}
+
+		if (options_.listener != NULL) {
+			TableFileInfo info;
+			info.db_name = dbname_;
+			info.file_path = TableFileName(cfd->dir, output_number);
+			info.file_number = output_number;
+			info.file_size = current_bytes;
+			info.level = compact->compaction->output_level();
+			info.status = s;
+			options_.listener->OnTableFileCreated(info);
+		}
 		return s;
 	}
 
 
 	Status DBImpl::InstallCompactionResults(CompactionState* compact) {
 		mutex_.AssertHeld();
+		ColumnFamilyData* const cfd = compact->cfd;
 		Log(options_.info_log, "Compacted %lu@%d + %lu@%d files => %lld bytes",
 			compact->compaction->num_input_files(0),
 			compact->compaction->level(),
@@ -1020,17 +2115,27 @@ namespace leveldb {
 
 		// Add compaction outputs
 		compact->compaction->AddInputDeletions(compact->compaction->edit());
-		const int level = compact->compaction->level();
+		const int level = compact->compaction->output_level();
 		for (size_t i = 0; i < compact->outputs.size(); i++) {
 			const CompactionState::Output& out = compact->outputs[i];
 			compact->compaction->edit()->AddFile(
-				level + 1,
+				level,
 				out.number, out.file_size, out.smallest, out.largest);
 		}
-		return versions_->LogAndApply(compact->compaction->edit(), &mutex_, &bg_log_cv_, &bg_log_occupied_);
+		if (compact->blobs != NULL && compact->blobs->size() > 0) {
+			compact->compaction->edit()->AddBlobFile(
+				compact->blobs->number(), compact->blobs->size());
+		}
+		for (std::map<uint64_t, uint64_t>::const_iterator it = compact->blob_garbage.begin();
+			it != compact->blob_garbage.end();
+			++it) {
+			compact->compaction->edit()->AddBlobGarbage(it->first, it->second);
+		}
+		return LogAndApply(cfd, compact->compaction->edit());
 	}
 
 	Status DBImpl::DoCompactionWork(CompactionState* compact) {
+		ColumnFamilyData* const cfd = compact->cfd;
 		const uint64_t start_micros = env_->NowMicros();
 		int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
 
@@ -1040,7 +2145,7 @@ namespace leveldb {
 			compact->compaction->num_input_files(1),
 			compact->compaction->level() + 1);
 
-		assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
+		assert(cfd->versions->NumLevelFiles(compact->compaction->level()) > 0);
 		assert(compact->builder == NULL);
 		assert(compact->outfile == NULL);
 		if (snapshots_.empty()) {
@@ -1049,23 +2154,49 @@ namespace leveldb {
 		else {
 			compact->smallest_snapshot = snapshots_.oldest()->number_;
 		}
+		snapshots_.GetSequenceNumbers(&compact->snapshots);
+		compact->blob_files = cfd->versions->current()->BlobFiles();
+
+		const CompactionFilter* filter = cfd->options.compaction_filter;
+		CompactionFilter::Context filter_context;
+		filter_context.level = compact->compaction->level();
+		filter_context.output_level = compact->compaction->output_level();
+		filter_context.is_full_compaction = compact->compaction->IsFullCompaction();
+		filter_context.is_manual_compaction = compact->reason == kReasonManual;
+		std::string filtered_key;
+		std::string filtered_value;
+		std::string blob_key;
+		std::string blob_index;
+		std::string blob_value;
 
 		// Release mutex while we're actually doing the compaction work
 		mutex_.Unlock();
 
-		Iterator* input = versions_->MakeInputIterator(compact->compaction);
+		Iterator* input = cfd->versions->MakeInputIterator(compact->compaction);
+		if (cfd->options.pipelined_compaction) {
+			input = NewPrefetchIterator(env_, input, 1 << 20);
+		}
 		input->SeekToFirst();
 		Status status;
+		const Comparator* user_cmp = cfd->user_comparator();
 		ParsedInternalKey ikey;
-		ParsedInternalKey current_key;
+		uint64_t ikey_num = 0;
+		Slice current_user_key;
+		uint64_t current_key_num = 0;
 		std::string current_key_backing;
 		bool has_current_key = false;
 		SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+		SequenceNumber last_stripe_for_key = kMaxSequenceNumber;
 		size_t boundary_hint = 0;
+		int64_t records_in = 0;
+		int64_t records_dropped = 0;
+		const uint64_t now = env_->NowMicros() / 1000000;
 		for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
 			Slice key = input->key();
+			Slice value = input->value();
 			// Handle key/value, add to state, etc.
 			bool drop = false;
+			bool expired = false;
 			if (!ParseInternalKey(key, &ikey)) {
 				// Do not hide error keys
 				current_key_backing.clear();
@@ -1073,22 +2204,26 @@ namespace leveldb {
 				last_sequence_for_key = kMaxSequenceNumber;
 			}
 			else {
+				// Keys with different KeyNum()s differ, so the comparator only
+				// runs for keys that share a prefix.
+				ikey_num = user_cmp->KeyNum(ikey.user_key);
 				if (!has_current_key ||
-					user_comparator()->Compare(ikey.user_key,
-						current_key.user_key) != 0) {
+					ikey_num != current_key_num ||
+					user_cmp->Compare(ikey.user_key, current_user_key) != 0) {
 					if (has_current_key && compact->builder &&
 						compact->builder->FileSize() >=
 						compact->compaction->MinOutputFileSize() &&
-						compact->compaction->CrossesBoundary(current_key, ikey, &boundary_hint)) {
+						compact->compaction->CrossesBoundary(current_user_key, current_key_num,
+							ikey.user_key, ikey_num, &boundary_hint)) {
 						status = FinishCompactionOutputFile(compact, input);
 						if (!status.ok()) {
 							break;
 						}
 					}
 					// First occurrence of this user key
-					current_key_backing.assign(key.data(), key.size());
-					bool x = ParseInternalKey(Slice(current_key_backing), &current_key);
-					assert(x);
+					current_key_backing.assign(ikey.user_key.data(), ikey.user_key.size());
+					current_user_key = Slice(current_key_backing);
+					current_key_num = ikey_num;
 					has_current_key = true;
 					last_sequence_for_key = kMaxSequenceNumber;
 				}
@@ -1096,13 +2231,20 @@ namespace leveldb {
 				// Just remember that last_sequence_for_key is decreasing over time, and
 				// all of this makes sense.
 
-				if (last_sequence_for_key <= compact->smallest_snapshot) {
-					// Hidden by an newer entry for same user key
+				// Readers at every snapshot see an expired value as a
+				// deletion, so it is dropped under the same rules.
+				expired = ikey.type == kTypeValueWithExpiry && IsExpired(value, now);
+
+				const SequenceNumber stripe = compact->StripeOf(ikey.sequence);
+				if (last_sequence_for_key != kMaxSequenceNumber &&
+					stripe == last_stripe_for_key) {
+					// Hidden by a newer entry for same user key from every
+					// reader that could see this one
 					drop = true;    // (A)
 				}
-				else if (ikey.type == kTypeDeletion &&
+				else if ((ikey.type == kTypeDeletion || expired) &&
 					ikey.sequence <= compact->smallest_snapshot &&
-					compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+					compact->compaction->IsBaseLevelForKey(ikey.user_key, ikey_num)) {
 					// For this user key:
 					// (1) there is no data in higher levels
 					// (2) data in lower levels will have larger sequence numbers
@@ -1122,10 +2264,100 @@ namespace leveldb {
 					drop = false;
 				}
 
+				// Filter the newest value of a key once every snapshot sees
+				// it, so that all readers agree on what the filter did.
+				if (!drop && filter != NULL &&
+					last_sequence_for_key == kMaxSequenceNumber &&
+					ikey.sequence <= compact->smallest_snapshot &&
+					(ikey.type == kTypeValue || ikey.type == kTypeBlobIndex ||
+					(ikey.type == kTypeValueWithExpiry && !expired))) {
+					Slice existing = ikey.type == kTypeValueWithExpiry ? StripExpiry(value) : value;
+					if (ikey.type == kTypeBlobIndex) {
+						status = cfd->table_cache->GetBlob(value, &blob_value);
+						if (!status.ok()) {
+							break;
+						}
+						existing = blob_value;
+					}
+					bool value_changed = false;
+					filtered_value.clear();
+					if (filter->Filter(filter_context, ikey.user_key, existing,
+						&filtered_value, &value_changed)) {
+						if (ikey.sequence < manual_garbage_cutoff_ &&
+							compact->compaction->IsBaseLevelForKey(ikey.user_key, ikey_num)) {
+							drop = true;
+						}
+						else {
+							// Older values may live in deeper levels
+							filtered_key.clear();
+							AppendInternalKey(&filtered_key,
+								ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeDeletion));
+							if (ikey.type == kTypeBlobIndex) {
+								compact->AddBlobGarbage(value);
+							}
+							key = filtered_key;
+							ikey.type = kTypeDeletion;
+							value = Slice();
+						}
+					}
+					else if (value_changed) {
+						if (ikey.type == kTypeValueWithExpiry) {
+							PutFixed64(&filtered_value, ExtractExpiry(value));
+						}
+						else if (ikey.type == kTypeBlobIndex) {
+							// The new value goes back into the table, or into
+							// a new blob below
+							compact->AddBlobGarbage(value);
+							filtered_key.clear();
+							AppendInternalKey(&filtered_key,
+								ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeValue));
+							key = filtered_key;
+							ikey.type = kTypeValue;
+						}
+						value = filtered_value;
+					}
+				}
+
 				last_sequence_for_key = ikey.sequence;
+				last_stripe_for_key = stripe;
+			}
+
+			++records_in;
+			if (drop) {
+				++records_dropped;
+				if (has_current_key && ikey.type == kTypeBlobIndex) {
+					compact->AddBlobGarbage(value);
+				}
 			}
+			else {
+				if (has_current_key && ikey.type == kTypeBlobIndex &&
+					compact->ShouldRewriteBlob(value, cfd->options.blob_gc_percent)) {
+					// Copy the value out of a mostly dead blob file
+					status = cfd->table_cache->GetBlob(value, &blob_value);
+					if (!status.ok()) {
+						break;
+					}
+					compact->AddBlobGarbage(value);
+					blob_key.clear();
+					AppendInternalKey(&blob_key,
+						ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeValue));
+					key = blob_key;
+					value = blob_value;
+					ikey.type = kTypeValue;
+				}
+				if (has_current_key && ikey.type == kTypeValue &&
+					cfd->options.min_blob_size > 0 && value.size() >= cfd->options.min_blob_size) {
+					status = AddCompactionBlob(compact, value, &blob_index);
+					if (!status.ok()) {
+						break;
+					}
+					blob_key.clear();
+					AppendInternalKey(&blob_key,
+						ParsedInternalKey(ikey.user_key, ikey.sequence, kTypeBlobIndex));
+					key = blob_key;
+					value = blob_index;
+				}
 
-			if (!drop) {
 				// Open output file if necessary
 				if (compact->builder == NULL) {
 					status = OpenCompactionOutputFile(compact);
@@ -1137,7 +2369,19 @@ namespace leveldb {
 					compact->current_output()->smallest.DecodeFrom(key);
 				}
 				compact->current_output()->largest.DecodeFrom(key);
-				compact->builder->Add(key, input->value());
+				if (has_current_key &&
+					ikey.sequence > compact->current_output()->max_sequence) {
+					compact->current_output()->max_sequence = ikey.sequence;
+				}
+				if (expired && value.size() >= 8) {
+					// Still shadows older entries, but its value is dead
+					value = Slice(value.data() + value.size() - 8, 8);
+				}
+				if (has_current_key && ikey.type == kTypeValueWithExpiry &&
+					ExtractExpiry(value) < compact->current_output()->min_expiry) {
+					compact->current_output()->min_expiry = ExtractExpiry(value);
+				}
+				compact->builder->Add(key, value);
 
 				// Close output file if it is big enough
 				if (compact->builder->FileSize() >=
@@ -1161,35 +2405,67 @@ namespace leveldb {
 		if (status.ok()) {
 			status = input->status();
 		}
+		if (status.ok() && compact->blobs != NULL) {
+			status = compact->blobs->Finish();
+		}
 		delete input;
 		input = NULL;
 
 		CompactionStats stats;
+		stats.count = 1;
 		stats.micros = env_->NowMicros() - start_micros - imm_micros;
-		for (int which = 0; which < 2; which++) {
-			for (size_t i = 0; i < compact->compaction->num_input_files(which); i++) {
-				stats.bytes_read += compact->compaction->input(which, i)->file_size;
-			}
+		for (size_t i = 0; i < compact->compaction->num_input_files(0); i++) {
+			stats.bytes_read_level += compact->compaction->input(0, i)->file_size;
+		}
+		for (size_t i = 0; i < compact->compaction->num_input_files(1); i++) {
+			stats.bytes_read_next += compact->compaction->input(1, i)->file_size;
 		}
+		stats.files_read_level = compact->compaction->num_input_files(0);
+		stats.files_read_next = compact->compaction->num_input_files(1);
 		for (size_t i = 0; i < compact->outputs.size(); i++) {
 			stats.bytes_written += compact->outputs[i].file_size;
 		}
+		if (compact->blobs != NULL) {
+			stats.bytes_written += compact->blobs->size();
+		}
+		stats.files_written = compact->outputs.size();
+		stats.records_in = records_in;
+		stats.records_dropped = records_dropped;
 
 		mutex_.Lock();
-		stats_[compact->compaction->level() + 1].Add(stats);
+		RecordCompactionStats(compact->compaction->output_level(), compact->reason, stats);
 
 		if (status.ok()) {
 			status = InstallCompactionResults(compact);
 		}
 		if (!status.ok()) {
-			RecordBackgroundError(status);
+			RecordBackgroundError(kErrorCompaction, status);
 		}
 		VersionSet::LevelSummaryStorage tmp;
 		Log(options_.info_log,
-			"compacted to: %s", versions_->LevelSummary(&tmp));
+			"compacted to: %s", cfd->versions->LevelSummary(&tmp));
 		return status;
 	}
 
+	void DBImpl::RecordCompactionStats(unsigned output_level, CompactionReason reason,
+		const CompactionStats& stats) {
+		mutex_.AssertHeld();
+		stats_[output_level].Add(stats);
+		reason_stats_[reason].Add(stats);
+
+		Statistics* const s = options_.statistics;
+		RecordTick(s, kCompactBytesRead, stats.bytes_read_level + stats.bytes_read_next);
+		RecordTick(s, kCompactBytesWritten, stats.bytes_written);
+		RecordTick(s, kCompactBytesMoved, stats.bytes_moved);
+		RecordTick(s, kCompactRecordsIn, stats.records_in);
+		RecordTick(s, kCompactRecordsDropped, stats.records_dropped);
+		static const Tickers kReasonTickers[kNumCompactionReasons] = {
+			kCompactionsLevel0, kCompactionsSize, kCompactionsSeek, kCompactionsManual,
+			kCompactionsExpiry
+		};
+		RecordTick(s, kReasonTickers[reason]);
+	}
+
 	namespace {
 		struct IterState {
 			port::Mutex* mu;
@@ -1209,7 +2485,8 @@ namespace leveldb {
 		}
 	}  // namespace
 
-	Iterator* DBImpl::NewInternalIterator(const ReadOptions& options, uint64_t number,
+	Iterator* DBImpl::NewInternalIterator(ColumnFamilyData* cfd,
+		const ReadOptions& options, uint64_t number,
 		SequenceNumber* latest_snapshot,
 		uint32_t* seed, bool external_sync) {
 		IterState* cleanup = new IterState;
@@ -1221,21 +2498,22 @@ namespace leveldb {
 
 		// Collect together all needed child iterators
 		std::vector<Iterator*> list;
-		list.push_back(mem_->NewIterator());
-		mem_->Ref();
-		if (imm_ != NULL) {
-			list.push_back(imm_->NewIterator());
-			imm_->Ref();
-		}
-		versions_->current()->AddSomeIterators(options, number, &list);
+		list.push_back(cfd->mem->NewIterator());
+		cfd->mem->Ref();
+		if (cfd->imm != NULL) {
+			list.push_back(cfd->imm->NewIterator());
+			cfd->imm->Ref();
+		}
+		Version* current = cfd->versions->current();
+		current->AddSomeIterators(options, number, &list);
 		Iterator* internal_iter =
-			NewMergingIterator(&internal_comparator_, &list[0], list.size());
-		versions_->current()->Ref();
+			NewMergingIterator(&cfd->internal_comparator, &list[0], list.size());
+		current->Ref();
 
 		cleanup->mu = &mutex_;
-		cleanup->mem = mem_;
-		cleanup->imm = imm_;
-		cleanup->version = versions_->current();
+		cleanup->mem = cfd->mem;
+		cleanup->imm = cfd->imm;
+		cleanup->version = current;
 		internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, NULL);
 
 		*seed = ++seed_;
@@ -1248,7 +2526,7 @@ namespace leveldb {
 	Iterator* DBImpl::TEST_NewInternalIterator() {
 		SequenceNumber ignored;
 		uint32_t ignored_seed;
-		return NewInternalIterator(ReadOptions(), 0, &ignored, &ignored_seed, false);
+		return NewInternalIterator(default_cf_, ReadOptions(), 0, &ignored, &ignored_seed, false);
 	}
 
 	int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1259,8 +2537,23 @@ namespace leveldb {
 	Status DBImpl::Get(const ReadOptions& options,
 		const Slice& key,
 		std::string* value) {
+		return Get(options, NULL, key, value);
+	}
+
+	Status DBImpl::Get(const ReadOptions& options,
+		ColumnFamilyHandle* column_family,
+		const Slice& key,
+		std::string* value) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
+		StopWatch sw(env_, options_.statistics, kGetMicros);
 		Status s;
+		PERF_TIMER_GUARD(db_mutex_lock_nanos);
 		MutexLock l(&mutex_);
+		PERF_TIMER_STOP(db_mutex_lock_nanos);
+		// A read-only instance no longer follows a family the primary dropped
+		if (open_mode_ != kOpenReadWrite && cfd->dropped) {
+			return Status::InvalidArgument(cfd->name, "column family was dropped");
+		}
 		SequenceNumber snapshot;
 		if (options.snapshot != NULL) {
 			snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
@@ -1269,9 +2562,9 @@ namespace leveldb {
 			snapshot = versions_->LastSequence();
 		}
 
-		MemTable* mem = mem_;
-		MemTable* imm = imm_;
-		Version* current = versions_->current();
+		MemTable* mem = cfd->mem;
+		MemTable* imm = cfd->imm;
+		Version* current = cfd->versions->current();
 		mem->Ref();
 		if (imm != NULL) imm->Ref();
 		current->Ref();
@@ -1284,17 +2577,27 @@ namespace leveldb {
 			mutex_.Unlock();
 			// First look in the memtable, then in the immutable memtable (if any).
 			LookupKey lkey(key, snapshot);
-			if (mem->Get(lkey, value, &s)) {
-				// Done
+			const uint64_t now = env_->NowMicros() / 1000000;
+			PERF_TIMER_GUARD(get_from_memtable_time);
+			PERF_COUNTER_ADD(get_from_memtable_count, 1);
+			bool done = mem->Get(lkey, value, &s, now);
+			if (!done && imm != NULL) {
+				PERF_COUNTER_ADD(get_from_memtable_count, 1);
+				done = imm->Get(lkey, value, &s, now);
 			}
-			else if (imm != NULL && imm->Get(lkey, value, &s)) {
-				// Done
+			PERF_TIMER_STOP(get_from_memtable_time);
+			if (done) {
+				RecordTick(options_.statistics, kMemtableHit);
 			}
 			else {
-				s = current->Get(options, lkey, value, &stats);
+				RecordTick(options_.statistics, kMemtableMiss);
+				PERF_TIMER_GUARD(get_from_output_files_time);
+				s = current->Get(options, lkey, value, &stats, now);
 				have_stat_update = true;
 			}
+			PERF_TIMER_START(db_mutex_lock_nanos);
 			mutex_.Lock();
+			PERF_TIMER_STOP(db_mutex_lock_nanos);
 		}
 
 		if (have_stat_update && current->UpdateStats(stats)) {
@@ -1308,11 +2611,24 @@ namespace leveldb {
 	}
 
 	Iterator* DBImpl::NewIterator(const ReadOptions& options) {
+		return NewIterator(options, NULL);
+	}
+
+	Iterator* DBImpl::NewIterator(const ReadOptions& options,
+		ColumnFamilyHandle* column_family) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
+		if (open_mode_ != kOpenReadWrite) {
+			MutexLock l(&mutex_);
+			if (cfd->dropped) {
+				return NewErrorIterator(
+					Status::InvalidArgument(cfd->name, "column family was dropped"));
+			}
+		}
 		SequenceNumber latest_snapshot;
 		uint32_t seed;
-		Iterator* iter = NewInternalIterator(options, 0, &latest_snapshot, &seed, false);
+		Iterator* iter = NewInternalIterator(cfd, options, 0, &latest_snapshot, &seed, false);
 		return NewDBIterator(
-			this, user_comparator(), iter,
+			this, cfd, cfd->user_comparator(), iter,
 			(options.snapshot != NULL
 				? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_
 				: latest_snapshot),
@@ -1441,11 +2757,13 @@ namespace leveldb {
 		SequenceNumber latest_snapshot;
 		uint32_t seed;
 		MutexLock l(&mutex_);
-		Iterator* internal_iter = NewInternalIterator(options, file, &latest_snapshot, &seed, true);
+		Iterator* internal_iter = NewInternalIterator(default_cf_, options, file,
+			&latest_snapshot, &seed, true);
 		internal_iter->SeekToFirst();
 		ReplayIteratorImpl* iterimpl;
 		iterimpl = new ReplayIteratorImpl(
-			this, &mutex_, user_comparator(), internal_iter, mem_, SequenceNumber(seqno));
+			this, &mutex_, default_cf_->user_comparator(), internal_iter, default_cf_->mem,
+			SequenceNumber(seqno));
 		*iter = iterimpl;
 		replay_iters_.push_back(iterimpl);
 		return Status::OK();
@@ -1464,14 +2782,23 @@ namespace leveldb {
 		}
 	}
 
-	void DBImpl::RecordReadSample(Slice key) {
+	void DBImpl::RecordReadSample(ColumnFamilyData* cfd, Slice key) {
 		MutexLock l(&mutex_);
 		++straight_reads_;
-		if (versions_->current()->RecordReadSample(key)) {
+		if (cfd->versions->current()->RecordReadSample(key)) {
 			bg_compaction_cv_.Signal();
 		}
 	}
 
+	Status DBImpl::GetBlob(ColumnFamilyData* cfd, const Slice& blob_index,
+		std::string* value) {
+		return cfd->table_cache->GetBlob(blob_index, value);
+	}
+
+	Status DBImpl::GetBlob(const Slice& blob_index, std::string* value) {
+		return GetBlob(default_cf_, blob_index, value);
+	}
+
 	SequenceNumber DBImpl::LastSequence() {
 		SequenceNumber ret;
 
@@ -1503,6 +2830,11 @@ namespace leveldb {
 
 	// Convenience methods
 	Status DBImpl::Put(const WriteOptions& o, const Slice& key, const Slice& val) {
+		if (o.ttl_seconds > 0) {
+			WriteBatch batch;
+			batch.PutWithExpiry(key, val, env_->NowMicros() / 1000000 + o.ttl_seconds);
+			return Write(o, &batch);
+		}
 		return DB::Put(o, key, val);
 	}
 
@@ -1510,10 +2842,39 @@ namespace leveldb {
 		return DB::Delete(options, key);
 	}
 
+	Status DBImpl::Put(const WriteOptions& o, ColumnFamilyHandle* column_family,
+		const Slice& key, const Slice& val) {
+		WriteBatch batch;
+		if (o.ttl_seconds > 0) {
+			batch.PutWithExpiry(column_family, key, val,
+				env_->NowMicros() / 1000000 + o.ttl_seconds);
+		}
+		else {
+			batch.Put(column_family, key, val);
+		}
+		return Write(o, &batch);
+	}
+
+	Status DBImpl::Delete(const WriteOptions& options, ColumnFamilyHandle* column_family,
+		const Slice& key) {
+		WriteBatch batch;
+		batch.Delete(column_family, key);
+		return Write(options, &batch);
+	}
+
 	Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+		return WriteInternal(options, updates, NULL);
+	}
+
+	Status DBImpl::WriteInternal(const WriteOptions& options, WriteBatch* updates,
+		ColumnFamilyData* flush_cfd) {
+		if (open_mode_ != kOpenReadWrite) {
+			return ReadOnlyError();
+		}
+		StopWatch sw(env_, updates != NULL ? options_.statistics : NULL, kWriteMicros);
 		Writer w(&writers_mutex_);
 		Status s;
-		s = SequenceWriteBegin(&w, updates);
+		s = SequenceWriteBegin(&w, updates, flush_cfd);
 
 		if (s.ok() && updates != NULL) { // NULL batch is for compactions
 			WriteBatchInternal::SetSequence(updates, w.start_sequence_);
@@ -1521,19 +2882,26 @@ namespace leveldb {
 			// Add to log and apply to memtable.  We do this without holding the lock
 			// because both the log and the memtable are safe for concurrent access.
 			// The synchronization with readers occurs with SequenceWriteEnd.
-			s = w.log_->AddRecord(WriteBatchInternal::Contents(updates));
+			Slice contents = WriteBatchInternal::Contents(updates);
+			s = w.log_->AddRecord(contents);
+			RecordTick(options_.statistics, kWalBytes, contents.size());
+			RecordTick(options_.statistics, kKeysWritten, WriteBatchInternal::Count(updates));
 
 			if (s.ok() && options.sync) {
 				s = w.logfile_->Sync();
+				RecordTick(options_.statistics, kWalSyncs);
 			}
 			if (s.ok()) {
-				s = WriteBatchInternal::InsertInto(updates, w.mem_);
+				s = WriteBatchInternal::InsertInto(updates, w.mems_);
 			}
 		}
 
-		if (!s.ok()) {
+		if (!s.ok() && !s.IsInvalidArgument()) {
+			// A batch that names a missing column family is refused before
+			// anything is logged, so the DB is fine.
 			mutex_.Lock();
-			RecordBackgroundError(s);
+			RecordBackgroundError(kErrorWriteLog, s);
+			NotifyDeferredEvents();
 			mutex_.Unlock();
 		}
 
@@ -1541,37 +2909,83 @@ namespace leveldb {
 		return s;
 	}
 	
-	Status DBImpl::SequenceWriteBegin(Writer* w, WriteBatch* updates) {
+	Status DBImpl::SequenceWriteBegin(Writer* w, WriteBatch* updates,
+		ColumnFamilyData* flush_cfd) {
 		Status s;
 
+		// The column families the batch writes to, or the one to force a
+		// new memtable for
+		std::vector<uint32_t> ids;
+		if (updates != NULL) {
+			s = WriteBatchInternal::ColumnFamilies(updates, &ids);
+			if (!s.ok()) {
+				return Status::InvalidArgument("malformed WriteBatch", s.ToString());
+			}
+		}
+		else if (flush_cfd != NULL) {
+			ids.push_back(flush_cfd->id);
+		}
+		if (ids.empty()) {
+			ids.push_back(0);
+		}
+
 		{
 			MutexLock l(&mutex_);
 			straight_reads_ = 0;
 			bool force = updates == NULL;
 			bool enqueue_mem = false;
-			w->micros_ = versions_->NumLevelFiles(0);
+			std::vector<ColumnFamilyData*> targets;
+			w->micros_ = 0;
+			for (size_t i = 0; i < ids.size(); i++) {
+				std::map<uint32_t, ColumnFamilyData*>::const_iterator it =
+					column_families_.find(ids[i]);
+				if (it == column_families_.end()) {
+					char buf[30];
+					snprintf(buf, sizeof(buf), "%u", static_cast<unsigned>(ids[i]));
+					return Status::InvalidArgument("no such column family", buf);
+				}
+				targets.push_back(it->second);
+				// FIFO compaction never shrinks level-0 by merging, so its file
+				// count must not slow writes down.
+				if (it->second->options.compaction_style != kCompactionStyleFIFO) {
+					w->micros_ = std::max(w->micros_,
+						static_cast<uint64_t>(it->second->versions->NumLevelFiles(0)));
+				}
+			}
 
-			while (true) {
+			for (size_t i = 0; i < targets.size(); ) {
+				ColumnFamilyData* cfd = targets[i];
 				if (!bg_error_.ok()) {
 					// Yield previous error
 					s = bg_error_;
 					break;
 				}
 				else if (!force &&
-					(mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
+					(cfd->mem->ApproximateMemoryUsage() <= cfd->options.write_buffer_size)) {
 					// There is room in current memtable
 					// Note that this is a sloppy check.  We can overfill a memtable by the
 					// amount of concurrently written data.
-					break;
+					++i;
 				}
-				else if (imm_ != NULL) {
+				else if (cfd->imm != NULL) {
 					// We have filled up the current memtable, but the previous
 					// one is still being compacted, so we wait.
 					bg_memtable_cv_.Signal();
+					UpdateStallCondition();
+					if (NotifyDeferredEvents()) {
+						// The listener ran unlocked; re-check before waiting.
+						continue;
+					}
+					const uint64_t start = env_->NowMicros();
 					bg_fg_cv_.Wait();
+					const uint64_t stalled = env_->NowMicros() - start;
+					atomic::increment_64_nobarrier(&stall_memtable_micros_, stalled);
+					RecordTick(options_.statistics, kStallMicros, stalled);
 				}
 				else {
-					// Attempt to switch to a new memtable and trigger compaction of old
+					// Attempt to switch to a new memtable and trigger compaction of
+					// old.  The new log lets the older ones go once every column
+					// family has flushed what it wrote to them.
 					assert(versions_->PrevLogNumber() == 0);
 					uint64_t new_log_number = versions_->NewFileNumber();
 					ConcurrentWritableFile* lfile = NULL;
@@ -1584,29 +2998,45 @@ namespace leveldb {
 					logfile_.reset(lfile);
 					logfile_number_ = new_log_number;
 					log_.reset(new log::Writer(lfile));
-					imm_ = mem_;
+					cfd->imm = cfd->mem;
 					w->has_imm_ = true;
-					mem_ = new MemTable(internal_comparator_);
-					mem_->Ref();
+					cfd->mem = new MemTable(cfd->internal_comparator);
+					cfd->mem->Ref();
+					cfd->mem_log_number = new_log_number;
 					force = false;   // Do not force another compaction if have room
-					enqueue_mem = true;
-					break;
+					enqueue_mem = enqueue_mem || cfd == default_cf_;
+					++i;
+				}
+			}
+
+			if (s.ok()) {
+				for (size_t i = 0; i < targets.size(); i++) {
+					if (targets[i]->dropped) {
+						// Dropped while we waited
+						s = Status::InvalidArgument("column family was dropped",
+							targets[i]->name);
+					}
 				}
 			}
 
 			if (s.ok()) {
 				w->log_ = log_;
 				w->logfile_ = logfile_;
-				w->mem_ = mem_;
-				mem_->Ref();
+				for (size_t i = 0; i < targets.size(); i++) {
+					w->mems_.push_back(std::make_pair(targets[i]->id, targets[i]->mem));
+					targets[i]->mem->Ref();
+				}
 			}
 
 			if (enqueue_mem) {
 				for (std::list<ReplayIteratorImpl*>::iterator it = replay_iters_.begin();
 					it != replay_iters_.end(); ++it) {
-					(*it)->enqueue(mem_, w->start_sequence_);
+					(*it)->enqueue(default_cf_->mem, w->start_sequence_);
 				}
 			}
+
+			UpdateStallCondition();
+			NotifyDeferredEvents();
 		}
 
 		if (s.ok()) {
@@ -1672,7 +3102,7 @@ namespace leveldb {
 
 		if (w->has_imm_ && !w->prev_) {
 			mutex_.Lock();
-			has_imm_.Release_Store(imm_);
+			has_imm_.Release_Store(AnyImmutableMemTable());
 			w->has_imm_ = false;
 			bg_memtable_cv_.Signal();
 			mutex_.Unlock();
@@ -1680,6 +3110,10 @@ namespace leveldb {
 
 		if (w->micros_ > config::kL0_SlowdownWritesTrigger) {
 			env_->SleepForMicroseconds(w->micros_ - config::kL0_SlowdownWritesTrigger);
+			atomic::increment_64_nobarrier(&stall_level0_micros_,
+				w->micros_ - config::kL0_SlowdownWritesTrigger);
+			RecordTick(options_.statistics, kStallMicros,
+				w->micros_ - config::kL0_SlowdownWritesTrigger);
 		}
 	}
 
@@ -1714,24 +3148,91 @@ namespace leveldb {
 
 		if (w.has_imm_) {
 			mutex_.Lock();
-			has_imm_.Release_Store(imm_);
+			has_imm_.Release_Store(AnyImmutableMemTable());
 			w.has_imm_ = false;
 			bg_memtable_cv_.Signal();
 			mutex_.Unlock();
 		}
 	}
 
+	Status DBImpl::BeginExclusiveWrite(Writer* w, WriteBatch* updates) {
+		{
+			MutexLock l(&writers_mutex_);
+			backup_in_progress_.Release_Store(this);
+			while (backup_waiter_has_it_) {
+				++backup_waiters_;
+				backup_cv_.Wait();
+				--backup_waiters_;
+			}
+			backup_waiter_has_it_ = true;
+		}
+
+		w->block_if_backup_in_progress_ = false;
+		Status s = SequenceWriteBegin(w, updates);
+
+		{
+			// Writers queued ahead of w took their sequence numbers before
+			// backup_in_progress_ was set; let them finish.
+			MutexLock l(&writers_mutex_);
+			Writer* p = w;
+			while (p->prev_) {
+				p = p->prev_;
+			}
+			while (p != w) {
+				assert(p);
+				p->block_if_backup_in_progress_ = false;
+				p->cv_.Signal();
+				p = p->next_;
+			}
+			while (w->prev_) {
+				w->wake_me_when_head_ = true;
+				w->cv_.Wait();
+			}
+		}
+		return s;
+	}
+
+	void DBImpl::EndExclusiveWrite(Writer* w) {
+		{
+			MutexLock l(&writers_mutex_);
+			backup_waiter_has_it_ = false;
+			if (backup_waiters_ > 0) {
+				backup_in_progress_.Release_Store(this);
+				backup_cv_.Signal();
+			}
+			else {
+				backup_in_progress_.Release_Store(NULL);
+			}
+		}
+
+		SequenceWriteEnd(w);
+	}
+
 	bool DBImpl::GetProperty(const Slice& property, std::string* value) {
+		return GetProperty(NULL, property, value);
+	}
+
+	bool DBImpl::GetProperty(ColumnFamilyHandle* column_family,
+		const Slice& property, std::string* value) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
 		value->clear();
 
+		uint64_t int_value;
+		if (GetIntProperty(column_family, property, &int_value)) {
+			char buf[30];
+			snprintf(buf, sizeof(buf), "%llu", (unsigned long long) int_value);
+			*value = buf;
+			return true;
+		}
+
 		MutexLock l(&mutex_);
 		Slice in = property;
 		Slice prefix("leveldb.");
 		if (!in.starts_with(prefix)) return false;
 		in.remove_prefix(prefix.size());
 
-		if (in.starts_with("num-files-at-level")) {
-			in.remove_prefix(strlen("num-files-at-level"));
+		if (in.starts_with("compaction-score-at-level")) {
+			in.remove_prefix(strlen("compaction-score-at-level"));
 			uint64_t level;
 			bool ok = ConsumeDecimalNumber(&in, &level) && in.empty();
 			if (!ok || level >= config::kNumLevels) {
@@ -1739,62 +3240,249 @@ namespace leveldb {
 			}
 			else {
 				char buf[100];
-				snprintf(buf, sizeof(buf), "%d",
-					versions_->NumLevelFiles(static_cast<int>(level)));
+				snprintf(buf, sizeof(buf), "%.3f",
+					cfd->versions->current()->CompactionScore(static_cast<unsigned>(level)));
 				*value = buf;
 				return true;
 			}
 		}
 		else if (in == "stats") {
-			char buf[200];
-			snprintf(buf, sizeof(buf),
-				"                               Compactions\n"
-				"Level  Files Size(MB) Time(sec) Read(MB) Write(MB)\n"
-				"--------------------------------------------------\n"
-			);
-			value->append(buf);
-			for (unsigned level = 0; level < config::kNumLevels; level++) {
-				int files = versions_->NumLevelFiles(level);
-				if (stats_[level].micros > 0 || files > 0) {
-					snprintf(
-						buf, sizeof(buf),
-						"%3d %8d %8.0f %9.0f %8.0f %9.0f\n",
-						level,
-						files,
-						versions_->NumLevelBytes(level) / 1048576.0,
-						stats_[level].micros / 1e6,
-						stats_[level].bytes_read / 1048576.0,
-						stats_[level].bytes_written / 1048576.0);
-					value->append(buf);
-				}
-			}
+			AppendCompactionStats(cfd, value);
 			return true;
 		}
 		else if (in == "sstables") {
-			*value = versions_->current()->DebugString();
+			*value = cfd->versions->current()->DebugString();
 			return true;
 		}
 
 		return false;
 	}
 
+	// Number of sorted runs a point lookup may have to search
+	static uint64_t SortedRuns(VersionSet* versions) {
+		uint64_t runs = versions->NumLevelFiles(0);
+		for (unsigned level = 1; level < config::kNumLevels; level++) {
+			if (versions->NumLevelFiles(level) > 0) {
+				runs++;
+			}
+		}
+		return runs;
+	}
+
+	// Columns of the rows printed by AppendStatsRow()
+	static void AppendStatsHeader(std::string* value) {
+		char buf[200];
+		snprintf(buf, sizeof(buf),
+			" %5s %9s %9s %9s %9s %9s %7s %8s %8s %11s %11s %6s\n",
+			"Count", "Time(sec)", "Rn(MB)", "Rnp1(MB)", "Write(MB)", "Moved(MB)",
+			"FilesN", "FilesN+1", "FilesOut", "RecordsIn", "RecordsDrop", "W-Amp");
+		value->append(buf);
+	}
+
+	void DBImpl::AppendStatsRow(const CompactionStats& s, double w_amp,
+		std::string* value) {
+		char buf[200];
+		snprintf(buf, sizeof(buf),
+			" %5lld %9.1f %9.1f %9.1f %9.1f %9.1f %7lld %8lld %8lld %11lld %11lld %6.1f\n",
+			static_cast<long long>(s.count),
+			s.micros / 1e6,
+			s.bytes_read_level / 1048576.0,
+			s.bytes_read_next / 1048576.0,
+			s.bytes_written / 1048576.0,
+			s.bytes_moved / 1048576.0,
+			static_cast<long long>(s.files_read_level),
+			static_cast<long long>(s.files_read_next),
+			static_cast<long long>(s.files_written),
+			static_cast<long long>(s.records_in),
+			static_cast<long long>(s.records_dropped),
+			w_amp);
+		value->append(buf);
+	}
+
+	void DBImpl::AppendCompactionStats(ColumnFamilyData* cfd, std::string* value) {
+		mutex_.AssertHeld();
+		char buf[200];
+
+		// The first columns are those this property has always shown.
+		value->append(
+			"                               Compactions\n"
+			"Level  Files Size(MB) Time(sec) Read(MB) Write(MB)");
+		AppendStatsHeader(value);
+		CompactionStats total;
+		int total_files = 0;
+		int64_t total_bytes = 0;
+		for (unsigned level = 0; level < config::kNumLevels; level++) {
+			const CompactionStats& s = stats_[level];
+			int files = cfd->versions->NumLevelFiles(level);
+			total.Add(s);
+			total_files += files;
+			total_bytes += cfd->versions->NumLevelBytes(level);
+			if (s.count > 0 || files > 0) {
+				snprintf(
+					buf, sizeof(buf),
+					"%3d %8d %8.0f %9.0f %8.0f %9.0f",
+					level,
+					files,
+					cfd->versions->NumLevelBytes(level) / 1048576.0,
+					s.micros / 1e6,
+					(s.bytes_read_level + s.bytes_read_next) / 1048576.0,
+					s.bytes_written / 1048576.0);
+				value->append(buf);
+				AppendStatsRow(s, s.WriteAmp(), value);
+			}
+		}
+
+		// The sum's write amplification is everything written per byte
+		// flushed, i.e. how often each byte that entered the DB was written.
+		const double w_amp = flush_stats_.bytes_written > 0 ?
+			static_cast<double>(total.bytes_written) / flush_stats_.bytes_written : 0.0;
+		snprintf(buf, sizeof(buf), "Sum %8d %8.0f %9.0f %8.0f %9.0f",
+			total_files,
+			total_bytes / 1048576.0,
+			total.micros / 1e6,
+			(total.bytes_read_level + total.bytes_read_next) / 1048576.0,
+			total.bytes_written / 1048576.0);
+		value->append(buf);
+		AppendStatsRow(total, w_amp, value);
+
+		static const char* const kReasonNames[kNumCompactionReasons] = {
+			"level0", "size", "seek", "manual", "expiry"
+		};
+		value->append("\n                               By reason\nReason");
+		AppendStatsHeader(value);
+		value->append("flush ");
+		AppendStatsRow(flush_stats_, flush_stats_.WriteAmp(), value);
+		for (int r = 0; r < kNumCompactionReasons; r++) {
+			snprintf(buf, sizeof(buf), "%-6s", kReasonNames[r]);
+			value->append(buf);
+			AppendStatsRow(reason_stats_[r], reason_stats_[r].WriteAmp(), value);
+		}
+
+		snprintf(buf, sizeof(buf),
+			"\nWrite amplification: %.2f (%.1f MB flushed, %.1f MB written)\n"
+			"Read amplification: %llu (level-0 files + non-empty levels)\n"
+			"Stalls(sec): %.3f memtable full, %.3f level-0 slowdown\n",
+			w_amp,
+			flush_stats_.bytes_written / 1048576.0,
+			total.bytes_written / 1048576.0,
+			static_cast<unsigned long long>(SortedRuns(cfd->versions)),
+			atomic::load_64_nobarrier(&stall_memtable_micros_) / 1e6,
+			atomic::load_64_nobarrier(&stall_level0_micros_) / 1e6);
+		value->append(buf);
+	}
+
+	bool DBImpl::GetIntProperty(const Slice& property, uint64_t* value) {
+		return GetIntProperty(NULL, property, value);
+	}
+
+	bool DBImpl::GetIntProperty(ColumnFamilyHandle* column_family,
+		const Slice& property, uint64_t* value) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
+		Slice in = property;
+		Slice prefix("leveldb.");
+		if (!in.starts_with(prefix)) return false;
+		in.remove_prefix(prefix.size());
+
+		// Properties that do not need mutex_
+		if (in == "block-cache-usage") {
+			*value = cfd->options.block_cache->TotalCharge();
+			return true;
+		}
+		else if (in == "block-cache-pinned-usage") {
+			*value = cfd->options.block_cache->PinnedCharge();
+			return true;
+		}
+		else if (in == "estimate-table-readers-mem") {
+			*value = cfd->table_cache->TableReadersMemory();
+			return true;
+		}
+		else if (in == "estimate-live-data-size") {
+			// Walks every file, so only hold mutex_ to pin the version.
+			mutex_.Lock();
+			Version* current = cfd->versions->current();
+			current->Ref();
+			mutex_.Unlock();
+			*value = current->EstimateLiveDataSize();
+			mutex_.Lock();
+			current->Unref();
+			mutex_.Unlock();
+			return true;
+		}
+
+		MutexLock l(&mutex_);
+		if (in.starts_with("num-files-at-level")) {
+			in.remove_prefix(strlen("num-files-at-level"));
+			uint64_t level;
+			bool ok = ConsumeDecimalNumber(&in, &level) && in.empty();
+			if (!ok || level >= config::kNumLevels) {
+				return false;
+			}
+			*value = cfd->versions->NumLevelFiles(static_cast<int>(level));
+		}
+		else if (in == "cur-size-active-mem-table") {
+			*value = cfd->mem->ApproximateMemoryUsage();
+		}
+		else if (in == "cur-size-all-mem-tables") {
+			*value = cfd->mem->ApproximateMemoryUsage() +
+				(cfd->imm != NULL ? cfd->imm->ApproximateMemoryUsage() : 0);
+		}
+		else if (in == "num-entries-active-mem-table") {
+			*value = cfd->mem->NumEntries();
+		}
+		else if (in == "num-entries-imm-mem-tables") {
+			*value = cfd->imm != NULL ? cfd->imm->NumEntries() : 0;
+		}
+		else if (in == "num-immutable-mem-table") {
+			*value = cfd->imm != NULL ? 1 : 0;
+		}
+		else if (in == "estimate-pending-compaction-bytes") {
+			*value = cfd->versions->EstimatePendingCompactionBytes();
+		}
+		else if (in == "num-snapshots") {
+			*value = snapshots_.size();
+		}
+		else if (in == "oldest-snapshot-sequence") {
+			*value = snapshots_.empty() ? 0 : snapshots_.oldest()->number_;
+		}
+		else if (in == "num-replay-iterators") {
+			*value = replay_iters_.size();
+		}
+		else if (in == "background-errors") {
+			*value = bg_error_.ok() ? 0 : 1;
+		}
+		else if (in == "read-amplification") {
+			*value = SortedRuns(cfd->versions);
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
 	void DBImpl::GetApproximateSizes(
 		const Range* range, int n,
 		uint64_t* sizes) {
+		GetApproximateSizes(NULL, range, n, sizes);
+	}
+
+	void DBImpl::GetApproximateSizes(ColumnFamilyHandle* column_family,
+		const Range* range, int n,
+		uint64_t* sizes) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
 		// TODO(opt): better implementation
 		Version* v;
 		{
 			MutexLock l(&mutex_);
-			versions_->current()->Ref();
-			v = versions_->current();
+			cfd->versions->current()->Ref();
+			v = cfd->versions->current();
 		}
 
 		for (int i = 0; i < n; i++) {
 			// Convert user_key into a corresponding internal key.
 			InternalKey k1(range[i].start, kMaxSequenceNumber, kValueTypeForSeek);
 			InternalKey k2(range[i].limit, kMaxSequenceNumber, kValueTypeForSeek);
-			uint64_t start = versions_->ApproximateOffsetOf(v, k1);
-			uint64_t limit = versions_->ApproximateOffsetOf(v, k2);
+			uint64_t start = cfd->versions->ApproximateOffsetOf(v, k1);
+			uint64_t limit = cfd->versions->ApproximateOffsetOf(v, k2);
 			sizes[i] = (limit >= start ? limit - start : 0);
 		}
 
@@ -1805,6 +3493,9 @@ namespace leveldb {
 	}
 
 	Status DBImpl::LiveBackup(const Slice& _name) {
+		if (open_mode_ != kOpenReadWrite) {
+			return ReadOnlyError();
+		}
 		Slice name = _name;
 		size_t name_sz = 0;
 
@@ -1812,40 +3503,15 @@ namespace leveldb {
 			;
 
 		name = Slice(name.data(), name_sz);
-		std::set<uint64_t> live;
 
-		{
-			MutexLock l(&writers_mutex_);
-			backup_in_progress_.Release_Store(this);
-			while (backup_waiter_has_it_) {
-				++backup_waiters_;
-				backup_cv_.Wait();
-				--backup_waiters_;
-			}
-			backup_waiter_has_it_ = true;
-		}
+		// The directory of each column family, where it goes in the
+		// backup, and its live files
+		std::vector<std::string> dirs;
+		std::vector<std::string> targets;
+		std::vector<std::set<uint64_t> > lives;
 
 		Writer w(&writers_mutex_);
-		w.block_if_backup_in_progress_ = false;
-		SequenceWriteBegin(&w, NULL);
-
-		{
-			MutexLock l(&writers_mutex_);
-			Writer* p = &w;
-			while (p->prev_) {
-				p = p->prev_;
-			}
-			while (p != &w) {
-				assert(p);
-				p->block_if_backup_in_progress_ = false;
-				p->cv_.Signal();
-				p = p->next_;
-			}
-			while (w.prev_) {
-				w.wake_me_when_head_ = true;
-				w.cv_.Wait();
-			}
-		}
+		BeginExclusiveWrite(&w, NULL);
 
 		{
 			MutexLock l(&mutex_);
@@ -1859,60 +3525,74 @@ namespace leveldb {
 			// will see backup_in_progress_.  If you change DeleteObsoleteFiles to
 			// release mutex_, you'll need to add some sort of synchronization in place
 			// of this text block.
-			versions_->AddLiveFiles(&live);
+			const std::string backup_dir = dbname_ + "/backup-" + name.ToString();
+			for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+				it != column_families_.end();
+				++it) {
+				ColumnFamilyData* cfd = it->second;
+				dirs.push_back(cfd->dir);
+				targets.push_back(cfd == default_cf_ ? backup_dir :
+					ColumnFamilyDirName(backup_dir, cfd->id));
+				lives.push_back(std::set<uint64_t>());
+				cfd->versions->AddLiveFiles(&lives.back());
+			}
 		}
 
 		Status s;
-		std::vector<std::string> filenames;
-		s = env_->GetChildren(dbname_, &filenames);
-		std::string backup_dir = dbname_ + "/backup-" + name.ToString() + "/";
+		for (size_t d = 0; s.ok() && d < dirs.size(); d++) {
+			std::vector<std::string> filenames;
+			s = env_->GetChildren(dirs[d], &filenames);
+			const std::string backup_dir = targets[d] + "/";
+			const std::set<uint64_t>& live = lives[d];
 
-		if (s.ok()) {
-			s = env_->CreateDir(backup_dir);
-		}
+			if (s.ok()) {
+				s = env_->CreateDir(backup_dir);
+			}
 
-		uint64_t number;
-		FileType type;
+			uint64_t number;
+			FileType type;
 
-		for (size_t i = 0; i < filenames.size(); i++) {
-			if (!s.ok()) {
-				continue;
-			}
-			if (ParseFileName(filenames[i], &number, &type)) {
-				std::string src = dbname_ + "/" + filenames[i];
-				std::string target = backup_dir + "/" + filenames[i];
-				switch (type) {
-				case kLogFile:
-				case kDescriptorFile:
-				case kCurrentFile:
-				case kInfoLogFile:
-					s = env_->CopyFile(src, target);
-					break;
-				case kTableFile:
-					// If it's a file referenced by a version, we have logged that version
-					// and applied it.  Our MANIFEST will reflect that, and the file
-					// number assigned to new files will be greater or equal, ensuring
-					// that they aren't overwritten.  Any file not in "live" either exists
-					// past the current manifest (output of ongoing compaction) or so far
-					// in the past we don't care (we're going to delete it at the end of
-					// this backup).  I'd rather play safe than sorry.
-					//
-					// Under no circumstances should you collapse this to a single
-					// LinkFile without the conditional as it has implications for backups
-					// that share hardlinks.  Opening an older backup that has files
-					// hardlinked with newer backups will overwrite "immutable" files in
-					// the newer backups because they aren't in our manifest, and we do an
-					// open/write rather than a creat/rename.  We avoid linking these
-					// files.
-					if (live.find(number) != live.end()) {
-						s = env_->LinkFile(src, target);
+			for (size_t i = 0; i < filenames.size(); i++) {
+				if (!s.ok()) {
+					continue;
+				}
+				if (ParseFileName(filenames[i], &number, &type)) {
+					std::string src = dirs[d] + "/" + filenames[i];
+					std::string target = backup_dir + "/" + filenames[i];
+					switch (type) {
+					case kLogFile:
+					case kDescriptorFile:
+					case kCurrentFile:
+					case kInfoLogFile:
+						s = env_->CopyFile(src, target);
+						break;
+					case kTableFile:
+					case kBlobFile:
+						// If it's a file referenced by a version, we have logged that version
+						// and applied it.  Our MANIFEST will reflect that, and the file
+						// number assigned to new files will be greater or equal, ensuring
+						// that they aren't overwritten.  Any file not in "live" either exists
+						// past the current manifest (output of ongoing compaction) or so far
+						// in the past we don't care (we're going to delete it at the end of
+						// this backup).  I'd rather play safe than sorry.
+						//
+						// Under no circumstances should you collapse this to a single
+						// LinkFile without the conditional as it has implications for backups
+						// that share hardlinks.  Opening an older backup that has files
+						// hardlinked with newer backups will overwrite "immutable" files in
+						// the newer backups because they aren't in our manifest, and we do an
+						// open/write rather than a creat/rename.  We avoid linking these
+						// files.
+						if (live.find(number) != live.end()) {
+							s = env_->LinkFile(src, target);
+						}
+						break;
+					case kTempFile:
+					case kDBLockFile:
+						break;
+					default:
+						break;
 					}
-					break;
-				case kTempFile:
-				case kDBLockFile:
-					break;
-				default:
-					break;
 				}
 			}
 		}
@@ -1925,24 +3605,307 @@ namespace leveldb {
 			backup_deferred_delete_ = false;
 			bg_log_occupied_ = false;
 			bg_log_cv_.Signal();
+			NotifyDeferredEvents();
 		}
 
+		EndExclusiveWrite(&w);
+		return s;
+	}
+
+	// Returns true if the user keys in "mem" span any part of
+	// [smallest,largest].
+	static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+		const Slice& smallest, const Slice& largest) {
+		Iterator* iter = mem->NewIterator();
+		bool overlaps = false;
+		iter->SeekToFirst();
+		if (iter->Valid() && ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0) {
+			iter->SeekToLast();
+			overlaps = ucmp->Compare(ExtractUserKey(iter->key()), smallest) >= 0;
+		}
+		delete iter;
+		return overlaps;
+	}
+
+	Status DBImpl::IngestExternalFile(const std::string& fname,
+		const IngestExternalFileOptions& ingest) {
+		if (open_mode_ != kOpenReadWrite) {
+			return ReadOnlyError();
+		}
+		ColumnFamilyData* const cfd = default_cf_;
+		// Find the key range of the table and check that SstFileWriter
+		// wrote it before changing anything.
+		uint64_t file_size = 0;
+		ParsedInternalKey smallest, largest;
+		std::map<std::string, std::string> props;
+		Status s = env_->GetFileSize(fname, &file_size);
+		if (s.ok()) {
+			RandomAccessFile* file = NULL;
+			Table* table = NULL;
+			s = env_->NewRandomAccessFile(fname, &file);
+			if (s.ok()) {
+				s = Table::Open(cfd->options, file, file_size, &table);
+			}
+			if (s.ok()) {
+				s = table->ReadProperties(&props);
+				if (s.IsNotFound()) {
+					s = Status::InvalidArgument(fname, "table has no properties block");
+				}
+			}
+			delete table;
+			delete file;
+		}
+		if (s.ok()) {
+			std::map<std::string, std::string>::const_iterator lo =
+				props.find(kPropertySmallestKey);
+			std::map<std::string, std::string>::const_iterator hi =
+				props.find(kPropertyLargestKey);
+			if (lo == props.end() || hi == props.end() ||
+				!ParseInternalKey(lo->second, &smallest) ||
+				!ParseInternalKey(hi->second, &largest) ||
+				smallest.sequence != 0 || largest.sequence != 0 ||
+				cfd->user_comparator()->Compare(smallest.user_key, largest.user_key) > 0) {
+				s = Status::InvalidArgument(fname, "not a table written by SstFileWriter");
+			}
+		}
+		if (!s.ok()) {
+			return s;
+		}
+
+		// Bring the table into the database directory under a temporary
+		// name, so that only a rename is left to do while writes wait.
+		uint64_t tmp_number;
 		{
-			MutexLock l(&writers_mutex_);
-			backup_waiter_has_it_ = false;
-			if (backup_waiters_ > 0) {
-				backup_in_progress_.Release_Store(this);
-				backup_cv_.Signal();
+			MutexLock l(&mutex_);
+			tmp_number = cfd->versions->NewFileNumber();
+			cfd->pending_outputs.insert(tmp_number);
+		}
+		const std::string tmp = TempFileName(cfd->dir, tmp_number);
+		if (ingest.move_file) {
+			s = env_->RenameFile(fname, tmp);
+		}
+		else {
+			s = env_->LinkFile(fname, tmp);
+			if (!s.ok()) {
+				s = env_->CopyFile(fname, tmp);
 			}
-			else {
-				backup_in_progress_.Release_Store(NULL);
+		}
+		bool have_tmp = s.ok();
+
+		// The table must end up newer than everything already written in
+		// its range, and older than everything written after this call.
+		// Holding writes off, take a sequence number G for it; once the
+		// writers before G are done, any of their keys in the range must
+		// already be in a table below where this one goes, so flush the
+		// memtables and try again if they are not.
+		uint64_t number = 0;
+		unsigned level = 0;
+		SequenceNumber global_sequence = 0;
+		bool installed = false;
+		while (s.ok() && !installed) {
+			Writer w(&writers_mutex_);
+			WriteBatch empty;
+			s = BeginExclusiveWrite(&w, &empty);
+			if (s.ok()) {
+				MutexLock l(&mutex_);
+				const Comparator* ucmp = cfd->user_comparator();
+				if (MemTableOverlaps(cfd->mem, ucmp, smallest.user_key, largest.user_key) ||
+					(cfd->imm != NULL && MemTableOverlaps(cfd->imm, ucmp, smallest.user_key, largest.user_key))) {
+					// Flush below, once writes may continue
+				}
+				else {
+					// Go as deep as the levels above are clear of the range.
+					// A level that a compaction is writing may gain a file
+					// spanning the range at any moment, so stop above it.
+					Version* base = cfd->versions->current();
+					bool overlaps = false;
+					for (unsigned i = 0; i < config::kNumLevels && !overlaps; i++) {
+						overlaps = base->OverlapInLevel(i, &smallest.user_key, &largest.user_key);
+					}
+					if (cfd->options.compaction_style == kCompactionStyleLevel &&
+						!base->OverlapInLevel(0, &smallest.user_key, &largest.user_key)) {
+						while (level + 1 < config::kNumLevels && !cfd->levels_locked[level + 1] &&
+							!base->OverlapInLevel(level + 1, &smallest.user_key, &largest.user_key)) {
+							++level;
+						}
+					}
+					// A table that shadows nothing can keep sequence number
+					// zero unless a snapshot must not see it.
+					global_sequence = (overlaps || !snapshots_.empty()) ? w.end_sequence_ : 0;
+					versions_->SetLastSequence(w.end_sequence_);
+
+					number = cfd->versions->NewFileNumber();
+					cfd->pending_outputs.insert(number);
+					s = env_->RenameFile(tmp, TableFileName(cfd->dir, number));
+					if (s.ok()) {
+						have_tmp = false;
+						VersionEdit edit;
+						edit.AddFile(level, number, file_size,
+							InternalKey(smallest.user_key, global_sequence, smallest.type),
+							InternalKey(largest.user_key, global_sequence, largest.type),
+							global_sequence);
+						// Keep compactions and memtable flushes that started
+						// from the old version out of the level.
+						const bool lock = level > 0;
+						if (lock) {
+							cfd->levels_locked[level] = true;
+						}
+						s = LogAndApply(cfd, &edit);
+						if (lock) {
+							cfd->levels_locked[level] = false;
+						}
+						bg_compaction_cv_.Signal();
+					}
+					cfd->pending_outputs.erase(number);
+					installed = true;
+				}
+			}
+			EndExclusiveWrite(&w);
+			if (s.ok() && !installed) {
+				s = FlushMemTable(cfd);
 			}
 		}
 
-		SequenceWriteEnd(&w);
+		if (have_tmp && ingest.move_file) {
+			// Hand the table back
+			env_->RenameFile(tmp, fname);
+		}
+		MutexLock l(&mutex_);
+		cfd->pending_outputs.erase(tmp_number);
+		DeleteObsoleteFiles();
+		if (s.ok()) {
+			Log(options_.info_log, "Ingested table #%llu: %lld bytes at level-%d, sequence %llu",
+				(unsigned long long) number,
+				(unsigned long long) file_size,
+				level,
+				(unsigned long long) global_sequence);
+		}
+		else {
+			Log(options_.info_log, "Ingesting %s failed: %s",
+				fname.c_str(), s.ToString().c_str());
+		}
 		return s;
 	}
 
+	Status DBImpl::CreateColumnFamily(const Options& options, const std::string& name,
+		ColumnFamilyHandle** handle) {
+		*handle = NULL;
+		if (open_mode_ != kOpenReadWrite) {
+			return ReadOnlyError();
+		}
+		// Held across the file I/O below, where mutex_ is released, so that
+		// two callers cannot pick the same name or id.
+		MutexLock create_lock(&create_cf_mutex_);
+		mutex_.Lock();
+		Status s = bg_error_;
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			s.ok() && it != column_families_.end();
+			++it) {
+			if (it->second->name == name) {
+				s = Status::InvalidArgument(name, "column family already exists");
+			}
+		}
+
+		// Register the column family before creating its directory: a
+		// crash in between leaves a directory without a descriptor, which
+		// the next Open() sets up again.
+		const uint32_t id = versions_->NextColumnFamilyID();
+		if (s.ok()) {
+			VersionEdit edit;
+			edit.AddColumnFamily(id, name);
+			s = LogAndApply(default_cf_, &edit);
+		}
+		if (!s.ok()) {
+			mutex_.Unlock();
+			return s;
+		}
+		ColumnFamilyData* cfd = NewColumnFamilyData(id, name, options);
+		// No write can name the family before it is in column_families_, so
+		// its descriptor may start from any log that is still current.
+		uint64_t log_number = logfile_number_;
+		mutex_.Unlock();
+
+		s = env_->CreateDir(cfd->dir);
+		if (s.ok()) {
+			s = NewDB(cfd, log_number);
+		}
+		if (s.ok()) {
+			s = cfd->versions->Recover();
+		}
+
+		MutexLock l(&mutex_);
+		if (s.ok()) {
+			log_number = logfile_number_;
+			VersionEdit first;
+			first.SetLogNumber(log_number);
+			s = LogAndApply(cfd, &first);
+		}
+		if (!s.ok()) {
+			delete cfd;
+			VersionEdit undo;
+			undo.DropColumnFamily(id);
+			LogAndApply(default_cf_, &undo);  // Its directory goes at the next Open()
+			return s;
+		}
+		cfd->mem_log_number = log_number;
+		column_families_[id] = cfd;
+		*handle = &cfd->handle;
+		Log(options_.info_log, "Created column family %s (id %u)", name.c_str(),
+			static_cast<unsigned>(id));
+		return s;
+	}
+
+	Status DBImpl::DropColumnFamily(ColumnFamilyHandle* column_family) {
+		ColumnFamilyData* cfd = GetColumnFamilyData(column_family);
+		if (cfd == default_cf_) {
+			return Status::InvalidArgument("the default column family cannot be dropped");
+		}
+		if (open_mode_ != kOpenReadWrite) {
+			return ReadOnlyError();
+		}
+		MutexLock l(&mutex_);
+		if (cfd->dropped) {
+			return Status::InvalidArgument(cfd->name, "column family already dropped");
+		}
+		// Marked first so that writers and a concurrent drop see it while
+		// the edit is logged without the lock.
+		cfd->dropped = true;
+		VersionEdit edit;
+		edit.DropColumnFamily(cfd->id);
+		Status s = LogAndApply(default_cf_, &edit);
+		if (!s.ok()) {
+			cfd->dropped = false;
+			return s;
+		}
+		column_families_.erase(cfd->id);
+		dropped_column_families_.push_back(cfd);
+		Log(options_.info_log, "Dropped column family %s (id %u)", cfd->name.c_str(),
+			static_cast<unsigned>(cfd->id));
+		// Its memtable no longer holds back the deletion of logs
+		DeleteObsoleteFiles();
+		bg_fg_cv_.SignalAll();
+		return s;
+	}
+
+	ColumnFamilyHandle* DBImpl::DefaultColumnFamily() const {
+		return &default_cf_->handle;
+	}
+
+	Status DBImpl::GetColumnFamilyHandle(const std::string& name,
+		ColumnFamilyHandle** handle) {
+		MutexLock l(&mutex_);
+		for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			if (it->second->name == name) {
+				*handle = &it->second->handle;
+				return Status::OK();
+			}
+		}
+		*handle = NULL;
+		return Status::NotFound(name, "no such column family");
+	}
+
 	// Default implementations of convenience methods that subclasses of DB
 	// can call if they wish
 	Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
@@ -1957,27 +3920,165 @@ namespace leveldb {
 		return Write(opt, &batch);
 	}
 
+	Status DB::Put(const WriteOptions& opt, ColumnFamilyHandle* column_family,
+		const Slice& key, const Slice& value) {
+		WriteBatch batch;
+		batch.Put(column_family, key, value);
+		return Write(opt, &batch);
+	}
+
+	Status DB::Delete(const WriteOptions& opt, ColumnFamilyHandle* column_family,
+		const Slice& key) {
+		WriteBatch batch;
+		batch.Delete(column_family, key);
+		return Write(opt, &batch);
+	}
+
 	DB::~DB() { }
 
+	bool DB::GetIntProperty(const Slice& property, uint64_t* value) {
+		std::string s;
+		if (!GetProperty(property, &s)) {
+			return false;
+		}
+		Slice in = s;
+		return ConsumeDecimalNumber(&in, value) && in.empty();
+	}
+
+	Status DB::IngestExternalFile(const std::string&, const IngestExternalFileOptions&) {
+		return Status::NotSupported("IngestExternalFile");
+	}
+
+	Status DB::CreateColumnFamily(const Options&, const std::string&,
+		ColumnFamilyHandle** handle) {
+		*handle = NULL;
+		return Status::NotSupported("CreateColumnFamily");
+	}
+
+	Status DB::DropColumnFamily(ColumnFamilyHandle*) {
+		return Status::NotSupported("DropColumnFamily");
+	}
+
+	ColumnFamilyHandle* DB::DefaultColumnFamily() const {
+		return NULL;
+	}
+
+	Status DB::GetColumnFamilyHandle(const std::string&, ColumnFamilyHandle** handle) {
+		*handle = NULL;
+		return Status::NotSupported("GetColumnFamilyHandle");
+	}
+
+	static bool IsDefaultColumnFamily(ColumnFamilyHandle* column_family) {
+		return column_family == NULL || column_family->GetID() == 0;
+	}
+
+	Status DB::Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+		const Slice& key, std::string* value) {
+		if (!IsDefaultColumnFamily(column_family)) {
+			return Status::NotSupported("column families");
+		}
+		return Get(options, key, value);
+	}
+
+	Iterator* DB::NewIterator(const ReadOptions& options,
+		ColumnFamilyHandle* column_family) {
+		if (!IsDefaultColumnFamily(column_family)) {
+			return NewErrorIterator(Status::NotSupported("column families"));
+		}
+		return NewIterator(options);
+	}
+
+	bool DB::GetProperty(ColumnFamilyHandle* column_family,
+		const Slice& property, std::string* value) {
+		return IsDefaultColumnFamily(column_family) && GetProperty(property, value);
+	}
+
+	bool DB::GetIntProperty(ColumnFamilyHandle* column_family,
+		const Slice& property, uint64_t* value) {
+		return IsDefaultColumnFamily(column_family) && GetIntProperty(property, value);
+	}
+
+	void DB::GetApproximateSizes(ColumnFamilyHandle* column_family,
+		const Range* range, int n, uint64_t* sizes) {
+		if (IsDefaultColumnFamily(column_family)) {
+			GetApproximateSizes(range, n, sizes);
+		}
+		else {
+			for (int i = 0; i < n; i++) {
+				sizes[i] = 0;
+			}
+		}
+	}
+
+	void DB::CompactRange(ColumnFamilyHandle* column_family,
+		const Slice* begin, const Slice* end) {
+		if (IsDefaultColumnFamily(column_family)) {
+			CompactRange(begin, end);
+		}
+	}
+
+	Status DB::Flush(ColumnFamilyHandle*) {
+		return Status::NotSupported("Flush");
+	}
+
+	Status DB::TryCatchUpWithPrimary() {
+		return Status::NotSupported("TryCatchUpWithPrimary");
+	}
+
+	ColumnFamilyHandle::~ColumnFamilyHandle() {
+	}
+
+	const char* kDefaultColumnFamilyName = "default";
+
 	Status DB::Open(const Options& options, const std::string& dbname,
+		DB** dbptr) {
+		std::vector<ColumnFamilyDescriptor> column_families;
+		column_families.push_back(ColumnFamilyDescriptor(kDefaultColumnFamilyName, options));
+		std::vector<ColumnFamilyHandle*> handles;
+		return DB::Open(options, dbname, column_families, &handles, dbptr);
+	}
+
+	Status DB::Open(const Options& options, const std::string& dbname,
+		const std::vector<ColumnFamilyDescriptor>& column_families,
+		std::vector<ColumnFamilyHandle*>* handles,
 		DB** dbptr) {
 		*dbptr = NULL;
-		DBImpl* impl = new DBImpl(options, dbname);
+		handles->clear();
+		std::map<std::string, Options> cf_options;
+		Options default_cf_options = options;
+		for (size_t i = 0; i < column_families.size(); i++) {
+			const ColumnFamilyDescriptor& cf = column_families[i];
+			if (!cf_options.insert(std::make_pair(cf.name, cf.options)).second) {
+				return Status::InvalidArgument(cf.name, "column family listed twice");
+			}
+			if (cf.name == kDefaultColumnFamilyName) {
+				default_cf_options = cf.options;
+			}
+		}
+
+		DBImpl* impl = new DBImpl(options, dbname, default_cf_options);
 		impl->mutex_.Lock();
-		VersionEdit edit;
+		std::map<uint32_t, VersionEdit> edits;
 
-		Status s = impl->Recover(&edit); // Handles create_if_missing, error_if_exists
+		Status s = impl->Recover(cf_options, &edits); // Handles create_if_missing, error_if_exists
 		if (s.ok()) {
 			uint64_t new_log_number = impl->versions_->NewFileNumber();
 			ConcurrentWritableFile* lfile;
 			s = options.env->NewConcurrentWritableFile(LogFileName(dbname, new_log_number),
 				&lfile);
 			if (s.ok()) {
-				edit.SetLogNumber(new_log_number);
 				impl->logfile_.reset(lfile);
 				impl->logfile_number_ = new_log_number;
 				impl->log_.reset(new log::Writer(lfile));
-				s = impl->versions_->LogAndApply(&edit, &impl->mutex_, &impl->bg_log_cv_, &impl->bg_log_occupied_);
+				// Every column family starts over in the new log
+				for (std::map<uint32_t, ColumnFamilyData*>::iterator it = impl->column_families_.begin();
+					s.ok() && it != impl->column_families_.end();
+					++it) {
+					VersionEdit& edit = edits[it->first];
+					edit.SetLogNumber(new_log_number);
+					s = impl->LogAndApply(it->second, &edit);
+					it->second->mem_log_number = new_log_number;
+				}
 			}
 			if (s.ok()) {
 				impl->DeleteObsoleteFiles();
@@ -1985,22 +4086,140 @@ namespace leveldb {
 				impl->bg_memtable_cv_.Signal();
 			}
 		}
-		impl->pending_outputs_.clear();
+		for (std::map<uint32_t, ColumnFamilyData*>::iterator it = impl->column_families_.begin();
+			it != impl->column_families_.end();
+			++it) {
+			it->second->pending_outputs.clear();
+		}
 		impl->allow_background_activity_ = true;
+		if (s.ok() && impl->options_.warm_table_cache) {
+			++impl->num_bg_threads_;
+			impl->env_->StartThread(&DBImpl::WarmTableCacheWrapper, impl);
+		}
 		impl->bg_compaction_cv_.SignalAll();
 		impl->bg_memtable_cv_.SignalAll();
+		impl->NotifyDeferredEvents();
 		impl->mutex_.Unlock();
+		if (s.ok()) {
+			impl->writers_mutex_.Lock();
+			impl->writers_upper_ = impl->versions_->LastSequence();
+			impl->writers_mutex_.Unlock();
+		}
+
+		// Hand out the handles, creating the column families that do not
+		// exist yet
+		for (size_t i = 0; s.ok() && i < column_families.size(); i++) {
+			const ColumnFamilyDescriptor& cf = column_families[i];
+			ColumnFamilyHandle* handle = NULL;
+			impl->mutex_.Lock();
+			for (std::map<uint32_t, ColumnFamilyData*>::const_iterator it = impl->column_families_.begin();
+				it != impl->column_families_.end();
+				++it) {
+				if (it->second->name == cf.name) {
+					handle = &it->second->handle;
+				}
+			}
+			impl->mutex_.Unlock();
+			if (handle == NULL) {
+				if (options.create_if_missing) {
+					s = impl->CreateColumnFamily(cf.options, cf.name, &handle);
+				}
+				else {
+					s = Status::InvalidArgument(
+						cf.name, "column family does not exist (create_if_missing is false)");
+				}
+			}
+			handles->push_back(handle);
+		}
+
 		if (s.ok()) {
 			*dbptr = impl;
 		}
 		else {
+			handles->clear();
 			delete impl;
-			impl = NULL;
 		}
-		if (impl) {
-			impl->writers_mutex_.Lock();
-			impl->writers_upper_ = impl->versions_->LastSequence();
-			impl->writers_mutex_.Unlock();
+		return s;
+	}
+
+	namespace {
+
+		// The info log of a read-only instance that was not given one:
+		// opening LOG in the directory would move the primary's aside.
+		class NullLogger : public Logger {
+		public:
+			NullLogger() { }
+			virtual void Logv(const char* /*format*/, va_list /*ap*/) { }
+		};
+		NullLogger null_logger;
+
+	}  // namespace
+
+	Status DBImpl::OpenReadOnly(const Options& options, const std::string& dbname,
+		OpenMode mode, DB** dbptr) {
+		*dbptr = NULL;
+		Options opts = options;
+		if (opts.info_log == NULL) {
+			opts.info_log = &null_logger;
+		}
+		DBImpl* impl = new DBImpl(opts, dbname, opts, mode);
+		impl->mutex_.Lock();
+		impl->read_only_cf_options_ = opts;
+		std::map<std::string, Options> cf_options;
+		cf_options[kDefaultColumnFamilyName] = opts;
+		std::map<uint32_t, VersionEdit> edits;
+		Status s = impl->Recover(cf_options, &edits);
+		if (s.ok()) {
+			s = impl->CatchUp();
+		}
+		if (s.ok() && impl->options_.warm_table_cache) {
+			++impl->num_bg_threads_;
+			impl->env_->StartThread(&DBImpl::WarmTableCacheWrapper, impl);
+		}
+		if (s.ok() && mode == kOpenSecondary && impl->options_.secondary_catch_up_millis > 0) {
+			++impl->num_bg_threads_;
+			impl->env_->StartThread(&DBImpl::CatchUpWrapper, impl);
+		}
+		impl->mutex_.Unlock();
+		if (s.ok()) {
+			*dbptr = impl;
+		}
+		else {
+			delete impl;
+		}
+		return s;
+	}
+
+	Status DB::OpenForReadOnly(const Options& options, const std::string& dbname,
+		DB** dbptr) {
+		return DBImpl::OpenReadOnly(options, dbname, DBImpl::kOpenReadOnly, dbptr);
+	}
+
+	Status DB::OpenAsSecondary(const Options& options, const std::string& dbname,
+		DB** dbptr) {
+		return DBImpl::OpenReadOnly(options, dbname, DBImpl::kOpenSecondary, dbptr);
+	}
+
+	Status DB::ListColumnFamilies(const Options& options, const std::string& dbname,
+		std::vector<std::string>* column_families) {
+		column_families->clear();
+		// Only the descriptors are read, so neither an info log nor a
+		// block cache is set up.
+		InternalKeyComparator icmp(options.comparator);
+		Options read_options = options;
+		read_options.comparator = &icmp;
+		read_options.filter_policy = NULL;
+		TableCache table_cache(dbname, &read_options, 10);
+		VersionSet versions(dbname, &read_options, &table_cache, &icmp);
+		Status s = versions.Recover();
+		if (s.ok()) {
+			column_families->push_back(kDefaultColumnFamilyName);
+			const std::map<uint32_t, std::string>& families = versions.ColumnFamilies();
+			for (std::map<uint32_t, std::string>::const_iterator it = families.begin();
+				it != families.end();
+				++it) {
+				column_families->push_back(it->second);
+			}
 		}
 		return s;
 	}
@@ -2026,6 +4245,10 @@ namespace leveldb {
 			for (size_t i = 0; i < filenames.size(); i++) {
 				if (ParseFileName(filenames[i], &number, &type) &&
 					type != kDBLockFile) {  // Lock file will be deleted at end
+					if (type == kColumnFamilyDir) {
+						DeleteColumnFamilyDir(env, dbname + "/" + filenames[i]);
+						continue;
+					}
 					Status del = env->DeleteFile(dbname + "/" + filenames[i]);
 					if (result.ok() && !del.ok()) {
 						result = del;
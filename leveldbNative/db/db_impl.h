@@ -9,18 +9,24 @@
 
 #include <deque>
 #include <list>
+#include <map>
 #include <set>
+#include <utility>
+#include <vector>
 #ifdef _LIBCPP_VERSION
 #include <memory>
 #else
 #include <boost/tr1/memory.hpp>
 #endif
+#include "db/column_family.h"
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/replay_iterator.h"
 #include "db/snapshot.h"
+#include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/listener.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
@@ -31,6 +37,7 @@ namespace leveldb {
 #define SHARED_PTR std::tr1::shared_ptr
 #endif
 
+	class Compaction;
 	class MemTable;
 	class TableCache;
 	class Version;
@@ -39,7 +46,18 @@ namespace leveldb {
 
 	class DBImpl : public DB {
 	public:
-		DBImpl(const Options& options, const std::string& dbname);
+		// How the DB was opened
+		enum OpenMode {
+			kOpenReadWrite,
+			kOpenReadOnly,      // DB::OpenForReadOnly()
+			kOpenSecondary      // DB::OpenAsSecondary()
+		};
+
+		// The DB-wide fields of "options" apply to every column family; the
+		// default column family uses "default_cf_options".  Background
+		// threads are only started for kOpenReadWrite.
+		DBImpl(const Options& options, const std::string& dbname,
+			const Options& default_cf_options, OpenMode mode = kOpenReadWrite);
 		virtual ~DBImpl();
 
 		// Implementations of the DB interface
@@ -60,14 +78,48 @@ namespace leveldb {
 		virtual const Snapshot* GetSnapshot();
 		virtual void ReleaseSnapshot(const Snapshot* snapshot);
 		virtual bool GetProperty(const Slice& property, std::string* value);
+		virtual bool GetIntProperty(const Slice& property, uint64_t* value);
 		virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
 		virtual void CompactRange(const Slice* begin, const Slice* end);
 		virtual Status LiveBackup(const Slice& name);
+		virtual Status IngestExternalFile(const std::string& fname,
+			const IngestExternalFileOptions& options);
+		virtual Status CreateColumnFamily(const Options& options,
+			const std::string& name,
+			ColumnFamilyHandle** handle);
+		virtual Status DropColumnFamily(ColumnFamilyHandle* column_family);
+		virtual ColumnFamilyHandle* DefaultColumnFamily() const;
+		virtual Status Put(const WriteOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key,
+			const Slice& value);
+		virtual Status Delete(const WriteOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key);
+		virtual Status Get(const ReadOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key, std::string* value);
+		virtual Iterator* NewIterator(const ReadOptions& options,
+			ColumnFamilyHandle* column_family);
+		virtual bool GetProperty(ColumnFamilyHandle* column_family,
+			const Slice& property, std::string* value);
+		virtual bool GetIntProperty(ColumnFamilyHandle* column_family,
+			const Slice& property, uint64_t* value);
+		virtual void GetApproximateSizes(ColumnFamilyHandle* column_family,
+			const Range* range, int n, uint64_t* sizes);
+		virtual void CompactRange(ColumnFamilyHandle* column_family,
+			const Slice* begin, const Slice* end);
+		virtual Status Flush(ColumnFamilyHandle* column_family);
+		virtual Status GetColumnFamilyHandle(const std::string& name,
+			ColumnFamilyHandle** handle);
+		virtual Status TryCatchUpWithPrimary();
 
 		// Extra methods (for testing) that are not in the public DB interface
 
-		// Compact any files in the named level that overlap [*begin,*end]
-		void TEST_CompactRange(unsigned level, const Slice* begin, const Slice* end);
+		// Compact any files in the named level that overlap [*begin,*end].
+		// A NULL column_family means the default one.
+		void TEST_CompactRange(unsigned level, const Slice* begin, const Slice* end,
+			ColumnFamilyHandle* column_family = NULL);
 
 		// Force current memtable contents to be compacted.
 		Status TEST_CompactMemTable();
@@ -81,36 +133,92 @@ namespace leveldb {
 		// file at a level >= 1.
 		int64_t TEST_MaxNextLevelOverlappingBytes();
 
-		// Record a sample of bytes read at the specified internal key.
-		// Samples are taken approximately once every config::kReadBytesPeriod
-		// bytes.
-		void RecordReadSample(Slice key);
+		// Record a sample of bytes read at the specified internal key of
+		// the column family.  Samples are taken approximately once every
+		// config::kReadBytesPeriod bytes.
+		void RecordReadSample(ColumnFamilyData* cfd, Slice key);
+
+		// Read the value an encoded BlobIndex of the column family refers
+		// to into *value.  The overload without a column family reads from
+		// the default one.
+		// REQUIRES: mutex_ not held; a live version references the blob file
+		Status GetBlob(ColumnFamilyData* cfd, const Slice& blob_index, std::string* value);
+		Status GetBlob(const Slice& blob_index, std::string* value);
 
 		// Peek at the last sequence;
 		// REQURES: mutex_ not held
 		SequenceNumber LastSequence();
 
+		// The options this DB was opened with, after sanitization.
+		const Options& options() const { return options_; }
+
 	private:
 		friend class DB;
 		struct CompactionState;
 		struct Writer;
 
-		Iterator* NewInternalIterator(const ReadOptions&, uint64_t number,
+		// DB::OpenForReadOnly() and DB::OpenAsSecondary()
+		static Status OpenReadOnly(const Options& options, const std::string& dbname,
+			OpenMode mode, DB** dbptr);
+
+		Iterator* NewInternalIterator(ColumnFamilyData* cfd,
+			const ReadOptions&, uint64_t number,
 			SequenceNumber* latest_snapshot,
 			uint32_t* seed, bool external_sync);
 
-		Status NewDB();
+		// Create the descriptor of an empty column family in cfd->dir.
+		// "log_number" is the first log that may hold its entries.
+		Status NewDB(ColumnFamilyData* cfd, uint64_t log_number);
+
+		// Set up the state of a column family, with a VersionSet whose
+		// descriptor is yet to be recovered or created.
+		ColumnFamilyData* NewColumnFamilyData(uint32_t id, const std::string& name,
+			const Options& options);
+
+		// The column family a handle passed in by the user refers to; NULL
+		// means the default one.
+		ColumnFamilyData* GetColumnFamilyData(ColumnFamilyHandle* column_family) const;
 
 		// Recover the descriptor from persistent storage.  May do a significant
 		// amount of work to recover recently logged updates.  Any changes to
-		// be made to the descriptor are added to *edit.
-		Status Recover(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// be made to the descriptor of a column family are added to
+		// (*edits)[id].  "options" gives the options of the column families
+		// by name.
+		Status Recover(const std::map<std::string, Options>& options,
+			std::map<uint32_t, VersionEdit>* edits) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Check that every table of the current version of the column
+		// family exists with the size recorded in the descriptor.  The
+		// files are checked on options_.max_file_opening_threads threads.
+		Status VerifyTableFiles(ColumnFamilyData* cfd) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// A background thread started by DB::Open when
+		// options_.warm_table_cache is set.  Opens the tables of the current
+		// version, lowest level first, until the table cache is full.
+		static void WarmTableCacheWrapper(void* db)
+		{
+			reinterpret_cast<DBImpl*>(db)->WarmTableCacheThread();
+		}
+		void WarmTableCacheThread();
 
 		void MaybeIgnoreError(Status* s) const;
 
 		// Delete any unneeded files and stale in-memory entries.
 		void DeleteObsoleteFiles();
 
+		// The immutable memtable of some column family, or NULL if none
+		// has one.
+		MemTable* AnyImmutableMemTable() const EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Oldest log that still holds entries not yet in the tables of
+		// some column family.
+		uint64_t MinLogNumberToKeep() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Apply "edit" to the descriptor of the column family.  Every
+		// descriptor records the last sequence of the whole DB.
+		Status LogAndApply(ColumnFamilyData* cfd, VersionEdit* edit)
+			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
 		// A background thread to compact the in-memory write buffer to disk.
 		// Switches to a new log-file/memtable and writes a new descriptor iff
 		// successful.
@@ -120,35 +228,117 @@ namespace leveldb {
 		}
 		void CompactMemTableThread();
 
+		// Replay the log into the column families that do not have its
+		// entries in their tables yet, adding the tables written to
+		// (*edits)[id].
 		Status RecoverLogFile(uint64_t log_number,
-			VersionEdit* edit,
+			std::map<uint32_t, VersionEdit>* edits,
 			SequenceNumber* max_sequence)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-		Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base, uint64_t* number)
+		// For read-only instances: add the entries of the log to "mems".
+		// A log that no longer exists is skipped, and so are records that
+		// are torn or not written yet.
+		// REQUIRES: mutex_ not held
+		Status ReplayLogFile(uint64_t log_number, const ColumnFamilyMemTables& mems,
+			SequenceNumber* max_sequence);
+
+		// For read-only instances: replay the logs into new memtables and
+		// read what was added to the descriptors, then make both visible
+		// at once.  Column families the default descriptor no longer lists
+		// are retired, and those it gained are opened.  Releases mutex_
+		// while reading.
+		Status CatchUp() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// CatchUp() for "families", which starts with default_cf_.
+		Status CatchUpFamilies(const std::vector<ColumnFamilyData*>& families)
+			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// For read-only instances: move the column families the default
+		// descriptor no longer lists to dropped_column_families_, and open
+		// those missing from column_families_, storing them in *added.
+		// Releases mutex_ while reading their descriptors.
+		Status UpdateColumnFamilies(std::vector<ColumnFamilyData*>* added)
+			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// A background thread started by DB::OpenAsSecondary() when
+		// options_.secondary_catch_up_millis is set.
+		static void CatchUpWrapper(void* db)
+		{
+			reinterpret_cast<DBImpl*>(db)->CatchUpThread();
+		}
+		void CatchUpThread();
+
+		// If "info" is non-NULL it is filled in with the number, size, level
+		// and status of the new table.  The new table, and the blob file
+		// whose number is stored in *blob_number (zero if none), stay in
+		// cfd->pending_outputs for the caller to remove.
+		Status WriteLevel0Table(ColumnFamilyData* cfd, MemTable* mem,
+			VersionEdit* edit, Version* base,
+			TableFileInfo* info, uint64_t* blob_number)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-		Status SequenceWriteBegin(Writer* w, WriteBatch* updates)
+		// Write() with a column family to switch to a new memtable when
+		// "updates" is NULL (see SequenceWriteBegin).
+		Status WriteInternal(const WriteOptions& options, WriteBatch* updates,
+			ColumnFamilyData* flush_cfd);
+
+		// A NULL "updates" forces a switch to a new memtable for
+		// flush_cfd, or for the default column family if that is NULL.
+		Status SequenceWriteBegin(Writer* w, WriteBatch* updates,
+			ColumnFamilyData* flush_cfd = NULL)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		void SequenceWriteEnd(Writer* w)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		// REQUIRES: writers_mutex_ not held
 		void WaitOutWriters();
 
+		// Like SequenceWriteBegin, but also holds off every later writer
+		// (and any other backup or ingestion) until EndExclusiveWrite, and
+		// returns only once all earlier writers are done.  Callers must
+		// call EndExclusiveWrite even if this fails.
+		// REQUIRES: mutex_ and writers_mutex_ not held
+		Status BeginExclusiveWrite(Writer* w, WriteBatch* updates);
+		void EndExclusiveWrite(Writer* w);
+
+		// Switch the column family to a new memtable and wait until the
+		// old one is on disk.
+		Status FlushMemTable(ColumnFamilyData* cfd);
+
 		static void CompactLevelWrapper(void* db)
 		{
 			reinterpret_cast<DBImpl*>(db)->CompactLevelThread();
 		}
 		void CompactLevelThread();
-		Status BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// The column family the compaction thread should work on next, or
+		// NULL if none needs a compaction.
+		ColumnFamilyData* PickCompactionFamily() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		Status BackgroundCompaction(ColumnFamilyData* cfd) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-		void RecordBackgroundError(const Status& s);
+		void RecordBackgroundError(BackgroundErrorReason reason, const Status& s)
+			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Queue a WriteStallInfo for the listener if the write stall condition
+		// has changed since the last call.
+		void UpdateStallCondition() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Deliver listener events that were raised while mutex_ was held.
+		// Releases mutex_ while the listener runs; returns true iff it did so.
+		bool NotifyDeferredEvents() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
 		void CleanupCompaction(CompactionState* compact)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		Status DoCompactionWork(CompactionState* compact)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		Status OpenCompactionOutputFile(CompactionState* compact);
+		// Add to c->edit() the blob values referenced from the tables a
+		// deletion-only compaction drops.  Unlocks mutex_ while reading.
+		Status AddDroppedBlobGarbage(ColumnFamilyData* cfd, Compaction* c)
+			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Append "value" to the compaction's blob file, creating it if
+		// needed, and store the encoded BlobIndex in *blob_index.
+		Status AddCompactionBlob(CompactionState* compact, const Slice& value,
+			std::string* blob_index);
 		Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
 		Status InstallCompactionResults(CompactionState* compact)
 			EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -161,19 +351,21 @@ namespace leveldb {
 		bool owns_info_log_;
 		bool owns_cache_;
 		const std::string dbname_;
-
-		// table_cache_ provides its own synchronization
-		TableCache* table_cache_;
+		const OpenMode open_mode_;
 
 		// Lock over the persistent DB state.  Non-NULL iff successfully acquired.
 		FileLock* db_lock_;
 
+		// Serializes TryCatchUpWithPrimary(); taken before mutex_
+		port::Mutex catch_up_mutex_;
+
+		// Serializes CreateColumnFamily(); taken before mutex_
+		port::Mutex create_cf_mutex_;
+
 		// State below is protected by mutex_
 		port::Mutex mutex_;
 		port::AtomicPointer shutting_down_;
-		MemTable* mem_;
-		MemTable* imm_;                // Memtable being compacted
-		port::AtomicPointer has_imm_;  // So bg thread can detect non-NULL imm_
+		port::AtomicPointer has_imm_;  // So bg thread can detect a non-NULL imm
 		SHARED_PTR<WritableFile> logfile_;
 		uint64_t logfile_number_;
 		SHARED_PTR<log::Writer> log_;
@@ -186,12 +378,17 @@ namespace leveldb {
 
 		SnapshotList snapshots_;
 
-		// Set of table files to protect from deletion because they are
-		// part of ongoing compactions.
-		std::set<uint64_t> pending_outputs_;
+		// The column families by id.  default_cf_ has id 0; dropped ones
+		// are kept until the DB is deleted, since their handles stay valid.
+		ColumnFamilyData* default_cf_;
+		std::map<uint32_t, ColumnFamilyData*> column_families_;
+		std::vector<ColumnFamilyData*> dropped_column_families_;
+		// For read-only instances: the options column families are opened with
+		Options read_only_cf_options_;
+		// Where PickCompactionFamily() starts looking
+		uint32_t next_compaction_family_;
 
 		bool allow_background_activity_;
-		bool levels_locked_[leveldb::config::kNumLevels];
 		int num_bg_threads_;
 		// Tell the foreground that background has done something of note
 		port::CondVar bg_fg_cv_;
@@ -206,12 +403,14 @@ namespace leveldb {
 		// Information for a manual compaction
 		struct ManualCompaction {
 			ManualCompaction()
-				: level(),
+				: cfd(),
+				level(),
 				done(),
 				begin(),
 				end(),
 				tmp_storage() {
 			}
+			ColumnFamilyData* cfd;
 			unsigned level;
 			bool done;
 			const InternalKey* begin;   // NULL means beginning of key range
@@ -232,6 +431,9 @@ namespace leveldb {
 		// how many reads have we done in a row, uninterrupted by writes
 		uint64_t straight_reads_;
 
+		// The VersionSet of the default column family.  Its descriptor
+		// holds the last sequence and the next file number that count for
+		// the log files, and records which column families exist.
 		VersionSet* versions_;
 
 		// Information for ongoing backup processes
@@ -244,22 +446,95 @@ namespace leveldb {
 									  // Have we encountered a background error in paranoid mode?
 		Status bg_error_;
 
-		// Per level compaction stats.  stats_[level] stores the stats for
-		// compactions that produced data for the specified "level".
+		// Listener events raised with mutex_ held, waiting for
+		// NotifyDeferredEvents().  Only used when options_.listener is set.
+		std::vector<TableFileInfo> pending_deleted_files_;
+		std::vector<WriteStallInfo> pending_stall_changes_;
+		std::vector<std::pair<BackgroundErrorReason, Status> > pending_bg_errors_;
+		WriteStallCondition stall_condition_;
+
+		// Why a compaction was scheduled
+		enum CompactionReason {
+			kReasonLevel0 = 0,  // level-0 has too many files
+			kReasonSize,        // a level is over its size target
+			kReasonSeek,        // file_to_compact_ used up its allowed seeks
+			kReasonManual,      // CompactRange()
+			kReasonExpiry,      // a file holds expired values
+			kNumCompactionReasons
+		};
+
+		// Compaction (and memtable flush) stats.  A compaction from level N
+		// reads "level" bytes from N and "next" bytes from N+1.
 		struct CompactionStats {
+			int64_t count;
 			int64_t micros;
-			int64_t bytes_read;
+			int64_t bytes_read_level;
+			int64_t bytes_read_next;
 			int64_t bytes_written;
-
-			CompactionStats() : micros(0), bytes_read(0), bytes_written(0) { }
+			int64_t bytes_moved;        // files moved to N+1 without a rewrite
+			int64_t bytes_flushed;      // part of bytes_written that came from memtables
+			int64_t files_read_level;
+			int64_t files_read_next;
+			int64_t files_written;
+			int64_t records_in;
+			int64_t records_dropped;
+
+			CompactionStats()
+				: count(0),
+				micros(0),
+				bytes_read_level(0),
+				bytes_read_next(0),
+				bytes_written(0),
+				bytes_moved(0),
+				bytes_flushed(0),
+				files_read_level(0),
+				files_read_next(0),
+				files_written(0),
+				records_in(0),
+				records_dropped(0) {
+			}
 
 			void Add(const CompactionStats& c) {
+				this->count += c.count;
 				this->micros += c.micros;
-				this->bytes_read += c.bytes_read;
+				this->bytes_read_level += c.bytes_read_level;
+				this->bytes_read_next += c.bytes_read_next;
 				this->bytes_written += c.bytes_written;
+				this->bytes_moved += c.bytes_moved;
+				this->bytes_flushed += c.bytes_flushed;
+				this->files_read_level += c.files_read_level;
+				this->files_read_next += c.files_read_next;
+				this->files_written += c.files_written;
+				this->records_in += c.records_in;
+				this->records_dropped += c.records_dropped;
+			}
+
+			// Bytes written per byte that came in from the level above (or
+			// from a memtable), so a flush on its own has a value of 1.
+			double WriteAmp() const {
+				const int64_t in = bytes_read_level + bytes_flushed;
+				return in > 0 ? static_cast<double>(bytes_written) / in : 0.0;
 			}
 		};
+		// stats_[level] stores the stats for flushes and compactions that
+		// produced data for the specified "level"; reason_stats_ breaks the
+		// compactions down by why they ran, and flush_stats_ covers flushes.
 		CompactionStats stats_[config::kNumLevels];
+		CompactionStats reason_stats_[kNumCompactionReasons];
+		CompactionStats flush_stats_;
+
+		// Time writers spent stalled, by cause.  Updated atomically because
+		// the level-0 slowdown is taken without mutex_.
+		uint64_t stall_memtable_micros_;
+		uint64_t stall_level0_micros_;
+
+		void RecordCompactionStats(unsigned output_level, CompactionReason reason,
+			const CompactionStats& stats);
+		// The level rows show the files of the column family; the counters
+		// cover the whole DB.
+		void AppendCompactionStats(ColumnFamilyData* cfd, std::string* value);
+		static void AppendStatsRow(const CompactionStats& s, double w_amp,
+			std::string* value);
 
 		// No copying allowed
 		DBImpl(const DBImpl&);
@@ -15,7 +15,9 @@
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
 #include "util/random.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
@@ -52,15 +54,21 @@ namespace leveldb {
 				kReverse
 			};
 
-			DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-				uint32_t seed)
+			DBIter(DBImpl* db, ColumnFamilyData* cfd, const Comparator* cmp,
+				Iterator* iter, SequenceNumber s, uint32_t seed)
 				: db_(db),
+				cfd_(cfd),
 				user_comparator_(cmp),
 				iter_(iter),
 				sequence_(s),
+				now_(db->options().env->NowMicros() / 1000000),
 				status_(),
 				saved_key_(),
 				saved_value_(),
+				saved_blob_(false),
+				blob_index_(),
+				blob_value_(),
+				blob_status_(),
 				direction_(kForward),
 				valid_(false),
 				rnd_(seed),
@@ -77,14 +85,27 @@ namespace leveldb {
 			}
 			virtual Slice value() const {
 				assert(valid_);
-				return (direction_ == kForward) ? iter_->value() : saved_value_;
+				if (direction_ == kReverse) {
+					return saved_blob_ ? ResolveBlob(saved_value_) : Slice(saved_value_);
+				}
+				const ValueType type = ExtractValueType(iter_->key());
+				if (type == kTypeValueWithExpiry) {
+					return StripExpiry(iter_->value());
+				}
+				else if (type == kTypeBlobIndex) {
+					return ResolveBlob(iter_->value());
+				}
+				return iter_->value();
 			}
 			virtual const Status& status() const {
-				if (status_.ok()) {
-					return iter_->status();
+				if (!status_.ok()) {
+					return status_;
+				}
+				else if (!blob_status_.ok()) {
+					return blob_status_;
 				}
 				else {
-					return status_;
+					return iter_->status();
 				}
 			}
 
@@ -103,6 +124,23 @@ namespace leveldb {
 				dst->assign(k.data(), k.size());
 			}
 
+			// Read the value a blob index refers to.  The last value read is
+			// kept, so asking for the same value again costs nothing.
+			Slice ResolveBlob(const Slice& index) const {
+				if (index != Slice(blob_index_)) {
+					blob_index_.assign(index.data(), index.size());
+					Status s = db_->GetBlob(cfd_, index, &blob_value_);
+					if (!s.ok()) {
+						blob_index_.clear();
+						blob_value_.clear();
+						if (blob_status_.ok()) {
+							blob_status_ = s;
+						}
+					}
+				}
+				return blob_value_;
+			}
+
 			inline void ClearSavedValue() {
 				if (saved_value_.capacity() > 1048576) {
 					std::string empty;
@@ -119,13 +157,22 @@ namespace leveldb {
 			}
 
 			DBImpl* db_;
+			ColumnFamilyData* const cfd_;
 			const Comparator* const user_comparator_;
 			Iterator* const iter_;
 			SequenceNumber const sequence_;
+			uint64_t const now_;        // entries expiring at or before this are deleted
 
 			Status status_;
 			std::string saved_key_;     // == current key when direction_==kReverse
-			std::string saved_value_;   // == current raw value when direction_==kReverse
+			std::string saved_value_;   // == current value when direction_==kReverse
+			bool saved_blob_;           // saved_value_ is a blob index
+
+			// Last blob value read by value(), and the first read error
+			mutable std::string blob_index_;
+			mutable std::string blob_value_;
+			mutable Status blob_status_;
+
 			Direction direction_;
 			bool valid_;
 
@@ -144,7 +191,7 @@ namespace leveldb {
 			bytes_counter_ -= n;
 			while (bytes_counter_ < 0) {
 				bytes_counter_ += RandomPeriod();
-				db_->RecordReadSample(k);
+				db_->RecordReadSample(cfd_, k);
 			}
 			if (!ParseInternalKey(k, ikey)) {
 				status_ = Status::Corruption("corrupted internal key in DBIter");
@@ -154,7 +201,7 @@ namespace leveldb {
 				if (ikey->type == kTypeDeletion) {
 					++tombstones_counter_;
 					if (tombstones_counter_ > 64) {
-						db_->RecordReadSample(k);
+						db_->RecordReadSample(cfd_, k);
 						tombstones_counter_ = 0;
 					}
 				}
@@ -195,6 +242,7 @@ namespace leveldb {
 			// Loop until we hit an acceptable entry to yield
 			assert(iter_->Valid());
 			assert(direction_ == kForward);
+			PERF_TIMER_GUARD(find_next_user_entry_time);
 			do {
 				ParsedInternalKey ikey;
 				if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
@@ -204,11 +252,22 @@ namespace leveldb {
 						// they are hidden by this deletion.
 						SaveKey(ikey.user_key, skip);
 						skipping = true;
+						PERF_COUNTER_ADD(internal_delete_skipped_count, 1);
 						break;
+					case kTypeValueWithExpiry:
+						if (IsExpired(iter_->value(), now_)) {
+							// Hides older entries just like a deletion
+							SaveKey(ikey.user_key, skip);
+							skipping = true;
+							break;
+						}
+						// Fall through
 					case kTypeValue:
+					case kTypeBlobIndex:
 						if (skipping &&
 							user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
 							// Entry hidden
+							PERF_COUNTER_ADD(internal_key_skipped_count, 1);
 						}
 						else {
 							valid_ = true;
@@ -267,18 +326,25 @@ namespace leveldb {
 							break;
 						}
 						value_type = ikey.type;
+						if (value_type == kTypeValueWithExpiry && IsExpired(iter_->value(), now_)) {
+							value_type = kTypeDeletion;
+						}
 						if (value_type == kTypeDeletion) {
 							saved_key_.clear();
 							ClearSavedValue();
 						}
 						else {
 							Slice raw_value = iter_->value();
+							if (value_type == kTypeValueWithExpiry) {
+								raw_value = StripExpiry(raw_value);
+							}
 							if (saved_value_.capacity() > raw_value.size() + 1048576) {
 								std::string empty;
 								swap(empty, saved_value_);
 							}
 							SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
 							saved_value_.assign(raw_value.data(), raw_value.size());
+							saved_blob_ = (value_type == kTypeBlobIndex);
 						}
 					}
 					iter_->Prev();
@@ -298,12 +364,16 @@ namespace leveldb {
 		}
 
 		void DBIter::Seek(const Slice& target) {
+			StopWatch sw(db_->options().env, db_->options().statistics, kSeekMicros);
 			direction_ = kForward;
 			ClearSavedValue();
 			saved_key_.clear();
 			AppendInternalKey(
 				&saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
-			iter_->Seek(saved_key_);
+			{
+				PERF_TIMER_GUARD(seek_internal_seek_time);
+				iter_->Seek(saved_key_);
+			}
 			if (iter_->Valid()) {
 				FindNextUserEntry(false, &saved_key_ /* temporary storage */);
 			}
@@ -335,11 +405,12 @@ namespace leveldb {
 
 	Iterator* NewDBIterator(
 		DBImpl* db,
+		ColumnFamilyData* cfd,
 		const Comparator* user_key_comparator,
 		Iterator* internal_iter,
 		SequenceNumber sequence,
 		uint32_t seed) {
-		return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+		return new DBIter(db, cfd, user_key_comparator, internal_iter, sequence, seed);
 	}
 
 }  // namespace leveldb
@@ -12,12 +12,15 @@
 namespace leveldb {
 
 	class DBImpl;
+	struct ColumnFamilyData;
 
 	// Return a new iterator that converts internal keys (yielded by
 	// "*internal_iter") that were live at the specified "sequence" number
-	// into appropriate user keys.
+	// into appropriate user keys.  "internal_iter" reads column family
+	// "cfd" of "db".
 	extern Iterator* NewDBIterator(
 		DBImpl* db,
+		ColumnFamilyData* cfd,
 		const Comparator* user_key_comparator,
 		Iterator* internal_iter,
 		SequenceNumber sequence,
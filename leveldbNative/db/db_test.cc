@@ -13,7 +13,12 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
+#include "leveldb/listener.h"
+#include "leveldb/perf_context.h"
+#include "leveldb/sst_file_writer.h"
+#include "leveldb/statistics.h"
 #include "leveldb/table.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -82,6 +87,9 @@ namespace leveldb {
 		bool count_random_reads_;
 		AtomicCounter random_read_counter_;
 
+		// Seconds added to the clock seen through NowMicros().
+		AtomicCounter clock_skew_seconds_;
+
 		explicit SpecialEnv(Env* base) : EnvWrapper(base) {
 			delay_data_sync_.Release_Store(NULL);
 			data_sync_error_.Release_Store(NULL);
@@ -92,6 +100,11 @@ namespace leveldb {
 			manifest_write_error_.Release_Store(NULL);
 		}
 
+		uint64_t NowMicros() {
+			return target()->NowMicros() +
+				static_cast<uint64_t>(clock_skew_seconds_.Read()) * 1000000;
+		}
+
 		Status NewWritableFile(const std::string& f, WritableFile** r) {
 			ConcurrentWritableFile* _r;
 			Status s = this->NewConcurrentWritableFile(f, &_r);
@@ -227,6 +240,7 @@ namespace leveldb {
 			kDefault,
 			kFilter,
 			kUncompressed,
+			kPipelined,
 			kEnd
 		};
 		int option_config_;
@@ -277,6 +291,10 @@ namespace leveldb {
 			case kUncompressed:
 				options.compression = kNoCompression;
 				break;
+			case kPipelined:
+				options.pipelined_compaction = true;
+				options.compression_threads = 2;
+				break;
 			default:
 				break;
 			}
@@ -399,6 +417,9 @@ namespace leveldb {
 						case kTypeDeletion:
 							result += "DEL";
 							break;
+						case kTypeValueWithExpiry:
+							result += "EXP:" + StripExpiry(iter->value()).ToString();
+							break;
 						}
 					}
 					iter->Next();
@@ -539,6 +560,39 @@ namespace leveldb {
 			}
 			return files_renamed;
 		}
+
+		// Returns the number of table files that record an expiry time.
+		int TablesWithMinExpiry() {
+			std::vector<std::string> filenames;
+			env_->GetChildren(dbname_, &filenames);
+			uint64_t number;
+			FileType type;
+			int result = 0;
+			for (size_t i = 0; i < filenames.size(); i++) {
+				if (!ParseFileName(filenames[i], &number, &type) || type != kTableFile) {
+					continue;
+				}
+				const std::string fname = TableFileName(dbname_, number);
+				uint64_t size;
+				RandomAccessFile* file;
+				Table* table = NULL;
+				Status s = env_->GetFileSize(fname, &size);
+				if (s.ok()) {
+					s = env_->NewRandomAccessFile(fname, &file);
+				}
+				if (s.ok()) {
+					s = Table::Open(Options(), file, size, &table);
+					std::map<std::string, std::string> properties;
+					if (s.ok() && table->ReadProperties(&properties).ok() &&
+						properties.count(kPropertyMinExpiry) > 0) {
+						result++;
+					}
+					delete table;
+					delete file;
+				}
+			}
+			return result;
+		}
 	};
 
 
@@ -1026,6 +1080,35 @@ namespace leveldb {
 		}
 	}
 
+	TEST(DBTest, PipelinedCompaction) {
+		Options options = CurrentOptions();
+		options.write_buffer_size = 100000000;        // Large write buffer
+		options.pipelined_compaction = true;
+		Reopen(&options);
+
+		// 24MB of values spans many prefetch batches and output chunks
+		Random rnd(301);
+		std::vector<std::string> values;
+		for (int i = 0; i < 240; i++) {
+			values.push_back(RandomString(&rnd, 100000));
+			ASSERT_OK(Put(Key(i), values[i]));
+		}
+		for (int i = 0; i < 240; i += 3) {
+			ASSERT_OK(Delete(Key(i)));
+		}
+		for (int i = 0; i < 240; i += 5) {
+			values[i] = RandomString(&rnd, 1000);
+			ASSERT_OK(Put(Key(i), values[i]));
+		}
+
+		Reopen(&options);
+		dbfull()->TEST_CompactRange(0, NULL, NULL);
+		ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+		for (int i = 0; i < 240; i++) {
+			ASSERT_EQ(Get(Key(i)), (i % 3 == 0 && i % 5 != 0) ? "NOT_FOUND" : values[i]);
+		}
+	}
+
 	// In HyperLevelDB, this test is useless because we have no "max files" cap.
 #if 0
 	TEST(DBTest, RepeatedWritesToSameKey) {
@@ -1265,6 +1348,635 @@ namespace leveldb {
 		} while (ChangeOptions());
 	}
 
+	TEST(DBTest, SnapshotStripes) {
+		Put("foo", "v1");
+		const Snapshot* s1 = db_->GetSnapshot();
+		Put("foo", "v2");
+		Put("foo", "v3");
+		const Snapshot* s2 = db_->GetSnapshot();
+		const Snapshot* s3 = db_->GetSnapshot();
+		Put("foo", "v4");
+		Put("foo", "v5");
+		Put("foo", "v6");
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		ASSERT_EQ(AllEntriesFor("foo"), "[ v6, v5, v4, v3, v2, v1 ]");
+
+		// Only the newest version below each snapshot survives
+		for (int level = 0; level < config::kNumLevels - 1; level++) {
+			dbfull()->TEST_CompactRange(level, NULL, NULL);
+		}
+		ASSERT_EQ(AllEntriesFor("foo"), "[ v6, v3, v1 ]");
+		ASSERT_EQ("v1", Get("foo", s1));
+		ASSERT_EQ("v3", Get("foo", s2));
+		ASSERT_EQ("v3", Get("foo", s3));
+		ASSERT_EQ("v6", Get("foo"));
+
+		db_->ReleaseSnapshot(s2);
+		db_->ReleaseSnapshot(s3);
+		// A file spanning "foo" pulls it into the next compactions
+		Put("a", "x");
+		Put("z", "x");
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		for (int level = 0; level < config::kNumLevels - 1; level++) {
+			dbfull()->TEST_CompactRange(level, NULL, NULL);
+		}
+		ASSERT_EQ(AllEntriesFor("foo"), "[ v6, v1 ]");
+		ASSERT_EQ("v1", Get("foo", s1));
+		db_->ReleaseSnapshot(s1);
+	}
+
+	// Write keys [from,to) with values prefix + number to an external table
+	static Status WriteExternalFile(const Options& options, const std::string& fname,
+		int from, int to, const std::string& prefix) {
+		SstFileWriter writer(options);
+		Status s = writer.Open(fname);
+		for (int i = from; s.ok() && i < to; i++) {
+			s = writer.Add(Key(i), prefix + NumberToString(i));
+		}
+		return s.ok() ? writer.Finish() : s;
+	}
+
+	TEST(DBTest, IngestExternalFile) {
+		Options options = CurrentOptions();
+		Reopen(&options);
+		const std::string fname = test::TmpDir() + "/db_test_external";
+		IngestExternalFileOptions ingest;
+
+		// Nothing to overlap: straight to the last level
+		ASSERT_OK(WriteExternalFile(options, fname, 0, 100, "e"));
+		ASSERT_OK(db_->IngestExternalFile(fname, ingest));
+		ASSERT_TRUE(env_->FileExists(fname));
+		ASSERT_EQ(NumTableFilesAtLevel(config::kNumLevels - 1), 1);
+		ASSERT_EQ("e5", Get(Key(5)));
+		ASSERT_EQ("NOT_FOUND", Get(Key(100)));
+
+		// Overlapping both the memtable and the first table
+		ASSERT_OK(Put(Key(150), "m"));
+		ASSERT_OK(Put(Key(200), "m"));
+		const Snapshot* snapshot = db_->GetSnapshot();
+		ASSERT_OK(WriteExternalFile(options, fname, 50, 151, "f"));
+		ingest.move_file = true;
+		ASSERT_OK(db_->IngestExternalFile(fname, ingest));
+		ASSERT_TRUE(!env_->FileExists(fname));
+		ASSERT_EQ("e5", Get(Key(5)));
+		ASSERT_EQ("f60", Get(Key(60)));
+		ASSERT_EQ("f150", Get(Key(150)));
+		ASSERT_EQ("m", Get(Key(200)));
+		ASSERT_EQ("e60", Get(Key(60), snapshot));
+		ASSERT_EQ("m", Get(Key(150), snapshot));
+		Iterator* iter = db_->NewIterator(ReadOptions());
+		iter->Seek(Key(60));
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(Key(60), iter->key().ToString());
+		ASSERT_EQ("f60", iter->value().ToString());
+		delete iter;
+		db_->ReleaseSnapshot(snapshot);
+
+		// Later writes win over the ingested values
+		ASSERT_OK(Put(Key(70), "w"));
+		ASSERT_EQ("w", Get(Key(70)));
+
+		Reopen(&options);
+		ASSERT_EQ("f60", Get(Key(60)));
+		ASSERT_EQ("w", Get(Key(70)));
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		for (int level = 0; level < config::kNumLevels - 1; level++) {
+			dbfull()->TEST_CompactRange(level, NULL, NULL);
+		}
+		ASSERT_EQ("e5", Get(Key(5)));
+		ASSERT_EQ("f60", Get(Key(60)));
+		ASSERT_EQ("w", Get(Key(70)));
+		ASSERT_EQ("f150", Get(Key(150)));
+		ASSERT_EQ("m", Get(Key(200)));
+	}
+
+	TEST(DBTest, SstFileWriterErrors) {
+		Options options = CurrentOptions();
+		const std::string fname = test::TmpDir() + "/db_test_external";
+		{
+			SstFileWriter writer(options);
+			ASSERT_OK(writer.Open(fname));
+			ASSERT_OK(writer.Add("b", "v"));
+			ASSERT_TRUE(!writer.Add("b", "v").ok());
+			ASSERT_TRUE(!writer.Add("a", "v").ok());
+			ASSERT_EQ(1, writer.NumEntries());
+			ASSERT_OK(writer.Finish());
+		}
+		{
+			SstFileWriter writer(options);
+			ASSERT_OK(writer.Open(fname));
+			ASSERT_TRUE(!writer.Finish().ok());
+			ASSERT_TRUE(!env_->FileExists(fname));
+		}
+		ASSERT_TRUE(!db_->IngestExternalFile(fname, IngestExternalFileOptions()).ok());
+	}
+
+	static std::vector<uint64_t> BlobFileNumbers(Env* env, const std::string& dbname) {
+		std::vector<std::string> files;
+		std::vector<uint64_t> numbers;
+		env->GetChildren(dbname, &files);
+		uint64_t number;
+		FileType type;
+		for (size_t i = 0; i < files.size(); i++) {
+			if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+				numbers.push_back(number);
+			}
+		}
+		std::sort(numbers.begin(), numbers.end());
+		return numbers;
+	}
+
+	TEST(DBTest, BlobFiles) {
+		Options options = CurrentOptions();
+		options.min_blob_size = 100;
+		Reopen(&options);
+		const std::string big1(1000, 'x');
+		const std::string big2(2000, 'y');
+		ASSERT_OK(Put("a", "small"));
+		ASSERT_OK(Put("b", big1));
+		ASSERT_OK(Put("c", big2));
+		ASSERT_EQ(0, BlobFileNumbers(env_, dbname_).size());
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		ASSERT_EQ(1, BlobFileNumbers(env_, dbname_).size());
+		ASSERT_EQ("small", Get("a"));
+		ASSERT_EQ(big1, Get("b"));
+		ASSERT_EQ(big2, Get("c"));
+
+		Iterator* iter = db_->NewIterator(ReadOptions());
+		iter->SeekToFirst();
+		ASSERT_EQ("a->small", IterStatus(iter));
+		iter->Next();
+		ASSERT_EQ("b->" + big1, IterStatus(iter));
+		iter->Next();
+		ASSERT_EQ("c->" + big2, IterStatus(iter));
+		iter->Prev();
+		ASSERT_EQ("b->" + big1, IterStatus(iter));
+		iter->SeekToLast();
+		ASSERT_EQ("c->" + big2, IterStatus(iter));
+		iter->Prev();
+		ASSERT_EQ("b->" + big1, IterStatus(iter));
+		ASSERT_OK(iter->status());
+		delete iter;
+
+		Reopen(&options);
+		ASSERT_EQ(big1, Get("b"));
+		dbfull()->CompactRange(NULL, NULL);
+		ASSERT_EQ(big1, Get("b"));
+		ASSERT_EQ(big2, Get("c"));
+		ASSERT_EQ(1, BlobFileNumbers(env_, dbname_).size());
+
+		// Once no table refers to a blob file any more, it goes away
+		ASSERT_OK(Put("b", "v2"));
+		ASSERT_OK(Delete("c"));
+		dbfull()->CompactRange(NULL, NULL);
+		ASSERT_EQ("v2", Get("b"));
+		ASSERT_EQ("NOT_FOUND", Get("c"));
+		ASSERT_EQ(0, BlobFileNumbers(env_, dbname_).size());
+	}
+
+	TEST(DBTest, BlobFileGarbageCollection) {
+		Options options = CurrentOptions();
+		options.min_blob_size = 100;
+		options.blob_gc_percent = 50;
+		Reopen(&options);
+		for (int i = 0; i < 4; i++) {
+			ASSERT_OK(Put(Key(i), std::string(1000, 'a' + i)));
+		}
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		std::vector<uint64_t> blobs = BlobFileNumbers(env_, dbname_);
+		ASSERT_EQ(1, blobs.size());
+		const uint64_t first = blobs[0];
+
+		// The compaction that drops the overwritten values leaves a quarter
+		// of the file referenced
+		for (int i = 1; i < 4; i++) {
+			ASSERT_OK(Put(Key(i), "small"));
+		}
+		dbfull()->CompactRange(NULL, NULL);
+		blobs = BlobFileNumbers(env_, dbname_);
+		ASSERT_EQ(1, blobs.size());
+		ASSERT_EQ(first, blobs[0]);
+
+		// The next compaction of the survivor copies it into a new file, and
+		// the old one is deleted
+		for (int level = 0; level < config::kNumLevels - 1; level++) {
+			dbfull()->TEST_CompactRange(level, NULL, NULL);
+		}
+		blobs = BlobFileNumbers(env_, dbname_);
+		ASSERT_EQ(1, blobs.size());
+		ASSERT_NE(first, blobs[0]);
+		ASSERT_EQ(std::string(1000, 'a'), Get(Key(0)));
+		ASSERT_EQ("small", Get(Key(1)));
+
+		Reopen(&options);
+		ASSERT_EQ(std::string(1000, 'a'), Get(Key(0)));
+	}
+
+	static std::string GetCF(DB* db, ColumnFamilyHandle* cf, const std::string& k) {
+		std::string result;
+		Status s = db->Get(ReadOptions(), cf, k, &result);
+		if (s.IsNotFound()) {
+			result = "NOT_FOUND";
+		}
+		else if (!s.ok()) {
+			result = s.ToString();
+		}
+		return result;
+	}
+
+	static int TableFiles(DB* db, ColumnFamilyHandle* cf) {
+		int result = 0;
+		for (int level = 0; level < config::kNumLevels; level++) {
+			uint64_t files;
+			if (db->GetIntProperty(cf, "leveldb.num-files-at-level" + NumberToString(level), &files)) {
+				result += static_cast<int>(files);
+			}
+		}
+		return result;
+	}
+
+	TEST(DBTest, ColumnFamilies) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ColumnFamilyHandle* cf;
+		ASSERT_OK(db_->CreateColumnFamily(options, "one", &cf));
+		ASSERT_EQ("one", cf->GetName());
+		ASSERT_TRUE(db_->CreateColumnFamily(options, "one", &cf).IsInvalidArgument());
+		ASSERT_OK(db_->CreateColumnFamily(options, "two", &cf));
+		ColumnFamilyHandle* two = cf;
+		ASSERT_TRUE(db_->DropColumnFamily(db_->DefaultColumnFamily()).IsInvalidArgument());
+
+		// The same key lives separately in each column family, and one
+		// batch updates several atomically
+		ASSERT_OK(Put("k", "default"));
+		ASSERT_OK(db_->Put(WriteOptions(), two, "k", "two"));
+		WriteBatch batch;
+		batch.Put("a", "default");
+		batch.Put(two, "b", "two");
+		batch.Delete(two, "k");
+		ASSERT_OK(db_->Write(WriteOptions(), &batch));
+		ASSERT_EQ("default", Get("k"));
+		ASSERT_EQ("NOT_FOUND", GetCF(db_, two, "k"));
+		ASSERT_EQ("two", GetCF(db_, two, "b"));
+		ASSERT_EQ("NOT_FOUND", Get("b"));
+
+		Iterator* iter = db_->NewIterator(ReadOptions(), two);
+		iter->SeekToFirst();
+		ASSERT_EQ("b->two", IterStatus(iter));
+		iter->Next();
+		ASSERT_EQ("(invalid)", IterStatus(iter));
+		delete iter;
+
+		// Flushes are per column family
+		ASSERT_OK(db_->Flush(two));
+		ASSERT_EQ(1, TableFiles(db_, two));
+		ASSERT_EQ(0, TableFiles(db_, db_->DefaultColumnFamily()));
+		ASSERT_OK(db_->Put(WriteOptions(), two, "c", "two"));
+
+		// Every column family must be listed to reopen
+		Close();
+		ASSERT_TRUE(TryReopen(&options).IsInvalidArgument());
+		std::vector<std::string> names;
+		ASSERT_OK(DB::ListColumnFamilies(options, dbname_, &names));
+		ASSERT_EQ(3, names.size());
+		ASSERT_EQ(kDefaultColumnFamilyName, names[0]);
+		ASSERT_EQ("one", names[1]);
+		ASSERT_EQ("two", names[2]);
+
+		std::vector<ColumnFamilyDescriptor> families;
+		families.push_back(ColumnFamilyDescriptor("two", options));
+		families.push_back(ColumnFamilyDescriptor("one", options));
+		families.push_back(ColumnFamilyDescriptor(kDefaultColumnFamilyName, options));
+		std::vector<ColumnFamilyHandle*> handles;
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ(3, handles.size());
+		ASSERT_EQ("two", handles[0]->GetName());
+		two = handles[0];
+		ASSERT_EQ("default", Get("k"));
+		ASSERT_EQ("default", Get("a"));
+		ASSERT_EQ("two", GetCF(db_, two, "b"));
+		ASSERT_EQ("two", GetCF(db_, two, "c"));
+		ASSERT_EQ("NOT_FOUND", GetCF(db_, two, "k"));
+		db_->CompactRange(two, NULL, NULL);
+		ASSERT_EQ("two", GetCF(db_, two, "b"));
+		ASSERT_EQ("two", GetCF(db_, two, "c"));
+
+		// Writes to a dropped column family fail, and it need not be listed
+		// any more
+		ASSERT_OK(db_->DropColumnFamily(handles[1]));
+		ASSERT_TRUE(db_->DropColumnFamily(handles[1]).IsInvalidArgument());
+		ASSERT_TRUE(!db_->Put(WriteOptions(), handles[1], "x", "y").ok());
+		ASSERT_OK(Put("k", "v2"));
+		Close();
+		families.erase(families.begin() + 1);
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ("v2", Get("k"));
+		ASSERT_EQ("two", GetCF(db_, handles[0], "b"));
+		ASSERT_OK(DB::ListColumnFamilies(options, dbname_, &names));
+		ASSERT_EQ(2, names.size());
+		ASSERT_TRUE(!env_->FileExists(ColumnFamilyDirName(dbname_, 1)));
+
+		// Missing column families are created on open
+		families.push_back(ColumnFamilyDescriptor("three", options));
+		Close();
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ(3, handles.size());
+		ASSERT_EQ("three", handles[2]->GetName());
+		ASSERT_OK(db_->Put(WriteOptions(), handles[2], "k", "three"));
+		ASSERT_EQ("three", GetCF(db_, handles[2], "k"));
+
+		// A family whose directory cannot be made is not created
+		const std::string blocker = ColumnFamilyDirName(dbname_, 4);
+		ASSERT_OK(WriteStringToFile(env_, "x", blocker));
+		ASSERT_TRUE(!db_->CreateColumnFamily(options, "four", &cf).ok());
+		ASSERT_TRUE(cf == NULL);
+		ASSERT_OK(db_->CreateColumnFamily(options, "four", &cf));
+		ASSERT_OK(db_->Put(WriteOptions(), cf, "k", "four"));
+		ASSERT_EQ("four", GetCF(db_, cf, "k"));
+		ASSERT_OK(env_->DeleteFile(blocker));
+	}
+
+	TEST(DBTest, ColumnFamilyLogRetention) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ColumnFamilyHandle* cf;
+		ASSERT_OK(db_->CreateColumnFamily(options, "one", &cf));
+
+		// The entries of "one" are only in the log when the default column
+		// family flushes, so the log has to survive those flushes
+		ASSERT_OK(db_->Put(WriteOptions(), cf, "k", "one"));
+		for (int i = 0; i < 3; i++) {
+			ASSERT_OK(Put(Key(i), "v"));
+			ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		}
+		Close();
+
+		std::vector<ColumnFamilyDescriptor> families;
+		families.push_back(ColumnFamilyDescriptor(kDefaultColumnFamilyName, options));
+		families.push_back(ColumnFamilyDescriptor("one", options));
+		std::vector<ColumnFamilyHandle*> handles;
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ("one", GetCF(db_, handles[1], "k"));
+		ASSERT_EQ("NOT_FOUND", Get("k"));
+		ASSERT_EQ("v", Get(Key(2)));
+
+		// Once "one" flushes as well, its old entries are not replayed
+		ASSERT_OK(db_->Flush(handles[1]));
+		ASSERT_OK(db_->Put(WriteOptions(), handles[1], "k", "two"));
+		Close();
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ("two", GetCF(db_, handles[1], "k"));
+	}
+
+	TEST(DBTest, RepairColumnFamilies) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ColumnFamilyHandle* one;
+		ColumnFamilyHandle* two;
+		ColumnFamilyHandle* gone;
+		ASSERT_OK(db_->CreateColumnFamily(options, "one", &one));
+		ASSERT_OK(db_->CreateColumnFamily(options, "two", &two));
+		ASSERT_OK(db_->CreateColumnFamily(options, "gone", &gone));
+		ASSERT_OK(Put("k", "default"));
+		ASSERT_OK(db_->Put(WriteOptions(), one, "a", "one"));
+		ASSERT_OK(db_->Flush(one));
+		ASSERT_OK(db_->Put(WriteOptions(), one, "b", "one"));
+		ASSERT_OK(db_->Put(WriteOptions(), two, "c", "two"));
+		ASSERT_OK(db_->Put(WriteOptions(), gone, "d", "gone"));
+		ASSERT_OK(db_->DropColumnFamily(gone));
+		Close();
+
+		// Entries still only in the shared log go to their own families,
+		// and the families are listed again
+		ASSERT_OK(RepairDB(dbname_, options));
+		std::vector<std::string> names;
+		ASSERT_OK(DB::ListColumnFamilies(options, dbname_, &names));
+		ASSERT_EQ(3, names.size());
+		ASSERT_EQ("one", names[1]);
+		ASSERT_EQ("two", names[2]);
+		std::vector<ColumnFamilyDescriptor> families;
+		families.push_back(ColumnFamilyDescriptor(kDefaultColumnFamilyName, options));
+		families.push_back(ColumnFamilyDescriptor("one", options));
+		families.push_back(ColumnFamilyDescriptor("two", options));
+		std::vector<ColumnFamilyHandle*> handles;
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ("default", Get("k"));
+		ASSERT_EQ("NOT_FOUND", Get("c"));
+		ASSERT_EQ("one", GetCF(db_, handles[1], "a"));
+		ASSERT_EQ("one", GetCF(db_, handles[1], "b"));
+		ASSERT_EQ("two", GetCF(db_, handles[2], "c"));
+		ASSERT_EQ("NOT_FOUND", GetCF(db_, handles[2], "d"));
+		ASSERT_TRUE(!env_->FileExists(ColumnFamilyDirName(dbname_, 3)));
+		ASSERT_OK(db_->Put(WriteOptions(), handles[2], "e", "two"));
+		Close();
+
+		// Without a readable descriptor the families keep their data under
+		// the names of their directories
+		std::vector<std::string> filenames;
+		ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+		uint64_t number;
+		FileType type;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			if (ParseFileName(filenames[i], &number, &type) && type == kDescriptorFile) {
+				ASSERT_OK(env_->DeleteFile(dbname_ + "/" + filenames[i]));
+			}
+		}
+		ASSERT_OK(RepairDB(dbname_, options));
+		ASSERT_OK(DB::ListColumnFamilies(options, dbname_, &names));
+		ASSERT_EQ(3, names.size());
+		ASSERT_EQ("cf-000001", names[1]);
+		ASSERT_EQ("cf-000002", names[2]);
+		families[1] = ColumnFamilyDescriptor(names[1], options);
+		families[2] = ColumnFamilyDescriptor(names[2], options);
+		ASSERT_OK(DB::Open(options, dbname_, families, &handles, &db_));
+		ASSERT_EQ("default", Get("k"));
+		ASSERT_EQ("one", GetCF(db_, handles[1], "b"));
+		ASSERT_EQ("two", GetCF(db_, handles[2], "c"));
+		ASSERT_EQ("two", GetCF(db_, handles[2], "e"));
+	}
+
+	TEST(DBTest, OpenForReadOnly) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ASSERT_OK(Put("a", "v1"));
+		ASSERT_OK(dbfull()->TEST_CompactMemTable());
+		ASSERT_OK(Put("b", "v2"));
+		std::vector<std::string> files_before;
+		ASSERT_OK(env_->GetChildren(dbname_, &files_before));
+
+		// Opened next to the writer, which keeps the lock
+		DB* reader = NULL;
+		ASSERT_OK(DB::OpenForReadOnly(options, dbname_, &reader));
+		std::string value;
+		ASSERT_OK(reader->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v1", value);
+		ASSERT_OK(reader->Get(ReadOptions(), "b", &value));
+		ASSERT_EQ("v2", value);
+		ASSERT_TRUE(reader->Put(WriteOptions(), "c", "v3").IsNotSupported());
+		ASSERT_TRUE(reader->TryCatchUpWithPrimary().IsNotSupported());
+		reader->CompactRange(NULL, NULL);
+
+		// Later writes are not seen
+		ASSERT_OK(Put("a", "v4"));
+		ASSERT_OK(reader->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v1", value);
+		Iterator* iter = reader->NewIterator(ReadOptions());
+		iter->SeekToFirst();
+		ASSERT_EQ("a->v1", IterStatus(iter));
+		iter->Next();
+		ASSERT_EQ("b->v2", IterStatus(iter));
+		iter->Next();
+		ASSERT_EQ("(invalid)", IterStatus(iter));
+		delete iter;
+		delete reader;
+
+		std::vector<std::string> files_after;
+		ASSERT_OK(env_->GetChildren(dbname_, &files_after));
+		std::sort(files_before.begin(), files_before.end());
+		std::sort(files_after.begin(), files_after.end());
+		ASSERT_TRUE(files_before == files_after);
+
+		ASSERT_TRUE(!DB::OpenForReadOnly(options, dbname_ + "-missing", &reader).ok());
+	}
+
+	TEST(DBTest, OpenAsSecondary) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ASSERT_OK(Put("a", "v1"));
+
+		DB* secondary = NULL;
+		ASSERT_OK(DB::OpenAsSecondary(options, dbname_, &secondary));
+		std::string value;
+		ASSERT_OK(secondary->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v1", value);
+
+		// New writes show up once the secondary catches up
+		ASSERT_OK(Put("a", "v2"));
+		ASSERT_OK(Put("b", "v3"));
+		ASSERT_OK(secondary->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v1", value);
+		ASSERT_TRUE(secondary->Get(ReadOptions(), "b", &value).IsNotFound());
+		const Snapshot* snapshot = secondary->GetSnapshot();
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_OK(secondary->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v2", value);
+		ASSERT_OK(secondary->Get(ReadOptions(), "b", &value));
+		ASSERT_EQ("v3", value);
+		ReadOptions at_snapshot;
+		at_snapshot.snapshot = snapshot;
+		ASSERT_OK(secondary->Get(at_snapshot, "a", &value));
+		ASSERT_EQ("v1", value);
+		secondary->ReleaseSnapshot(snapshot);
+
+		// So do flushes and compactions, which retire the logs
+		for (int i = 0; i < 100; i++) {
+			ASSERT_OK(Put(Key(i), "x"));
+		}
+		ASSERT_OK(Delete("b"));
+		db_->CompactRange(NULL, NULL);
+		ASSERT_OK(Put("c", "v4"));
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_OK(secondary->Get(ReadOptions(), "a", &value));
+		ASSERT_EQ("v2", value);
+		ASSERT_TRUE(secondary->Get(ReadOptions(), "b", &value).IsNotFound());
+		ASSERT_OK(secondary->Get(ReadOptions(), "c", &value));
+		ASSERT_EQ("v4", value);
+		ASSERT_OK(secondary->Get(ReadOptions(), Key(99), &value));
+		ASSERT_EQ("x", value);
+
+		// A reopened primary starts a new descriptor
+		Reopen(&options);
+		ASSERT_OK(Put("d", "v5"));
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_OK(secondary->Get(ReadOptions(), "d", &value));
+		ASSERT_EQ("v5", value);
+		ASSERT_OK(secondary->Get(ReadOptions(), "c", &value));
+		ASSERT_EQ("v4", value);
+		ASSERT_TRUE(secondary->Put(WriteOptions(), "e", "v6").IsNotSupported());
+		delete secondary;
+
+		// Periodic catching up
+		options.secondary_catch_up_millis = 1;
+		ASSERT_OK(DB::OpenAsSecondary(options, dbname_, &secondary));
+		ASSERT_OK(Put("e", "v7"));
+		Status s;
+		for (int i = 0; i < 1000; i++) {
+			s = secondary->Get(ReadOptions(), "e", &value);
+			if (s.ok()) {
+				break;
+			}
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_OK(s);
+		ASSERT_EQ("v7", value);
+		delete secondary;
+	}
+
+	TEST(DBTest, OpenAsSecondaryColumnFamilies) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+		ColumnFamilyHandle* old_cf;
+		ASSERT_OK(db_->CreateColumnFamily(options, "old", &old_cf));
+		ASSERT_OK(db_->Put(WriteOptions(), old_cf, "k", "old"));
+
+		// Families that exist when it opens are there from the start
+		DB* secondary = NULL;
+		ASSERT_OK(DB::OpenAsSecondary(options, dbname_, &secondary));
+		ColumnFamilyHandle* secondary_old;
+		ASSERT_OK(secondary->GetColumnFamilyHandle("old", &secondary_old));
+		ASSERT_EQ("old", GetCF(secondary, secondary_old, "k"));
+		ColumnFamilyHandle* secondary_new;
+		ASSERT_TRUE(secondary->GetColumnFamilyHandle("new", &secondary_new).IsNotFound());
+		ASSERT_TRUE(secondary_new == NULL);
+
+		// One the primary creates shows up once the secondary catches up,
+		// with what was written to it before then
+		ColumnFamilyHandle* new_cf;
+		ASSERT_OK(db_->CreateColumnFamily(options, "new", &new_cf));
+		ASSERT_OK(db_->Put(WriteOptions(), new_cf, "a", "v1"));
+		ASSERT_OK(db_->Flush(new_cf));
+		ASSERT_OK(db_->Put(WriteOptions(), new_cf, "b", "v2"));
+		ASSERT_TRUE(secondary->GetColumnFamilyHandle("new", &secondary_new).IsNotFound());
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_OK(secondary->GetColumnFamilyHandle("new", &secondary_new));
+		ASSERT_EQ("v1", GetCF(secondary, secondary_new, "a"));
+		ASSERT_EQ("v2", GetCF(secondary, secondary_new, "b"));
+		ASSERT_EQ("NOT_FOUND", GetCF(secondary, NULL, "a"));
+		ASSERT_OK(db_->Put(WriteOptions(), new_cf, "b", "v3"));
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_EQ("v3", GetCF(secondary, secondary_new, "b"));
+
+		// One it drops stops being read, even once its files are gone
+		ASSERT_OK(db_->DropColumnFamily(old_cf));
+		ASSERT_EQ("old", GetCF(secondary, secondary_old, "k"));
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		std::string value;
+		ASSERT_TRUE(secondary->Get(ReadOptions(), secondary_old, "k", &value).IsInvalidArgument());
+		Iterator* iter = secondary->NewIterator(ReadOptions(), secondary_old);
+		ASSERT_TRUE(iter->status().IsInvalidArgument());
+		delete iter;
+		ASSERT_TRUE(secondary->GetColumnFamilyHandle("old", &secondary_old).IsNotFound());
+		Close();
+		ASSERT_OK(secondary->TryCatchUpWithPrimary());
+		ASSERT_EQ("v3", GetCF(secondary, secondary_new, "b"));
+		delete secondary;
+
+		// A read-only instance opens every family as well
+		DB* reader = NULL;
+		ASSERT_OK(DB::OpenForReadOnly(options, dbname_, &reader));
+		ColumnFamilyHandle* reader_new;
+		ASSERT_OK(reader->GetColumnFamilyHandle("new", &reader_new));
+		ASSERT_EQ("v1", GetCF(reader, reader_new, "a"));
+		ASSERT_EQ("v3", GetCF(reader, reader_new, "b"));
+		delete reader;
+	}
+
 	TEST(DBTest, DeletionMarkers1) {
 		Put("foo", "v1");
 		ASSERT_OK(dbfull()->TEST_CompactMemTable());
@@ -1361,6 +2073,315 @@ namespace leveldb {
 		} while (ChangeOptions());
 	}
 
+	TEST(DBTest, TrivialMoveFromLevel0) {
+		// Placeholder in level-2, then a file spanning everything in level-1
+		// so that the next memtables stay in level-0.
+		ASSERT_OK(Put("m", "placeholder"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_OK(Put("a", "va"));
+		ASSERT_OK(Put("z", "vz"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ("0,1,1", FilesPerLevel());
+
+		// Level-0 files, oldest first: b..c, f..g, c..d
+		const char* ranges[][2] = { { "b", "c" }, { "f", "g" }, { "c", "d" } };
+		for (int i = 0; i < 3; i++) {
+			ASSERT_OK(Put(ranges[i][0], ranges[i][0] + std::string("1")));
+			ASSERT_OK(Put(ranges[i][1], ranges[i][1] + std::string("1")));
+			dbfull()->TEST_CompactMemTable();
+		}
+		ASSERT_EQ("3,1,1", FilesPerLevel());
+
+		// Empty level-1; the level-0 files now overlap nothing below them
+		dbfull()->TEST_CompactRange(1, NULL, NULL);
+		ASSERT_EQ("3,0,1", FilesPerLevel());
+
+		// A fourth file triggers the level-0 compaction.  b..c and f..g
+		// overlap no older level-0 file and are moved; c..d and c..f stay.
+		ASSERT_OK(Put("c", "c2"));
+		ASSERT_OK(Put("f", "f2"));
+		dbfull()->TEST_CompactMemTable();
+		for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) > 2; i++) {
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_EQ("2,2,1", FilesPerLevel());
+		ASSERT_EQ("b1", Get("b"));
+		ASSERT_EQ("c2", Get("c"));
+		ASSERT_EQ("d1", Get("d"));
+		ASSERT_EQ("f2", Get("f"));
+		ASSERT_EQ("g1", Get("g"));
+		ASSERT_EQ("va", Get("a"));
+
+		Reopen();
+		ASSERT_EQ("2,2,1", FilesPerLevel());
+		ASSERT_EQ("c2", Get("c"));
+		ASSERT_EQ("f2", Get("f"));
+	}
+
+	TEST(DBTest, UniversalCompaction) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.compaction_style = kCompactionStyleUniversal;
+		options.compression = kNoCompression;
+		DestroyAndReopen(&options);
+		ASSERT_EQ(config::kL0_CompactionTrigger, 4) << "Fix test to match config";
+
+		// Four equal runs: the newer three are 300% of the oldest, so all
+		// of them are merged into level-1.
+		for (int run = 0; run < 4; run++) {
+			for (int i = 0; i < 250; i++) {
+				ASSERT_OK(Put(Key(run * 250 + i), "base"));
+			}
+			dbfull()->TEST_CompactMemTable();
+		}
+		for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) > 0; i++) {
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_EQ("0,1", FilesPerLevel());
+
+		// Three small runs of equal size next to the large one: they are
+		// merged by size ratio into a single level-0 run.
+		const Snapshot* snapshot = NULL;
+		for (int run = 0; run < 3; run++) {
+			for (int i = 0; i < 10; i++) {
+				ASSERT_OK(Put(Key(i), "new" + NumberToString(run)));
+			}
+			ASSERT_OK(Delete(Key(500 + run)));
+			dbfull()->TEST_CompactMemTable();
+			if (run == 0) {
+				snapshot = db_->GetSnapshot();
+			}
+		}
+		for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) > 1; i++) {
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_EQ("1,1", FilesPerLevel());
+		ASSERT_EQ("new2", Get(Key(3)));
+		ASSERT_EQ("new0", Get(Key(3), snapshot));
+		ASSERT_EQ("base", Get(Key(20)));
+		// The deletions still shadow the older run
+		ASSERT_EQ("NOT_FOUND", Get(Key(501)));
+		ASSERT_EQ("base", Get(Key(501), snapshot));
+		ASSERT_EQ("base", Get(Key(503)));
+
+		db_->ReleaseSnapshot(snapshot);
+		dbfull()->CompactRange(NULL, NULL);
+		ASSERT_EQ("0,1", FilesPerLevel());
+		ASSERT_EQ("NOT_FOUND", Get(Key(501)));
+		ASSERT_EQ("new2", Get(Key(3)));
+	}
+
+	TEST(DBTest, FIFOCompaction) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.env = env_;
+		options.compaction_style = kCompactionStyleFIFO;
+		options.compression = kNoCompression;
+		options.fifo_max_table_files_size = 350 * 1024;
+		DestroyAndReopen(&options);
+
+		// Ten files of about 100KB each: only the newest three fit, and
+		// nothing is ever merged.
+		const std::string value(1000, 'v');
+		for (int file = 0; file < 10; file++) {
+			for (int i = 0; i < 100; i++) {
+				ASSERT_OK(Put(Key(file * 100 + i), value));
+			}
+			dbfull()->TEST_CompactMemTable();
+			for (int i = 0; i < 1000 && TotalTableFiles() > 3; i++) {
+				env_->SleepForMicroseconds(10000);
+			}
+		}
+		ASSERT_EQ("3", FilesPerLevel());
+		ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+		ASSERT_EQ("NOT_FOUND", Get(Key(699)));
+		ASSERT_EQ(value, Get(Key(700)));
+		ASSERT_EQ(value, Get(Key(999)));
+
+		// CompactRange() leaves the files in level-0
+		dbfull()->CompactRange(NULL, NULL);
+		ASSERT_EQ("3", FilesPerLevel());
+
+		// With a TTL, files age out once a flush wakes the background
+		// thread, also after a reopen, which has to read the creation
+		// times back from the files.
+		options.fifo_max_table_files_size = 1 << 30;
+		options.fifo_ttl_seconds = 3600;
+		Reopen(&options);
+		ASSERT_EQ("3", FilesPerLevel());
+		env_->clock_skew_seconds_.IncrementBy(7200);
+		ASSERT_OK(Put(Key(1000), "fresh"));
+		dbfull()->TEST_CompactMemTable();
+		for (int i = 0; i < 1000 && TotalTableFiles() > 1; i++) {
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_EQ("1", FilesPerLevel());
+		ASSERT_EQ("NOT_FOUND", Get(Key(999)));
+		ASSERT_EQ("fresh", Get(Key(1000)));
+		env_->clock_skew_seconds_.Reset();
+	}
+
+	TEST(DBTest, ExpiringValues) {
+		Options options = CurrentOptions();
+		options.env = env_;
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+
+		WriteOptions ttl;
+		ttl.ttl_seconds = 100;
+		ASSERT_OK(Put("a", "old"));
+		const Snapshot* snapshot = db_->GetSnapshot();
+		ASSERT_OK(db_->Put(ttl, "a", "va"));
+		ASSERT_OK(db_->Put(ttl, "b", "vb"));
+		ASSERT_OK(Put("c", "vc"));
+		ASSERT_EQ("va", Get("a"));
+		ASSERT_EQ("(a->va)(b->vb)(c->vc)", Contents());
+
+		// Expired values read as deleted from the memtable and from tables,
+		// and still hide older values.
+		env_->clock_skew_seconds_.IncrementBy(200);
+		ASSERT_EQ("NOT_FOUND", Get("a"));
+		ASSERT_EQ("NOT_FOUND", Get("b"));
+		ASSERT_EQ("old", Get("a", snapshot));
+		ASSERT_EQ("(c->vc)", Contents());
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ("0,0,1", FilesPerLevel());
+		ASSERT_EQ("NOT_FOUND", Get("a"));
+		ASSERT_EQ("old", Get("a", snapshot));
+		ASSERT_EQ("(c->vc)", Contents());
+
+		// While the snapshot is live a compaction only strips the expired
+		// values, and "old" stays visible to the snapshot.
+		dbfull()->TEST_CompactRange(2, NULL, NULL);
+		ASSERT_EQ("[ EXP:, old ]", AllEntriesFor("a"));
+		ASSERT_EQ("[ EXP: ]", AllEntriesFor("b"));
+		ASSERT_EQ("NOT_FOUND", Get("a"));
+		ASSERT_EQ("old", Get("a", snapshot));
+
+		// Then they are dropped without leaving a deletion marker
+		db_->ReleaseSnapshot(snapshot);
+		dbfull()->TEST_CompactRange(3, NULL, NULL);
+		ASSERT_EQ("[ ]", AllEntriesFor("a"));
+		ASSERT_EQ("[ ]", AllEntriesFor("b"));
+		ASSERT_EQ("(c->vc)", Contents());
+		env_->clock_skew_seconds_.Reset();
+	}
+
+	TEST(DBTest, CompactExpiredFiles) {
+		Options options = CurrentOptions();
+		options.env = env_;
+		options.create_if_missing = true;
+		options.compact_expired_files = true;
+		DestroyAndReopen(&options);
+
+		WriteOptions ttl;
+		ttl.ttl_seconds = 100;
+		for (int i = 0; i < 100; i++) {
+			ASSERT_OK(db_->Put(ttl, Key(i), "expiring"));
+		}
+		ASSERT_OK(Put(Key(100), "kept"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ("0,0,1", FilesPerLevel());
+
+		// Nothing has expired yet, so the file stays where it is
+		ASSERT_OK(Put("z", "wake"));
+		dbfull()->TEST_CompactMemTable();
+		DelayMilliseconds(100);
+		ASSERT_EQ("[ EXP:expiring ]", AllEntriesFor(Key(0)));
+
+		// Once it has, the next wakeup compacts the file into level-3 and
+		// drops the expired values on the way.
+		env_->clock_skew_seconds_.IncrementBy(200);
+		ASSERT_OK(Put("z", "wake"));
+		dbfull()->TEST_CompactMemTable();
+		for (int i = 0; i < 1000 && AllEntriesFor(Key(0)) != "[ ]"; i++) {
+			env_->SleepForMicroseconds(10000);
+		}
+		ASSERT_EQ("[ ]", AllEntriesFor(Key(0)));
+		ASSERT_EQ("[ ]", AllEntriesFor(Key(99)));
+		ASSERT_EQ("kept", Get(Key(100)));
+		env_->clock_skew_seconds_.Reset();
+	}
+
+	// Removes values "remove" and rewrites values "change"
+	class TestCompactionFilter : public CompactionFilter {
+	public:
+		mutable CompactionFilter::Context last_context_;
+		mutable int calls_;
+
+		TestCompactionFilter() : last_context_(), calls_(0) { }
+
+		virtual bool Filter(const Context& context,
+			const Slice& key,
+			const Slice& existing_value,
+			std::string* new_value,
+			bool* value_changed) const {
+			last_context_ = context;
+			calls_++;
+			if (existing_value == "change") {
+				new_value->assign("changed");
+				*value_changed = true;
+			}
+			return existing_value == "remove";
+		}
+
+		virtual const char* Name() const { return "TestCompactionFilter"; }
+	};
+
+	TEST(DBTest, CompactionFilter) {
+		TestCompactionFilter filter;
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.compaction_filter = &filter;
+		DestroyAndReopen(&options);
+
+		ASSERT_OK(Put("a", "keep"));
+		ASSERT_OK(Put("b", "remove"));
+		ASSERT_OK(Put("c", "change"));
+		ASSERT_OK(Put("e", "old"));
+		const Snapshot* snapshot = db_->GetSnapshot();
+		ASSERT_OK(Put("d", "remove"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ(0, filter.calls_);
+		ASSERT_EQ("0,0,1", FilesPerLevel());
+
+		// "d" is newer than the snapshot, so it is not filtered yet
+		dbfull()->TEST_CompactRange(2, NULL, NULL);
+		ASSERT_EQ(4, filter.calls_);
+		ASSERT_EQ(2, filter.last_context_.level);
+		ASSERT_EQ(3, filter.last_context_.output_level);
+		ASSERT_TRUE(filter.last_context_.is_full_compaction);
+		ASSERT_TRUE(filter.last_context_.is_manual_compaction);
+		ASSERT_EQ("[ ]", AllEntriesFor("b"));
+		ASSERT_EQ("(a->keep)(c->changed)(d->remove)(e->old)", Contents());
+
+		db_->ReleaseSnapshot(snapshot);
+		dbfull()->TEST_CompactRange(3, NULL, NULL);
+		ASSERT_EQ("(a->keep)(c->changed)(e->old)", Contents());
+
+		// Above an older value, a removed value becomes a deletion marker
+		ASSERT_OK(Put("e", "remove"));
+		ASSERT_OK(Put("f", "x"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ("0,0,1,0,1", FilesPerLevel());
+		dbfull()->TEST_CompactRange(2, NULL, NULL);
+		ASSERT_EQ("[ DEL, old ]", AllEntriesFor("e"));
+		ASSERT_EQ("(a->keep)(c->changed)(f->x)", Contents());
+		ASSERT_TRUE(!filter.last_context_.is_full_compaction);
+
+		// So does an expiring one, and the output records no expiry
+		WriteOptions ttl;
+		ttl.ttl_seconds = 100;
+		ASSERT_OK(db_->Put(ttl, "e", "remove"));
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_EQ("0,0,1,1,1", FilesPerLevel());
+		ASSERT_EQ(1, TablesWithMinExpiry());
+		dbfull()->TEST_CompactRange(2, NULL, NULL);
+		ASSERT_EQ("0,0,0,1,1", FilesPerLevel());
+		ASSERT_EQ("[ DEL, old ]", AllEntriesFor("e"));
+		ASSERT_EQ(0, TablesWithMinExpiry());
+	}
+
 	TEST(DBTest, L0_CompactionBug_Issue44_a) {
 		Reopen();
 		ASSERT_OK(Put("b", "v"));
@@ -1673,6 +2694,39 @@ namespace leveldb {
 		}
 	}
 
+	TEST(DBTest, ManifestRollover) {
+		Options options = CurrentOptions();
+		options.max_manifest_file_size = 1;   // Roll over on every edit
+		Reopen(&options);
+		std::string current;
+		ASSERT_OK(ReadFileToString(env_, CurrentFileName(dbname_), &current));
+		for (int i = 0; i < 10; i++) {
+			ASSERT_OK(Put(Key(i), "v"));
+			dbfull()->TEST_CompactMemTable();
+		}
+		std::string rolled;
+		ASSERT_OK(ReadFileToString(env_, CurrentFileName(dbname_), &rolled));
+		ASSERT_NE(current, rolled);
+
+		// Old descriptors are garbage collected along with other files.
+		std::vector<std::string> filenames;
+		ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+		uint64_t number;
+		FileType type;
+		int manifests = 0;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			if (ParseFileName(filenames[i], &number, &type) && type == kDescriptorFile) {
+				manifests++;
+			}
+		}
+		ASSERT_LE(manifests, 2);
+
+		Reopen(&options);
+		for (int i = 0; i < 10; i++) {
+			ASSERT_EQ("v", Get(Key(i)));
+		}
+	}
+
 	TEST(DBTest, MissingSSTFile) {
 		ASSERT_OK(Put("foo", "bar"));
 		ASSERT_EQ("bar", Get("foo"));
@@ -1691,6 +2745,62 @@ namespace leveldb {
 			<< s.ToString();
 	}
 
+	TEST(DBTest, TruncatedSSTFile) {
+		ASSERT_OK(Put("foo", "bar"));
+		dbfull()->TEST_CompactMemTable();
+		Close();
+
+		std::vector<std::string> filenames;
+		ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+		uint64_t number;
+		FileType type;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			if (ParseFileName(filenames[i], &number, &type) && type == kTableFile) {
+				const std::string fname = TableFileName(dbname_, number);
+				std::string contents;
+				ASSERT_OK(ReadFileToString(env_, fname, &contents));
+				contents.resize(contents.size() - 1);
+				ASSERT_OK(WriteStringToFile(env_, contents, fname));
+			}
+		}
+
+		// Tables are opened lazily, so only paranoid_checks notice on open.
+		Options options = CurrentOptions();
+		ASSERT_OK(TryReopen(&options));
+		Close();
+		options.paranoid_checks = true;
+		options.max_file_opening_threads = 4;
+		Status s = TryReopen(&options);
+		ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+		ASSERT_TRUE(s.ToString().find("expected") != std::string::npos)
+			<< s.ToString();
+	}
+
+	TEST(DBTest, WarmTableCache) {
+		for (int i = 0; i < 5; i++) {
+			ASSERT_OK(Put(Key(i), "v"));
+			dbfull()->TEST_CompactMemTable();
+		}
+		Options options = CurrentOptions();
+		options.warm_table_cache = true;
+		Reopen(&options);
+		uint64_t value = 0;
+		for (int i = 0; i < 1000 && value == 0; i++) {
+			ASSERT_TRUE(db_->GetIntProperty("leveldb.estimate-table-readers-mem", &value));
+			if (value == 0) {
+				env_->SleepForMicroseconds(10000);
+			}
+		}
+		ASSERT_GT(value, 0);
+		for (int i = 0; i < 5; i++) {
+			ASSERT_EQ("v", Get(Key(i)));
+		}
+
+		// Closing while the warm-up may still be running must be safe.
+		Reopen(&options);
+		Close();
+	}
+
 	TEST(DBTest, StillReadSST) {
 		ASSERT_OK(Put("foo", "bar"));
 		ASSERT_EQ("bar", Get("foo"));
@@ -1765,6 +2875,368 @@ namespace leveldb {
 		delete options.filter_policy;
 	}
 
+	TEST(DBTest, Statistics) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.block_cache = NewLRUCache(1 << 20);
+		options.filter_policy = NewBloomFilterPolicy(10);
+		options.statistics = NewDBStatistics();
+		DestroyAndReopen(&options);
+		Statistics* stats = options.statistics;
+
+		const int N = 100;
+		for (int i = 0; i < N; i++) {
+			ASSERT_OK(Put(Key(i), Key(i)));
+		}
+		ASSERT_EQ(N, stats->GetTickerCount(kKeysWritten));
+		ASSERT_GT(stats->GetTickerCount(kWalBytes), N * Key(0).size());
+
+		ASSERT_EQ(Key(0), Get(Key(0)));
+		ASSERT_EQ(1, stats->GetTickerCount(kMemtableHit));
+		dbfull()->TEST_CompactMemTable();
+
+		for (int i = 0; i < N; i++) {
+			ASSERT_EQ(Key(i), Get(Key(i)));
+		}
+		ASSERT_EQ(N, stats->GetTickerCount(kMemtableMiss));
+		ASSERT_EQ(N, stats->GetTickerCount(kBloomFilterTruePositive));
+		ASSERT_GE(stats->GetTickerCount(kBlockCacheDataMiss), 1);
+		ASSERT_GE(stats->GetTickerCount(kBlockCacheDataHit), 1);
+		ASSERT_EQ(N, stats->GetTickerCount(kBlockCacheDataHit) +
+			stats->GetTickerCount(kBlockCacheDataMiss));
+
+		for (int i = 0; i < N; i++) {
+			ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+		}
+		ASSERT_GE(stats->GetTickerCount(kBloomFilterUseful), N * 9 / 10);
+		// Lookups past the last key of the table never reach its filter.
+		ASSERT_LE(stats->GetTickerCount(kBloomFilterUseful) +
+			stats->GetTickerCount(kBloomFilterPositive) -
+			stats->GetTickerCount(kBloomFilterTruePositive), N);
+
+		Iterator* iter = db_->NewIterator(ReadOptions());
+		iter->Seek(Key(N / 2));
+		ASSERT_TRUE(iter->Valid());
+		delete iter;
+
+		HistogramData data;
+		stats->GetHistogramData(kGetMicros, &data);
+		ASSERT_EQ(2 * N + 1, data.count);
+		stats->GetHistogramData(kWriteMicros, &data);
+		ASSERT_EQ(N, data.count);
+		stats->GetHistogramData(kSeekMicros, &data);
+		ASSERT_EQ(1, data.count);
+		ASSERT_TRUE(stats->ToString().find("leveldb.memtable.hit COUNT : 1\n") !=
+			std::string::npos);
+
+		stats->Reset();
+		ASSERT_EQ(0, stats->GetTickerCount(kMemtableHit));
+
+		Close();
+		delete options.block_cache;
+		delete options.filter_policy;
+		delete options.statistics;
+	}
+
+	TEST(DBTest, PerfContext) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.filter_policy = NewBloomFilterPolicy(10);
+		options.compression = kNoCompression;
+		DestroyAndReopen(&options);
+
+		const int N = 100;
+		for (int i = 0; i < N; i++) {
+			ASSERT_OK(Put(Key(i), Key(i)));
+		}
+		dbfull()->TEST_CompactMemTable();
+		PerfContext* ctx = GetPerfContext();
+
+		// The first read of the data block misses the block cache.
+		SetPerfLevel(kEnableTime);
+		ReadOptions ro;
+		ro.verify_checksums = true;
+		ctx->Reset();
+		std::string value;
+		ASSERT_OK(db_->Get(ro, Key(2), &value));
+		ASSERT_EQ(1, ctx->block_read_count);
+		ASSERT_GT(ctx->block_read_byte, 0);
+		ASSERT_GT(ctx->get_from_output_files_time, 0);
+		ASSERT_GT(ctx->block_read_time, 0);
+		ASSERT_GT(ctx->block_checksum_time, 0);
+		ASSERT_GE(ctx->get_from_output_files_time, ctx->block_read_time);
+
+		// Nothing is collected while disabled.
+		SetPerfLevel(kDisable);
+		ctx->Reset();
+		ASSERT_EQ(Key(1), Get(Key(1)));
+		ASSERT_EQ("", ctx->ToString());
+
+		SetPerfLevel(kEnableCount);
+		ctx->Reset();
+		ASSERT_EQ(Key(1), Get(Key(1)));
+		ASSERT_EQ(1, ctx->get_from_memtable_count);
+		ASSERT_EQ(1, ctx->table_probe_count);
+		ASSERT_EQ(1, ctx->block_cache_hit_count + ctx->block_read_count);
+		ASSERT_EQ(0, ctx->get_from_output_files_time);
+
+		ctx->Reset();
+		ASSERT_EQ("NOT_FOUND", Get(Key(1) + ".missing"));
+		ASSERT_EQ(ctx->table_probe_count, ctx->bloom_sst_miss_count +
+			ctx->block_cache_hit_count + ctx->block_read_count);
+
+		SetPerfLevel(kEnableTime);
+		ASSERT_OK(Delete(Key(3)));
+		ASSERT_OK(Put(Key(4), "v2"));
+		ctx->Reset();
+		Iterator* iter = db_->NewIterator(ReadOptions());
+		iter->Seek(Key(3));
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(Key(4), iter->key().ToString());
+		ASSERT_EQ("v2", iter->value().ToString());
+		iter->Next();
+		ASSERT_EQ(Key(5), iter->key().ToString());
+		delete iter;
+		// Skipped: the old Key(3) under its tombstone, then on Next() the
+		// current entry for Key(4) and the older version below it.
+		ASSERT_EQ(1, ctx->internal_delete_skipped_count);
+		ASSERT_EQ(3, ctx->internal_key_skipped_count);
+		ASSERT_GT(ctx->seek_internal_seek_time, 0);
+		ASSERT_GT(ctx->find_next_user_entry_time, 0);
+
+		SetPerfLevel(kDisable);
+		Close();
+		delete options.filter_policy;
+	}
+
+	TEST(DBTest, IntProperties) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		DestroyAndReopen(&options);
+
+		uint64_t value;
+		ASSERT_TRUE(!db_->GetIntProperty("leveldb.no-such-property", &value));
+		ASSERT_TRUE(!db_->GetIntProperty("leveldb.stats", &value));
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-entries-active-mem-table", &value));
+		ASSERT_EQ(0, value);
+
+		ASSERT_OK(Put("a", "v1"));
+		ASSERT_OK(Put("b", "v2"));
+		ASSERT_OK(Put("a", "v3"));
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-entries-active-mem-table", &value));
+		ASSERT_EQ(3, value);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.cur-size-active-mem-table", &value));
+		ASSERT_GT(value, 0);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-immutable-mem-table", &value));
+		ASSERT_EQ(0, value);
+
+		const Snapshot* snapshot = db_->GetSnapshot();
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-snapshots", &value));
+		ASSERT_EQ(1, value);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.oldest-snapshot-sequence", &value));
+		ASSERT_GT(value, 0);
+		db_->ReleaseSnapshot(snapshot);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-snapshots", &value));
+		ASSERT_EQ(0, value);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.oldest-snapshot-sequence", &value));
+		ASSERT_EQ(0, value);
+
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.num-entries-active-mem-table", &value));
+		ASSERT_EQ(0, value);
+		uint64_t live;
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.estimate-live-data-size", &live));
+		ASSERT_GT(live, 0);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.estimate-pending-compaction-bytes", &value));
+		ASSERT_EQ(0, value);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.background-errors", &value));
+		ASSERT_EQ(0, value);
+
+		// Integer properties are also readable as strings, and vice versa.
+		std::string str;
+		ASSERT_TRUE(db_->GetProperty("leveldb.estimate-live-data-size", &str));
+		ASSERT_EQ(NumberToString(live), str);
+		ASSERT_TRUE(db_->GetProperty("leveldb.compaction-score-at-level0", &str));
+		ASSERT_TRUE(!db_->GetIntProperty("leveldb.compaction-score-at-level0", &value));
+
+		ASSERT_EQ("v3", Get("a"));
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.estimate-table-readers-mem", &value));
+		ASSERT_GT(value, 0);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.block-cache-usage", &value));
+		ASSERT_GT(value, 0);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.block-cache-pinned-usage", &value));
+		ASSERT_EQ(0, value);
+		Iterator* iter = db_->NewIterator(ReadOptions());
+		iter->Seek("a");
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.block-cache-pinned-usage", &value));
+		ASSERT_GT(value, 0);
+		delete iter;
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.block-cache-pinned-usage", &value));
+		ASSERT_EQ(0, value);
+	}
+
+	TEST(DBTest, CompactionStats) {
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.statistics = NewDBStatistics();
+		DestroyAndReopen(&options);
+		Statistics* stats = options.statistics;
+
+		// Two overlapping flushes, the second overwriting every key.
+		const int N = 100;
+		for (int i = 0; i < N; i++) {
+			ASSERT_OK(Put(Key(i), "v1"));
+		}
+		dbfull()->TEST_CompactMemTable();
+		for (int i = 0; i < N; i++) {
+			ASSERT_OK(Put(Key(i), "v2"));
+		}
+		dbfull()->TEST_CompactMemTable();
+		ASSERT_GT(stats->GetTickerCount(kFlushBytesWritten), 0);
+		uint64_t runs;
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.read-amplification", &runs));
+		ASSERT_EQ(2, runs);
+
+		db_->CompactRange(NULL, NULL);
+		ASSERT_TRUE(db_->GetIntProperty("leveldb.read-amplification", &runs));
+		ASSERT_EQ(1, runs);
+		ASSERT_GE(stats->GetTickerCount(kCompactionsManual), 1);
+		ASSERT_GE(stats->GetTickerCount(kCompactRecordsIn), 2 * N);
+		ASSERT_GE(stats->GetTickerCount(kCompactRecordsDropped), N);
+		ASSERT_GT(stats->GetTickerCount(kCompactBytesRead), 0);
+		ASSERT_GT(stats->GetTickerCount(kCompactBytesWritten), 0);
+		for (int i = 0; i < N; i++) {
+			ASSERT_EQ("v2", Get(Key(i)));
+		}
+
+		std::string str;
+		ASSERT_TRUE(db_->GetProperty("leveldb.stats", &str));
+		ASSERT_TRUE(str.find("By reason") != std::string::npos);
+		ASSERT_TRUE(str.find("\nmanual ") != std::string::npos);
+		ASSERT_TRUE(str.find("Write amplification: ") != std::string::npos);
+		ASSERT_TRUE(str.find("Read amplification: 1 ") != std::string::npos);
+
+		Close();
+		delete options.statistics;
+	}
+
+	namespace {
+
+		class RecordingListener : public EventListener {
+		public:
+			port::Mutex mu;
+			int flushes_begun;
+			int compactions_begun;
+			std::vector<FlushJobInfo> flushes;
+			std::vector<CompactionJobInfo> compactions;
+			std::set<uint64_t> created;
+			std::set<uint64_t> deleted;
+			std::vector<BackgroundErrorReason> errors;
+
+			RecordingListener() : flushes_begun(0), compactions_begun(0) { }
+
+			virtual void OnFlushBegin(const FlushJobInfo& info) {
+				MutexLock l(&mu);
+				flushes_begun++;
+			}
+			virtual void OnFlushCompleted(const FlushJobInfo& info) {
+				MutexLock l(&mu);
+				flushes.push_back(info);
+			}
+			virtual void OnCompactionBegin(const CompactionJobInfo& info) {
+				MutexLock l(&mu);
+				compactions_begun++;
+			}
+			virtual void OnCompactionCompleted(const CompactionJobInfo& info) {
+				MutexLock l(&mu);
+				compactions.push_back(info);
+			}
+			virtual void OnTableFileCreated(const TableFileInfo& info) {
+				MutexLock l(&mu);
+				if (info.status.ok()) {
+					created.insert(info.file_number);
+				}
+			}
+			virtual void OnTableFileDeleted(const TableFileInfo& info) {
+				MutexLock l(&mu);
+				deleted.insert(info.file_number);
+			}
+			virtual void OnBackgroundError(BackgroundErrorReason reason, const Status& s) {
+				MutexLock l(&mu);
+				errors.push_back(reason);
+			}
+		};
+
+	}  // namespace
+
+	TEST(DBTest, EventListener) {
+		RecordingListener listener;
+		Options options = CurrentOptions();
+		options.create_if_missing = true;
+		options.env = env_;
+		options.listener = &listener;
+		DestroyAndReopen(&options);
+
+		for (int i = 0; i < 100; i++) {
+			ASSERT_OK(Put(Key(i), "v1"));
+		}
+		dbfull()->TEST_CompactMemTable();
+		for (int i = 0; i < 100; i++) {
+			ASSERT_OK(Put(Key(i), "v2"));
+		}
+		dbfull()->TEST_CompactMemTable();
+		dbfull()->CompactRange(NULL, NULL);
+		ASSERT_EQ("v2", Get(Key(5)));
+
+		// Background errors are reported before the failing write returns.
+		env_->data_sync_error_.Release_Store(env_);
+		WriteOptions sync;
+		sync.sync = true;
+		ASSERT_TRUE(!db_->Put(sync, "k", "v").ok());
+		env_->data_sync_error_.Release_Store(NULL);
+		{
+			MutexLock l(&listener.mu);
+			ASSERT_EQ(1, listener.errors.size());
+			ASSERT_EQ(kErrorWriteLog, listener.errors[0]);
+		}
+
+		// Closing the DB delivers any events still in flight.
+		Close();
+		MutexLock l(&listener.mu);
+
+		ASSERT_EQ(listener.flushes_begun, listener.flushes.size());
+		int tables_flushed = 0;
+		for (size_t i = 0; i < listener.flushes.size(); i++) {
+			const FlushJobInfo& f = listener.flushes[i];
+			ASSERT_OK(f.status);
+			if (f.file_number != 0) {
+				ASSERT_TRUE(listener.created.count(f.file_number) == 1);
+				ASSERT_GT(f.file_size, 0);
+				tables_flushed++;
+			}
+		}
+		ASSERT_EQ(2, tables_flushed);
+
+		ASSERT_EQ(listener.compactions_begun, listener.compactions.size());
+		ASSERT_GE(listener.compactions.size(), 1);
+		for (size_t i = 0; i < listener.compactions.size(); i++) {
+			const CompactionJobInfo& c = listener.compactions[i];
+			ASSERT_OK(c.status);
+			ASSERT_EQ(c.level + 1, c.output_level);
+			if (c.is_trivial_move) {
+				continue;
+			}
+			ASSERT_GT(c.bytes_read, 0);
+			for (size_t j = 0; j < c.input_files.size(); j++) {
+				ASSERT_TRUE(listener.deleted.count(c.input_files[j]) == 1);
+			}
+			for (size_t j = 0; j < c.output_files.size(); j++) {
+				ASSERT_TRUE(listener.created.count(c.output_files[j]) == 1);
+			}
+		}
+	}
+
 	// Multi-threaded test:
 	namespace {
 
@@ -100,6 +100,10 @@ namespace leveldb {
 		}
 	}
 
+	uint64_t InternalKeyComparator::KeyNum(const Slice& key) const {
+		return user_comparator_->KeyNum(ExtractUserKey(key));
+	}
+
 	const char* InternalFilterPolicy::Name() const {
 		return user_policy_->Name();
 	}
@@ -52,7 +52,14 @@ namespace leveldb {
 	// data structures.
 	enum ValueType {
 		kTypeDeletion = 0x0,
-		kTypeValue = 0x1
+		kTypeValue = 0x1,
+		kTypeValueWithExpiry = 0x2,
+		kTypeBlobIndex = 0x3,       // Tables only: value is an encoded BlobIndex (db/blob_file.h)
+		// WriteBatch only: the types above for a column family other than
+		// the default one, whose id follows the tag
+		kTypeColumnFamilyDeletion = 0x4,
+		kTypeColumnFamilyValue = 0x5,
+		kTypeColumnFamilyValueWithExpiry = 0x6
 	};
 	// kValueTypeForSeek defines the ValueType that should be passed when
 	// constructing a ParsedInternalKey object for seeking to a particular
@@ -60,7 +67,7 @@ namespace leveldb {
 	// and the value type is embedded as the low 8 bits in the sequence
 	// number in internal keys, we need to use the highest-numbered
 	// ValueType, not the lowest).
-	static const ValueType kValueTypeForSeek = kTypeValue;
+	static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 	typedef uint64_t SequenceNumber;
 
@@ -69,6 +76,42 @@ namespace leveldb {
 	static const SequenceNumber kMaxSequenceNumber =
 		((0x1ull << 56) - 1);
 
+	// Table property holding the varint64 encoded largest sequence number
+	// of any entry in the file.  Lets RepairDB rebuild file metadata without
+	// scanning every key.
+	static const char kPropertyMaxSequence[] = "leveldb.max.sequence";
+
+	// The value of a kTypeValueWithExpiry entry is the user value followed
+	// by the fixed64 time, in seconds since the epoch, at which the entry
+	// expires.  From then on it reads like a deletion.  A value too short
+	// to hold the time counts as expired.
+	inline uint64_t ExtractExpiry(const Slice& stored_value) {
+		if (stored_value.size() < 8) {
+			return 0;
+		}
+		return DecodeFixed64(stored_value.data() + stored_value.size() - 8);
+	}
+
+	inline Slice StripExpiry(const Slice& stored_value) {
+		if (stored_value.size() < 8) {
+			return Slice();
+		}
+		return Slice(stored_value.data(), stored_value.size() - 8);
+	}
+
+	inline bool IsExpired(const Slice& stored_value, uint64_t now) {
+		return ExtractExpiry(stored_value) <= now;
+	}
+
+	// Table property holding the varint64 encoded smallest expiry time of
+	// any kTypeValueWithExpiry entry in the file; absent if there is none.
+	static const char kPropertyMinExpiry[] = "leveldb.min.expiry";
+
+	// Table property holding the varint64 encoded time, in seconds since
+	// the epoch, at which a memtable flush wrote the file.  FIFO compaction
+	// drops files by this age.
+	static const char kPropertyCreationTime[] = "leveldb.creation.time";
+
 	struct ParsedInternalKey {
 		Slice user_key;
 		SequenceNumber sequence;
@@ -128,6 +171,7 @@ namespace leveldb {
 			std::string* start,
 			const Slice& limit) const;
 		virtual void FindShortSuccessor(std::string* key) const;
+		virtual uint64_t KeyNum(const Slice& key) const;
 
 		const Comparator* user_comparator() const { return user_comparator_; }
 
@@ -202,7 +246,7 @@ namespace leveldb {
 		result->sequence = num >> 8;
 		result->type = static_cast<ValueType>(c);
 		result->user_key = Slice(internal_key.data(), n - 8);
-		return (c <= static_cast<unsigned char>(kTypeValue));
+		return (c <= static_cast<unsigned char>(kTypeBlobIndex));
 	}
 
 	// A helper class useful for DBImpl::Get()
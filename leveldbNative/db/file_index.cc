@@ -0,0 +1,228 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_index.h"
+
+#include <assert.h>
+#include <algorithm>
+#include "leveldb/comparator.h"
+
+namespace leveldb {
+
+	FileIndex::FileIndex()
+		: icmp_(NULL),
+		use_prefix_(false) {
+		for (unsigned level = 0; level < config::kNumLevels; level++) {
+			next_level_[level] = config::kNumLevels;
+		}
+	}
+
+	uint64_t FileIndex::KeyPrefix(const Slice& user_key) const {
+		if (!use_prefix_) {
+			return 0;
+		}
+		// Big-endian, zero padded: integer order matches bytewise order
+		// whenever two prefixes differ.
+		uint64_t prefix = 0;
+		const size_t n = user_key.size() < 8 ? user_key.size() : 8;
+		for (size_t i = 0; i < 8; i++) {
+			prefix <<= 8;
+			if (i < n) {
+				prefix |= static_cast<unsigned char>(user_key[i]);
+			}
+		}
+		return prefix;
+	}
+
+	static bool NewestEntryFirst(const FileMetaData* a, const FileMetaData* b) {
+		return a->number > b->number;
+	}
+
+	void FileIndex::Build(const InternalKeyComparator* icmp,
+		const std::vector<FileMetaData*>* files,
+		int max_error) {
+		icmp_ = icmp;
+		use_prefix_ = (icmp->user_comparator() == BytewiseComparator());
+		for (unsigned level = 0; level < config::kNumLevels; level++) {
+			std::vector<FileMetaData*> sorted(files[level]);
+			if (level == 0) {
+				std::sort(sorted.begin(), sorted.end(), NewestEntryFirst);
+			}
+			std::vector<Entry>& entries = levels_[level];
+			entries.resize(sorted.size());
+			for (size_t i = 0; i < sorted.size(); i++) {
+				Entry* e = &entries[i];
+				e->smallest_prefix = KeyPrefix(sorted[i]->smallest.user_key());
+				e->largest_prefix = KeyPrefix(sorted[i]->largest.user_key());
+				e->file = sorted[i];
+				e->next_smallest = 0;
+				e->next_largest = 0;
+			}
+
+			models_[level] = LearnedIndex();
+			if (level > 0 && max_error > 0 && sorted.size() > 1) {
+				const Comparator* ucmp = icmp->user_comparator();
+				std::vector<uint64_t> keys(sorted.size());
+				for (size_t i = 0; i < sorted.size(); i++) {
+					keys[i] = ucmp->KeyNum(sorted[i]->largest.user_key());
+				}
+				models_[level].Train(&keys[0], keys.size(), max_error);
+			}
+		}
+
+		unsigned next = config::kNumLevels;
+		for (unsigned level = config::kNumLevels; level-- > 0; ) {
+			next_level_[level] = next;
+			if (!levels_[level].empty()) {
+				next = level;
+			}
+		}
+		for (unsigned level = 1; level < config::kNumLevels; level++) {
+			if (!levels_[level].empty() && next_level_[level] < config::kNumLevels) {
+				LinkLevels(level, next_level_[level]);
+			}
+		}
+	}
+
+	void FileIndex::LinkLevels(unsigned level, unsigned next) {
+		// Both levels are sorted and disjoint, so the positions only move
+		// forward and one merge-like pass finds all of them.
+		std::vector<Entry>& entries = levels_[level];
+		const std::vector<Entry>& below = levels_[next];
+		uint32_t s = 0;
+		uint32_t l = 0;
+		for (size_t i = 0; i < entries.size(); i++) {
+			const Slice smallest = entries[i].file->smallest.Encode();
+			const Slice largest = entries[i].file->largest.Encode();
+			while (s < below.size() &&
+				icmp_->InternalKeyComparator::Compare(below[s].file->largest.Encode(), smallest) < 0) {
+				++s;
+			}
+			if (l < s) {
+				l = s;
+			}
+			while (l < below.size() &&
+				icmp_->InternalKeyComparator::Compare(below[l].file->largest.Encode(), largest) < 0) {
+				++l;
+			}
+			entries[i].next_smallest = s;
+			entries[i].next_largest = l;
+		}
+	}
+
+	int FileIndex::CompareLargest(const Entry& e, const Slice& ikey, uint64_t prefix) const {
+		if (use_prefix_) {
+			if (e.largest_prefix < prefix) return -1;
+			if (e.largest_prefix > prefix) return +1;
+		}
+		return icmp_->InternalKeyComparator::Compare(e.file->largest.Encode(), ikey);
+	}
+
+	int FileIndex::CompareSmallest(const Entry& e, const Slice& ikey, uint64_t prefix) const {
+		if (use_prefix_) {
+			if (e.smallest_prefix < prefix) return -1;
+			if (e.smallest_prefix > prefix) return +1;
+		}
+		return icmp_->InternalKeyComparator::Compare(e.file->smallest.Encode(), ikey);
+	}
+
+	bool FileIndex::Level0Overlaps(uint32_t i, const Slice& user_key, uint64_t prefix) const {
+		const Entry& e = levels_[0][i];
+		if (use_prefix_) {
+			if (prefix < e.smallest_prefix || prefix > e.largest_prefix) {
+				return false;
+			}
+			if (prefix > e.smallest_prefix && prefix < e.largest_prefix) {
+				return true;
+			}
+		}
+		const Comparator* ucmp = icmp_->user_comparator();
+		return ucmp->Compare(user_key, e.file->smallest.user_key()) >= 0 &&
+			ucmp->Compare(user_key, e.file->largest.user_key()) <= 0;
+	}
+
+	uint32_t FileIndex::FindFile(unsigned level, const Slice& ikey, uint64_t prefix,
+		Hint* hint) const {
+		assert(level > 0);
+		const std::vector<Entry>& entries = levels_[level];
+		uint32_t left = 0;
+		uint32_t right = entries.size();
+		if (hint->level == level) {
+			left = hint->left;
+			right = hint->right;
+		}
+		if (!models_[level].empty() && right - left > 2 * models_[level].max_error() + 4) {
+			uint32_t lo, hi;
+			if (PredictRange(level, ikey, prefix, &lo, &hi)) {
+				if (lo > left) left = lo;
+				if (hi < right) right = hi;
+			}
+		}
+		while (left < right) {
+			uint32_t mid = (left + right) / 2;
+			if (CompareLargest(entries[mid], ikey, prefix) < 0) {
+				// Key at "mid.largest" is < "target".  Therefore all
+				// files at or before "mid" are uninteresting.
+				left = mid + 1;
+			}
+			else {
+				right = mid;
+			}
+		}
+		const uint32_t index = right;
+
+		const unsigned next = next_level_[level];
+		hint->level = next;
+		if (next < config::kNumLevels) {
+			if (index < entries.size() && CompareSmallest(entries[index], ikey, prefix) <= 0) {
+				// ikey falls inside entries[index]
+				hint->left = entries[index].next_smallest;
+				hint->right = entries[index].next_largest;
+			}
+			else {
+				// ikey falls in the gap before entries[index]
+				hint->left = (index > 0) ? entries[index - 1].next_largest : 0;
+				hint->right = (index < entries.size())
+					? entries[index].next_smallest
+					: static_cast<uint32_t>(levels_[next].size());
+			}
+		}
+		return index;
+	}
+
+	bool FileIndex::PredictRange(unsigned level, const Slice& ikey, uint64_t prefix,
+		uint32_t* left, uint32_t* right) const {
+		const std::vector<Entry>& entries = levels_[level];
+		// With the bytewise comparator the prefix is the key's KeyNum()
+		const uint64_t num = use_prefix_ ? prefix
+			: icmp_->user_comparator()->KeyNum(ExtractUserKey(ikey));
+		uint32_t lo, hi;
+		models_[level].Predict(num, &lo, &hi);
+		if (hi > entries.size()) {
+			hi = static_cast<uint32_t>(entries.size());
+		}
+		// The answer is in [lo, hi] iff the file before the window ends
+		// before ikey and the last file in it does not.
+		if (lo > 0 && CompareLargest(entries[lo - 1], ikey, prefix) >= 0) {
+			return false;
+		}
+		if (hi < entries.size() && CompareLargest(entries[hi], ikey, prefix) < 0) {
+			return false;
+		}
+		*left = lo;
+		*right = hi;
+		return true;
+	}
+
+	bool FileIndex::BeforeFile(unsigned level, uint32_t i, const Slice& user_key,
+		uint64_t prefix) const {
+		const Entry& e = levels_[level][i];
+		if (use_prefix_) {
+			if (prefix < e.smallest_prefix) return true;
+			if (prefix > e.smallest_prefix) return false;
+		}
+		return icmp_->user_comparator()->Compare(user_key, e.file->smallest.user_key()) < 0;
+	}
+
+}  // namespace leveldb
@@ -0,0 +1,108 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// FileIndex is the point-lookup search structure of a Version.  For every
+// level it keeps the files' key boundaries in one contiguous array, so a
+// search walks a few cache lines instead of chasing FileMetaData pointers.
+//
+// Each entry carries the first eight bytes of its smallest and largest user
+// key as an integer.  With the bytewise comparator, unequal prefixes decide
+// a comparison without calling the comparator; only equal prefixes fall
+// back to the full InternalKeyComparator.
+//
+// Entries of level L >= 1 also record where their boundaries fall in the
+// next non-empty level (fractional cascading).  The position found in level
+// L narrows the binary search in the level below to the files overlapping
+// one file or one gap of level L, usually a handful of entries.
+//
+// Level 0 entries are kept newest first, the order in which Get probes
+// them.
+//
+// Optionally each level >= 1 also gets a LearnedIndex over the KeyNum() of
+// its files' largest keys.  When no narrower cascading range is known,
+// FindFile() searches the model's window after checking the files on
+// either side of it, and the whole level otherwise.
+
+#ifndef STORAGE_LEVELDB_DB_FILE_INDEX_H_
+#define STORAGE_LEVELDB_DB_FILE_INDEX_H_
+
+#include <stdint.h>
+#include <vector>
+#include "db/dbformat.h"
+#include "db/version_edit.h"
+#include "util/learned_index.h"
+
+namespace leveldb {
+
+	class FileIndex {
+	public:
+		// Carries the search range for a level from one FindFile call to the
+		// next.  Start each lookup with a default constructed hint.
+		struct Hint {
+			Hint() : level(config::kNumLevels), left(0), right(0) {}
+			unsigned level;     // Level the range applies to
+			uint32_t left;      // Answer lies in [left, right]
+			uint32_t right;
+		};
+
+		FileIndex();
+
+		// Index "files", an array of config::kNumLevels file lists sorted as
+		// in Version::files_.  "icmp" must outlive the index.  A positive
+		// "max_error" also trains the per-level learned indexes.
+		void Build(const InternalKeyComparator* icmp,
+			const std::vector<FileMetaData*>* files,
+			int max_error = 0);
+
+		// Key prefix used by the other methods; compute it once per lookup.
+		uint64_t KeyPrefix(const Slice& user_key) const;
+
+		size_t NumFiles(unsigned level) const { return levels_[level].size(); }
+		FileMetaData* File(unsigned level, uint32_t i) const {
+			return levels_[level][i].file;
+		}
+
+		// For level 0: true iff the i-th newest file may contain user_key.
+		bool Level0Overlaps(uint32_t i, const Slice& user_key, uint64_t prefix) const;
+
+		// For level >= 1: return the smallest index i such that file i's
+		// largest key >= ikey, or NumFiles(level) if there is none, and set
+		// *hint up for the next non-empty level.  Same result as the global
+		// FindFile() over the level's files.
+		uint32_t FindFile(unsigned level, const Slice& ikey, uint64_t prefix, Hint* hint) const;
+
+		// True iff user_key sorts before the smallest user key of file i.
+		bool BeforeFile(unsigned level, uint32_t i, const Slice& user_key, uint64_t prefix) const;
+
+	private:
+		struct Entry {
+			uint64_t smallest_prefix;
+			uint64_t largest_prefix;
+			FileMetaData* file;
+			// First index in the next non-empty level whose largest key is
+			// >= this file's smallest (resp. largest) key
+			uint32_t next_smallest;
+			uint32_t next_largest;
+		};
+
+		int CompareLargest(const Entry& e, const Slice& ikey, uint64_t prefix) const;
+		int CompareSmallest(const Entry& e, const Slice& ikey, uint64_t prefix) const;
+		void LinkLevels(unsigned level, unsigned next);
+		bool PredictRange(unsigned level, const Slice& ikey, uint64_t prefix,
+			uint32_t* left, uint32_t* right) const;
+
+		const InternalKeyComparator* icmp_;
+		bool use_prefix_;   // Prefixes are only meaningful for bytewise order
+		std::vector<Entry> levels_[config::kNumLevels];
+		unsigned next_level_[config::kNumLevels];
+		LearnedIndex models_[config::kNumLevels];   // Empty if not trained
+
+		// No copying allowed
+		FileIndex(const FileIndex&);
+		void operator=(const FileIndex&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_FILE_INDEX_H_
@@ -39,6 +39,18 @@ namespace leveldb {
 		return MakeFileName(name, number, "ldb");
 	}
 
+	std::string BlobFileName(const std::string& name, uint64_t number) {
+		assert(number > 0);
+		return MakeFileName(name, number, "blob");
+	}
+
+	std::string ColumnFamilyDirName(const std::string& dbname, uint32_t id) {
+		assert(id > 0);
+		char buf[100];
+		snprintf(buf, sizeof(buf), "/cf-%06u", static_cast<unsigned>(id));
+		return dbname + buf;
+	}
+
 	std::string DescriptorFileName(const std::string& dbname, uint64_t number) {
 		assert(number > 0);
 		char buf[100];
@@ -76,7 +88,8 @@ namespace leveldb {
 	//    dbname/LOG
 	//    dbname/LOG.old
 	//    dbname/MANIFEST-[0-9]+
-	//    dbname/[0-9]+.(log|sst|ldb)
+	//    dbname/[0-9]+.(log|sst|ldb|blob)
+	//    dbname/cf-[0-9]+
 	bool ParseFileName(const std::string& fname,
 		uint64_t* number,
 		FileType* type) {
@@ -105,6 +118,18 @@ namespace leveldb {
 			*type = kDescriptorFile;
 			*number = num;
 		}
+		else if (rest.starts_with("cf-")) {
+			rest.remove_prefix(strlen("cf-"));
+			uint64_t num;
+			if (!ConsumeDecimalNumber(&rest, &num)) {
+				return false;
+			}
+			if (!rest.empty()) {
+				return false;
+			}
+			*type = kColumnFamilyDir;
+			*number = num;
+		}
 		else {
 			// Avoid strtoull() to keep filename format independent of the
 			// current locale
@@ -122,6 +147,9 @@ namespace leveldb {
 			else if (suffix == Slice(".dbtmp")) {
 				*type = kTempFile;
 			}
+			else if (suffix == Slice(".blob")) {
+				*type = kBlobFile;
+			}
 			else {
 				return false;
 			}
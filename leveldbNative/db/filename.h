@@ -24,7 +24,9 @@ namespace leveldb {
 		kDescriptorFile,
 		kCurrentFile,
 		kTempFile,
-		kInfoLogFile  // Either the current one, or an old one
+		kInfoLogFile,  // Either the current one, or an old one
+		kBlobFile,
+		kColumnFamilyDir
 	};
 
 	// Return the name of the log file with the specified number
@@ -42,6 +44,15 @@ namespace leveldb {
 	// "dbname".
 	extern std::string LDBTableFileName(const std::string& dbname, uint64_t number);
 
+	// Return the name of the blob file with the specified number in the
+	// db named by "dbname".  The result will be prefixed with "dbname".
+	extern std::string BlobFileName(const std::string& dbname, uint64_t number);
+
+	// Return the name of the directory holding the files of the column
+	// family with the specified id, other than the default one, of the db
+	// named by "dbname".  The result will be prefixed with "dbname".
+	extern std::string ColumnFamilyDirName(const std::string& dbname, uint32_t id);
+
 	// Return the name of the descriptor file for the db named by
 	// "dbname" and the specified incarnation number.  The result will be
 	// prefixed with "dbname".
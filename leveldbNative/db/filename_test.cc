@@ -47,6 +47,8 @@ namespace leveldb {
 			{ "0.log",              0,     kLogFile },
 			{ "0.sst",              0,     kTableFile },
 			{ "0.ldb",              0,     kTableFile },
+			{ "7.blob",             7,     kBlobFile },
+			{ "cf-000003",          3,     kColumnFamilyDir },
 			{ "CURRENT",            0,     kCurrentFile },
 			{ "LOCK",               0,     kDBLockFile },
 			{ "MANIFEST-2",         2,     kDescriptorFile },
@@ -85,7 +87,11 @@ namespace leveldb {
 			"184467440737095516150.log",
 			"100",
 			"100.",
-			"100.lop"
+			"100.lop",
+			"100.blobx",
+			"cf-",
+			"cf-3x",
+			"xcf-3"
 		};
 		for (int i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
 			std::string f = errors[i];
@@ -122,6 +128,18 @@ namespace leveldb {
 		ASSERT_EQ(200, number);
 		ASSERT_EQ(kTableFile, type);
 
+		fname = BlobFileName("bar", 201);
+		ASSERT_EQ("bar/", std::string(fname.data(), 4));
+		ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+		ASSERT_EQ(201, number);
+		ASSERT_EQ(kBlobFile, type);
+
+		fname = ColumnFamilyDirName("bar", 4);
+		ASSERT_EQ("bar/", std::string(fname.data(), 4));
+		ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+		ASSERT_EQ(4, number);
+		ASSERT_EQ(kColumnFamilyDir, type);
+
 		fname = DescriptorFileName("bar", 100);
 		ASSERT_EQ("bar/", std::string(fname.data(), 4));
 		ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
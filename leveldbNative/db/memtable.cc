@@ -25,6 +25,7 @@ namespace leveldb {
 		: comparator_(cmp),
 		extractor_(cmp),
 		refs_(0),
+		num_entries_(0),
 		arena_(),
 		table_(comparator_, extractor_, &arena_) {
 	}
@@ -119,9 +120,10 @@ namespace leveldb {
 		memcpy(p, value.data(), val_size);
 		assert(static_cast<size_t>((p + val_size) - buf) == encoded_len);
 		table_.Insert(buf);
+		atomic::increment_64_nobarrier(&num_entries_, 1);
 	}
 
-	bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+	bool MemTable::Get(const LookupKey& key, std::string* value, Status* s, uint64_t now) {
 		Slice memkey = key.memtable_key();
 		Table::Iterator iter(&table_);
 		iter.Seek(memkey.data());
@@ -149,6 +151,17 @@ namespace leveldb {
 					value->assign(v.data(), v.size());
 					return true;
 				}
+				case kTypeValueWithExpiry: {
+					Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+					if (IsExpired(v, now)) {
+						*s = Status::NotFound(Slice());
+					}
+					else {
+						v = StripExpiry(v);
+						value->assign(v.data(), v.size());
+					}
+					return true;
+				}
 				case kTypeDeletion:
 					*s = Status::NotFound(Slice());
 					return true;
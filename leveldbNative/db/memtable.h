@@ -35,6 +35,10 @@ namespace leveldb {
 			}
 		}
 
+		// Return true if anyone but its first owner holds a reference, such
+		// as a writer that has yet to add its entries.
+		bool IsShared() const { return atomic::load_64_nobarrier(&refs_) > 1; }
+
 		// Returns an estimate of the number of bytes of data in use by this
 		// data structure.
 		//
@@ -42,6 +46,10 @@ namespace leveldb {
 		// operations on the same MemTable.
 		size_t ApproximateMemoryUsage();
 
+		// Return the number of entries added so far.  Safe to call
+		// concurrently with Add().
+		uint64_t NumEntries() const { return atomic::load_64_nobarrier(&num_entries_); }
+
 		// Return an iterator that yields the contents of the memtable.
 		//
 		// The caller must ensure that the underlying MemTable remains live
@@ -58,10 +66,11 @@ namespace leveldb {
 			const Slice& value);
 
 		// If memtable contains a value for key, store it in *value and return true.
-		// If memtable contains a deletion for key, store a NotFound() error
-		// in *status and return true.
+		// If memtable contains a deletion for key, or a value that expired
+		// at or before "now" (seconds since the epoch), store a NotFound()
+		// error in *status and return true.
 		// Else, return false.
-		bool Get(const LookupKey& key, std::string* value, Status* s);
+		bool Get(const LookupKey& key, std::string* value, Status* s, uint64_t now);
 
 	private:
 		~MemTable();  // Private since only Unref() should be used to delete it
@@ -84,6 +93,7 @@ namespace leveldb {
 		KeyComparator comparator_;
 		KeyExtractor extractor_;
 		uint64_t refs_;
+		uint64_t num_entries_;
 		Arena arena_;
 		Table table_;
 
@@ -0,0 +1,730 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Microbenchmarks for the data structures underneath the DB.  Unlike
+// db_bench, nothing here touches the file system, so the numbers reflect
+// only the cost of the code under test.
+//
+// Every benchmark is run once with a single thread and once with
+// --threads threads.  Each configuration gets one discarded warm-up run
+// followed by --repeats measured runs; the median is reported together
+// with the fastest run and the spread between fastest and slowest, so
+// that noisy results are easy to spot.
+
+#define __STDC_LIMIT_MACROS
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "port/port_win.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "db/log_writer.h"
+#include "db/skiplist.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "port/port.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/filter_block.h"
+#include "table/format.h"
+#include "table/merger.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
+
+// Comma-separated list of benchmarks to run; all of them by default:
+//      skiplist_insert  -- SkipList::Insert of random keys into one list
+//      skiplist_seek    -- SkipList::Iterator::Seek in a 100K entry list
+//      arena_allocate   -- Arena::Allocate of 1..128 bytes
+//      block_build      -- BlockBuilder::Add, finishing every block_size bytes
+//      block_seek       -- Block::Iter::Seek in a 1K entry block
+//      merging_iter     -- MergingIterator::Next over --merge_children blocks
+//      filter_match     -- FilterBlockReader::KeyMayMatch, half of them hits
+//      cache_lookup     -- Lookup and Release in the sharded LRU cache
+//      log_add_record   -- log::Writer::AddRecord of 100 bytes to a null file
+//      varint32         -- EncodeVarint32 + GetVarint32Ptr
+//      varint64         -- EncodeVarint64 + GetVarint64Ptr
+static const char* FLAGS_benchmarks =
+	"skiplist_insert,"
+	"skiplist_seek,"
+	"arena_allocate,"
+	"block_build,"
+	"block_seek,"
+	"merging_iter,"
+	"filter_match,"
+	"cache_lookup,"
+	"log_add_record,"
+	"varint32,"
+	"varint64,"
+	;
+
+// Number of threads for the multi-threaded run of each benchmark
+static int FLAGS_threads = 4;
+
+// Operations per thread in each run
+static int FLAGS_ops = 200000;
+
+// Measured runs per configuration
+static int FLAGS_repeats = 5;
+
+// Number of children of the merging iterator
+static int FLAGS_merge_children = 8;
+
+namespace leveldb {
+
+	namespace {
+
+		// Results are folded into this so the compiler cannot drop the work.
+		volatile uint64_t sink;
+
+		// Number of precomputed probe keys; a power of two.
+		static const int kNumProbes = 4096;
+
+		static std::string MakeKey(int k) {
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%016d", k);
+			return std::string(buf, 16);
+		}
+
+		// Build a block holding "keys" (which must be sorted) with 100 byte values.
+		static Block* BuildBlock(const Options& options, const std::vector<std::string>& keys) {
+			BlockBuilder builder(&options);
+			const std::string value(100, 'v');
+			for (size_t i = 0; i < keys.size(); i++) {
+				builder.Add(keys[i], value);
+			}
+			Slice raw = builder.Finish();
+			char* data = new char[raw.size()];
+			memcpy(data, raw.data(), raw.size());
+			BlockContents contents;
+			contents.data = Slice(data, raw.size());
+			contents.cachable = false;
+			contents.heap_allocated = true;
+			return new Block(contents);
+		}
+
+		class MicroBenchmark {
+		public:
+			MicroBenchmark() { }
+			virtual ~MicroBenchmark() { }
+
+			virtual std::string Name() const = 0;
+
+			// Prepare a run of "threads" threads doing "ops" operations each.
+			// Not timed.
+			virtual void SetUp(int /*threads*/, int /*ops*/) { }
+			virtual void TearDown() { }
+
+			// Perform "ops" operations as thread "tid".  Called concurrently.
+			virtual void Run(int tid, int ops, Random* rnd) = 0;
+
+		private:
+			// No copying allowed
+			MicroBenchmark(const MicroBenchmark&);
+			void operator=(const MicroBenchmark&);
+		};
+
+		typedef uint64_t SkipKey;
+
+		struct SkipComparator {
+			int operator()(const SkipKey& a, const SkipKey& b) const {
+				if (a < b) {
+					return -1;
+				}
+				else if (a > b) {
+					return +1;
+				}
+				else {
+					return 0;
+				}
+			}
+		};
+
+		struct SkipExtractor {
+			uint64_t operator()(const SkipKey& k) const {
+				return k;
+			}
+		};
+
+		typedef SkipList<SkipKey, SkipComparator, SkipExtractor> BenchSkipList;
+
+		class SkipListInsert : public MicroBenchmark {
+		public:
+			SkipListInsert() : arena_(NULL), list_(NULL) { }
+			virtual std::string Name() const { return "skiplist_insert"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				arena_ = new Arena;
+				list_ = new BenchSkipList(SkipComparator(), SkipExtractor(), arena_);
+			}
+			virtual void TearDown() {
+				delete list_;
+				delete arena_;
+			}
+			virtual void Run(int tid, int ops, Random* rnd) {
+				// The low bits keep the keys unique across threads.
+				const uint64_t base = static_cast<uint64_t>(tid) * ops;
+				for (int i = 0; i < ops; i++) {
+					list_->Insert((static_cast<uint64_t>(rnd->Next()) << 32) | (base + i));
+				}
+			}
+
+		private:
+			Arena* arena_;
+			BenchSkipList* list_;
+		};
+
+		class SkipListSeek : public MicroBenchmark {
+		public:
+			SkipListSeek() : arena_(NULL), list_(NULL) { }
+			virtual std::string Name() const { return "skiplist_seek"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				arena_ = new Arena;
+				list_ = new BenchSkipList(SkipComparator(), SkipExtractor(), arena_);
+				for (uint64_t i = 0; i < kEntries; i++) {
+					list_->Insert(i * 2);
+				}
+			}
+			virtual void TearDown() {
+				delete list_;
+				delete arena_;
+			}
+			virtual void Run(int /*tid*/, int ops, Random* rnd) {
+				BenchSkipList::Iterator iter(list_);
+				uint64_t sum = 0;
+				for (int i = 0; i < ops; i++) {
+					iter.Seek(rnd->Uniform(2 * kEntries));
+					if (iter.Valid()) {
+						sum += iter.key();
+					}
+				}
+				sink += sum;
+			}
+
+		private:
+			static const int kEntries = 100000;
+			Arena* arena_;
+			BenchSkipList* list_;
+		};
+
+		class ArenaAllocate : public MicroBenchmark {
+		public:
+			ArenaAllocate() : arena_(NULL) { }
+			virtual std::string Name() const { return "arena_allocate"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				arena_ = new Arena;
+			}
+			virtual void TearDown() {
+				delete arena_;
+			}
+			virtual void Run(int /*tid*/, int ops, Random* /*rnd*/) {
+				for (int i = 0; i < ops; i++) {
+					char* p = arena_->Allocate((i & 127) + 1);
+					p[0] = static_cast<char>(i);
+				}
+			}
+
+		private:
+			Arena* arena_;
+		};
+
+		class BlockBuild : public MicroBenchmark {
+		public:
+			BlockBuild() : value_(100, 'v') { }
+			virtual std::string Name() const { return "block_build"; }
+
+			virtual void SetUp(int /*threads*/, int ops) {
+				if (keys_.size() != static_cast<size_t>(ops)) {
+					keys_.clear();
+					for (int i = 0; i < ops; i++) {
+						keys_.push_back(MakeKey(i));
+					}
+				}
+			}
+			virtual void Run(int /*tid*/, int ops, Random* /*rnd*/) {
+				BlockBuilder builder(&options_);
+				uint64_t bytes = 0;
+				for (int i = 0; i < ops; i++) {
+					builder.Add(keys_[i], value_);
+					if (builder.CurrentSizeEstimate() >= options_.block_size) {
+						bytes += builder.Finish().size();
+						builder.Reset();
+					}
+				}
+				sink += bytes;
+			}
+
+		private:
+			Options options_;
+			const std::string value_;
+			std::vector<std::string> keys_;
+		};
+
+		class BlockSeek : public MicroBenchmark {
+		public:
+			BlockSeek() : block_(NULL) { }
+			virtual std::string Name() const { return "block_seek"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				std::vector<std::string> keys;
+				for (int i = 0; i < kEntries; i++) {
+					keys.push_back(MakeKey(i * 2));
+				}
+				block_ = BuildBlock(Options(), keys);
+				Random rnd(301);
+				probes_.clear();
+				for (int i = 0; i < kNumProbes; i++) {
+					probes_.push_back(MakeKey(rnd.Uniform(2 * kEntries)));
+				}
+			}
+			virtual void TearDown() {
+				delete block_;
+			}
+			virtual void Run(int tid, int ops, Random* /*rnd*/) {
+				Iterator* iter = block_->NewIterator(BytewiseComparator());
+				uint64_t sum = 0;
+				for (int i = 0; i < ops; i++) {
+					iter->Seek(probes_[(i + tid * 997) & (kNumProbes - 1)]);
+					if (iter->Valid()) {
+						sum += iter->value().size();
+					}
+				}
+				delete iter;
+				sink += sum;
+			}
+
+		private:
+			static const int kEntries = 1024;
+			Block* block_;
+			std::vector<std::string> probes_;
+		};
+
+		class MergingIter : public MicroBenchmark {
+		public:
+			explicit MergingIter(int children) : children_(std::max(1, children)) { }
+			virtual std::string Name() const {
+				char buf[50];
+				snprintf(buf, sizeof(buf), "merging_iter(%d)", children_);
+				return buf;
+			}
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				// Interleave the keys so that every Next() moves to another child.
+				Options options;
+				for (int c = 0; c < children_; c++) {
+					std::vector<std::string> keys;
+					for (int k = c; k < kEntries; k += children_) {
+						keys.push_back(MakeKey(k));
+					}
+					blocks_.push_back(BuildBlock(options, keys));
+				}
+			}
+			virtual void TearDown() {
+				for (size_t i = 0; i < blocks_.size(); i++) {
+					delete blocks_[i];
+				}
+				blocks_.clear();
+			}
+			virtual void Run(int /*tid*/, int ops, Random* /*rnd*/) {
+				std::vector<Iterator*> list;
+				for (size_t i = 0; i < blocks_.size(); i++) {
+					list.push_back(blocks_[i]->NewIterator(BytewiseComparator()));
+				}
+				Iterator* iter = NewMergingIterator(BytewiseComparator(), &list[0],
+					static_cast<int>(list.size()));
+				uint64_t sum = 0;
+				iter->SeekToFirst();
+				for (int i = 0; i < ops; i++) {
+					if (!iter->Valid()) {
+						iter->SeekToFirst();
+					}
+					sum += iter->key().size();
+					iter->Next();
+				}
+				delete iter;
+				sink += sum;
+			}
+
+		private:
+			static const int kEntries = 100000;
+			const int children_;
+			std::vector<Block*> blocks_;
+		};
+
+		class FilterMatch : public MicroBenchmark {
+		public:
+			FilterMatch() : policy_(NewBloomFilterPolicy(10)), reader_(NULL) { }
+			virtual ~FilterMatch() { delete policy_; }
+			virtual std::string Name() const { return "filter_match"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				FilterBlockBuilder builder(policy_);
+				for (int b = 0; b < kBlocks; b++) {
+					builder.StartBlock(b * kBlockSize);
+					for (int k = 0; k < kKeysPerBlock; k++) {
+						builder.AddKey(MakeKey(b * kKeysPerBlock + k));
+					}
+				}
+				filter_ = builder.Finish().ToString();
+				reader_ = new FilterBlockReader(policy_, filter_);
+
+				// Every other probe is for a key that was never added.
+				Random rnd(301);
+				probes_.clear();
+				for (int i = 0; i < kNumProbes; i++) {
+					const int k = rnd.Uniform(kBlocks * kKeysPerBlock);
+					probes_.push_back(MakeKey((i & 1) ? k + kBlocks * kKeysPerBlock : k));
+				}
+			}
+			virtual void TearDown() {
+				delete reader_;
+			}
+			virtual void Run(int tid, int ops, Random* /*rnd*/) {
+				uint64_t matches = 0;
+				for (int i = 0; i < ops; i++) {
+					const int p = (i + tid * 997) & (kNumProbes - 1);
+					const uint64_t offset = (p % kBlocks) * kBlockSize;
+					if (reader_->KeyMayMatch(offset, probes_[p])) {
+						matches++;
+					}
+				}
+				sink += matches;
+			}
+
+		private:
+			static const int kBlocks = 100;
+			static const int kKeysPerBlock = 100;
+			static const int kBlockSize = 4096;
+			const FilterPolicy* policy_;
+			FilterBlockReader* reader_;
+			std::string filter_;
+			std::vector<std::string> probes_;
+		};
+
+		static void DeleteNothing(const Slice& /*key*/, void* /*value*/) {
+		}
+
+		class CacheLookup : public MicroBenchmark {
+		public:
+			CacheLookup() : cache_(NULL) { }
+			virtual std::string Name() const { return "cache_lookup"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				cache_ = NewLRUCache(2 * kEntries);
+				for (int i = 0; i < kEntries; i++) {
+					cache_->Release(cache_->Insert(MakeKey(i), NULL, 1, &DeleteNothing));
+				}
+				Random rnd(301);
+				probes_.clear();
+				for (int i = 0; i < kNumProbes; i++) {
+					probes_.push_back(MakeKey(rnd.Uniform(kEntries)));
+				}
+			}
+			virtual void TearDown() {
+				delete cache_;
+			}
+			virtual void Run(int tid, int ops, Random* /*rnd*/) {
+				uint64_t hits = 0;
+				for (int i = 0; i < ops; i++) {
+					Cache::Handle* h = cache_->Lookup(probes_[(i + tid * 997) & (kNumProbes - 1)]);
+					if (h != NULL) {
+						hits++;
+						cache_->Release(h);
+					}
+				}
+				sink += hits;
+			}
+
+		private:
+			static const int kEntries = 10000;
+			Cache* cache_;
+			std::vector<std::string> probes_;
+		};
+
+		// Discards everything written to it.
+		class NullFile : public ConcurrentWritableFile {
+		public:
+			virtual Status WriteAt(uint64_t /*offset*/, const Slice& /*data*/) { return Status::OK(); }
+			virtual Status Append(const Slice& /*data*/) { return Status::OK(); }
+			virtual Status Close() { return Status::OK(); }
+			virtual Status Flush() { return Status::OK(); }
+			virtual Status Sync() { return Status::OK(); }
+		};
+
+		class LogAddRecord : public MicroBenchmark {
+		public:
+			LogAddRecord() : record_(100, 'r'), file_(NULL), writer_(NULL) { }
+			virtual std::string Name() const { return "log_add_record"; }
+
+			virtual void SetUp(int /*threads*/, int /*ops*/) {
+				file_ = new NullFile;
+				writer_ = new log::Writer(file_);
+			}
+			virtual void TearDown() {
+				delete writer_;
+				delete file_;
+			}
+			virtual void Run(int /*tid*/, int ops, Random* /*rnd*/) {
+				for (int i = 0; i < ops; i++) {
+					writer_->AddRecord(record_);
+				}
+			}
+
+		private:
+			const std::string record_;
+			NullFile* file_;
+			log::Writer* writer_;
+		};
+
+		// Values of every encoded length, so the branches are exercised evenly.
+		class Varint : public MicroBenchmark {
+		public:
+			explicit Varint(bool is64) : is64_(is64) {
+				Random rnd(301);
+				for (int i = 0; i < kNumProbes; i++) {
+					const int bits = rnd.Uniform(is64 ? 64 : 32) + 1;
+					uint64_t v = (static_cast<uint64_t>(rnd.Next()) << 33) ^ rnd.Next();
+					values_.push_back(bits == 64 ? v : v & ((1ull << bits) - 1));
+				}
+			}
+			virtual std::string Name() const { return is64_ ? "varint64" : "varint32"; }
+
+			virtual void Run(int /*tid*/, int ops, Random* /*rnd*/) {
+				char buf[10];
+				uint64_t sum = 0;
+				for (int i = 0; i < ops; i++) {
+					const uint64_t v = values_[i & (kNumProbes - 1)];
+					if (is64_) {
+						const char* limit = EncodeVarint64(buf, v);
+						uint64_t result;
+						GetVarint64Ptr(buf, limit, &result);
+						sum += result;
+					}
+					else {
+						const char* limit = EncodeVarint32(buf, static_cast<uint32_t>(v));
+						uint32_t result;
+						GetVarint32Ptr(buf, limit, &result);
+						sum += result;
+					}
+				}
+				sink += sum;
+			}
+
+		private:
+			const bool is64_;
+			std::vector<uint64_t> values_;
+		};
+
+		struct SharedState {
+			port::Mutex mu;
+			port::CondVar cv;
+			int total;
+			int num_initialized;
+			int num_done;
+			bool start;
+
+			SharedState() : cv(&mu), total(0), num_initialized(0), num_done(0), start(false) { }
+		};
+
+		struct ThreadArg {
+			MicroBenchmark* bench;
+			SharedState* shared;
+			int tid;
+			int ops;
+		};
+
+		static void ThreadBody(void* v) {
+			ThreadArg* arg = reinterpret_cast<ThreadArg*>(v);
+			SharedState* shared = arg->shared;
+			Random rnd(1000 + arg->tid);
+			{
+				MutexLock l(&shared->mu);
+				shared->num_initialized++;
+				if (shared->num_initialized >= shared->total) {
+					shared->cv.SignalAll();
+				}
+				while (!shared->start) {
+					shared->cv.Wait();
+				}
+			}
+
+			arg->bench->Run(arg->tid, arg->ops, &rnd);
+
+			{
+				MutexLock l(&shared->mu);
+				shared->num_done++;
+				if (shared->num_done >= shared->total) {
+					shared->cv.SignalAll();
+				}
+			}
+		}
+
+		// Run "bench" on "n" threads and return the elapsed wall-clock time
+		// in nanoseconds.
+		static uint64_t RunOnce(MicroBenchmark* bench, int n) {
+			Env* env = Env::Default();
+			bench->SetUp(n, FLAGS_ops);
+
+			SharedState shared;
+			shared.total = n;
+			std::vector<ThreadArg> args(n);
+			for (int i = 0; i < n; i++) {
+				args[i].bench = bench;
+				args[i].shared = &shared;
+				args[i].tid = i;
+				args[i].ops = FLAGS_ops;
+				env->StartThread(ThreadBody, &args[i]);
+			}
+
+			shared.mu.Lock();
+			while (shared.num_initialized < n) {
+				shared.cv.Wait();
+			}
+			const uint64_t start = env->NowNanos();
+			shared.start = true;
+			shared.cv.SignalAll();
+			while (shared.num_done < n) {
+				shared.cv.Wait();
+			}
+			const uint64_t elapsed = env->NowNanos() - start;
+			shared.mu.Unlock();
+
+			bench->TearDown();
+			return elapsed;
+		}
+
+		static void Measure(MicroBenchmark* bench, int n) {
+			RunOnce(bench, n);  // warm-up
+			std::vector<uint64_t> runs;
+			for (int r = 0; r < std::max(1, FLAGS_repeats); r++) {
+				runs.push_back(RunOnce(bench, n));
+			}
+			std::sort(runs.begin(), runs.end());
+
+			// Per-operation cost as seen by one thread, plus the aggregate rate.
+			const double ops = static_cast<double>(FLAGS_ops) * n;
+			const double median = static_cast<double>(runs[runs.size() / 2]);
+			const double fastest = static_cast<double>(runs.front());
+			const double spread = (runs.back() - runs.front()) * 100.0 / median;
+			fprintf(stdout, "%-18s %2d thr : %9.1f ns/op (min %9.1f, spread %5.1f%%) %9.2f Mops/s\n",
+				bench->Name().c_str(), n,
+				median * n / ops, fastest * n / ops, spread,
+				ops * 1e3 / median);
+			fflush(stdout);
+		}
+
+		static MicroBenchmark* NewBenchmark(const Slice& name) {
+			if (name == Slice("skiplist_insert")) {
+				return new SkipListInsert;
+			}
+			else if (name == Slice("skiplist_seek")) {
+				return new SkipListSeek;
+			}
+			else if (name == Slice("arena_allocate")) {
+				return new ArenaAllocate;
+			}
+			else if (name == Slice("block_build")) {
+				return new BlockBuild;
+			}
+			else if (name == Slice("block_seek")) {
+				return new BlockSeek;
+			}
+			else if (name == Slice("merging_iter")) {
+				return new MergingIter(FLAGS_merge_children);
+			}
+			else if (name == Slice("filter_match")) {
+				return new FilterMatch;
+			}
+			else if (name == Slice("cache_lookup")) {
+				return new CacheLookup;
+			}
+			else if (name == Slice("log_add_record")) {
+				return new LogAddRecord;
+			}
+			else if (name == Slice("varint32")) {
+				return new Varint(false);
+			}
+			else if (name == Slice("varint64")) {
+				return new Varint(true);
+			}
+			return NULL;
+		}
+
+		static void RunAll() {
+#ifndef NDEBUG
+			fprintf(stdout, "WARNING: Assertions are enabled; benchmarks unnecessarily slow\n");
+#endif
+			fprintf(stdout, "Ops/thread: %d, repeats: %d\n", FLAGS_ops, FLAGS_repeats);
+			fprintf(stdout, "------------------------------------------------\n");
+
+			const char* benchmarks = FLAGS_benchmarks;
+			while (benchmarks != NULL) {
+				const char* sep = strchr(benchmarks, ',');
+				Slice name;
+				if (sep == NULL) {
+					name = benchmarks;
+					benchmarks = NULL;
+				}
+				else {
+					name = Slice(benchmarks, sep - benchmarks);
+					benchmarks = sep + 1;
+				}
+				if (name.empty()) {
+					continue;
+				}
+
+				MicroBenchmark* bench = NewBenchmark(name);
+				if (bench == NULL) {
+					fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
+					continue;
+				}
+				Measure(bench, 1);
+				if (FLAGS_threads > 1) {
+					Measure(bench, FLAGS_threads);
+				}
+				delete bench;
+			}
+		}
+
+	}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		int n;
+		char junk;
+		if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
+			FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
+		}
+		else if (sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1 && n > 0) {
+			FLAGS_threads = n;
+		}
+		else if (sscanf(argv[i], "--ops=%d%c", &n, &junk) == 1 && n > 0) {
+			FLAGS_ops = n;
+		}
+		else if (sscanf(argv[i], "--repeats=%d%c", &n, &junk) == 1 && n > 0) {
+			FLAGS_repeats = n;
+		}
+		else if (sscanf(argv[i], "--merge_children=%d%c", &n, &junk) == 1 && n > 0) {
+			FLAGS_merge_children = n;
+		}
+		else {
+			fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	leveldb::RunAll();
+	return 0;
+}
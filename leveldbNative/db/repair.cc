@@ -14,18 +14,33 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file is added whole, since we do not know which of
+//        its values the tables still refer to
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
 //   (b) Sort tables by largest sequence# in the table
 //   (c) For each table: if it overlaps earlier table, place in level-0,
 //       else place in level-M.
-// Possible optimization 2:
-//   Store per-table metadata (smallest, largest, largest-seq#, ...)
-//   in the table's meta section to speed up ScanTable.
+//
+// Logs are converted and tables scanned on up to
+// options.max_file_opening_threads threads.  Tables that carry a properties
+// block with their smallest/largest key and largest sequence number are
+// not scanned at all; older tables are read end to end as before.
+//
+// Column families: the list of families is read back from whatever old
+// descriptors of the default column family can still be parsed, and any
+// cf-NNNNNN directory they do not mention is kept as a family named after
+// the directory.  Each family's directory is repaired like the top-level
+// one, the entries the shared logs hold for it are saved to tables in its
+// directory, and the new default descriptor lists the families again.
+// Every family is repaired with the options passed to RepairDB().
 
 #define __STDC_LIMIT_MACROS
 
+#include <algorithm>
+#include <map>
+#include <set>
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -39,6 +54,12 @@
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/table.h"
+#include "port/port.h"
+#include "table/format.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/parallel.h"
 
 namespace leveldb {
 
@@ -46,8 +67,15 @@ namespace leveldb {
 
 		class Repairer {
 		public:
-			Repairer(const std::string& dbname, const Options& options)
+			// "dbname" is the directory to repair: the database itself for
+			// the default column family (id 0), or the directory of another
+			// column family.
+			Repairer(const std::string& dbname, const Options& options,
+				uint32_t id = 0, const std::string& name = kDefaultColumnFamilyName)
 				: dbname_(dbname),
+				id_(id),
+				name_(name),
+				user_options_(options),
 				env_(options.env),
 				icmp_(options.comparator),
 				ipolicy_(options.filter_policy),
@@ -58,14 +86,26 @@ namespace leveldb {
 				edit_(),
 				manifests_(),
 				table_numbers_(),
+				blob_numbers_(),
 				logs_(),
 				tables_(),
-				next_file_number_(1) {
+				next_file_number_(1),
+				family_dirs_(),
+				families_(),
+				dropped_families_(),
+				mutex_(),
+				tables_scanned_(0),
+				bytes_scanned_(0),
+				bytes_total_(0),
+				last_progress_micros_(0) {
 				// TableCache can be small since we expect each table to be opened once.
 				table_cache_ = new TableCache(dbname_, &options_, 10);
 			}
 
 			~Repairer() {
+				for (size_t i = 0; i < families_.size(); i++) {
+					delete families_[i];
+				}
 				delete table_cache_;
 				if (owns_info_log_) {
 					delete options_.info_log;
@@ -77,23 +117,43 @@ namespace leveldb {
 
 			Status Run() {
 				Status status = FindFiles();
+				if (status.ok()) {
+					status = FindColumnFamilies();
+				}
 				if (status.ok()) {
 					ConvertLogFilesToTables();
-					ExtractMetaData();
-					status = WriteDescriptor();
+					std::vector<Repairer*> targets;
+					Targets(&targets);
+					// Sequence numbers are shared by all column families
+					SequenceNumber max_sequence = 0;
+					for (size_t i = 0; i < targets.size(); i++) {
+						targets[i]->ExtractMetaData();
+						max_sequence = std::max(max_sequence, targets[i]->MaxSequence());
+					}
+					// The default descriptor goes last: it names the others
+					for (size_t i = targets.size(); status.ok() && i > 0; i--) {
+						status = targets[i - 1]->WriteDescriptor(max_sequence);
+					}
 				}
 				if (status.ok()) {
+					int files = 0;
 					unsigned long long bytes = 0;
-					for (size_t i = 0; i < tables_.size(); i++) {
-						bytes += tables_[i].meta.file_size;
+					std::vector<Repairer*> targets;
+					Targets(&targets);
+					for (size_t i = 0; i < targets.size(); i++) {
+						files += static_cast<int>(targets[i]->tables_.size());
+						for (size_t j = 0; j < targets[i]->tables_.size(); j++) {
+							bytes += targets[i]->tables_[j].meta.file_size;
+						}
 					}
 					Log(options_.info_log,
 						"**** Repaired leveldb %s; "
-						"recovered %d files; %llu bytes. "
+						"recovered %d files in %d column families; %llu bytes. "
 						"Some data may have been lost. "
 						"****",
 						dbname_.c_str(),
-						static_cast<int>(tables_.size()),
+						files,
+						static_cast<int>(targets.size()),
 						bytes);
 				}
 				return status;
@@ -103,12 +163,43 @@ namespace leveldb {
 			Repairer(const Repairer&);
 			Repairer& operator = (const Repairer&);
 			struct TableInfo {
-				TableInfo() : meta(), max_sequence() {}
+				TableInfo() : meta(), max_sequence(), keep() {}
 				FileMetaData meta;
 				SequenceNumber max_sequence;
+				bool keep;    // False if the table was dropped
+			};
+
+			// Per-log result of ConvertLogFilesToTables, with one entry per
+			// column family in the order of Targets()
+			struct LogInfo {
+				LogInfo() : table_numbers(), table_sizes() {}
+				std::vector<uint64_t> table_numbers;    // Reserved before conversion starts
+				std::vector<uint64_t> table_sizes;      // Zero if no table was produced
+			};
+
+			struct LogReporter : public log::Reader::Reporter {
+				LogReporter()
+					: info_log(),
+					fname() {
+				}
+				Logger* info_log;
+				std::string fname;
+				virtual void Corruption(size_t bytes, const Status& s) {
+					// We print error messages for corruption, but continue repairing.
+					Log(info_log, "%s: dropping %d bytes; %s",
+						fname.c_str(),
+						static_cast<int>(bytes),
+						s.ToString().c_str());
+				}
+			private:
+				LogReporter(const LogReporter&);
+				LogReporter& operator = (const LogReporter&);
 			};
 
 			std::string const dbname_;
+			uint32_t const id_;
+			std::string const name_;
+			Options const user_options_;
 			Env* const env_;
 			InternalKeyComparator const icmp_;
 			InternalFilterPolicy const ipolicy_;
@@ -120,17 +211,68 @@ namespace leveldb {
 
 			std::vector<std::string> manifests_;
 			std::vector<uint64_t> table_numbers_;
+			std::vector<uint64_t> blob_numbers_;
 			std::vector<uint64_t> logs_;
 			std::vector<TableInfo> tables_;
 			uint64_t next_file_number_;
 
+			// Default column family only: the ids of the cf-NNNNNN
+			// directories found, the repairers of the other column families,
+			// and the ids of those that were dropped.
+			std::vector<uint32_t> family_dirs_;
+			std::vector<Repairer*> families_;
+			std::set<uint32_t> dropped_families_;
+
+			// Guards next_file_number_ and the progress counters once the
+			// worker threads are running.
+			port::Mutex mutex_;
+			int tables_scanned_;
+			uint64_t bytes_scanned_;
+			uint64_t bytes_total_;
+			uint64_t last_progress_micros_;
+
+			int Threads() const {
+				return options_.max_file_opening_threads < 1 ? 1 : options_.max_file_opening_threads;
+			}
+
+			uint64_t NewFileNumber() {
+				MutexLock l(&mutex_);
+				return next_file_number_++;
+			}
+
+			// This repairer followed by those of the other column families
+			void Targets(std::vector<Repairer*>* targets) {
+				targets->push_back(this);
+				targets->insert(targets->end(), families_.begin(), families_.end());
+			}
+
+			SequenceNumber MaxSequence() const {
+				SequenceNumber max_sequence = 0;
+				for (size_t i = 0; i < tables_.size(); i++) {
+					if (max_sequence < tables_[i].max_sequence) {
+						max_sequence = tables_[i].max_sequence;
+					}
+				}
+				return max_sequence;
+			}
+
 			Status FindFiles() {
 				std::vector<std::string> filenames;
 				Status status = env_->GetChildren(dbname_, &filenames);
-				if (!status.ok()) {
+				if (id_ != 0) {
+					// A column family may not have got its directory or any
+					// file yet; the logs can still hold entries for it.
+					if (!status.ok()) {
+						status = env_->CreateDir(dbname_);
+					}
+					if (!status.ok()) {
+						return status;
+					}
+				}
+				else if (!status.ok()) {
 					return status;
 				}
-				if (filenames.empty()) {
+				else if (filenames.empty()) {
 					return Status::IOError(dbname_, "repair found no files");
 				}
 
@@ -141,6 +283,11 @@ namespace leveldb {
 						if (type == kDescriptorFile) {
 							manifests_.push_back(filenames[i]);
 						}
+						else if (type == kColumnFamilyDir) {
+							if (id_ == 0) {
+								family_dirs_.push_back(static_cast<uint32_t>(number));
+							}
+						}
 						else {
 							if (number + 1 > next_file_number_) {
 								next_file_number_ = number + 1;
@@ -151,6 +298,9 @@ namespace leveldb {
 							else if (type == kTableFile) {
 								table_numbers_.push_back(number);
 							}
+							else if (type == kBlobFile) {
+								blob_numbers_.push_back(number);
+							}
 							else {
 								// Ignore other files
 							}
@@ -160,41 +310,132 @@ namespace leveldb {
 				return status;
 			}
 
-			void ConvertLogFilesToTables() {
-				for (size_t i = 0; i < logs_.size(); i++) {
-					std::string logname = LogFileName(dbname_, logs_[i]);
-					Status status = ConvertLogToTable(logs_[i]);
-					if (!status.ok()) {
-						Log(options_.info_log, "Log #%llu: ignoring conversion error: %s",
-							(unsigned long long) logs_[i],
-							status.ToString().c_str());
+			// Apply the column family records of the default column family's
+			// old descriptors, oldest first, to *names and dropped_families_.
+			// Records that cannot be read are skipped.
+			void ReadColumnFamilies(std::map<uint32_t, std::string>* names) {
+				std::vector<std::pair<uint64_t, std::string> > manifests;
+				uint64_t number;
+				FileType type;
+				for (size_t i = 0; i < manifests_.size(); i++) {
+					if (ParseFileName(manifests_[i], &number, &type)) {
+						manifests.push_back(std::make_pair(number, manifests_[i]));
 					}
-					ArchiveFile(logname);
+				}
+				std::sort(manifests.begin(), manifests.end());
+				for (size_t i = 0; i < manifests.size(); i++) {
+					const std::string fname = dbname_ + "/" + manifests[i].second;
+					SequentialFile* file;
+					if (!env_->NewSequentialFile(fname, &file).ok()) {
+						continue;
+					}
+					LogReporter reporter;
+					reporter.info_log = options_.info_log;
+					reporter.fname = fname;
+					log::Reader reader(file, &reporter, true/*checksum*/,
+						0/*initial_offset*/);
+					Slice record;
+					std::string scratch;
+					while (reader.ReadRecord(&record, &scratch)) {
+						VersionEdit edit;
+						if (!edit.DecodeFrom(record).ok()) {
+							continue;
+						}
+						const std::vector<std::pair<uint32_t, std::string> >& added =
+							edit.NewColumnFamilies();
+						for (size_t j = 0; j < added.size(); j++) {
+							(*names)[added[j].first] = added[j].second;
+						}
+						const std::vector<uint32_t>& dropped = edit.DroppedColumnFamilies();
+						for (size_t j = 0; j < dropped.size(); j++) {
+							names->erase(dropped[j]);
+							dropped_families_.insert(dropped[j]);
+						}
+					}
+					delete file;
 				}
 			}
 
-			Status ConvertLogToTable(uint64_t log) {
-				struct LogReporter : public log::Reader::Reporter {
-					LogReporter()
-						: env(),
-						info_log(),
-						lognum() {
-					}
-					Env* env;
-					Logger* info_log;
-					uint64_t lognum;
-					virtual void Corruption(size_t bytes, const Status& s) {
-						// We print error messages for corruption, but continue repairing.
-						Log(info_log, "Log #%llu: dropping %d bytes; %s",
-							(unsigned long long) lognum,
-							static_cast<int>(bytes),
-							s.ToString().c_str());
+			// Set up a repairer for every column family other than the
+			// default one and find its files.
+			Status FindColumnFamilies() {
+				std::map<uint32_t, std::string> names;
+				ReadColumnFamilies(&names);
+				for (size_t i = 0; i < family_dirs_.size(); i++) {
+					const uint32_t id = family_dirs_[i];
+					if (names.count(id) == 0 && dropped_families_.count(id) == 0) {
+						char name[20];
+						snprintf(name, sizeof(name), "cf-%06u", static_cast<unsigned>(id));
+						names[id] = name;
+						Log(options_.info_log, "Column family %u: no name recorded; naming it %s",
+							static_cast<unsigned>(id), name);
+					}
+				}
+
+				Options family_options = user_options_;
+				family_options.info_log = options_.info_log;
+				family_options.block_cache = options_.block_cache;
+				for (std::map<uint32_t, std::string>::const_iterator it = names.begin();
+					it != names.end();
+					++it) {
+					Repairer* family = new Repairer(ColumnFamilyDirName(dbname_, it->first),
+						family_options, it->first, it->second);
+					families_.push_back(family);
+					Status s = family->FindFiles();
+					if (!s.ok()) {
+						return s;
+					}
+				}
+				return Status::OK();
+			}
+
+			struct ConvertLogsArg {
+				Repairer* repairer;
+				std::vector<LogInfo>* infos;
+			};
+
+			static void ConvertLogWork(void* arg, int i) {
+				ConvertLogsArg* c = reinterpret_cast<ConvertLogsArg*>(arg);
+				Repairer* r = c->repairer;
+				uint64_t log = r->logs_[i];
+				std::string logname = LogFileName(r->dbname_, log);
+				Status status = r->ConvertLogToTable(log, &(*c->infos)[i]);
+				if (!status.ok()) {
+					Log(r->options_.info_log, "Log #%llu: ignoring conversion error: %s",
+						(unsigned long long) log,
+						status.ToString().c_str());
+				}
+				r->ArchiveFile(logname);
+			}
+
+			void ConvertLogFilesToTables() {
+				// Table numbers are handed out in log order up front so the
+				// result does not depend on which thread finishes first.
+				std::vector<Repairer*> targets;
+				Targets(&targets);
+				std::sort(logs_.begin(), logs_.end());
+				std::vector<LogInfo> infos(logs_.size());
+				for (size_t i = 0; i < logs_.size(); i++) {
+					for (size_t j = 0; j < targets.size(); j++) {
+						infos[i].table_numbers.push_back(targets[j]->next_file_number_++);
+						infos[i].table_sizes.push_back(0);
 					}
-				private:
-					LogReporter(const LogReporter&);
-					LogReporter& operator = (const LogReporter&);
-				};
+				}
+				ConvertLogsArg arg;
+				arg.repairer = this;
+				arg.infos = &infos;
+				ParallelFor(env_, Threads(), static_cast<int>(logs_.size()),
+					&ConvertLogWork, &arg);
+				for (size_t i = 0; i < infos.size(); i++) {
+					for (size_t j = 0; j < targets.size(); j++) {
+						if (infos[i].table_sizes[j] > 0) {
+							targets[j]->table_numbers_.push_back(infos[i].table_numbers[j]);
+						}
+					}
+				}
+			}
 
+			Status ConvertLogToTable(uint64_t log, LogInfo* info) {
 				// Open the log file
 				std::string logname = LogFileName(dbname_, log);
 				SequentialFile* lfile;
@@ -205,9 +446,8 @@ namespace leveldb {
 
 				// Create the log reader.
 				LogReporter reporter;
-				reporter.env = env_;
 				reporter.info_log = options_.info_log;
-				reporter.lognum = log;
+				reporter.fname = logname;
 				// We intentially make log::Reader do checksumming so that
 				// corruptions cause entire commits to be skipped instead of
 				// propagating bad information (like overly large sequence
@@ -215,12 +455,19 @@ namespace leveldb {
 				log::Reader reader(lfile, &reporter, false/*do not checksum*/,
 					0/*initial_offset*/);
 
-				// Read all the records and add to a memtable
+				// Read all the records and add them to a memtable per column
+				// family.  Entries of dropped column families are skipped.
+				std::vector<Repairer*> targets;
+				Targets(&targets);
+				ColumnFamilyMemTables mems;
+				for (size_t i = 0; i < targets.size(); i++) {
+					MemTable* mem = new MemTable(targets[i]->icmp_);
+					mem->Ref();
+					mems.push_back(std::make_pair(targets[i]->id_, mem));
+				}
 				std::string scratch;
 				Slice record;
 				WriteBatch batch;
-				MemTable* mem = new MemTable(icmp_);
-				mem->Ref();
 				int counter = 0;
 				while (reader.ReadRecord(&record, &scratch)) {
 					if (record.size() < 12) {
@@ -229,7 +476,7 @@ namespace leveldb {
 						continue;
 					}
 					WriteBatchInternal::SetContents(&batch, record);
-					status = WriteBatchInternal::InsertInto(&batch, mem);
+					status = WriteBatchInternal::InsertInto(&batch, mems);
 					if (status.ok()) {
 						counter += WriteBatchInternal::Count(&batch);
 					}
@@ -244,73 +491,185 @@ namespace leveldb {
 
 				// Do not record a version edit for this conversion to a Table
 				// since ExtractMetaData() will also generate edits.
-				FileMetaData meta;
-				meta.number = next_file_number_++;
-				Iterator* iter = mem->NewIterator();
-				status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
-				delete iter;
-				mem->Unref();
-				mem = NULL;
-				if (status.ok()) {
-					if (meta.file_size > 0) {
-						table_numbers_.push_back(meta.number);
+				Log(options_.info_log, "Log #%llu: %d ops",
+					(unsigned long long) log,
+					counter);
+				for (size_t i = 0; i < targets.size(); i++) {
+					Repairer* t = targets[i];
+					FileMetaData meta;
+					meta.number = info->table_numbers[i];
+					Iterator* iter = mems[i].second->NewIterator();
+					Status s = BuildTable(t->dbname_, env_, t->options_, t->table_cache_, iter, &meta);
+					delete iter;
+					mems[i].second->Unref();
+					if (s.ok()) {
+						info->table_sizes[i] = meta.file_size;
+					}
+					else if (status.ok()) {
+						status = s;
+					}
+					if (meta.file_size > 0 || !s.ok()) {
+						Log(options_.info_log, "Log #%llu: column family %s saved to Table #%llu %s",
+							(unsigned long long) log,
+							t->name_.c_str(),
+							(unsigned long long) meta.number,
+							s.ToString().c_str());
 					}
 				}
-				Log(options_.info_log, "Log #%llu: %d ops saved to Table #%llu %s",
-					(unsigned long long) log,
-					counter,
-					(unsigned long long) meta.number,
-					status.ToString().c_str());
 				return status;
 			}
 
+			static void ScanTableWork(void* arg, int i) {
+				Repairer* r = reinterpret_cast<Repairer*>(arg);
+				r->ScanTable(&r->tables_[i]);
+			}
+
 			void ExtractMetaData() {
+				std::sort(table_numbers_.begin(), table_numbers_.end());
+				std::vector<TableInfo> infos(table_numbers_.size());
 				for (size_t i = 0; i < table_numbers_.size(); i++) {
-					ScanTable(table_numbers_[i]);
+					infos[i].meta.number = table_numbers_[i];
+					std::string fname;
+					if (!GetTableSize(&infos[i].meta, &fname).ok()) {
+						infos[i].meta.file_size = 0;
+					}
+					bytes_total_ += infos[i].meta.file_size;
+				}
+				tables_.swap(infos);
+				last_progress_micros_ = env_->NowMicros();
+				ParallelFor(env_, Threads(), static_cast<int>(tables_.size()),
+					&ScanTableWork, this);
+				ReportProgress(true);
+
+				// Keep only the tables that survived, in file number order
+				std::vector<TableInfo> kept;
+				for (size_t i = 0; i < tables_.size(); i++) {
+					if (tables_[i].keep) {
+						kept.push_back(tables_[i]);
+					}
 				}
+				tables_.swap(kept);
 			}
 
-			Iterator* NewTableIterator(const FileMetaData& meta) {
-				// Same as compaction iterators: if paranoid_checks are on, turn
-				// on checksum verification.
-				ReadOptions r;
-				r.verify_checksums = options_.paranoid_checks;
-				return table_cache_->NewIterator(r, meta.number, meta.file_size);
+			// Called by each scanner when it is done with a table; logs a
+			// progress line at most every ten seconds, plus a final one.
+			void TableScanned(uint64_t bytes) {
+				MutexLock l(&mutex_);
+				tables_scanned_++;
+				bytes_scanned_ += bytes;
+				ReportProgressLocked(false);
 			}
 
-			void ScanTable(uint64_t number) {
-				TableInfo t;
-				t.meta.number = number;
-				std::string fname = TableFileName(dbname_, number);
-				Status status = env_->GetFileSize(fname, &t.meta.file_size);
+			void ReportProgress(bool force) {
+				MutexLock l(&mutex_);
+				ReportProgressLocked(force);
+			}
+
+			void ReportProgressLocked(bool force) {
+				mutex_.AssertHeld();
+				const uint64_t now = env_->NowMicros();
+				if (!force && now < last_progress_micros_ + 10000000) {
+					return;
+				}
+				last_progress_micros_ = now;
+				Log(options_.info_log, "Repair: scanned %d of %d tables, %llu of %llu MB",
+					tables_scanned_,
+					static_cast<int>(tables_.size()),
+					(unsigned long long) (bytes_scanned_ >> 20),
+					(unsigned long long) (bytes_total_ >> 20));
+			}
+
+			Status GetTableSize(FileMetaData* meta, std::string* fname) {
+				*fname = TableFileName(dbname_, meta->number);
+				Status status = env_->GetFileSize(*fname, &meta->file_size);
 				if (!status.ok()) {
 					// Try alternate file name.
-					fname = LDBTableFileName(dbname_, number);
-					Status s2 = env_->GetFileSize(fname, &t.meta.file_size);
+					*fname = LDBTableFileName(dbname_, meta->number);
+					Status s2 = env_->GetFileSize(*fname, &meta->file_size);
 					if (s2.ok()) {
 						status = Status::OK();
 					}
 				}
+				return status;
+			}
+
+			Iterator* NewTableIterator(const FileMetaData& meta, Table** table) {
+				// Same as compaction iterators: if paranoid_checks are on, turn
+				// on checksum verification.
+				ReadOptions r;
+				r.verify_checksums = options_.paranoid_checks;
+				return table_cache_->NewIterator(r, meta.number, meta.file_size, table);
+			}
+
+			// Fill in *t from the table's properties block.  Returns false if
+			// the table predates the block or the block is unusable, in which
+			// case the caller falls back to a full scan.
+			bool ReadTableProperties(Table* table, TableInfo* t) {
+				std::map<std::string, std::string> props;
+				if (table == NULL || !table->ReadProperties(&props).ok()) {
+					return false;
+				}
+				std::map<std::string, std::string>::const_iterator smallest =
+					props.find(kPropertySmallestKey);
+				std::map<std::string, std::string>::const_iterator largest =
+					props.find(kPropertyLargestKey);
+				std::map<std::string, std::string>::const_iterator seq =
+					props.find(kPropertyMaxSequence);
+				if (smallest == props.end() || largest == props.end() || seq == props.end()) {
+					return false;
+				}
+				ParsedInternalKey parsed;
+				Slice input(seq->second);
+				uint64_t max_sequence;
+				if (!ParseInternalKey(smallest->second, &parsed) ||
+					!ParseInternalKey(largest->second, &parsed) ||
+					!GetVarint64(&input, &max_sequence)) {
+					return false;
+				}
+				t->meta.smallest.DecodeFrom(smallest->second);
+				t->meta.largest.DecodeFrom(largest->second);
+				t->max_sequence = max_sequence;
+				return true;
+			}
+
+			void ScanTable(TableInfo* t) {
+				const uint64_t number = t->meta.number;
+				std::string fname;
+				Status status = GetTableSize(&t->meta, &fname);
 				if (!status.ok()) {
 					ArchiveFile(TableFileName(dbname_, number));
 					ArchiveFile(LDBTableFileName(dbname_, number));
 					Log(options_.info_log, "Table #%llu: dropped: %s",
-						(unsigned long long) t.meta.number,
+						(unsigned long long) t->meta.number,
 						status.ToString().c_str());
+					TableScanned(0);
+					return;
+				}
+
+				// Unless paranoid checks ask for every block to be verified,
+				// use the metadata recorded by the writer.
+				Table* table = NULL;
+				Iterator* iter = NewTableIterator(t->meta, &table);
+				if (iter->status().ok() && !options_.paranoid_checks &&
+					ReadTableProperties(table, t)) {
+					delete iter;
+					Log(options_.info_log, "Table #%llu: metadata from properties",
+						(unsigned long long) t->meta.number);
+					t->keep = true;
+					TableScanned(t->meta.file_size);
 					return;
 				}
 
 				// Extract metadata by scanning through table.
 				int counter = 0;
-				Iterator* iter = NewTableIterator(t.meta);
 				bool empty = true;
 				ParsedInternalKey parsed;
-				t.max_sequence = 0;
+				t->max_sequence = 0;
 				for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
 					Slice key = iter->key();
 					if (!ParseInternalKey(key, &parsed)) {
 						Log(options_.info_log, "Table #%llu: unparsable key %s",
-							(unsigned long long) t.meta.number,
+							(unsigned long long) t->meta.number,
 							EscapeString(key).c_str());
 						continue;
 					}
@@ -318,11 +677,11 @@ namespace leveldb {
 					counter++;
 					if (empty) {
 						empty = false;
-						t.meta.smallest.DecodeFrom(key);
+						t->meta.smallest.DecodeFrom(key);
 					}
-					t.meta.largest.DecodeFrom(key);
-					if (parsed.sequence > t.max_sequence) {
-						t.max_sequence = parsed.sequence;
+					t->meta.largest.DecodeFrom(key);
+					if (parsed.sequence > t->max_sequence) {
+						t->max_sequence = parsed.sequence;
 					}
 				}
 				if (!iter->status().ok()) {
@@ -330,24 +689,25 @@ namespace leveldb {
 				}
 				delete iter;
 				Log(options_.info_log, "Table #%llu: %d entries %s",
-					(unsigned long long) t.meta.number,
+					(unsigned long long) t->meta.number,
 					counter,
 					status.ToString().c_str());
 
 				if (status.ok()) {
-					tables_.push_back(t);
+					t->keep = true;
 				}
 				else {
 					RepairTable(fname, t);  // RepairTable archives input file.
 				}
+				TableScanned(t->meta.file_size);
 			}
 
-			void RepairTable(const std::string& src, TableInfo t) {
+			void RepairTable(const std::string& src, TableInfo* t) {
 				// We will copy src contents to a new table and then rename the
 				// new table over the source.
 
 				// Create builder.
-				std::string copy = TableFileName(dbname_, next_file_number_++);
+				std::string copy = TableFileName(dbname_, NewFileNumber());
 				WritableFile* file;
 				Status s = env_->NewWritableFile(copy, &file);
 				if (!s.ok()) {
@@ -356,23 +716,26 @@ namespace leveldb {
 				TableBuilder* builder = new TableBuilder(options_, file);
 
 				// Copy data.
-				Iterator* iter = NewTableIterator(t.meta);
+				Iterator* iter = NewTableIterator(t->meta, NULL);
 				int counter = 0;
 				for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
 					builder->Add(iter->key(), iter->value());
 					counter++;
 				}
 				delete iter;
-				table_cache_->Evict(t.meta.number);
+				table_cache_->Evict(t->meta.number);
 
 				ArchiveFile(src);
 				if (counter == 0) {
 					builder->Abandon();  // Nothing to save
 				}
 				else {
+					std::string encoded;
+					PutVarint64(&encoded, t->max_sequence);
+					builder->AddProperty(kPropertyMaxSequence, encoded);
 					s = builder->Finish();
 					if (s.ok()) {
-						t.meta.file_size = builder->FileSize();
+						t->meta.file_size = builder->FileSize();
 					}
 				}
 				delete builder;
@@ -385,12 +748,12 @@ namespace leveldb {
 				file = NULL;
 
 				if (counter > 0 && s.ok()) {
-					std::string orig = TableFileName(dbname_, t.meta.number);
+					std::string orig = TableFileName(dbname_, t->meta.number);
 					s = env_->RenameFile(copy, orig);
 					if (s.ok()) {
 						Log(options_.info_log, "Table #%llu: %d entries repaired",
-							(unsigned long long) t.meta.number, counter);
-						tables_.push_back(t);
+							(unsigned long long) t->meta.number, counter);
+						t->keep = true;
 					}
 				}
 				if (!s.ok()) {
@@ -398,7 +761,9 @@ namespace leveldb {
 				}
 			}
 
-			Status WriteDescriptor() {
+			// "max_sequence" is the largest sequence number of all column
+			// families.
+			Status WriteDescriptor(SequenceNumber max_sequence) {
 				std::string tmp = TempFileName(dbname_, 1);
 				ConcurrentWritableFile* file;
 				Status status = env_->NewConcurrentWritableFile(tmp, &file);
@@ -406,13 +771,6 @@ namespace leveldb {
 					return status;
 				}
 
-				SequenceNumber max_sequence = 0;
-				for (size_t i = 0; i < tables_.size(); i++) {
-					if (max_sequence < tables_[i].max_sequence) {
-						max_sequence = tables_[i].max_sequence;
-					}
-				}
-
 				edit_.SetComparatorName(icmp_.user_comparator()->Name());
 				edit_.SetLogNumber(0);
 				edit_.SetNextFile(next_file_number_);
@@ -424,6 +782,21 @@ namespace leveldb {
 					edit_.AddFile(0, t.meta.number, t.meta.file_size,
 						t.meta.smallest, t.meta.largest);
 				}
+				for (size_t i = 0; i < blob_numbers_.size(); i++) {
+					uint64_t blob_size = 0;
+					if (env_->GetFileSize(BlobFileName(dbname_, blob_numbers_[i]), &blob_size).ok() &&
+						blob_size > 0) {
+						edit_.AddBlobFile(blob_numbers_[i], blob_size);
+					}
+				}
+				for (size_t i = 0; i < families_.size(); i++) {
+					edit_.AddColumnFamily(families_[i]->id_, families_[i]->name_);
+				}
+				for (std::set<uint32_t>::const_iterator it = dropped_families_.begin();
+					it != dropped_families_.end();
+					++it) {
+					edit_.DropColumnFamily(*it);
+				}
 
 				//fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
 				{
@@ -464,12 +837,26 @@ namespace leveldb {
 				//    dir/foo
 				// rename to
 				//    dir/lost/foo
+				// The files of a column family go to dir/lost/cf-NNNNNN/foo
+				// instead, which leaves nothing behind that would keep its
+				// directory from being deleted.
 				const char* slash = strrchr(fname.c_str(), '/');
 				std::string new_dir;
 				if (slash != NULL) {
 					new_dir.assign(fname.data(), slash - fname.data());
 				}
-				new_dir.append("/lost");
+				if (id_ != 0) {
+					const size_t sep = new_dir.rfind('/');
+					std::string family_dir = new_dir.substr(sep + 1);
+					new_dir.resize(sep == std::string::npos ? 0 : sep);
+					new_dir.append("/lost");
+					env_->CreateDir(new_dir);  // Ignore error
+					new_dir.append("/");
+					new_dir.append(family_dir);
+				}
+				else {
+					new_dir.append("/lost");
+				}
 				env_->CreateDir(new_dir);  // Ignore error
 				std::string new_file = new_dir;
 				new_file.append("/");
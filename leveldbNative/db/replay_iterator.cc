@@ -47,6 +47,8 @@ ReplayIteratorImpl::ReplayIteratorImpl(DBImpl* db, port::Mutex* mutex, const Com
     start_at_(s),
     valid_(),
     status_(),
+    blob_value_(),
+    blob_status_(),
     has_current_user_key_(false),
     current_user_key_(),
     current_user_sequence_(),
@@ -83,7 +85,9 @@ void ReplayIteratorImpl::SkipToLast() {
 
 bool ReplayIteratorImpl::HasValue() {
   ParsedInternalKey ikey;
-  return ParseKey(&ikey) && ikey.type == kTypeValue;
+  return ParseKey(&ikey) &&
+         (ikey.type == kTypeValue || ikey.type == kTypeValueWithExpiry ||
+          ikey.type == kTypeBlobIndex);
 }
 
 Slice ReplayIteratorImpl::key() const {
@@ -93,12 +97,27 @@ Slice ReplayIteratorImpl::key() const {
 
 Slice ReplayIteratorImpl::value() const {
   assert(valid_);
+  const ValueType type = ExtractValueType(rs_.iter_->key());
+  if (type == kTypeValueWithExpiry) {
+    return StripExpiry(rs_.iter_->value());
+  } else if (type == kTypeBlobIndex) {
+    Status s = db_->GetBlob(rs_.iter_->value(), &blob_value_);
+    if (!s.ok()) {
+      blob_value_.clear();
+      if (blob_status_.ok()) {
+        blob_status_ = s;
+      }
+    }
+    return blob_value_;
+  }
   return rs_.iter_->value();
 }
 
 Status ReplayIteratorImpl::status() const {
   if (!status_.ok()) {
     return status_;
+  } else if (!blob_status_.ok()) {
+    return blob_status_;
   } else {
     return rs_.iter_->status();
   }
@@ -170,7 +189,8 @@ void ReplayIteratorImpl::Prime() {
                                      Slice(current_user_key_)) != 0 ||
            ikey.sequence >= current_user_sequence_) &&
           (ikey.sequence >= rs_.seq_start_ &&
-            (ikey.type == kTypeDeletion || ikey.type == kTypeValue))) {
+            (ikey.type == kTypeDeletion || ikey.type == kTypeValue ||
+             ikey.type == kTypeValueWithExpiry || ikey.type == kTypeBlobIndex))) {
         has_current_user_key_ = true;
         current_user_key_.assign(ikey.user_key.data(), ikey.user_key.size());
         current_user_sequence_ = ikey.sequence;
@@ -61,6 +61,10 @@ class ReplayIteratorImpl : public ReplayIterator {
   bool valid_;
   Status status_;
 
+  // Value read for a blob index by value(), and the first read error
+  mutable std::string blob_value_;
+  mutable Status blob_status_;
+
   bool has_current_user_key_;
   std::string current_user_key_;
   SequenceNumber current_user_sequence_;
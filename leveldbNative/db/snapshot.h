@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_DB_SNAPSHOT_H_
 #define STORAGE_LEVELDB_DB_SNAPSHOT_H_
 
+#include <vector>
+#include "db/dbformat.h"
 #include "leveldb/db.h"
 
 namespace leveldb {
@@ -38,15 +40,28 @@ namespace leveldb {
 	class SnapshotList {
 	public:
 		SnapshotList()
-			: list_() {
+			: list_(),
+			size_(0) {
 			list_.prev_ = &list_;
 			list_.next_ = &list_;
 		}
 
 		bool empty() const { return list_.next_ == &list_; }
+		size_t size() const { return size_; }
 		SnapshotImpl* oldest() const { assert(!empty()); return list_.next_; }
 		SnapshotImpl* newest() const { assert(!empty()); return list_.prev_; }
 
+		// Store the sequence number of every snapshot in *seqs, oldest
+		// first, without repeating a number shared by several snapshots.
+		void GetSequenceNumbers(std::vector<SequenceNumber>* seqs) const {
+			seqs->clear();
+			for (const SnapshotImpl* s = list_.next_; s != &list_; s = s->next_) {
+				if (seqs->empty() || seqs->back() != s->number_) {
+					seqs->push_back(s->number_);
+				}
+			}
+		}
+
 		const SnapshotImpl* New(SequenceNumber seq) {
 			SnapshotImpl* s = new SnapshotImpl;
 			s->number_ = seq;
@@ -55,6 +70,7 @@ namespace leveldb {
 			s->prev_ = list_.prev_;
 			s->prev_->next_ = s;
 			s->next_->prev_ = s;
+			++size_;
 			return s;
 		}
 
@@ -62,12 +78,14 @@ namespace leveldb {
 			assert(s->list_ == this);
 			s->prev_->next_ = s->next_;
 			s->next_->prev_ = s->prev_;
+			--size_;
 			delete s;
 		}
 
 	private:
 		// Dummy head of doubly-linked list of snapshots
 		SnapshotImpl list_;
+		size_t size_;
 	};
 
 }  // namespace leveldb
@@ -0,0 +1,127 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include <assert.h>
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+	// Every entry is stored as a value with sequence number zero, the same
+	// form a compaction gives entries no snapshot can tell apart.  The
+	// database substitutes a sequence number of its own when it ingests
+	// the table, if the table overlaps older data.
+	struct SstFileWriter::Rep {
+		const InternalKeyComparator internal_comparator;
+		const InternalFilterPolicy internal_filter_policy;
+		Options options;
+		std::string fname;
+		WritableFile* file;
+		TableBuilder* builder;
+		std::string last_key;   // User key of the last entry added
+		bool finished;
+
+		explicit Rep(const Options& opt)
+			: internal_comparator(opt.comparator),
+			internal_filter_policy(opt.filter_policy),
+			options(opt),
+			fname(),
+			file(NULL),
+			builder(NULL),
+			last_key(),
+			finished(false) {
+			options.comparator = &internal_comparator;
+			options.filter_policy = (opt.filter_policy != NULL) ? &internal_filter_policy : NULL;
+		}
+	};
+
+	SstFileWriter::SstFileWriter(const Options& options)
+		: rep_(new Rep(options)) {
+	}
+
+	SstFileWriter::~SstFileWriter() {
+		if (rep_->builder != NULL && !rep_->finished) {
+			rep_->builder->Abandon();
+			delete rep_->file;
+			rep_->options.env->DeleteFile(rep_->fname);
+		}
+		delete rep_->builder;
+		delete rep_;
+	}
+
+	Status SstFileWriter::Open(const std::string& fname) {
+		Rep* r = rep_;
+		assert(r->file == NULL && !r->finished);
+		// An earlier table at fname may have been hard-linked into a
+		// database; unlink it rather than truncate it underneath.
+		r->options.env->DeleteFile(fname);
+		Status s = r->options.env->NewWritableFile(fname, &r->file);
+		if (s.ok()) {
+			r->fname = fname;
+			r->builder = new TableBuilder(r->options, r->file);
+		}
+		return s;
+	}
+
+	Status SstFileWriter::Add(const Slice& key, const Slice& value) {
+		Rep* r = rep_;
+		assert(r->builder != NULL);
+		if (r->builder->NumEntries() > 0 &&
+			r->internal_comparator.user_comparator()->Compare(key, r->last_key) <= 0) {
+			return Status::InvalidArgument("keys must be added in strictly increasing order",
+				key.ToString());
+		}
+		std::string ikey;
+		AppendInternalKey(&ikey, ParsedInternalKey(key, 0, kTypeValue));
+		r->builder->Add(ikey, value);
+		r->last_key.assign(key.data(), key.size());
+		return r->builder->status();
+	}
+
+	Status SstFileWriter::Finish() {
+		Rep* r = rep_;
+		assert(r->builder != NULL);
+		Status s;
+		if (r->builder->NumEntries() == 0) {
+			r->builder->Abandon();
+			s = Status::InvalidArgument("an external table needs at least one entry",
+				r->fname);
+		}
+		else {
+			std::string encoded;
+			PutVarint64(&encoded, 0);
+			r->builder->AddProperty(kPropertyMaxSequence, encoded);
+			encoded.clear();
+			PutVarint64(&encoded, r->options.env->NowMicros() / 1000000);
+			r->builder->AddProperty(kPropertyCreationTime, encoded);
+			s = r->builder->Finish();
+		}
+		if (s.ok()) {
+			s = r->file->Sync();
+		}
+		if (s.ok()) {
+			s = r->file->Close();
+		}
+		delete r->file;
+		r->file = NULL;
+		if (!s.ok()) {
+			r->options.env->DeleteFile(r->fname);
+		}
+		r->finished = true;
+		return s;
+	}
+
+	uint64_t SstFileWriter::NumEntries() const {
+		return rep_->builder != NULL ? rep_->builder->NumEntries() : 0;
+	}
+
+	uint64_t SstFileWriter::FileSize() const {
+		return rep_->builder != NULL ? rep_->builder->FileSize() : 0;
+	}
+
+}  // namespace leveldb
@@ -4,38 +4,132 @@
 
 #include "db/table_cache.h"
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "util/atomic.h"
 #include "util/coding.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
 	struct TableAndFile {
 		RandomAccessFile* file;
 		Table* table;
+		uint64_t memory;
+		uint64_t* readers_memory;   // TableCache::readers_memory_
 	};
 
 	static void DeleteEntry(const Slice& /*key*/, void* value) {
 		TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+		atomic::increment_64_nobarrier(tf->readers_memory, -tf->memory);
 		delete tf->table;
 		delete tf->file;
 		delete tf;
 	}
 
+	static void DeleteBlobFileEntry(const Slice& /*key*/, void* value) {
+		delete reinterpret_cast<RandomAccessFile*>(value);
+	}
+
 	static void UnrefEntry(void* arg1, void* arg2) {
 		Cache* cache = reinterpret_cast<Cache*>(arg1);
 		Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
 		cache->Release(h);
 	}
 
+	namespace {
+
+		// Yields the entries of a table whose keys were all written with
+		// sequence number zero as if they carried "sequence" instead.
+		class GlobalSequenceIterator : public Iterator {
+		public:
+			GlobalSequenceIterator(const Comparator* icmp, Iterator* iter,
+				SequenceNumber sequence)
+				: icmp_(icmp),
+				iter_(iter),
+				sequence_(sequence),
+				key_() {
+			}
+			virtual ~GlobalSequenceIterator() {
+				delete iter_;
+			}
+			virtual bool Valid() const { return iter_->Valid(); }
+			virtual void SeekToFirst() { iter_->SeekToFirst(); Update(); }
+			virtual void SeekToLast() { iter_->SeekToLast(); Update(); }
+			virtual void Seek(const Slice& target) {
+				iter_->Seek(target);
+				Update();
+				// The table orders "target"'s user key as if it were written
+				// before any snapshot, so skip it if it is newer than "target".
+				if (Valid() && icmp_->Compare(key_, target) < 0) {
+					Next();
+				}
+			}
+			virtual void Next() { iter_->Next(); Update(); }
+			virtual void Prev() { iter_->Prev(); Update(); }
+			virtual Slice key() const { return key_; }
+			virtual Slice value() const { return iter_->value(); }
+			virtual const Status& status() const { return iter_->status(); }
+
+		private:
+			void Update() {
+				key_.clear();
+				ParsedInternalKey parsed;
+				if (iter_->Valid() && ParseInternalKey(iter_->key(), &parsed)) {
+					parsed.sequence = sequence_;
+					AppendInternalKey(&key_, parsed);
+				}
+				else if (iter_->Valid()) {
+					key_.assign(iter_->key().data(), iter_->key().size());
+				}
+			}
+
+			const Comparator* const icmp_;
+			Iterator* const iter_;
+			const SequenceNumber sequence_;
+			std::string key_;
+
+			GlobalSequenceIterator(const GlobalSequenceIterator&);
+			void operator=(const GlobalSequenceIterator&);
+		};
+
+		struct GlobalSequenceSaver {
+			void* arg;
+			void(*saver)(void*, const Slice&, const Slice&);
+			SequenceNumber sequence;
+			SequenceNumber snapshot;
+			std::string key;
+		};
+
+		void SaveWithGlobalSequence(void* arg, const Slice& k, const Slice& v) {
+			GlobalSequenceSaver* s = reinterpret_cast<GlobalSequenceSaver*>(arg);
+			ParsedInternalKey parsed;
+			if (s->sequence > s->snapshot) {
+				return;
+			}
+			if (!ParseInternalKey(k, &parsed)) {
+				(*s->saver)(s->arg, k, v);
+				return;
+			}
+			parsed.sequence = s->sequence;
+			s->key.clear();
+			AppendInternalKey(&s->key, parsed);
+			(*s->saver)(s->arg, s->key, v);
+		}
+
+	}  // namespace
+
 	TableCache::TableCache(const std::string& dbname,
 		const Options* options,
 		int entries)
 		: env_(options->env),
 		dbname_(dbname),
 		options_(options),
-		cache_(NewLRUCache(entries)) {
+		cache_(NewLRUCache(entries)),
+		readers_memory_(0) {
 	}
 
 	TableCache::~TableCache() {
@@ -44,12 +138,14 @@ namespace leveldb {
 
 	Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 		Cache::Handle** handle) {
+		PERF_TIMER_GUARD(find_table_nanos);
 		Status s;
 		char buf[sizeof(file_number)];
 		EncodeFixed64(buf, file_number);
 		Slice key(buf, sizeof(buf));
 		*handle = cache_->Lookup(key);
 		if (*handle == NULL) {
+			RecordTick(options_->statistics, kTableCacheMiss);
 			std::string fname = TableFileName(dbname_, file_number);
 			RandomAccessFile* file = NULL;
 			Table* table = NULL;
@@ -74,16 +170,39 @@ namespace leveldb {
 				TableAndFile* tf = new TableAndFile;
 				tf->file = file;
 				tf->table = table;
+				tf->memory = table->ApproximateMemoryUsage();
+				tf->readers_memory = &readers_memory_;
+				atomic::increment_64_nobarrier(&readers_memory_, tf->memory);
 				*handle = cache_->Insert(key, tf, 1, &DeleteEntry);
 			}
 		}
+		else {
+			RecordTick(options_->statistics, kTableCacheHit);
+		}
+		return s;
+	}
+
+	Status TableCache::FindBlobFile(uint64_t file_number, Cache::Handle** handle) {
+		Status s;
+		char buf[sizeof(file_number)];
+		EncodeFixed64(buf, file_number);
+		Slice key(buf, sizeof(buf));
+		*handle = cache_->Lookup(key);
+		if (*handle == NULL) {
+			RandomAccessFile* file = NULL;
+			s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number), &file);
+			if (s.ok()) {
+				*handle = cache_->Insert(key, file, 1, &DeleteBlobFileEntry);
+			}
+		}
 		return s;
 	}
 
 	Iterator* TableCache::NewIterator(const ReadOptions& options,
 		uint64_t file_number,
 		uint64_t file_size,
-		Table** tableptr) {
+		Table** tableptr,
+		SequenceNumber global_sequence) {
 		if (tableptr != NULL) {
 			*tableptr = NULL;
 		}
@@ -97,6 +216,9 @@ namespace leveldb {
 		Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
 		Iterator* result = table->NewIterator(options);
 		result->RegisterCleanup(&UnrefEntry, cache_, handle);
+		if (global_sequence != 0) {
+			result = new GlobalSequenceIterator(options_->comparator, result, global_sequence);
+		}
 		if (tableptr != NULL) {
 			*tableptr = table;
 		}
@@ -108,12 +230,59 @@ namespace leveldb {
 		uint64_t file_size,
 		const Slice& k,
 		void* arg,
-		void(*saver)(void*, const Slice&, const Slice&)) {
+		void(*saver)(void*, const Slice&, const Slice&),
+		SequenceNumber global_sequence) {
 		Cache::Handle* handle = NULL;
 		Status s = FindTable(file_number, file_size, &handle);
 		if (s.ok()) {
 			Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-			s = t->InternalGet(options, k, arg, saver);
+			if (global_sequence != 0 && k.size() >= 8) {
+				GlobalSequenceSaver gs;
+				gs.arg = arg;
+				gs.saver = saver;
+				gs.sequence = global_sequence;
+				gs.snapshot = DecodeFixed64(k.data() + k.size() - 8) >> 8;
+				s = t->InternalGet(options, k, &gs, &SaveWithGlobalSequence);
+			}
+			else {
+				s = t->InternalGet(options, k, arg, saver);
+			}
+			cache_->Release(handle);
+		}
+		return s;
+	}
+
+	Status TableCache::Load(uint64_t file_number, uint64_t file_size) {
+		Cache::Handle* handle = NULL;
+		Status s = FindTable(file_number, file_size, &handle);
+		if (s.ok()) {
+			cache_->Release(handle);
+		}
+		return s;
+	}
+
+	Status TableCache::GetProperties(uint64_t file_number, uint64_t file_size,
+		std::map<std::string, std::string>* properties) {
+		Cache::Handle* handle = NULL;
+		Status s = FindTable(file_number, file_size, &handle);
+		if (s.ok()) {
+			Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+			s = t->ReadProperties(properties);
+			cache_->Release(handle);
+		}
+		return s;
+	}
+
+	Status TableCache::GetBlob(const Slice& blob_index, std::string* value) {
+		BlobIndex index;
+		Status s = index.DecodeFrom(blob_index);
+		Cache::Handle* handle = NULL;
+		if (s.ok()) {
+			s = FindBlobFile(index.file_number, &handle);
+		}
+		if (s.ok()) {
+			RandomAccessFile* file = reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+			s = ReadBlob(file, index, value);
 			cache_->Release(handle);
 		}
 		return s;
@@ -125,4 +294,8 @@ namespace leveldb {
 		cache_->Erase(Slice(buf, sizeof(buf)));
 	}
 
+	uint64_t TableCache::TableReadersMemory() const {
+		return atomic::load_64_nobarrier(&readers_memory_);
+	}
+
 }  // namespace leveldb
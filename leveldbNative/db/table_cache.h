@@ -7,6 +7,7 @@
 #ifndef STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 #define STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 
+#include <map>
 #include <string>
 #include <stdint.h>
 #include "db/dbformat.h"
@@ -29,24 +30,49 @@ namespace leveldb {
 		// underlying the returned iterator, or NULL if no Table object underlies
 		// the returned iterator.  The returned "*tableptr" object is owned by
 		// the cache and should not be deleted, and is valid for as long as the
-		// returned iterator is live.
+		// returned iterator is live.  A non-zero global_sequence is reported
+		// as the sequence number of every entry (see
+		// FileMetaData::global_sequence).
 		Iterator* NewIterator(const ReadOptions& options,
 			uint64_t file_number,
 			uint64_t file_size,
-			Table** tableptr = NULL);
+			Table** tableptr = NULL,
+			SequenceNumber global_sequence = 0);
 
 		// If a seek to internal key "k" in specified file finds an entry,
-		// call (*handle_result)(arg, found_key, found_value).
+		// call (*handle_result)(arg, found_key, found_value).  With a non-zero
+		// global_sequence, found_key carries it, and entries newer than the
+		// sequence number of "k" are not found.
 		Status Get(const ReadOptions& options,
 			uint64_t file_number,
 			uint64_t file_size,
 			const Slice& k,
 			void* arg,
-			void(*handle_result)(void*, const Slice&, const Slice&));
+			void(*handle_result)(void*, const Slice&, const Slice&),
+			SequenceNumber global_sequence = 0);
+
+		// Open the specified file and keep it in the cache, so that a later
+		// NewIterator() or Get() finds it there.  Does nothing if the file is
+		// already cached.
+		Status Load(uint64_t file_number, uint64_t file_size);
+
+		// Store the properties block of the specified file in *properties
+		// (see Table::ReadProperties).
+		Status GetProperties(uint64_t file_number, uint64_t file_size,
+			std::map<std::string, std::string>* properties);
+
+		// Read the value that the encoded BlobIndex "blob_index" locates
+		// into *value.  Open blob files share the cache with the tables.
+		Status GetBlob(const Slice& blob_index, std::string* value);
 
 		// Evict any entry for the specified file number
 		void Evict(uint64_t file_number);
 
+		// Return the heap memory held by the open tables in the cache (see
+		// Table::ApproximateMemoryUsage).  Safe to call without external
+		// synchronization.
+		uint64_t TableReadersMemory() const;
+
 	private:
 		TableCache(const TableCache&);
 		TableCache& operator = (const TableCache&);
@@ -54,8 +80,10 @@ namespace leveldb {
 		const std::string dbname_;
 		const Options* options_;
 		Cache* cache_;
+		uint64_t readers_memory_;   // updated atomically
 
 		Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+		Status FindBlobFile(uint64_t file_number, Cache::Handle**);
 	};
 
 }  // namespace leveldb
@@ -20,7 +20,12 @@ namespace leveldb {
 		kDeletedFile = 6,
 		kNewFile = 7,
 		// 8 was used for large value refs
-		kPrevLogNumber = 9
+		kPrevLogNumber = 9,
+		kNewExternalFile = 10,    // kNewFile followed by a global sequence number
+		kNewBlobFile = 11,
+		kBlobGarbage = 12,
+		kNewColumnFamily = 13,
+		kDroppedColumnFamily = 14
 	};
 
 	void VersionEdit::Clear() {
@@ -36,6 +41,10 @@ namespace leveldb {
 		has_last_sequence_ = false;
 		deleted_files_.clear();
 		new_files_.clear();
+		new_blob_files_.clear();
+		blob_garbage_.clear();
+		new_column_families_.clear();
+		dropped_column_families_.clear();
 	}
 
 	void VersionEdit::EncodeTo(std::string* dst) const {
@@ -76,12 +85,38 @@ namespace leveldb {
 
 		for (size_t i = 0; i < new_files_.size(); i++) {
 			const FileMetaData& f = new_files_[i].second;
-			PutVarint32(dst, kNewFile);
+			PutVarint32(dst, f.global_sequence != 0 ? kNewExternalFile : kNewFile);
 			PutVarint32(dst, new_files_[i].first);  // level
 			PutVarint64(dst, f.number);
 			PutVarint64(dst, f.file_size);
 			PutLengthPrefixedSlice(dst, f.smallest.Encode());
 			PutLengthPrefixedSlice(dst, f.largest.Encode());
+			if (f.global_sequence != 0) {
+				PutVarint64(dst, f.global_sequence);
+			}
+		}
+
+		for (size_t i = 0; i < new_blob_files_.size(); i++) {
+			PutVarint32(dst, kNewBlobFile);
+			PutVarint64(dst, new_blob_files_[i].first);   // file number
+			PutVarint64(dst, new_blob_files_[i].second);  // bytes
+		}
+
+		for (size_t i = 0; i < blob_garbage_.size(); i++) {
+			PutVarint32(dst, kBlobGarbage);
+			PutVarint64(dst, blob_garbage_[i].first);     // file number
+			PutVarint64(dst, blob_garbage_[i].second);    // bytes
+		}
+
+		for (size_t i = 0; i < new_column_families_.size(); i++) {
+			PutVarint32(dst, kNewColumnFamily);
+			PutVarint32(dst, new_column_families_[i].first);
+			PutLengthPrefixedSlice(dst, new_column_families_[i].second);
+		}
+
+		for (size_t i = 0; i < dropped_column_families_.size(); i++) {
+			PutVarint32(dst, kDroppedColumnFamily);
+			PutVarint32(dst, dropped_column_families_[i]);
 		}
 	}
 
@@ -117,6 +152,8 @@ namespace leveldb {
 		// Temporary storage for parsing
 		int level;
 		uint64_t number;
+		uint64_t bytes;
+		uint32_t id;
 		FileMetaData f;
 		Slice str;
 		InternalKey key;
@@ -190,11 +227,14 @@ namespace leveldb {
 				break;
 
 			case kNewFile:
+			case kNewExternalFile:
+				f.global_sequence = 0;
 				if (GetLevel(&input, &level) &&
 					GetVarint64(&input, &f.number) &&
 					GetVarint64(&input, &f.file_size) &&
 					GetInternalKey(&input, &f.smallest) &&
-					GetInternalKey(&input, &f.largest)) {
+					GetInternalKey(&input, &f.largest) &&
+					(tag == kNewFile || GetVarint64(&input, &f.global_sequence))) {
 					new_files_.push_back(std::make_pair(level, f));
 				}
 				else {
@@ -202,6 +242,45 @@ namespace leveldb {
 				}
 				break;
 
+			case kNewBlobFile:
+				if (GetVarint64(&input, &number) &&
+					GetVarint64(&input, &bytes)) {
+					new_blob_files_.push_back(std::make_pair(number, bytes));
+				}
+				else {
+					msg = "new-blob-file entry";
+				}
+				break;
+
+			case kBlobGarbage:
+				if (GetVarint64(&input, &number) &&
+					GetVarint64(&input, &bytes)) {
+					blob_garbage_.push_back(std::make_pair(number, bytes));
+				}
+				else {
+					msg = "blob-garbage entry";
+				}
+				break;
+
+			case kNewColumnFamily:
+				if (GetVarint32(&input, &id) &&
+					GetLengthPrefixedSlice(&input, &str)) {
+					new_column_families_.push_back(std::make_pair(id, str.ToString()));
+				}
+				else {
+					msg = "new-column-family entry";
+				}
+				break;
+
+			case kDroppedColumnFamily:
+				if (GetVarint32(&input, &id)) {
+					dropped_column_families_.push_back(id);
+				}
+				else {
+					msg = "dropped-column-family entry";
+				}
+				break;
+
 			default:
 				msg = "unknown tag";
 				break;
@@ -268,6 +347,32 @@ namespace leveldb {
 			r.append(f.smallest.DebugString());
 			r.append(" .. ");
 			r.append(f.largest.DebugString());
+			if (f.global_sequence != 0) {
+				r.append(" @ ");
+				AppendNumberTo(&r, f.global_sequence);
+			}
+		}
+		for (size_t i = 0; i < new_blob_files_.size(); i++) {
+			r.append("\n  AddBlobFile: ");
+			AppendNumberTo(&r, new_blob_files_[i].first);
+			r.append(" ");
+			AppendNumberTo(&r, new_blob_files_[i].second);
+		}
+		for (size_t i = 0; i < blob_garbage_.size(); i++) {
+			r.append("\n  BlobGarbage: ");
+			AppendNumberTo(&r, blob_garbage_[i].first);
+			r.append(" ");
+			AppendNumberTo(&r, blob_garbage_[i].second);
+		}
+		for (size_t i = 0; i < new_column_families_.size(); i++) {
+			r.append("\n  AddColumnFamily: ");
+			AppendNumberTo(&r, new_column_families_[i].first);
+			r.append(" ");
+			r.append(new_column_families_[i].second);
+		}
+		for (size_t i = 0; i < dropped_column_families_.size(); i++) {
+			r.append("\n  DropColumnFamily: ");
+			AppendNumberTo(&r, dropped_column_families_[i]);
 		}
 		r.append("\n}\n");
 		return r;
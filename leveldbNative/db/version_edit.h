@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 #include "db/dbformat.h"
@@ -21,8 +22,15 @@ namespace leveldb {
 		uint64_t file_size;         // File size in bytes
 		InternalKey smallest;       // Smallest internal key served by table
 		InternalKey largest;        // Largest internal key served by table
-
-		FileMetaData() : refs(0), allowed_seeks(1 << 30), number(0), file_size(0), smallest(), largest() { }
+		uint64_t creation_time;     // Not persisted: 0 until read from the table's
+		                            // properties, ~0 if it records none
+		uint64_t min_expiry;        // Not persisted, read with creation_time; ~0 if
+		                            // no entry expires
+		SequenceNumber global_sequence;  // If non-zero, the sequence number of
+		                            // every entry; the table stores zeros (see
+		                            // DB::IngestExternalFile)
+
+		FileMetaData() : refs(0), allowed_seeks(1 << 30), number(0), file_size(0), smallest(), largest(), creation_time(0), min_expiry(0), global_sequence(0) { }
 	};
 
 	class VersionEdit {
@@ -40,7 +48,11 @@ namespace leveldb {
 			has_last_sequence_(),
 			compact_pointers_(),
 			deleted_files_(),
-			new_files_() {
+			new_files_(),
+			new_blob_files_(),
+			blob_garbage_(),
+			new_column_families_(),
+			dropped_column_families_() {
 			Clear();
 		}
 		~VersionEdit() { }
@@ -74,15 +86,19 @@ namespace leveldb {
 		// Add the specified file at the specified number.
 		// REQUIRES: This version has not been saved (see VersionSet::SaveTo)
 		// REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+		// A non-zero global_sequence replaces the sequence number of every
+		// entry in the file when it is read.
 		void AddFile(int level, uint64_t file,
 			uint64_t file_size,
 			const InternalKey& smallest,
-			const InternalKey& largest) {
+			const InternalKey& largest,
+			SequenceNumber global_sequence = 0) {
 			FileMetaData f;
 			f.number = file;
 			f.file_size = file_size;
 			f.smallest = smallest;
 			f.largest = largest;
+			f.global_sequence = global_sequence;
 			new_files_.push_back(std::make_pair(level, f));
 		}
 
@@ -91,6 +107,38 @@ namespace leveldb {
 			deleted_files_.insert(std::make_pair(level, file));
 		}
 
+		// Add the blob file with the specified number, holding "bytes" bytes
+		// of values.
+		void AddBlobFile(uint64_t file, uint64_t bytes) {
+			new_blob_files_.push_back(std::make_pair(file, bytes));
+		}
+
+		// Record that "bytes" more bytes of the specified blob file are no
+		// longer referenced.  Once all of its bytes are, the file is dropped.
+		void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+			blob_garbage_.push_back(std::make_pair(file, bytes));
+		}
+
+		// Add the column family with the specified id and name to the
+		// database.  Only the default column family's descriptor keeps
+		// track of the column families.
+		void AddColumnFamily(uint32_t id, const Slice& name) {
+			new_column_families_.push_back(std::make_pair(id, name.ToString()));
+		}
+
+		// Drop the column family with the specified id.
+		void DropColumnFamily(uint32_t id) {
+			dropped_column_families_.push_back(id);
+		}
+
+		// The column families added and dropped by this edit
+		const std::vector< std::pair<uint32_t, std::string> >& NewColumnFamilies() const {
+			return new_column_families_;
+		}
+		const std::vector<uint32_t>& DroppedColumnFamilies() const {
+			return dropped_column_families_;
+		}
+
 		void EncodeTo(std::string* dst) const;
 		Status DecodeFrom(const Slice& src);
 
@@ -115,6 +163,10 @@ namespace leveldb {
 		std::vector< std::pair<int, InternalKey> > compact_pointers_;
 		DeletedFileSet deleted_files_;
 		std::vector< std::pair<int, FileMetaData> > new_files_;
+		std::vector< std::pair<uint64_t, uint64_t> > new_blob_files_;
+		std::vector< std::pair<uint64_t, uint64_t> > blob_garbage_;
+		std::vector< std::pair<uint32_t, std::string> > new_column_families_;
+		std::vector<uint32_t> dropped_column_families_;
 	};
 
 }  // namespace leveldb
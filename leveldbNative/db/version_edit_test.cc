@@ -44,7 +44,15 @@ namespace leveldb {
 			edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
 				InternalKey("foo", kBig + 500 + i, kTypeValue),
 				InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+			edit.AddFile(5, kBig + 800 + i, kBig + 400 + i,
+				InternalKey("bar", kBig + 1100 + i, kTypeValue),
+				InternalKey("baz", kBig + 1100 + i, kTypeValue),
+				kBig + 1100 + i);
 			edit.DeleteFileVer(4, kBig + 700 + i);
+			edit.AddBlobFile(kBig + 1200 + i, kBig + 1300 + i);
+			edit.AddBlobGarbage(kBig + 1400 + i, 1300 + i);
+			edit.AddColumnFamily(1500 + i, "family");
+			edit.DropColumnFamily(1600 + i);
 			edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
 		}
 
@@ -20,6 +20,8 @@
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics.h"
 #include <iostream>
 
 namespace leveldb {
@@ -64,6 +66,13 @@ namespace leveldb {
 		return MaxFileSizeForLevel(level) * 16;
 	}
 
+	// Maximum bytes of overlap in grandparent (i.e., level+2) before a file
+	// is rewritten into level+1 instead of being moved there.  Moving it
+	// would leave a level+1 file whose next compaction is very expensive.
+	static uint64_t MaxGrandParentOverlapBytes(unsigned level) {
+		return MaxFileSizeForLevel(level + 1) * 10;
+	}
+
 	static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
 		int64_t sum = 0;
 		for (size_t i = 0; i < files.size(); i++) {
@@ -174,8 +183,8 @@ namespace leveldb {
 	// An internal iterator.  For a given version/level pair, yields
 	// information about the files in the level.  For a given entry, key()
 	// is the largest key that occurs in the file, and value() is an
-	// 16-byte value containing the file number and file size, both
-	// encoded using EncodeFixed64.
+	// 24-byte value containing the file number, file size and global
+	// sequence number, all encoded using EncodeFixed64.
 	//
 	// If num != 0, then do not call SeekToLast, Prev
 	class Version::LevelFileNumIterator : public Iterator {
@@ -227,6 +236,7 @@ namespace leveldb {
 			assert(Valid());
 			EncodeFixed64(value_buf_, (*flist_)[index_]->number);
 			EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+			EncodeFixed64(value_buf_ + 16, (*flist_)[index_]->global_sequence);
 			return Slice(value_buf_, sizeof(value_buf_));
 		}
 		virtual const Status& status() const { return status_; }
@@ -245,22 +255,25 @@ namespace leveldb {
 		uint64_t number_;
 		Status status_;
 
-		// Backing store for value().  Holds the file number and size.
-		mutable char value_buf_[16];
+		// Backing store for value().  Holds the file number, size and
+		// global sequence number.
+		mutable char value_buf_[24];
 	};
 
 	static Iterator* GetFileIterator(void* arg,
 		const ReadOptions& options,
 		const Slice& file_value) {
 		TableCache* cache = reinterpret_cast<TableCache*>(arg);
-		if (file_value.size() != 16) {
+		if (file_value.size() != 24) {
 			return NewErrorIterator(
 				Status::Corruption("FileReader invoked with unexpected value"));
 		}
 		else {
 			return cache->NewIterator(options,
 				DecodeFixed64(file_value.data()),
-				DecodeFixed64(file_value.data() + 8));
+				DecodeFixed64(file_value.data() + 8),
+				NULL,
+				DecodeFixed64(file_value.data() + 16));
 		}
 	}
 
@@ -282,7 +295,8 @@ namespace leveldb {
 		for (size_t i = 0; i < files_[0].size(); i++) {
 			iters->push_back(
 				vset_->table_cache_->NewIterator(
-					options, files_[0][i]->number, files_[0][i]->file_size));
+					options, files_[0][i]->number, files_[0][i]->file_size,
+					NULL, files_[0][i]->global_sequence));
 		}
 
 		// For levels > 0, we can use a concatenating iterator that sequentially
@@ -304,11 +318,13 @@ namespace leveldb {
 			kCorrupt
 		};
 		struct Saver {
-			Saver() : state(), ucmp(), user_key(), value() {}
+			Saver() : state(), ucmp(), user_key(), value(), now(), blob(false) {}
 			SaverState state;
 			const Comparator* ucmp;
 			Slice user_key;
 			std::string* value;
+			uint64_t now;
+			bool blob;      // *value is a BlobIndex to resolve
 		private:
 			Saver(const Saver&);
 			Saver& operator = (const Saver&);
@@ -322,57 +338,52 @@ namespace leveldb {
 		}
 		else {
 			if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-				s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-				if (s->state == kFound) {
+				if (parsed_key.type == kTypeValue || parsed_key.type == kTypeBlobIndex) {
+					s->state = kFound;
 					s->value->assign(v.data(), v.size());
+					s->blob = (parsed_key.type == kTypeBlobIndex);
+				}
+				else if (parsed_key.type == kTypeValueWithExpiry && !IsExpired(v, s->now)) {
+					s->state = kFound;
+					Slice stripped = StripExpiry(v);
+					s->value->assign(stripped.data(), stripped.size());
+				}
+				else {
+					s->state = kDeleted;
 				}
 			}
 		}
 	}
 
-	static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
-		return a->number > b->number;
-	}
-
 	void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
 		void* arg,
 		bool(*func)(void*, unsigned, FileMetaData*)) {
 		// TODO(sanjay): Change Version::Get() to use this function.
-		const Comparator* ucmp = vset_->icmp_.user_comparator();
+		const uint64_t prefix = index_.KeyPrefix(user_key);
 
 		// Search level-0 in order from newest to oldest.
-		std::vector<FileMetaData*> tmp;
-		tmp.reserve(files_[0].size());
-		for (uint32_t i = 0; i < files_[0].size(); i++) {
-			FileMetaData* f = files_[0][i];
-			if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-				ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-				tmp.push_back(f);
-			}
-		}
-		if (!tmp.empty()) {
-			std::sort(tmp.begin(), tmp.end(), NewestFirst);
-			for (uint32_t i = 0; i < tmp.size(); i++) {
-				if (!(*func)(arg, 0, tmp[i])) {
+		for (uint32_t i = 0; i < index_.NumFiles(0); i++) {
+			if (index_.Level0Overlaps(i, user_key, prefix)) {
+				if (!(*func)(arg, 0, index_.File(0, i))) {
 					return;
 				}
 			}
 		}
 
 		// Search other levels.
+		FileIndex::Hint hint;
 		for (unsigned level = 1; level < config::kNumLevels; level++) {
-			size_t num_files = files_[level].size();
+			size_t num_files = index_.NumFiles(level);
 			if (num_files == 0) continue;
 
-			// Binary search to find earliest index whose largest key >= internal_key.
-			uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+			// Earliest index whose largest key >= internal_key.
+			uint32_t index = index_.FindFile(level, internal_key, prefix, &hint);
 			if (index < num_files) {
-				FileMetaData* f = files_[level][index];
-				if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
-					// All of "f" is past any data for user_key
+				if (index_.BeforeFile(level, index, user_key, prefix)) {
+					// All of the file is past any data for user_key
 				}
 				else {
-					if (!(*func)(arg, level, f)) {
+					if (!(*func)(arg, level, index_.File(level, index))) {
 						return;
 					}
 				}
@@ -383,10 +394,12 @@ namespace leveldb {
 	Status Version::Get(const ReadOptions& options,
 		const LookupKey& k,
 		std::string* value,
-		GetStats* stats) {
+		GetStats* stats,
+		uint64_t now) {
 		Slice ikey = k.internal_key();
 		Slice user_key = k.user_key();
 		const Comparator* ucmp = vset_->icmp_.user_comparator();
+		const uint64_t prefix = index_.KeyPrefix(user_key);
 		Status s;
 
 		stats->seek_file = NULL;
@@ -397,60 +410,39 @@ namespace leveldb {
 		// We can search level-by-level since entries never hop across
 		// levels.  Therefore we are guaranteed that if we find data
 		// in an smaller level, later levels are irrelevant.
-		std::vector<FileMetaData*> tmp;
-		FileMetaData* tmp2;
+		FileIndex::Hint hint;
 		for (unsigned level = 0; level < config::kNumLevels; level++) {
-			size_t num_files = files_[level].size();
+			size_t num_files = index_.NumFiles(level);
 			if (num_files == 0) continue;
 
-			// Get the list of files to search in this level
-			FileMetaData* const* files = &files_[level][0];
-			if (level == 0) {
-				// Level-0 files may overlap each other.  Find all files that
-				// overlap user_key and process them in order from newest to oldest.
-				tmp.reserve(num_files);
-				for (uint32_t i = 0; i < num_files; i++) {
-					FileMetaData* f = files[i];
-					if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-						ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-						tmp.push_back(f);
-					}
-				}
-				if (tmp.empty()) continue;
-
-				std::sort(tmp.begin(), tmp.end(), NewestFirst);
-				files = &tmp[0];
-				num_files = tmp.size();
-			}
-			else {
-				// Binary search to find earliest index whose largest key >= ikey.
-				uint32_t index = FindFile(vset_->icmp_, files_[level], ikey);
-				if (index >= num_files) {
-					files = NULL;
-					num_files = 0;
+			// Get the range of files to search in this level.  Level-0 files
+			// may overlap each other; the index keeps them newest first and
+			// each is checked against user_key.  Other levels have at most
+			// one candidate.
+			uint32_t first = 0;
+			if (level > 0) {
+				// Earliest index whose largest key >= ikey.
+				first = index_.FindFile(level, ikey, prefix, &hint);
+				if (first < num_files && !index_.BeforeFile(level, first, user_key, prefix)) {
+					num_files = first + 1;
 				}
 				else {
-					tmp2 = files[index];
-					if (ucmp->Compare(user_key, tmp2->smallest.user_key()) < 0) {
-						// All of "tmp2" is past any data for user_key
-						files = NULL;
-						num_files = 0;
-					}
-					else {
-						files = &tmp2;
-						num_files = 1;
-					}
+					// All of the file is past any data for user_key
+					num_files = 0;
 				}
 			}
 
-			for (uint32_t i = 0; i < num_files; ++i) {
+			for (uint32_t i = first; i < num_files; ++i) {
+				if (level == 0 && !index_.Level0Overlaps(i, user_key, prefix)) {
+					continue;
+				}
 				if (last_file_read != NULL && stats->seek_file == NULL) {
 					// We have had more than one seek for this read.  Charge the 1st file.
 					stats->seek_file = last_file_read;
 					stats->seek_file_level = last_file_read_level;
 				}
 
-				FileMetaData* f = files[i];
+				FileMetaData* f = index_.File(level, i);
 				last_file_read = f;
 				last_file_read_level = level;
 
@@ -459,15 +451,26 @@ namespace leveldb {
 				saver.ucmp = ucmp;
 				saver.user_key = user_key;
 				saver.value = value;
+				saver.now = now;
+				PERF_COUNTER_ADD(table_probe_count, 1);
 				s = vset_->table_cache_->Get(options, f->number, f->file_size,
-					ikey, &saver, SaveValue);
+					ikey, &saver, SaveValue, f->global_sequence);
 				if (!s.ok()) {
 					return s;
 				}
+				if ((saver.state == kFound || saver.state == kDeleted) &&
+					vset_->options_->filter_policy != NULL) {
+					RecordTick(vset_->options_->statistics, kBloomFilterTruePositive);
+				}
 				switch (saver.state) {
 				case kNotFound:
 					break;      // Keep searching in other files
 				case kFound:
+					if (saver.blob) {
+						std::string blob_index;
+						blob_index.swap(*value);
+						s = vset_->table_cache_->GetBlob(blob_index, value);
+					}
 					return s;
 				case kDeleted:
 					s = Status::NotFound(Slice());  // Use empty error message for speed
@@ -555,6 +558,25 @@ namespace leveldb {
 			smallest_user_key, largest_user_key);
 	}
 
+	uint64_t Version::EstimateLiveDataSize() {
+		uint64_t size = 0;
+		for (int level = config::kNumLevels - 1; level >= 0; level--) {
+			for (size_t i = 0; i < files_[level].size(); i++) {
+				const FileMetaData* f = files_[level][i];
+				const Slice smallest = f->smallest.user_key();
+				const Slice largest = f->largest.user_key();
+				bool covered = false;
+				for (unsigned deeper = level + 1; !covered && deeper < config::kNumLevels; deeper++) {
+					covered = OverlapInLevel(deeper, &smallest, &largest);
+				}
+				if (!covered) {
+					size += f->file_size;
+				}
+			}
+		}
+		return size;
+	}
+
 	int Version::PickLevelForMemTableOutput(
 		const Slice& smallest_user_key,
 		const Slice& largest_user_key) {
@@ -645,6 +667,21 @@ namespace leveldb {
 				r.append("]\n");
 			}
 		}
+		if (!blob_files_.empty()) {
+			// E.g., " 21:4096-1024" for a blob file with 1024 bytes of garbage
+			r.append("--- blob files ---\n");
+			for (std::map<uint64_t, BlobFileMetaData>::const_iterator it = blob_files_.begin();
+				it != blob_files_.end();
+				++it) {
+				r.push_back(' ');
+				AppendNumberTo(&r, it->first);
+				r.push_back(':');
+				AppendNumberTo(&r, it->second.total_bytes);
+				r.push_back('-');
+				AppendNumberTo(&r, it->second.garbage_bytes);
+				r.push_back('\n');
+			}
+		}
 		return r;
 	}
 
@@ -684,12 +721,14 @@ namespace leveldb {
 		VersionSet* vset_;
 		Version* base_;
 		LevelState levels_[config::kNumLevels];
+		std::map<uint64_t, BlobFileMetaData> blob_files_;
 
 	public:
 		// Initialize a builder with the files from *base and other info from *vset
 		Builder(VersionSet* vset, Version* base)
 			: vset_(vset),
-			base_(base) {
+			base_(base),
+			blob_files_(base->blob_files_) {
 			base_->Ref();
 			BySmallestKey cmp;
 			cmp.internal_comparator = &vset_->icmp_;
@@ -768,6 +807,20 @@ namespace leveldb {
 				levels_[level].deleted_files.erase(f->number);
 				levels_[level].added_files->insert(f);
 			}
+
+			// Add new blob files and account for their garbage
+			for (size_t i = 0; i < edit->new_blob_files_.size(); i++) {
+				BlobFileMetaData& b = blob_files_[edit->new_blob_files_[i].first];
+				b.total_bytes = edit->new_blob_files_[i].second;
+				b.garbage_bytes = 0;
+			}
+			for (size_t i = 0; i < edit->blob_garbage_.size(); i++) {
+				std::map<uint64_t, BlobFileMetaData>::iterator it =
+					blob_files_.find(edit->blob_garbage_[i].first);
+				if (it != blob_files_.end()) {
+					it->second.garbage_bytes += edit->blob_garbage_[i].second;
+				}
+			}
 		}
 
 		// Save the current state in *v.
@@ -817,6 +870,15 @@ namespace leveldb {
 				}
 #endif
 			}
+
+			// Keep the blob files that still hold live values
+			for (std::map<uint64_t, BlobFileMetaData>::const_iterator it = blob_files_.begin();
+				it != blob_files_.end();
+				++it) {
+				if (it->second.garbage_bytes < it->second.total_bytes) {
+					v->blob_files_.insert(*it);
+				}
+			}
 		}
 
 		void MaybeAddFile(Version* v, unsigned level, FileMetaData* f) {
@@ -855,8 +917,13 @@ namespace leveldb {
 		prev_log_number_(0),
 		descriptor_file_(NULL),
 		descriptor_log_(NULL),
+		descriptor_size_(0),
 		dummy_versions_(this),
-		current_(NULL) {
+		current_(NULL),
+		column_families_(),
+		dropped_column_families_(),
+		tail_descriptor_(),
+		tail_offset_(0) {
 		AppendVersion(new Version(this));
 	}
 
@@ -886,6 +953,28 @@ namespace leveldb {
 		v->next_->prev_ = v;
 	}
 
+	void VersionSet::ApplyColumnFamilies(const VersionEdit& edit) {
+		for (size_t i = 0; i < edit.new_column_families_.size(); i++) {
+			column_families_[edit.new_column_families_[i].first] =
+				edit.new_column_families_[i].second;
+		}
+		for (size_t i = 0; i < edit.dropped_column_families_.size(); i++) {
+			column_families_.erase(edit.dropped_column_families_[i]);
+			dropped_column_families_.insert(edit.dropped_column_families_[i]);
+		}
+	}
+
+	uint32_t VersionSet::NextColumnFamilyID() const {
+		uint32_t id = 1;
+		if (!column_families_.empty()) {
+			id = std::max(id, column_families_.rbegin()->first + 1);
+		}
+		if (!dropped_column_families_.empty()) {
+			id = std::max(id, *dropped_column_families_.rbegin() + 1);
+		}
+		return id;
+	}
+
 	Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu, port::CondVar* cv, bool* wt) {
 		while (*wt) {
 			cv->Wait();
@@ -927,19 +1016,71 @@ namespace leveldb {
 			s = env_->NewConcurrentWritableFile(new_manifest_file, &descriptor_file_);
 			if (s.ok()) {
 				descriptor_log_ = new log::Writer(descriptor_file_);
-				s = WriteSnapshot(descriptor_log_);
-			}
+				std::string record;
+				EncodeSnapshot(&record);
+				s = descriptor_log_->AddRecord(record);
+				descriptor_size_ = record.size();
+			}
+		}
+
+		// Roll over to a new descriptor once the current one is too large.
+		// Only the snapshot is taken under *mu; the new file is written after
+		// it has been released.  Until CURRENT names the new file,
+		// manifest_file_number_ keeps pointing at the old one, so
+		// DeleteObsoleteFiles() leaves both alone.
+		uint64_t new_manifest_number = manifest_file_number_;
+		std::string snapshot;
+		ConcurrentWritableFile* old_descriptor_file = NULL;
+		log::Writer* old_descriptor_log = NULL;
+		uint64_t old_descriptor_size = descriptor_size_;
+		if (s.ok() && new_manifest_file.empty() &&
+			options_->max_manifest_file_size > 0 &&
+			descriptor_size_ >= options_->max_manifest_file_size) {
+			new_manifest_number = NewFileNumber();
+			edit->SetNextFile(next_file_number_);
+			EncodeSnapshot(&snapshot);
 		}
 
 		// Unlock during expensive MANIFEST log write
 		{
 			mu->Unlock();
 
+			if (!snapshot.empty()) {
+				std::string fname = DescriptorFileName(dbname_, new_manifest_number);
+				ConcurrentWritableFile* file = NULL;
+				log::Writer* log = NULL;
+				Status r = env_->NewConcurrentWritableFile(fname, &file);
+				if (r.ok()) {
+					log = new log::Writer(file);
+					r = log->AddRecord(snapshot);
+				}
+				if (r.ok()) {
+					Log(options_->info_log, "MANIFEST #%llu has %llu bytes; rolling over to #%llu\n",
+						(unsigned long long) manifest_file_number_,
+						(unsigned long long) descriptor_size_,
+						(unsigned long long) new_manifest_number);
+					old_descriptor_file = descriptor_file_;
+					old_descriptor_log = descriptor_log_;
+					descriptor_file_ = file;
+					descriptor_log_ = log;
+					descriptor_size_ = snapshot.size();
+					new_manifest_file = fname;
+				}
+				else {
+					// Keep appending to the old descriptor; the next edit retries.
+					Log(options_->info_log, "MANIFEST rollover: %s\n", r.ToString().c_str());
+					delete log;
+					delete file;
+					env_->DeleteFile(fname);
+				}
+			}
+
 			// Write new record to MANIFEST log
 			if (s.ok()) {
 				std::string record;
 				edit->EncodeTo(&record);
 				s = descriptor_log_->AddRecord(record);
+				descriptor_size_ += record.size();
 				if (s.ok()) {
 					// XXX Unlock during expensive MANIFEST log write
 					s = descriptor_file_->Sync();
@@ -952,7 +1093,7 @@ namespace leveldb {
 			// If we just created a new descriptor file, install it by writing a
 			// new CURRENT file that points to it.
 			if (s.ok() && !new_manifest_file.empty()) {
-				s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+				s = SetCurrentFile(env_, dbname_, new_manifest_number);
 			}
 
 			mu->Lock();
@@ -961,8 +1102,23 @@ namespace leveldb {
 		// Install the new version
 		if (s.ok()) {
 			AppendVersion(v);
+			ApplyColumnFamilies(*edit);
 			log_number_ = edit->log_number_;
 			prev_log_number_ = edit->prev_log_number_;
+			manifest_file_number_ = new_manifest_number;
+			delete old_descriptor_log;
+			delete old_descriptor_file;
+		}
+		else if (old_descriptor_log != NULL) {
+			// Failed after rolling over: go back to the descriptor CURRENT
+			// still names.  The edit is not applied.
+			delete v;
+			delete descriptor_log_;
+			delete descriptor_file_;
+			descriptor_log_ = old_descriptor_log;
+			descriptor_file_ = old_descriptor_file;
+			descriptor_size_ = old_descriptor_size;
+			env_->DeleteFile(new_manifest_file);
 		}
 		else {
 			delete v;
@@ -980,6 +1136,20 @@ namespace leveldb {
 		return s;
 	}
 
+	// Read the name of the current descriptor from "CURRENT"
+	static Status ReadCurrentFile(Env* env, const std::string& dbname,
+		std::string* name) {
+		Status s = ReadFileToString(env, CurrentFileName(dbname), name);
+		if (!s.ok()) {
+			return s;
+		}
+		if (name->empty() || (*name)[name->size() - 1] != '\n') {
+			return Status::Corruption("CURRENT file does not end with newline");
+		}
+		name->resize(name->size() - 1);
+		return s;
+	}
+
 	Status VersionSet::Recover() {
 		struct LogReporter : public log::Reader::Reporter {
 			LogReporter() : status() {}
@@ -992,16 +1162,11 @@ namespace leveldb {
 			LogReporter& operator = (const LogReporter&);
 		};
 
-		// Read "CURRENT" file, which contains a pointer to the current manifest file
 		std::string curfile;
-		Status s = ReadFileToString(env_, CurrentFileName(dbname_), &curfile);
+		Status s = ReadCurrentFile(env_, dbname_, &curfile);
 		if (!s.ok()) {
 			return s;
 		}
-		if (curfile.empty() || curfile[curfile.size() - 1] != '\n') {
-			return Status::Corruption("CURRENT file does not end with newline");
-		}
-		curfile.resize(curfile.size() - 1);
 
 		std::string dscname = dbname_ + "/" + curfile;
 		SequentialFile* file;
@@ -1018,6 +1183,7 @@ namespace leveldb {
 		uint64_t last_sequence = 0;
 		uint64_t log_number = 0;
 		uint64_t prev_log_number = 0;
+		uint64_t last_record_offset = 0;
 		Builder builder(this, current_);
 
 		{
@@ -1028,6 +1194,7 @@ namespace leveldb {
 			std::string scratch;
 
 			while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+				last_record_offset = reader.LastRecordOffset();
 				VersionEdit edit;
 				s = edit.DecodeFrom(record);
 				if (s.ok()) {
@@ -1042,6 +1209,7 @@ namespace leveldb {
 
 				if (s.ok()) {
 					builder.Apply(&edit);
+					ApplyColumnFamilies(edit);
 				}
 
 				if (edit.has_log_number_) {
@@ -1098,11 +1266,113 @@ namespace leveldb {
 			last_sequence_ = last_sequence;
 			log_number_ = log_number;
 			prev_log_number_ = prev_log_number;
+			tail_descriptor_ = curfile;
+			tail_offset_ = last_record_offset;
 		}
 
 		return s;
 	}
 
+	Status VersionSet::CatchUp(port::Mutex* mu, bool* changed) {
+		struct TailReporter : public log::Reader::Reporter {
+			TailReporter() : corrupt(false) {}
+			bool corrupt;
+			virtual void Corruption(size_t /*bytes*/, const Status& /*s*/) {
+				corrupt = true;
+			}
+		};
+
+		mu->AssertHeld();
+		*changed = false;
+		mu->Unlock();
+
+		std::string curfile;
+		Status s = ReadCurrentFile(env_, dbname_, &curfile);
+		// A new descriptor starts with a snapshot of the whole state, so it
+		// is read from the start and applied to an empty version.
+		const bool restart = curfile != tail_descriptor_;
+		uint64_t last_record_offset = tail_offset_;
+		std::vector<std::string> records;
+		if (s.ok()) {
+			SequentialFile* file;
+			s = env_->NewSequentialFile(dbname_ + "/" + curfile, &file);
+			if (s.ok()) {
+				// The record after the last one read may still be being
+				// written, and the writer zero-fills ahead of itself, so a
+				// record that looks corrupt ends the pass rather than failing
+				// it; the next call reads it again.
+				TailReporter reporter;
+				log::Reader reader(file, &reporter, true/*checksum*/,
+					restart ? 0 : tail_offset_ + 1);
+				Slice record;
+				std::string scratch;
+				while (reader.ReadRecord(&record, &scratch) && !reporter.corrupt) {
+					records.push_back(record.ToString());
+					last_record_offset = reader.LastRecordOffset();
+				}
+				delete file;
+			}
+		}
+		mu->Lock();
+		if (!s.ok() || records.empty()) {
+			return s;
+		}
+
+		bool have_log_number = false;
+		bool have_prev_log_number = false;
+		uint64_t log_number = 0;
+		uint64_t prev_log_number = 0;
+		Version* base = restart ? new Version(this) : current_;
+		Builder builder(this, base);
+		for (size_t i = 0; i < records.size() && s.ok(); i++) {
+			VersionEdit edit;
+			s = edit.DecodeFrom(records[i]);
+			if (s.ok() && edit.has_comparator_ &&
+				edit.comparator_ != icmp_.user_comparator()->Name()) {
+				s = Status::InvalidArgument(
+					edit.comparator_ + " does not match existing comparator ",
+					icmp_.user_comparator()->Name());
+			}
+			if (!s.ok()) {
+				break;
+			}
+			builder.Apply(&edit);
+			ApplyColumnFamilies(edit);
+			if (edit.has_log_number_) {
+				log_number = edit.log_number_;
+				have_log_number = true;
+			}
+			if (edit.has_prev_log_number_) {
+				prev_log_number = edit.prev_log_number_;
+				have_prev_log_number = true;
+			}
+			if (edit.has_next_file_number_) {
+				MarkFileNumberUsed(edit.next_file_number_);
+			}
+			if (edit.has_last_sequence_) {
+				SetLastSequence(edit.last_sequence_);
+			}
+		}
+
+		if (s.ok()) {
+			Version* v = new Version(this);
+			builder.SaveTo(v);
+			Finalize(v);
+			AppendVersion(v);
+			if (have_log_number) {
+				log_number_ = log_number;
+				prev_log_number_ = have_prev_log_number ? prev_log_number : 0;
+			}
+			else if (have_prev_log_number) {
+				prev_log_number_ = prev_log_number;
+			}
+			tail_descriptor_ = curfile;
+			tail_offset_ = last_record_offset;
+			*changed = true;
+		}
+		return s;
+	}
+
 	void VersionSet::MarkFileNumberUsed(uint64_t number) {
 		if (next_file_number_ <= number) {
 			next_file_number_ = number + 1;
@@ -1140,9 +1410,11 @@ namespace leveldb {
 			}
 			v->compaction_scores_[level] = score;
 		}
+
+		v->index_.Build(&icmp_, v->files_, options_->learned_index_max_error);
 	}
 
-	Status VersionSet::WriteSnapshot(log::Writer* log) {
+	void VersionSet::EncodeSnapshot(std::string* record) {
 		// TODO: Break up into multiple records to reduce memory usage on recovery?
 
 		// Save metadata
@@ -1163,13 +1435,35 @@ namespace leveldb {
 			const std::vector<FileMetaData*>& files = current_->files_[level];
 			for (size_t i = 0; i < files.size(); i++) {
 				const FileMetaData* f = files[i];
-				edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+				edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+					f->global_sequence);
 			}
 		}
 
-		std::string record;
-		edit.EncodeTo(&record);
-		return log->AddRecord(record);
+		// Save blob files
+		const std::map<uint64_t, BlobFileMetaData>& blobs = current_->blob_files_;
+		for (std::map<uint64_t, BlobFileMetaData>::const_iterator it = blobs.begin();
+			it != blobs.end();
+			++it) {
+			edit.AddBlobFile(it->first, it->second.total_bytes);
+			if (it->second.garbage_bytes > 0) {
+				edit.AddBlobGarbage(it->first, it->second.garbage_bytes);
+			}
+		}
+
+		// Save column families
+		for (std::map<uint32_t, std::string>::const_iterator it = column_families_.begin();
+			it != column_families_.end();
+			++it) {
+			edit.AddColumnFamily(it->first, it->second);
+		}
+		for (std::set<uint32_t>::const_iterator it = dropped_column_families_.begin();
+			it != dropped_column_families_.end();
+			++it) {
+			edit.DropColumnFamily(*it);
+		}
+
+		edit.EncodeTo(record);
 	}
 
 	int VersionSet::NumLevelFiles(unsigned level) const {
@@ -1236,6 +1530,11 @@ namespace leveldb {
 					live->insert(files[i]->number);
 				}
 			}
+			for (std::map<uint64_t, BlobFileMetaData>::const_iterator it = v->blob_files_.begin();
+				it != v->blob_files_.end();
+				++it) {
+				live->insert(it->first);
+			}
 		}
 	}
 
@@ -1244,6 +1543,30 @@ namespace leveldb {
 		return TotalFileSize(current_->files_[level]);
 	}
 
+	uint64_t VersionSet::EstimatePendingCompactionBytes() const {
+		// Bytes that compacting a level pushes into the next one are added
+		// to that level's size, and rewriting them costs roughly the ratio
+		// of the two levels' sizes in next-level bytes.
+		uint64_t result = 0;
+		uint64_t pushed_down = 0;
+		if (current_->files_[0].size() >= config::kL0_CompactionTrigger) {
+			pushed_down = TotalFileSize(current_->files_[0]);
+			result += pushed_down;
+		}
+		for (unsigned level = 1; level + 1 < config::kNumLevels; level++) {
+			const uint64_t level_bytes = TotalFileSize(current_->files_[level]) + pushed_down;
+			const uint64_t max_bytes = static_cast<uint64_t>(MaxBytesForLevel(level));
+			pushed_down = 0;
+			if (level_bytes > max_bytes) {
+				pushed_down = level_bytes - max_bytes;
+				const uint64_t next_bytes = TotalFileSize(current_->files_[level + 1]);
+				result += static_cast<uint64_t>(pushed_down *
+					(static_cast<double>(next_bytes) / level_bytes + 1));
+			}
+		}
+		return result;
+	}
+
 	int64_t VersionSet::MaxNextLevelOverlappingBytes() {
 		int64_t result = 0;
 		std::vector<FileMetaData*> overlaps;
@@ -1316,7 +1639,8 @@ namespace leveldb {
 					const std::vector<FileMetaData*>& files = c->inputs_[which];
 					for (size_t i = 0; i < files.size(); i++) {
 						list[num++] = table_cache_->NewIterator(
-							options, files[i]->number, files[i]->file_size);
+							options, files[i]->number, files[i]->file_size,
+							NULL, files[i]->global_sequence);
 					}
 				}
 				else {
@@ -1402,9 +1726,11 @@ namespace leveldb {
 		}
 	}
 
-	unsigned VersionSet::PickCompactionLevel(bool* locked, bool seek_driven) const {
+	unsigned VersionSet::PickCompactionLevel(bool* locked, bool seek_driven,
+		bool* by_seek) const {
 		// Find an unlocked level has score >= 1 where level + 1 has score < 1.
 		unsigned level = config::kNumLevels;
+		bool seek = false;
 		for (unsigned i = 1; i + 1 < config::kNumLevels; ++i) {
 			if (locked[i] || locked[i + 1]) {
 				continue;
@@ -1422,11 +1748,16 @@ namespace leveldb {
 			!locked[current_->file_to_compact_level_ + 0] &&
 			!locked[current_->file_to_compact_level_ + 1]) {
 			level = current_->file_to_compact_level_;
+			seek = true;
 		}
 		if (!locked[0] && !locked[1] &&
 			current_->compaction_scores_[0] >= 1.0 &&
 			current_->compaction_scores_[1] <= 1.0) {
 			level = 0;
+			seek = false;
+		}
+		if (by_seek != NULL) {
+			*by_seek = seek;
 		}
 		return level;
 	}
@@ -1435,6 +1766,20 @@ namespace leveldb {
 		return a->number < b->number;
 	}
 
+	static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
+		return a->number > b->number;
+	}
+
+	bool VersionSet::GrandparentOverlapAllowsMove(Version* v, unsigned level,
+		const FileMetaData* f) {
+		if (level + 2 >= config::kNumLevels) {
+			return true;
+		}
+		std::vector<FileMetaData*> overlaps;
+		v->GetOverlappingInputs(level + 2, &f->smallest, &f->largest, &overlaps);
+		return static_cast<uint64_t>(TotalFileSize(overlaps)) <= MaxGrandParentOverlapBytes(level);
+	}
+
 	Compaction* VersionSet::PickCompaction(Version* v, unsigned level) {
 		assert(level < config::kNumLevels);
 		bool trivial = false;
@@ -1467,7 +1812,6 @@ namespace leveldb {
 					uint64_t sz_a = LA_sizes[j + 1] - LA_sizes[i];
 					uint64_t sz_b = LB_sizes[boundaries[j].limit] - LB_sizes[boundaries[i].start];
 					if (boundaries[j].start == boundaries[j].limit) {
-						trivial = true;
 						break;
 					}
 					if (sz_a + sz_b >= MaxCompactionBytesForLevel(level)) {
@@ -1485,14 +1829,17 @@ namespace leveldb {
 				}
 			}
 
-			// Trivial moves have a near-0 cost, so do them first.
-			if (trivial) {
-				for (size_t i = 0; i < LA.size(); ++i) {
-					if (boundaries[i].start == boundaries[i].limit) {
-						c->inputs_[0].push_back(LA[i]);
-					}
+			// Files that overlap nothing in level+1 can be moved there with a
+			// metadata-only edit.  Trivial moves have a near-0 cost, so do them
+			// first.
+			for (size_t i = 0; i < LA.size(); ++i) {
+				if (boundaries[i].start == boundaries[i].limit &&
+					GrandparentOverlapAllowsMove(v, level, LA[i])) {
+					c->inputs_[0].push_back(LA[i]);
 				}
-				trivial = level != 0;
+			}
+			if (!c->inputs_[0].empty()) {
+				trivial = true;
 				// go with the best ratio
 			}
 			else if (best_ratio >= 0.0) {
@@ -1532,18 +1879,271 @@ namespace leveldb {
 		else {
 			std::vector<FileMetaData*> tmp(v->files_[0]);
 			std::sort(tmp.begin(), tmp.end(), OldestFirst);
-			for (size_t i = 0; i < tmp.size() && c->inputs_[0].size() < 32; ++i) {
+
+			// A level-0 file can move to level-1 if it overlaps neither level-1
+			// nor any older level-0 file; newer level-0 files are still read
+			// first.  Sequential inserts produce mostly such files.  The files
+			// picked this way are disjoint: of two overlapping files, the
+			// newer one overlaps an older file.
+			const Comparator* user_cmp = icmp_.user_comparator();
+			for (size_t i = 0; i < tmp.size(); ++i) {
+				const Slice smallest = tmp[i]->smallest.user_key();
+				const Slice largest = tmp[i]->largest.user_key();
+				bool movable = !v->OverlapInLevel(1, &smallest, &largest);
+				for (size_t j = 0; movable && j < i; ++j) {
+					movable = user_cmp->Compare(largest, tmp[j]->smallest.user_key()) < 0 ||
+						user_cmp->Compare(smallest, tmp[j]->largest.user_key()) > 0;
+				}
+				if (movable && GrandparentOverlapAllowsMove(v, 0, tmp[i])) {
+					c->inputs_[0].push_back(tmp[i]);
+				}
+			}
+			trivial = !c->inputs_[0].empty();
+
+			for (size_t i = 0; !trivial && i < tmp.size() && c->inputs_[0].size() < 32; ++i) {
 				c->inputs_[0].push_back(tmp[i]);
 			}
-			trivial = false;
 		}
 
+		c->trivial_move_ = trivial;
 		if (!trivial) {
 			SetupOtherInputs(c);
 		}
 		return c;
 	}
 
+	size_t VersionSet::PickUniversalRuns(Version* v, std::vector<FileMetaData*>* level0,
+		bool* by_count) const {
+		*level0 = v->files_[0];
+		std::sort(level0->begin(), level0->end(), NewestFirst);
+		std::vector<uint64_t> runs;
+		for (size_t i = 0; i < level0->size(); ++i) {
+			runs.push_back((*level0)[i]->file_size);
+		}
+		if (!v->files_[1].empty()) {
+			runs.push_back(TotalFileSize(v->files_[1]));
+		}
+		const size_t n = runs.size();
+		*by_count = false;
+		if (n < config::kL0_CompactionTrigger) {
+			return 0;
+		}
+
+		// Space amplification: merge everything once the newer runs, which
+		// may all be overwrites of the oldest one, grow too large.
+		uint64_t newer = 0;
+		for (size_t i = 0; i + 1 < n; ++i) {
+			newer += runs[i];
+		}
+		if (newer * 100 > runs[n - 1] *
+			static_cast<uint64_t>(options_->universal_max_size_amplification_percent)) {
+			return n;
+		}
+
+		// Size ratio: extend a merge of the newest runs while the next run
+		// is not much larger than everything picked so far.
+		uint64_t picked = runs[0];
+		size_t k = 1;
+		while (k < n && runs[k] * 100 <=
+			picked * (100 + static_cast<uint64_t>(options_->universal_size_ratio))) {
+			picked += runs[k];
+			++k;
+		}
+		if (k >= static_cast<size_t>(options_->universal_min_merge_width)) {
+			return k;
+		}
+
+		// Run count: merge just enough runs to get below the trigger.
+		*by_count = true;
+		return n - config::kL0_CompactionTrigger + 2;
+	}
+
+	Compaction* VersionSet::PickUniversalCompaction(Version* v, bool* by_count) {
+		std::vector<FileMetaData*> level0;
+		const size_t k = PickUniversalRuns(v, &level0, by_count);
+		if (k == 0) {
+			return NULL;
+		}
+
+		Compaction* c = new Compaction(0);
+		c->input_version_ = v;
+		c->input_version_->Ref();
+		if (k > level0.size() || (k == level0.size() && v->files_[1].empty())) {
+			// Reaches the oldest run: an ordinary level-0 compaction into
+			// level-1, which may also drop deletion markers.
+			c->inputs_[0] = level0;
+			SetupOtherInputs(c);
+		}
+		else {
+			// The newest runs become one level-0 file.  It is numbered above
+			// every input, so it is still read before the older runs.
+			c->inputs_[0].assign(level0.begin(), level0.begin() + k);
+			c->output_level_ = 0;
+			c->max_output_file_size_ = ~static_cast<uint64_t>(0);
+		}
+		return c;
+	}
+
+	size_t VersionSet::PickFIFODrops(Version* v, std::vector<FileMetaData*>* level0) const {
+		*level0 = v->files_[0];
+		std::sort(level0->begin(), level0->end(), OldestFirst);
+		const size_t n = level0->size();
+		uint64_t total = TotalFileSize(*level0);
+		size_t k = 0;
+		while (k < n && total > options_->fifo_max_table_files_size) {
+			total -= (*level0)[k]->file_size;
+			++k;
+		}
+
+		// Files are never merged, so the oldest files by number are also
+		// the oldest by creation time.  A file whose time is not loaded yet
+		// ends the scan.
+		const uint64_t ttl = options_->fifo_ttl_seconds;
+		const uint64_t now = env_->NowMicros() / 1000000;
+		if (ttl > 0 && now >= ttl) {
+			while (k < n && (*level0)[k]->creation_time != 0 &&
+				(*level0)[k]->creation_time <= now - ttl) {
+				++k;
+			}
+		}
+		return k;
+	}
+
+	Compaction* VersionSet::PickFIFOCompaction(Version* v) {
+		std::vector<FileMetaData*> level0;
+		const size_t k = PickFIFODrops(v, &level0);
+		if (k == 0) {
+			return NULL;
+		}
+
+		Compaction* c = new Compaction(0);
+		c->input_version_ = v;
+		c->input_version_->Ref();
+		c->inputs_[0].assign(level0.begin(), level0.begin() + k);
+		c->output_level_ = 0;
+		c->deletion_only_ = true;
+		return c;
+	}
+
+	bool VersionSet::NeedsTableTimes(Version* v) const {
+		if (!options_->compact_expired_files &&
+			(options_->compaction_style != kCompactionStyleFIFO ||
+				options_->fifo_ttl_seconds == 0)) {
+			return false;
+		}
+		for (unsigned level = 0; level < config::kNumLevels; level++) {
+			for (size_t i = 0; i < v->files_[level].size(); ++i) {
+				if (v->files_[level][i]->creation_time == 0) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void VersionSet::LoadTableTimes(Version* v, port::Mutex* mu) {
+		mu->AssertHeld();
+		if (!NeedsTableTimes(v)) {
+			return;
+		}
+		std::vector<FileMetaData*> unread;
+		for (unsigned level = 0; level < config::kNumLevels; level++) {
+			for (size_t i = 0; i < v->files_[level].size(); ++i) {
+				if (v->files_[level][i]->creation_time == 0) {
+					unread.push_back(v->files_[level][i]);
+				}
+			}
+		}
+
+		// Holding a reference to "v" keeps the files alive; only this
+		// thread writes creation_time.
+		v->Ref();
+		mu->Unlock();
+		const char* const names[2] = { kPropertyCreationTime, kPropertyMinExpiry };
+		std::vector<uint64_t> times(2 * unread.size(), ~static_cast<uint64_t>(0));
+		for (size_t i = 0; i < unread.size(); ++i) {
+			std::map<std::string, std::string> props;
+			if (!table_cache_->GetProperties(unread[i]->number, unread[i]->file_size, &props).ok()) {
+				continue;
+			}
+			for (int n = 0; n < 2; n++) {
+				std::map<std::string, std::string>::const_iterator it = props.find(names[n]);
+				if (it != props.end()) {
+					Slice input(it->second);
+					uint64_t t;
+					if (GetVarint64(&input, &t) && t != 0) {
+						times[2 * i + n] = t;
+					}
+				}
+			}
+		}
+		mu->Lock();
+		for (size_t i = 0; i < unread.size(); ++i) {
+			unread[i]->creation_time = times[2 * i];
+			unread[i]->min_expiry = times[2 * i + 1];
+		}
+		v->Unref();
+	}
+
+	FileMetaData* VersionSet::FindExpiredFile(Version* v, bool* locked, unsigned* level) const {
+		const uint64_t now = env_->NowMicros() / 1000000;
+		FileMetaData* result = NULL;
+		for (unsigned i = 1; i + 1 < config::kNumLevels; ++i) {
+			if (locked[i] || locked[i + 1]) {
+				continue;
+			}
+			for (size_t j = 0; j < v->files_[i].size(); ++j) {
+				FileMetaData* f = v->files_[i][j];
+				if (f->creation_time != 0 && f->min_expiry <= now &&
+					(result == NULL || f->min_expiry < result->min_expiry)) {
+					result = f;
+					*level = i;
+				}
+			}
+		}
+		return result;
+	}
+
+	Compaction* VersionSet::PickExpiredCompaction(Version* v, bool* locked) {
+		unsigned level = 0;
+		FileMetaData* f = FindExpiredFile(v, locked, &level);
+		if (f == NULL) {
+			return NULL;
+		}
+
+		Compaction* c = new Compaction(level);
+		c->input_version_ = v;
+		c->input_version_->Ref();
+		c->inputs_[0].push_back(f);
+		SetupOtherInputs(c);
+		return c;
+	}
+
+	bool VersionSet::NeedsCompaction(bool* levels, bool seek_driven, bool flush_pending) const {
+		if (options_->compaction_style == kCompactionStyleUniversal) {
+			std::vector<FileMetaData*> level0;
+			bool by_count;
+			return !flush_pending && !levels[0] && !levels[1] &&
+				PickUniversalRuns(current_, &level0, &by_count) > 0;
+		}
+		if (options_->compaction_style == kCompactionStyleFIFO) {
+			std::vector<FileMetaData*> level0;
+			if (levels[0] || levels[1]) {
+				return false;
+			}
+			return PickFIFODrops(current_, &level0) > 0 || NeedsTableTimes(current_);
+		}
+		if (PickCompactionLevel(levels, seek_driven, NULL) != config::kNumLevels) {
+			return true;
+		}
+		if (options_->compact_expired_files) {
+			unsigned level;
+			return NeedsTableTimes(current_) ||
+				FindExpiredFile(current_, levels, &level) != NULL;
+		}
+		return false;
+	}
+
 	void VersionSet::SetupOtherInputs(Compaction* c) {
 		const unsigned level = c->level();
 		assert(level + 1 < config::kNumLevels);
@@ -1607,14 +2207,17 @@ namespace leveldb {
 
 	Compaction::Compaction(unsigned l)
 		: level_(l),
+		output_level_(l + 1),
 		min_output_file_size_(MinFileSizeForLevel(l)),
 		max_output_file_size_(MaxFileSizeForLevel(l)),
 		input_version_(NULL),
 		edit_(),
-		boundaries_() {
-		for (unsigned i = 0; i < config::kNumLevels; i++) {
-			level_ptrs_[i] = 0;
-		}
+		trivial_move_(false),
+		deletion_only_(false),
+		boundaries_(),
+		base_fences_(),
+		base_fence_ptr_(0),
+		base_fences_built_(false) {
 	}
 
 #pragma GCC diagnostic push
@@ -1628,25 +2231,28 @@ namespace leveldb {
 
 #pragma GCC diagnostic pop
 
-	bool Compaction::CrossesBoundary(const ParsedInternalKey& old_key,
-		const ParsedInternalKey& new_key,
+	// Orders keys by KeyNum() first, so the comparator only breaks ties.
+	static inline int CompareNum(const Comparator* user_cmp,
+		const Slice& a, uint64_t a_num,
+		const Slice& b, uint64_t b_num) {
+		if (a_num != b_num) {
+			return a_num < b_num ? -1 : 1;
+		}
+		return user_cmp->Compare(a, b);
+	}
+
+	bool Compaction::CrossesBoundary(const Slice& old_key, uint64_t old_num,
+		const Slice& new_key, uint64_t new_num,
 		size_t* hint) const {
 		if (boundaries_.empty()) {
 			return false;
 		}
 		const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-		uint64_t lower_num = user_cmp->KeyNum(old_key.user_key);
-		uint64_t upper_num = user_cmp->KeyNum(new_key.user_key);
+		assert(CompareNum(user_cmp, old_key, old_num, new_key, new_num) <= 0);
 		while (*hint < boundaries_.size()) {
-			assert(lower_num < upper_num ||
-				(lower_num == upper_num &&
-					user_cmp->Compare(old_key.user_key, new_key.user_key) <= 0));
-			bool lower = lower_num < boundaries_[*hint].first ||
-				(lower_num == boundaries_[*hint].first &&
-					user_cmp->Compare(old_key.user_key, boundaries_[*hint].second) <= 0);
-			bool upper = upper_num > boundaries_[*hint].first ||
-				(upper_num == boundaries_[*hint].first &&
-					user_cmp->Compare(new_key.user_key, boundaries_[*hint].second) > 0);
+			const std::pair<uint64_t, Slice>& b = boundaries_[*hint];
+			bool lower = CompareNum(user_cmp, old_key, old_num, b.second, b.first) <= 0;
+			bool upper = CompareNum(user_cmp, new_key, new_num, b.second, b.first) > 0;
 			if (lower && upper) {
 				return true;
 			}
@@ -1661,7 +2267,7 @@ namespace leveldb {
 	}
 
 	bool Compaction::IsTrivialMove() const {
-		return num_input_files(1) == 0;
+		return trivial_move_;
 	}
 
 	void Compaction::AddInputDeletions(VersionEdit* ed) {
@@ -1672,27 +2278,89 @@ namespace leveldb {
 		}
 	}
 
-	bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
-		// Maybe use binary search to find right entry instead of linear search?
+	struct Compaction::BaseFenceOrder {
+		const Comparator* user_cmp;
+		explicit BaseFenceOrder(const Comparator* c) : user_cmp(c) {}
+		bool operator () (const BaseFence& a, const BaseFence& b) const {
+			return CompareNum(user_cmp, a.smallest, a.smallest_num,
+				b.smallest, b.smallest_num) < 0;
+		}
+	};
+
+	void Compaction::BuildBaseFences() {
+		base_fences_built_ = true;
+		if (inputs_[0].empty() && inputs_[1].empty()) {
+			return;
+		}
 		const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-		for (unsigned lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
-			const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-			for (; level_ptrs_[lvl] < files.size(); ) {
-				FileMetaData* f = files[level_ptrs_[lvl]];
-				if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
-					// We've advanced far enough
-					if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
-						// Key falls in this file's range, so definitely not base level
-						return false;
-					}
-					break;
+		InternalKey smallest, largest;
+		input_version_->vset_->GetRange2(inputs_[0], inputs_[1], &smallest, &largest);
+		std::vector<FileMetaData*> files;
+		for (unsigned lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+			input_version_->GetOverlappingInputs(lvl, &smallest, &largest, &files);
+			for (size_t i = 0; i < files.size(); i++) {
+				BaseFence f;
+				f.smallest = files[i]->smallest.user_key();
+				f.largest = files[i]->largest.user_key();
+				f.smallest_num = user_cmp->KeyNum(f.smallest);
+				f.largest_num = user_cmp->KeyNum(f.largest);
+				base_fences_.push_back(f);
+			}
+		}
+		if (base_fences_.empty()) {
+			return;
+		}
+
+		// Each level is already sorted and disjoint; merge the levels and
+		// coalesce overlapping ranges so one forward pointer suffices.
+		std::sort(base_fences_.begin(), base_fences_.end(), BaseFenceOrder(user_cmp));
+		size_t out = 0;
+		for (size_t i = 1; i < base_fences_.size(); i++) {
+			BaseFence* cur = &base_fences_[out];
+			const BaseFence& next = base_fences_[i];
+			if (CompareNum(user_cmp, next.smallest, next.smallest_num,
+				cur->largest, cur->largest_num) <= 0) {
+				if (CompareNum(user_cmp, next.largest, next.largest_num,
+					cur->largest, cur->largest_num) > 0) {
+					cur->largest = next.largest;
+					cur->largest_num = next.largest_num;
 				}
-				level_ptrs_[lvl]++;
+			}
+			else {
+				base_fences_[++out] = next;
+			}
+		}
+		base_fences_.resize(out + 1);
+	}
+
+	bool Compaction::IsBaseLevelForKey(const Slice& user_key, uint64_t key_num) {
+		if (output_level_ == level_) {
+			// A merge of level-0 runs that leaves older runs untouched
+			return false;
+		}
+		if (!base_fences_built_) {
+			BuildBaseFences();
+		}
+		const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+		for (; base_fence_ptr_ < base_fences_.size(); base_fence_ptr_++) {
+			const BaseFence& f = base_fences_[base_fence_ptr_];
+			if (CompareNum(user_cmp, user_key, key_num, f.largest, f.largest_num) <= 0) {
+				// We've advanced far enough; a key inside the range is
+				// definitely not at its base level
+				return CompareNum(user_cmp, user_key, key_num, f.smallest, f.smallest_num) < 0;
 			}
 		}
 		return true;
 	}
 
+	bool Compaction::IsFullCompaction() const {
+		size_t files = 0;
+		for (unsigned lvl = 0; lvl < config::kNumLevels; lvl++) {
+			files += input_version_->NumFiles(lvl);
+		}
+		return files == inputs_[0].size() + inputs_[1].size();
+	}
+
 	void Compaction::ReleaseInputs() {
 		if (input_version_ != NULL) {
 			input_version_->Unref();
@@ -17,8 +17,10 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 #include "db/dbformat.h"
+#include "db/file_index.h"
 #include "db/version_edit.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -57,6 +59,16 @@ namespace leveldb {
 		const Slice* smallest_user_key,
 		const Slice* largest_user_key);
 
+	// Space accounting for a blob file (see db/blob_file.h).  Compactions
+	// add to garbage_bytes the values they drop or move elsewhere; the file
+	// is forgotten once all of it is garbage.
+	struct BlobFileMetaData {
+		uint64_t total_bytes;
+		uint64_t garbage_bytes;
+
+		BlobFileMetaData() : total_bytes(0), garbage_bytes(0) { }
+	};
+
 	class Version {
 	public:
 		// Append to *iters a sequence of iterators that will
@@ -71,14 +83,16 @@ namespace leveldb {
 		void AddSomeIterators(const ReadOptions&, uint64_t num, std::vector<Iterator*>* iters);
 
 		// Lookup the value for key.  If found, store it in *val and
-		// return OK.  Else return a non-OK status.  Fills *stats.
+		// return OK.  Else return a non-OK status.  Values that expired at
+		// or before "now" (seconds since the epoch) are not found.  Fills
+		// *stats.
 		// REQUIRES: lock is not held
 		struct GetStats {
 			FileMetaData* seek_file;
 			int seek_file_level;
 		};
 		Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-			GetStats* stats);
+			GetStats* stats, uint64_t now);
 
 		// Adds "stats" into the current state.  Returns true if a new
 		// compaction may need to be triggered, false otherwise.
@@ -117,6 +131,20 @@ namespace leveldb {
 
 		size_t NumFiles(unsigned level) const { return files_[level].size(); }
 
+		// Return the compaction score computed for "level" by Finalize().  A
+		// score >= 1 means the level needs compacting; the last level has no
+		// score and returns -1.
+		double CompactionScore(unsigned level) const { return compaction_scores_[level]; }
+
+		// Return an estimate of the size of the live data in this version.
+		// Files are considered from the last level up, and a file whose key
+		// range overlaps a deeper level is assumed to hold only newer
+		// versions of keys already counted there.
+		uint64_t EstimateLiveDataSize();
+
+		// Return the blob files live in this version, by file number.
+		const std::map<uint64_t, BlobFileMetaData>& BlobFiles() const { return blob_files_; }
+
 		// Return a human readable string that describes this version's contents.
 		std::string DebugString() const;
 
@@ -144,6 +172,9 @@ namespace leveldb {
 									  // List of files per level
 		std::vector<FileMetaData*> files_[config::kNumLevels];
 
+		// Blob files referenced by the tables above
+		std::map<uint64_t, BlobFileMetaData> blob_files_;
+
 		// Next file to compact based on seek stats.
 		FileMetaData* file_to_compact_;
 		int file_to_compact_level_;
@@ -153,10 +184,15 @@ namespace leveldb {
 		// are initialized by Finalize().
 		double compaction_scores_[config::kNumLevels];
 
+		// Search structure over files_ for Get(); built by Finalize()
+		FileIndex index_;
+
 		explicit Version(VersionSet* vset)
 			: vset_(vset), next_(this), prev_(this), refs_(0),
+			blob_files_(),
 			file_to_compact_(NULL),
-			file_to_compact_level_(-1) {
+			file_to_compact_level_(-1),
+			index_() {
 			for (unsigned i = 0; i < config::kNumLevels; ++i) {
 				compaction_scores_[i] = -1;
 			}
@@ -188,6 +224,16 @@ namespace leveldb {
 		// Recover the last saved descriptor from persistent storage.
 		Status Recover();
 
+		// For a descriptor another process is writing: apply the records
+		// added since Recover() or the previous call, reading the whole
+		// descriptor CURRENT names if that has changed, and install the
+		// result as the current version.  Stops before a record that is
+		// incomplete or corrupt.  Sets *changed iff a version was
+		// installed.  Will release *mu while reading the file.
+		// REQUIRES: *mu is held on entry.
+		// REQUIRES: no other thread concurrently calls CatchUp() or LogAndApply()
+		Status CatchUp(port::Mutex* mu, bool* changed) EXCLUSIVE_LOCKS_REQUIRED(mu);
+
 		// Return the current version.
 		Version* current() const { return current_; }
 
@@ -232,10 +278,26 @@ namespace leveldb {
 		// being compacted, or zero if there is no such log file.
 		uint64_t PrevLogNumber() const { return prev_log_number_; }
 
+		// The column families other than the default one, by id, as
+		// recorded by VersionEdit::AddColumnFamily(), and the ids of those
+		// that have been dropped since.
+		const std::map<uint32_t, std::string>& ColumnFamilies() const {
+			return column_families_;
+		}
+		const std::set<uint32_t>& DroppedColumnFamilies() const {
+			return dropped_column_families_;
+		}
+
+		// Return an id no column family has ever had.
+		uint32_t NextColumnFamilyID() const;
+
 		// Pick level for a new compaction.
 		// Returns kNumLevels if there is no compaction to be done.
 		// Otherwise returns the lowest unlocked level that may compact upwards.
-		unsigned PickCompactionLevel(bool* locked, bool seek_driven) const;
+		// If "by_seek" is non-NULL, sets it to true iff the level was picked
+		// for its file_to_compact_ rather than for its size.
+		unsigned PickCompactionLevel(bool* locked, bool seek_driven,
+			bool* by_seek) const;
 
 		// Pick inputs for a new compaction at the specified level.
 		// Returns NULL if there is no compaction to be done.
@@ -243,6 +305,33 @@ namespace leveldb {
 		// describes the compaction.  Caller should delete the result.
 		Compaction* PickCompaction(Version* v, unsigned level);
 
+		// For kCompactionStyleUniversal: pick the sorted runs of "v" to
+		// merge, or return NULL if none need merging.  Sets *by_count to
+		// true iff the runs were picked only to reduce their number.  A
+		// result whose output_level() is 0 must get its output file number
+		// before any later memtable output does.  Caller should delete the
+		// result.
+		Compaction* PickUniversalCompaction(Version* v, bool* by_count);
+
+		// For kCompactionStyleFIFO: pick the oldest level-0 files of "v" that
+		// are over the size or age limit, or return NULL if there are none.
+		// The result only deletes its inputs (see IsDeletionCompaction()).
+		// Caller should delete the result.
+		Compaction* PickFIFOCompaction(Version* v);
+
+		// If fifo_ttl_seconds or compact_expired_files need them, read the
+		// creation and earliest expiry times of every file of "v" that has
+		// not been read yet.  Releases *mu while reading.
+		// REQUIRES: *mu is held on entry.
+		void LoadTableTimes(Version* v, port::Mutex* mu)
+			EXCLUSIVE_LOCKS_REQUIRED(mu);
+
+		// For compact_expired_files: pick a file of "v" in an unlocked level
+		// whose earliest expiry time has passed and compact it into the
+		// next level, or return NULL if there is none.  Caller should delete
+		// the result.
+		Compaction* PickExpiredCompaction(Version* v, bool* locked);
+
 		// Return a compaction object for compacting the range [begin,end] in
 		// the specified level.  Returns NULL if there is nothing in that
 		// level that overlaps the specified range.  Caller should delete
@@ -256,14 +345,19 @@ namespace leveldb {
 		// file at a level >= 1.
 		int64_t MaxNextLevelOverlappingBytes();
 
+		// Return an estimate of the number of bytes compactions must rewrite
+		// to bring every level of the current version under its size limit.
+		uint64_t EstimatePendingCompactionBytes() const;
+
 		// Create an iterator that reads over the compaction inputs for "*c".
 		// The caller should delete the iterator when no longer needed.
 		Iterator* MakeInputIterator(Compaction* c);
 
-		// Returns true iff some level needs a compaction.
-		bool NeedsCompaction(bool* levels, bool seek_driven) const {
-			return PickCompactionLevel(levels, seek_driven) != config::kNumLevels;
-		}
+		// Returns true iff some level needs a compaction, or table times
+		// need to be loaded (see LoadTableTimes()).  Universal
+		// compactions wait while "flush_pending" (a memtable is being
+		// written to level-0).
+		bool NeedsCompaction(bool* levels, bool seek_driven, bool flush_pending) const;
 
 		// Add all files listed in any live version to *live.
 		// May also mutate some internal state.
@@ -305,13 +399,36 @@ namespace leveldb {
 			std::vector<uint64_t>* LB_sizes,
 			std::vector<class CompactionBoundary>* boundaries);
 
+		// True iff moving f from "level" to level+1 leaves it overlapping
+		// few enough bytes in level+2.
+		bool GrandparentOverlapAllowsMove(Version* v, unsigned level, const FileMetaData* f);
+
 		void SetupOtherInputs(Compaction* c);
 
-		// Save current contents to *log
-		Status WriteSnapshot(log::Writer* log);
+		// Level-0 files newest first followed by level-1, if non-empty, as a
+		// single run.  Returns the number of newest runs to merge, 0 if none.
+		size_t PickUniversalRuns(Version* v, std::vector<FileMetaData*>* level0,
+			bool* by_count) const;
+
+		// Level-0 files oldest first.  Returns the number of oldest files to
+		// drop, 0 if none.
+		size_t PickFIFODrops(Version* v, std::vector<FileMetaData*>* level0) const;
+
+		// True iff the options use table times and some file of "v" has not
+		// had them read.
+		bool NeedsTableTimes(Version* v) const;
+
+		// The unlocked file with the earliest expired min_expiry in levels 1
+		// to kNumLevels-2, or NULL.
+		FileMetaData* FindExpiredFile(Version* v, bool* locked, unsigned* level) const;
+
+		// Encode the current contents as a single descriptor record
+		void EncodeSnapshot(std::string* record);
 
 		void AppendVersion(Version* v);
 
+		void ApplyColumnFamilies(const VersionEdit& edit);
+
 		Env* const env_;
 		const std::string dbname_;
 		const Options* const options_;
@@ -326,6 +443,7 @@ namespace leveldb {
 									// Opened lazily
 		ConcurrentWritableFile* descriptor_file_;
 		log::Writer* descriptor_log_;
+		uint64_t descriptor_size_;   // Record bytes written to descriptor_log_
 		Version dummy_versions_;  // Head of circular doubly-linked list of versions.
 		Version* current_;        // == dummy_versions_.prev_
 
@@ -333,6 +451,14 @@ namespace leveldb {
 								  // Either an empty string, or a valid InternalKey.
 		std::string compact_pointer_[config::kNumLevels];
 
+		std::map<uint32_t, std::string> column_families_;
+		std::set<uint32_t> dropped_column_families_;
+
+		// The descriptor Recover() or CatchUp() read last, and the offset
+		// of the last record read from it
+		std::string tail_descriptor_;
+		uint64_t tail_offset_;
+
 		// No copying allowed
 		VersionSet(const VersionSet&);
 		void operator=(const VersionSet&);
@@ -347,6 +473,10 @@ namespace leveldb {
 		// and "level+1" will be merged to produce a set of "level+1" files.
 		unsigned level() const { return level_; }
 
+		// Level the outputs are added to: level()+1, except for universal
+		// compactions that merge level-0 files into a new level-0 file.
+		unsigned output_level() const { return output_level_; }
+
 		// Return the object that holds the edits to the descriptor done
 		// by this compaction.
 		VersionEdit* edit() { return &edit_; }
@@ -364,22 +494,32 @@ namespace leveldb {
 		uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
 
 		// Does the transition from old_key to new_key cross any boundaries at a
-		// higher level?
-		bool CrossesBoundary(const ParsedInternalKey& old_key,
-			const ParsedInternalKey& new_key,
+		// higher level?  old_num and new_num are the comparator's KeyNum() of
+		// the two keys, which the caller already has at hand.
+		bool CrossesBoundary(const Slice& old_key, uint64_t old_num,
+			const Slice& new_key, uint64_t new_num,
 			size_t* hint) const;
 
 		// Is this a trivial compaction that can be implemented by just
-		// moving a single input file to the next level (no merging or splitting)
+		// moving the level() input files to the next level (no merging or
+		// splitting)?  Only PickCompaction() picks such compactions.
 		bool IsTrivialMove() const;
 
+		// Does this compaction only delete its level() inputs, writing
+		// nothing?  Only PickFIFOCompaction() picks such compactions.
+		bool IsDeletionCompaction() const { return deletion_only_; }
+
 		// Add all inputs to this compaction as delete operations to *edit.
 		void AddInputDeletions(VersionEdit* edit);
 
 		// Returns true if the information we have available guarantees that
 		// the compaction is producing data in "level+1" for which no data exists
-		// in levels greater than "level+1".
-		bool IsBaseLevelForKey(const Slice& user_key);
+		// in levels greater than "level+1".  key_num must be the comparator's
+		// KeyNum() of user_key, and successive calls must not go backwards.
+		bool IsBaseLevelForKey(const Slice& user_key, uint64_t key_num);
+
+		// Do the inputs cover every file of the input version?
+		bool IsFullCompaction() const;
 
 		// Release the input version for the compaction, once the compaction
 		// is successful.
@@ -394,10 +534,13 @@ namespace leveldb {
 		explicit Compaction(unsigned level);
 
 		unsigned level_;
+		unsigned output_level_;
 		uint64_t min_output_file_size_;
 		uint64_t max_output_file_size_;
 		Version* input_version_;
 		VersionEdit edit_;
+		bool trivial_move_;
+		bool deletion_only_;
 
 		// Each compaction reads inputs from "level_" and "level_+1", and avoids
 		// writing generating overlap in "level_+2".
@@ -406,11 +549,21 @@ namespace leveldb {
 
 		// State for implementing IsBaseLevelForKey
 
-		// level_ptrs_ holds indices into input_version_->levels_: our state
-		// is that we are positioned at one of the file ranges for each
-		// higher level than the ones involved in this compaction (i.e. for
-		// all L >= level_ + 2).
-		size_t level_ptrs_[config::kNumLevels];
+		// The user key ranges of every file in a level below output_level_
+		// that overlaps this compaction, merged into sorted, disjoint
+		// intervals.  Built on first use; base_fence_ptr_ is the first
+		// interval whose largest key is not behind the last key asked about.
+		struct BaseFence {
+			uint64_t smallest_num;
+			uint64_t largest_num;
+			Slice smallest;
+			Slice largest;
+		};
+		struct BaseFenceOrder;
+		void BuildBaseFences();
+		std::vector<BaseFence> base_fences_;
+		size_t base_fence_ptr_;
+		bool base_fences_built_;
 	};
 
 }  // namespace leveldb
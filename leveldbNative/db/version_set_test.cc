@@ -17,8 +17,10 @@
 #include "util/testharness.h"
 #include "util/testutil.h"
 
+#include "db/file_index.h"
 #include "db/version_set.h"
 #include "util/logging.h"
+#include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
 
@@ -187,4 +189,142 @@ namespace leveldb {
 		ASSERT_TRUE(Overlaps("600", "700"));
 	}
 
+	class FileIndexTest {
+	public:
+		InternalKeyComparator icmp_;
+		std::vector<FileMetaData*> files_[config::kNumLevels];
+		std::string format_;
+		bool strip_zeros_;    // Drop trailing '0's; keeps the order, varies lengths
+		int max_error_;       // Learned index error bound passed to Build()
+
+		FileIndexTest()
+			: icmp_(BytewiseComparator()),
+			format_(),
+			strip_zeros_(false),
+			max_error_(0) {
+		}
+
+		~FileIndexTest() {
+			for (unsigned level = 0; level < config::kNumLevels; level++) {
+				for (size_t i = 0; i < files_[level].size(); i++) {
+					delete files_[level][i];
+				}
+			}
+		}
+
+		std::string Key(int k) {
+			char buf[100];
+			snprintf(buf, sizeof(buf), format_.c_str(), strip_zeros_ ? k + 1000 : k);
+			std::string key = buf;
+			while (strip_zeros_ && key.size() > 1 && key[key.size() - 1] == '0') {
+				key.resize(key.size() - 1);
+			}
+			return key;
+		}
+
+		// Fill every level but "empty_level" with disjoint sorted files over
+		// keys in [0, 1000), and level-0 with overlapping ones.
+		void Fill(Random* rnd, unsigned empty_level) {
+			uint64_t number = 1;
+			for (unsigned level = 1; level < config::kNumLevels; level++) {
+				if (level == empty_level) continue;
+				int k = rnd->Uniform(20);
+				while (k < 1000) {
+					int end = k + rnd->Uniform(level * 10);
+					FileMetaData* f = new FileMetaData;
+					f->number = number++;
+					f->smallest = InternalKey(Key(k), 100, kTypeValue);
+					f->largest = InternalKey(Key(end), 100, kTypeValue);
+					files_[level].push_back(f);
+					k = end + 1 + rnd->Uniform(20);
+				}
+			}
+			for (int i = 0; i < 8; i++) {
+				int k = rnd->Uniform(1000);
+				FileMetaData* f = new FileMetaData;
+				f->number = number++;
+				f->smallest = InternalKey(Key(k), 100, kTypeValue);
+				f->largest = InternalKey(Key(k + rnd->Uniform(200)), 100, kTypeValue);
+				files_[0].push_back(f);
+			}
+		}
+
+		void Check(Random* rnd) {
+			FileIndex index;
+			index.Build(&icmp_, files_, max_error_);
+			for (int n = 0; n < 2000; n++) {
+				const std::string user_key = Key(rnd->Uniform(1100));
+				const uint64_t prefix = index.KeyPrefix(user_key);
+				SequenceNumber seq = rnd->OneIn(2) ? 100 : 50 + rnd->Uniform(100);
+				InternalKey ikey(user_key, seq, kTypeValue);
+
+				for (uint32_t i = 0; i < index.NumFiles(0); i++) {
+					const FileMetaData* f = index.File(0, i);
+					bool overlaps = user_key >= f->smallest.user_key().ToString() &&
+						user_key <= f->largest.user_key().ToString();
+					ASSERT_EQ(overlaps, index.Level0Overlaps(i, user_key, prefix));
+					if (i > 0) {
+						ASSERT_GT(index.File(0, i - 1)->number, f->number);
+					}
+				}
+
+				FileIndex::Hint hint;
+				for (unsigned level = 1; level < config::kNumLevels; level++) {
+					if (files_[level].empty()) continue;
+					uint32_t expected = FindFile(icmp_, files_[level], ikey.Encode());
+					ASSERT_EQ(expected, index.FindFile(level, ikey.Encode(), prefix, &hint));
+					if (expected < files_[level].size()) {
+						bool before = user_key < files_[level][expected]->smallest.user_key().ToString();
+						ASSERT_EQ(before, index.BeforeFile(level, expected, user_key, prefix));
+					}
+				}
+			}
+		}
+	};
+
+	TEST(FileIndexTest, DistinctPrefixes) {
+		Random rnd(301);
+		format_ = "%07d";
+		Fill(&rnd, 3);
+		Check(&rnd);
+	}
+
+	TEST(FileIndexTest, SharedPrefixes) {
+		// All keys share their first eight bytes, so every decision goes
+		// through the comparator.
+		Random rnd(302);
+		format_ = "commonprefix%04d";
+		Fill(&rnd, 5);
+		Check(&rnd);
+	}
+
+	TEST(FileIndexTest, ShortKeys) {
+		// Keys of different lengths, most shorter than a prefix, e.g. "1",
+		// "101" and "11".
+		Random rnd(303);
+		format_ = "%d";
+		strip_zeros_ = true;
+		Fill(&rnd, 1);
+		Check(&rnd);
+	}
+
+	TEST(FileIndexTest, LearnedIndex) {
+		Random rnd(304);
+		format_ = "%07d";
+		max_error_ = 1;
+		Fill(&rnd, 2);
+		Check(&rnd);
+	}
+
+	TEST(FileIndexTest, LearnedIndexShortKeys) {
+		// KeyNum() of these keys is far from linear in their rank, so many
+		// predicted windows miss and FindFile() must fall back.
+		Random rnd(305);
+		format_ = "%d";
+		strip_zeros_ = true;
+		max_error_ = 2;
+		Fill(&rnd, 4);
+		Check(&rnd);
+	}
+
 }  // namespace leveldb
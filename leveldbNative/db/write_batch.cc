@@ -8,7 +8,14 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeValueWithExpiry varstring varstring |
+//    kTypeColumnFamilyValue varint32 varstring varstring         |
+//    kTypeColumnFamilyDeletion varint32 varstring                |
+//    kTypeColumnFamilyValueWithExpiry varint32 varstring varstring
+// (the second varstring of kTypeValueWithExpiry is the value followed by
+// the fixed64 expiry time, as stored in memtables and tables; the
+// varint32 of the column family types is the column family id)
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -17,6 +24,7 @@
 
 #include "leveldb/write_batch.h"
 
+#include <algorithm>
 #include "leveldb/db.h"
 #include "db/dbformat.h"
 #include "db/memtable.h"
@@ -37,6 +45,22 @@ namespace leveldb {
 
 	WriteBatch::Handler::~Handler() { }
 
+	void WriteBatch::Handler::PutWithExpiry(const Slice& key, const Slice& value, uint64_t /*expiry*/) {
+		Put(key, value);
+	}
+
+	void WriteBatch::Handler::PutCF(uint32_t /*column_family_id*/, const Slice& /*key*/,
+		const Slice& /*value*/) {
+	}
+
+	void WriteBatch::Handler::DeleteCF(uint32_t /*column_family_id*/, const Slice& /*key*/) {
+	}
+
+	void WriteBatch::Handler::PutWithExpiryCF(uint32_t column_family_id, const Slice& key,
+		const Slice& value, uint64_t /*expiry*/) {
+		PutCF(column_family_id, key, value);
+	}
+
 	void WriteBatch::Clear() {
 		rep_.clear();
 		rep_.resize(kHeader);
@@ -50,6 +74,7 @@ namespace leveldb {
 
 		input.remove_prefix(kHeader);
 		Slice key, value;
+		uint32_t id;
 		int found = 0;
 		while (!input.empty()) {
 			found++;
@@ -73,6 +98,46 @@ namespace leveldb {
 					return Status::Corruption("bad WriteBatch Delete");
 				}
 				break;
+			case kTypeValueWithExpiry:
+				if (GetLengthPrefixedSlice(&input, &key) &&
+					GetLengthPrefixedSlice(&input, &value) &&
+					value.size() >= 8) {
+					handler->PutWithExpiry(key, StripExpiry(value), ExtractExpiry(value));
+				}
+				else {
+					return Status::Corruption("bad WriteBatch PutWithExpiry");
+				}
+				break;
+			case kTypeColumnFamilyValue:
+				if (GetVarint32(&input, &id) &&
+					GetLengthPrefixedSlice(&input, &key) &&
+					GetLengthPrefixedSlice(&input, &value)) {
+					handler->PutCF(id, key, value);
+				}
+				else {
+					return Status::Corruption("bad WriteBatch PutCF");
+				}
+				break;
+			case kTypeColumnFamilyDeletion:
+				if (GetVarint32(&input, &id) &&
+					GetLengthPrefixedSlice(&input, &key)) {
+					handler->DeleteCF(id, key);
+				}
+				else {
+					return Status::Corruption("bad WriteBatch DeleteCF");
+				}
+				break;
+			case kTypeColumnFamilyValueWithExpiry:
+				if (GetVarint32(&input, &id) &&
+					GetLengthPrefixedSlice(&input, &key) &&
+					GetLengthPrefixedSlice(&input, &value) &&
+					value.size() >= 8) {
+					handler->PutWithExpiryCF(id, key, StripExpiry(value), ExtractExpiry(value));
+				}
+				else {
+					return Status::Corruption("bad WriteBatch PutWithExpiryCF");
+				}
+				break;
 			default:
 				return Status::Corruption("unknown WriteBatch tag");
 			}
@@ -101,41 +166,139 @@ namespace leveldb {
 		EncodeFixed64(&b->rep_[0], seq);
 	}
 
+	// Start a record of type "type" for the default column family, or of
+	// the matching column family type for any other.
+	static void PutRecordTag(std::string* rep, ColumnFamilyHandle* column_family,
+		ValueType type, ValueType cf_type) {
+		const uint32_t id = column_family != NULL ? column_family->GetID() : 0;
+		if (id == 0) {
+			rep->push_back(static_cast<char>(type));
+		}
+		else {
+			rep->push_back(static_cast<char>(cf_type));
+			PutVarint32(rep, id);
+		}
+	}
+
 	void WriteBatch::Put(const Slice& key, const Slice& value) {
+		Put(NULL, key, value);
+	}
+
+	void WriteBatch::PutWithExpiry(const Slice& key, const Slice& value, uint64_t expiry) {
+		PutWithExpiry(NULL, key, value, expiry);
+	}
+
+	void WriteBatch::Delete(const Slice& key) {
+		Delete(NULL, key);
+	}
+
+	void WriteBatch::Put(ColumnFamilyHandle* column_family, const Slice& key,
+		const Slice& value) {
 		WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
-		rep_.push_back(static_cast<char>(kTypeValue));
+		PutRecordTag(&rep_, column_family, kTypeValue, kTypeColumnFamilyValue);
 		PutLengthPrefixedSlice(&rep_, key);
 		PutLengthPrefixedSlice(&rep_, value);
 	}
 
-	void WriteBatch::Delete(const Slice& key) {
+	void WriteBatch::PutWithExpiry(ColumnFamilyHandle* column_family, const Slice& key,
+		const Slice& value, uint64_t expiry) {
+		WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+		PutRecordTag(&rep_, column_family, kTypeValueWithExpiry,
+			kTypeColumnFamilyValueWithExpiry);
+		PutLengthPrefixedSlice(&rep_, key);
+		PutVarint32(&rep_, static_cast<uint32_t>(value.size() + 8));
+		rep_.append(value.data(), value.size());
+		PutFixed64(&rep_, expiry);
+	}
+
+	void WriteBatch::Delete(ColumnFamilyHandle* column_family, const Slice& key) {
 		WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
-		rep_.push_back(static_cast<char>(kTypeDeletion));
+		PutRecordTag(&rep_, column_family, kTypeDeletion, kTypeColumnFamilyDeletion);
 		PutLengthPrefixedSlice(&rep_, key);
 	}
 
 	namespace {
+		// Every entry takes a sequence number, whether or not its column
+		// family has a memtable to add it to.
 		class MemTableInserter : public WriteBatch::Handler {
 		public:
 			MemTableInserter()
 				: sequence_(),
-				mem_() {
+				mem_(),
+				families_(NULL) {
 			}
 			SequenceNumber sequence_;
-			MemTable* mem_;
+			MemTable* mem_;                                 // Default column family
+			const ColumnFamilyMemTables* families_;         // NULL if only mem_
 
 			virtual void Put(const Slice& key, const Slice& value) {
-				mem_->Add(sequence_, kTypeValue, key, value);
-				sequence_++;
+				Add(mem_, kTypeValue, key, value);
 			}
 			virtual void Delete(const Slice& key) {
-				mem_->Add(sequence_, kTypeDeletion, key, Slice());
-				sequence_++;
+				Add(mem_, kTypeDeletion, key, Slice());
+			}
+			virtual void PutWithExpiry(const Slice& key, const Slice& value, uint64_t expiry) {
+				std::string stored(value.data(), value.size());
+				PutFixed64(&stored, expiry);
+				Add(mem_, kTypeValueWithExpiry, key, stored);
+			}
+			virtual void PutCF(uint32_t id, const Slice& key, const Slice& value) {
+				Add(Find(id), kTypeValue, key, value);
+			}
+			virtual void DeleteCF(uint32_t id, const Slice& key) {
+				Add(Find(id), kTypeDeletion, key, Slice());
 			}
+			virtual void PutWithExpiryCF(uint32_t id, const Slice& key, const Slice& value,
+				uint64_t expiry) {
+				std::string stored(value.data(), value.size());
+				PutFixed64(&stored, expiry);
+				Add(Find(id), kTypeValueWithExpiry, key, stored);
+			}
+
+			MemTable* Find(uint32_t id) const {
+				if (families_ != NULL) {
+					for (size_t i = 0; i < families_->size(); i++) {
+						if ((*families_)[i].first == id) {
+							return (*families_)[i].second;
+						}
+					}
+				}
+				return NULL;
+			}
+
 		private:
+			void Add(MemTable* mem, ValueType type, const Slice& key, const Slice& value) {
+				if (mem != NULL) {
+					mem->Add(sequence_, type, key, value);
+				}
+				sequence_++;
+			}
+
 			MemTableInserter(const MemTableInserter&);
 			MemTableInserter& operator = (const MemTableInserter&);
 		};
+
+		class ColumnFamilyCollector : public WriteBatch::Handler {
+		public:
+			explicit ColumnFamilyCollector(std::vector<uint32_t>* ids) : ids_(ids) { }
+
+			virtual void Put(const Slice&, const Slice&) { Note(0); }
+			virtual void Delete(const Slice&) { Note(0); }
+			virtual void PutCF(uint32_t id, const Slice&, const Slice&) { Note(id); }
+			virtual void DeleteCF(uint32_t id, const Slice&) { Note(id); }
+
+		private:
+			void Note(uint32_t id) {
+				if (std::find(ids_->begin(), ids_->end(), id) == ids_->end()) {
+					ids_->push_back(id);
+				}
+			}
+
+			std::vector<uint32_t>* const ids_;
+
+			ColumnFamilyCollector(const ColumnFamilyCollector&);
+			ColumnFamilyCollector& operator = (const ColumnFamilyCollector&);
+		};
 	}  // namespace
 
 	Status WriteBatchInternal::InsertInto(const WriteBatch* b,
@@ -146,6 +309,22 @@ namespace leveldb {
 		return b->Iterate(&inserter);
 	}
 
+	Status WriteBatchInternal::InsertInto(const WriteBatch* b,
+		const ColumnFamilyMemTables& memtables) {
+		MemTableInserter inserter;
+		inserter.sequence_ = WriteBatchInternal::Sequence(b);
+		inserter.families_ = &memtables;
+		inserter.mem_ = inserter.Find(0);
+		return b->Iterate(&inserter);
+	}
+
+	Status WriteBatchInternal::ColumnFamilies(const WriteBatch* b,
+		std::vector<uint32_t>* ids) {
+		ids->clear();
+		ColumnFamilyCollector collector(ids);
+		return b->Iterate(&collector);
+	}
+
 	void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
 		assert(contents.size() >= kHeader);
 		b->rep_.assign(contents.data(), contents.size());
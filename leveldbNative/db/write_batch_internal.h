@@ -5,12 +5,18 @@
 #ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
+#include <utility>
+#include <vector>
 #include "leveldb/write_batch.h"
 
 namespace leveldb {
 
 	class MemTable;
 
+	// The memtable of each column family a batch is inserted into, by
+	// column family id.
+	typedef std::vector<std::pair<uint32_t, MemTable*> > ColumnFamilyMemTables;
+
 	// WriteBatchInternal provides static methods for manipulating a
 	// WriteBatch that we don't want in the public WriteBatch interface.
 	class WriteBatchInternal {
@@ -38,8 +44,19 @@ namespace leveldb {
 
 		static void SetContents(WriteBatch* batch, const Slice& contents);
 
+		// Insert the entries of the default column family into "memtable",
+		// and skip the others.
 		static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
+		// Insert each entry into the memtable of its column family, and
+		// skip the entries of families "memtables" does not list.
+		static Status InsertInto(const WriteBatch* batch,
+			const ColumnFamilyMemTables& memtables);
+
+		// Store the ids of the column families the batch writes to in *ids,
+		// in order of first appearance.
+		static Status ColumnFamilies(const WriteBatch* batch, std::vector<uint32_t>* ids);
+
 		static void Append(WriteBatch* dst, const WriteBatch* src);
 	};
 
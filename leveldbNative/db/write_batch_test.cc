@@ -55,6 +55,16 @@ namespace leveldb {
 				state.append(")");
 				count++;
 				break;
+			case kTypeValueWithExpiry:
+				state.append("PutWithExpiry(");
+				state.append(ikey.user_key.ToString());
+				state.append(", ");
+				state.append(StripExpiry(iter->value()).ToString());
+				state.append(", ");
+				state.append(NumberToString(ExtractExpiry(iter->value())));
+				state.append(")");
+				count++;
+				break;
 			}
 			state.append("@");
 			state.append(NumberToString(ikey.sequence));
@@ -92,6 +102,17 @@ namespace leveldb {
 			PrintContents(&batch));
 	}
 
+	TEST(WriteBatchTest, PutWithExpiry) {
+		WriteBatch batch;
+		batch.PutWithExpiry(Slice("foo"), Slice("bar"), 1234567890123ull);
+		batch.PutWithExpiry(Slice("baz"), Slice(), 7);
+		WriteBatchInternal::SetSequence(&batch, 100);
+		ASSERT_EQ(2, WriteBatchInternal::Count(&batch));
+		ASSERT_EQ("PutWithExpiry(baz, , 7)@101"
+			"PutWithExpiry(foo, bar, 1234567890123)@100",
+			PrintContents(&batch));
+	}
+
 	TEST(WriteBatchTest, Corruption) {
 		WriteBatch batch;
 		batch.Put(Slice("foo"), Slice("bar"));
@@ -81,6 +81,16 @@ namespace leveldb {
 		// its cache keys.
 		virtual uint64_t NewId() = 0;
 
+		// Return an estimate of the combined charges of all elements stored
+		// in the cache.  The default implementation returns 0.
+		virtual size_t TotalCharge() const { return 0; }
+
+		// Return the combined charges of the elements that are currently
+		// held through a handle returned by Insert() or Lookup().  Pinned
+		// elements cannot be evicted until they are released.  The default
+		// implementation returns 0.
+		virtual size_t PinnedCharge() const { return 0; }
+
 	private:
 		void LRU_Remove(Handle* e);
 		void LRU_Append(Handle* e);
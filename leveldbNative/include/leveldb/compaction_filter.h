@@ -0,0 +1,57 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A CompactionFilter installed in Options::compaction_filter lets the
+// application remove or rewrite values while compactions copy them, e.g.
+// to garbage collect data it knows to be stale without issuing deletes.
+//
+// The filter only sees the newest value of a key, and only once no live
+// snapshot could see an older one; values written after the oldest live
+// snapshot wait for a later compaction.  Memtable flushes do not call it.
+// Calls come from the DB's compaction thread, without the DB mutex held.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+namespace leveldb {
+
+	class Slice;
+
+	class CompactionFilter {
+	public:
+		struct Context {
+			Context()
+				: level(0),
+				output_level(1),
+				is_full_compaction(false),
+				is_manual_compaction(false) {
+			}
+
+			int level;                  // level the inputs are compacted from
+			int output_level;           // level the outputs are written to
+			bool is_full_compaction;    // the inputs are every table of the DB
+			bool is_manual_compaction;  // started by DB::CompactRange()
+		};
+
+		virtual ~CompactionFilter();
+
+		// Return true to remove the entry for "key".  Otherwise, to replace
+		// "existing_value", store the new value in *new_value and set
+		// *value_changed to true.  A removed entry becomes a deletion marker
+		// where older values of the key may still exist in deeper levels.
+		virtual bool Filter(const Context& context,
+			const Slice& key,
+			const Slice& existing_value,
+			std::string* new_value,
+			bool* value_changed) const = 0;
+
+		// Return the name of this filter.
+		virtual const char* Name() const = 0;
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
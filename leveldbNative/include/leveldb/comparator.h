@@ -53,7 +53,8 @@ namespace leveldb {
 		// i.e., an implementation of this method that does nothing is correct.
 		virtual void FindShortSuccessor(std::string* key) const = 0;
 
-		// If unsure, return 0;
+		// Map a key to an integer such that a < b implies KeyNum(a) <=
+		// KeyNum(b).  If unsure, return 0;
 		virtual uint64_t KeyNum(const Slice& key) const;
 	};
 
@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/replay_iterator.h"
@@ -30,6 +32,43 @@ namespace leveldb {
 		virtual ~Snapshot();
 	};
 
+	// Name of the column family every database has.  Open() without a
+	// list of column families, and the methods that take no
+	// ColumnFamilyHandle, use it.
+	extern const char* kDefaultColumnFamilyName;
+
+	// A column family is a keyspace of a DB with its own memtable, tables
+	// and options.  All the column families of a DB share its log and its
+	// background threads, and a WriteBatch may update several of them
+	// atomically.
+	//
+	// Handles are owned by the DB and stay valid, even for a column family
+	// that has been dropped, until the DB is deleted.
+	class ColumnFamilyHandle {
+	public:
+		virtual const std::string& GetName() const = 0;
+		virtual uint32_t GetID() const = 0;
+
+	protected:
+		virtual ~ColumnFamilyHandle();
+	};
+
+	struct ColumnFamilyDescriptor {
+		std::string name;
+
+		// Options for the column family.  Those that concern the whole
+		// database (env, info_log, create_if_missing, error_if_exists,
+		// paranoid_checks, statistics, listener, manual_garbage_collection,
+		// max_file_opening_threads and warm_table_cache) are taken from
+		// the options the DB is opened with instead.  A NULL block_cache
+		// shares the DB's.
+		Options options;
+
+		ColumnFamilyDescriptor() : name(kDefaultColumnFamilyName), options() { }
+		ColumnFamilyDescriptor(const std::string& n, const Options& o)
+			: name(n), options(o) { }
+	};
+
 	// A range of keys
 	struct Range {
 		Slice start;          // Included in the range
@@ -53,6 +92,51 @@ namespace leveldb {
 			const std::string& name,
 			DB** dbptr);
 
+		// Open the database with the specified "name" and column families.
+		// Every column family the database has must be listed; those that
+		// do not exist yet are created if options.create_if_missing is
+		// set.  If the default column family is listed, its options are
+		// used for it; otherwise "options" are.
+		// On success stores a handle for each column family in *handles,
+		// in the order of "column_families", and the database in *dbptr.
+		static Status Open(const Options& options,
+			const std::string& name,
+			const std::vector<ColumnFamilyDescriptor>& column_families,
+			std::vector<ColumnFamilyHandle*>* handles,
+			DB** dbptr);
+
+		// Open the database with the specified "name" for reading only.
+		// The LOCK file is not taken, so another process may have the
+		// database open for writing, and nothing in the directory is
+		// created, changed or deleted; unless options.info_log is set,
+		// nothing is logged.  Every column family is opened with "options",
+		// as it was when this call read the descriptors and the logs; see
+		// GetColumnFamilyHandle().  Writes, flushes, compactions, backups
+		// and column family changes return NotSupported or do nothing.
+		static Status OpenForReadOnly(const Options& options,
+			const std::string& name,
+			DB** dbptr);
+
+		// Like OpenForReadOnly(), but the database can then follow what the
+		// process that writes to it (the primary) does, through
+		// TryCatchUpWithPrimary().  It also does so on a thread of its own
+		// every options.secondary_catch_up_millis.  Column families the
+		// primary creates are opened when it catches up; reads of those it
+		// drops fail from then on.
+		//
+		// The primary deletes the tables its compactions replace; reading
+		// one that the table cache had not opened before then fails, so
+		// catch up often enough.
+		static Status OpenAsSecondary(const Options& options,
+			const std::string& name,
+			DB** dbptr);
+
+		// Store the names of the column families of the database with the
+		// specified "name" in *column_families.
+		static Status ListColumnFamilies(const Options& options,
+			const std::string& name,
+			std::vector<std::string>* column_families);
+
 		DB() { }
 		virtual ~DB();
 
@@ -113,11 +197,67 @@ namespace leveldb {
 		//  "leveldb.num-files-at-level<N>" - return the number of files at level <N>,
 		//     where <N> is an ASCII representation of a level number (e.g. "0").
 		//  "leveldb.stats" - returns a multi-line string that describes statistics
-		//     about the internal operation of the DB.
+		//     about the internal operation of the DB: flush and compaction I/O,
+		//     records and write amplification by level and by the reason the
+		//     compactions ran, read amplification and time spent stalled.
 		//  "leveldb.sstables" - returns a multi-line string that describes all
 		//     of the sstables that make up the db contents.
+		//  "leveldb.compaction-score-at-level<N>" - returns the compaction score
+		//     of level <N>; a score >= 1 means the level is due for compaction.
+		//
+		// as well as every integer property listed under GetIntProperty().
 		virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
+		// Like GetProperty(), for properties whose value is an integer.
+		// Returns false if "property" is unknown or not an integer.
+		//
+		// Valid property names include:
+		//
+		//  "leveldb.num-files-at-level<N>" - number of files at level <N>.
+		//  "leveldb.cur-size-active-mem-table" - bytes in the active memtable.
+		//  "leveldb.cur-size-all-mem-tables" - bytes in the active and the
+		//     immutable memtable.
+		//  "leveldb.num-entries-active-mem-table" - entries in the active memtable.
+		//  "leveldb.num-entries-imm-mem-tables" - entries in the immutable memtable.
+		//  "leveldb.num-immutable-mem-table" - 1 while a memtable awaits its
+		//     flush, 0 otherwise.
+		//  "leveldb.estimate-live-data-size" - estimated bytes of live data
+		//     in the sstables.
+		//  "leveldb.estimate-pending-compaction-bytes" - estimated bytes that
+		//     compactions must rewrite to bring every level within its limit.
+		//  "leveldb.block-cache-usage" - bytes charged to the block cache.
+		//  "leveldb.block-cache-pinned-usage" - bytes of the block cache that
+		//     are held by iterators or reads in progress.
+		//  "leveldb.estimate-table-readers-mem" - heap bytes held by open
+		//     sstables for their index and filter blocks.
+		//  "leveldb.num-snapshots" - number of unreleased snapshots.
+		//  "leveldb.oldest-snapshot-sequence" - sequence number of the oldest
+		//     snapshot, 0 if there is none.
+		//  "leveldb.num-replay-iterators" - number of unreleased replay iterators.
+		//  "leveldb.background-errors" - 1 if a background error has stopped
+		//     writes, 0 otherwise.
+		//  "leveldb.read-amplification" - number of sorted runs (level-0 files
+		//     plus non-empty levels) a lookup may have to search.
+		//
+		// The three block cache and table reader properties are read without
+		// taking the DB's internal lock, so they never wait for a write or a
+		// compaction to release it.
+		virtual bool GetIntProperty(const Slice& property, uint64_t* value);
+
+		// Add the table at "fname", written by an SstFileWriter with options
+		// compatible with this DB's (same comparator and filter policy), to
+		// the database.  Its entries become visible at once, as if written
+		// in a single batch, and override any earlier values of their keys;
+		// snapshots taken before the call do not see them.  The table is
+		// placed in the deepest level where it overlaps nothing, so loading
+		// sorted data this way bypasses the log, the memtable and most
+		// compactions.  Writes wait while the table is being added; if the
+		// memtable holds keys in the table's range it is flushed first.
+		//
+		// The default implementation returns NotSupported.
+		virtual Status IngestExternalFile(const std::string& fname,
+			const IngestExternalFileOptions& options);
+
 		// For each i in [0,n-1], store in "sizes[i]", the approximate
 		// file system space used by keys in "[range[i].start .. range[i].limit)".
 		//
@@ -171,6 +311,77 @@ namespace leveldb {
 		// Release a previously allocated replay iterator.
 		virtual void ReleaseReplayIterator(ReplayIterator* iter) = 0;
 
+		// Create a column family named "name" with the given options (see
+		// ColumnFamilyDescriptor::options), and store a handle for it in
+		// *handle.
+		//
+		// The default implementation returns NotSupported.
+		virtual Status CreateColumnFamily(const Options& options,
+			const std::string& name,
+			ColumnFamilyHandle** handle);
+
+		// Drop a column family.  Writes to it fail from then on; its files
+		// are deleted once the DB is closed.  The default column family
+		// cannot be dropped.
+		//
+		// The default implementation returns NotSupported.
+		virtual Status DropColumnFamily(ColumnFamilyHandle* column_family);
+
+		// Handle for the default column family, or NULL if the
+		// implementation has no column families.
+		virtual ColumnFamilyHandle* DefaultColumnFamily() const;
+
+		// Store a handle for the open column family named "name" in
+		// *handle, or return NotFound.  The handle stays valid until the
+		// DB is deleted.
+		//
+		// The default implementation returns NotSupported.
+		virtual Status GetColumnFamilyHandle(const std::string& name,
+			ColumnFamilyHandle** handle);
+
+		// The methods above for the given column family.  Replay iterators
+		// and IngestExternalFile() only cover the default column family.
+		// The properties of a column family that describe memtables and
+		// tables are its own; the others, and the flush and compaction
+		// counters of "leveldb.stats", cover the whole DB.
+		//
+		// The default implementations of Get, NewIterator, the properties,
+		// GetApproximateSizes and CompactRange only support the default
+		// column family.  Flush returns NotSupported.
+		virtual Status Put(const WriteOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key,
+			const Slice& value);
+		virtual Status Delete(const WriteOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key);
+		virtual Status Get(const ReadOptions& options,
+			ColumnFamilyHandle* column_family,
+			const Slice& key, std::string* value);
+		virtual Iterator* NewIterator(const ReadOptions& options,
+			ColumnFamilyHandle* column_family);
+		virtual bool GetProperty(ColumnFamilyHandle* column_family,
+			const Slice& property, std::string* value);
+		virtual bool GetIntProperty(ColumnFamilyHandle* column_family,
+			const Slice& property, uint64_t* value);
+		virtual void GetApproximateSizes(ColumnFamilyHandle* column_family,
+			const Range* range, int n, uint64_t* sizes);
+		virtual void CompactRange(ColumnFamilyHandle* column_family,
+			const Slice* begin, const Slice* end);
+
+		// Write the memtable of the column family to a table, and wait
+		// until it is done.
+		virtual Status Flush(ColumnFamilyHandle* column_family);
+
+		// For a database opened with OpenAsSecondary(): read what the
+		// primary has added to its descriptor and logs, and make all of it
+		// visible at once.  Reads then see the database as recovering it
+		// after a crash at this moment would; a write the primary is still
+		// in the middle of is left for a later call.
+		//
+		// The default implementation returns NotSupported.
+		virtual Status TryCatchUpWithPrimary();
+
 	private:
 		// No copying allowed
 		DB(const DB&);
@@ -185,6 +396,10 @@ namespace leveldb {
 	// resurrect as much of the contents of the database as possible.
 	// Some data may be lost, so be careful when calling this function
 	// on a database that contains important information.
+	//
+	// Column families are repaired as well, each with "options", and stay
+	// listed under their names as far as the old descriptors still show
+	// them.
 	Status RepairDB(const std::string& dbname, const Options& options);
 
 }  // namespace leveldb
@@ -26,12 +26,13 @@ namespace leveldb {
 	class RandomAccessFile;
 	class SequentialFile;
 	class Slice;
+	class ThreadPool;
 	class WritableFile;
 	class ConcurrentWritableFile;
 
 	class Env {
 	public:
-		Env() { }
+		Env();
 		virtual ~Env();
 
 		// Return a default environment suitable for the current operating
@@ -141,6 +142,18 @@ namespace leveldb {
 		// When "function(arg)" returns, the thread will be destroyed.
 		virtual void StartThread(void(*function)(void* arg), void* arg) = 0;
 
+		// Arrange to run "(*function)(arg)" once on a pool of long-lived
+		// threads kept for work the engine splits off a single operation,
+		// such as compressing the blocks of a table being built.  Items run
+		// concurrently up to the size of the pool and must not wait for one
+		// another.  The default implementation keeps a pool inside this Env
+		// whose threads are started with StartThread().
+		virtual void ScheduleWork(void(*function)(void* arg), void* arg);
+
+		// Grow the pool used by ScheduleWork() to at least "threads" threads.
+		// It never shrinks.
+		virtual void ReserveWorkThreads(int threads);
+
 		// *path is set to a temporary directory that can be used for testing. It may
 		// or many not have just been created. The directory may or may not differ
 		// between runs of the same process, but subsequent calls will return the
@@ -154,10 +167,17 @@ namespace leveldb {
 		// useful for computing deltas of time.
 		virtual uint64_t NowMicros() = 0;
 
+		// Returns the number of nano-seconds since some fixed point in time. Only
+		// useful for computing deltas of time.  The default implementation
+		// scales NowMicros(), so it is no finer than that clock.
+		virtual uint64_t NowNanos() { return NowMicros() * 1000; }
+
 		// Sleep/delay the thread for the perscribed number of micro-seconds.
 		virtual void SleepForMicroseconds(int micros) = 0;
 
 	private:
+		ThreadPool* work_pool_;
+
 		// No copying allowed
 		Env(const Env&);
 		void operator=(const Env&);
@@ -353,6 +373,12 @@ namespace leveldb {
 		void StartThread(void(*f)(void*), void* a) {
 			return target_->StartThread(f, a);
 		}
+		void ScheduleWork(void(*f)(void*), void* a) {
+			return target_->ScheduleWork(f, a);
+		}
+		void ReserveWorkThreads(int threads) {
+			return target_->ReserveWorkThreads(threads);
+		}
 		virtual Status GetTestDirectory(std::string* path) {
 			return target_->GetTestDirectory(path);
 		}
@@ -362,6 +388,9 @@ namespace leveldb {
 		uint64_t NowMicros() {
 			return target_->NowMicros();
 		}
+		uint64_t NowNanos() {
+			return target_->NowNanos();
+		}
 		void SleepForMicroseconds(int micros) {
 			target_->SleepForMicroseconds(micros);
 		}
@@ -0,0 +1,148 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An EventListener installed in Options::listener is told about the
+// background work of a DB: memtable flushes, compactions, table files
+// coming and going, write stalls and background errors.
+//
+// Callbacks never run while the DB holds its internal mutex, so they may
+// call back into the DB (e.g. DB::GetProperty).  They run on the DB's
+// background threads, or on the thread of a DB call that noticed the
+// event, possibly several at once; the work that raised an event waits
+// for the callback to return.  Keep them short and thread-safe.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+#define STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+	struct TableFileInfo {
+		TableFileInfo()
+			: db_name(),
+			file_path(),
+			file_number(0),
+			file_size(0),
+			level(-1),
+			status() {
+		}
+
+		std::string db_name;
+		std::string file_path;
+		uint64_t file_number;
+		uint64_t file_size;     // 0 when unknown (e.g. for deleted files)
+		int level;              // level the file was written for, -1 if unknown
+		Status status;
+	};
+
+	struct FlushJobInfo {
+		FlushJobInfo()
+			: db_name(),
+			memtable_bytes(0),
+			file_number(0),
+			file_size(0),
+			level(-1),
+			micros(0),
+			status() {
+		}
+
+		std::string db_name;
+		uint64_t memtable_bytes;
+		// The remaining fields are only set by OnFlushCompleted.
+		uint64_t file_number;   // 0 if the memtable produced no table
+		uint64_t file_size;
+		int level;
+		uint64_t micros;
+		Status status;
+	};
+
+	struct CompactionJobInfo {
+		CompactionJobInfo()
+			: db_name(),
+			level(0),
+			output_level(0),
+			is_manual(false),
+			is_trivial_move(false),
+			input_files(),
+			output_files(),
+			bytes_read(0),
+			bytes_written(0),
+			micros(0),
+			status() {
+		}
+
+		std::string db_name;
+		int level;                          // level of the first set of inputs
+		int output_level;
+		bool is_manual;
+		bool is_trivial_move;               // files were moved, not rewritten
+		std::vector<uint64_t> input_files;  // file numbers
+		// The remaining fields are only set by OnCompactionCompleted.
+		std::vector<uint64_t> output_files;
+		uint64_t bytes_read;
+		uint64_t bytes_written;
+		uint64_t micros;
+		Status status;
+	};
+
+	enum WriteStallCondition {
+		kStallNormal = 0,
+		kStallDelayed,      // writers are slowed because level-0 has too many files
+		kStallStopped       // writers wait for the immutable memtable to be flushed
+	};
+
+	struct WriteStallInfo {
+		WriteStallInfo() : db_name(), previous(kStallNormal), current(kStallNormal) { }
+
+		std::string db_name;
+		WriteStallCondition previous;
+		WriteStallCondition current;
+	};
+
+	enum BackgroundErrorReason {
+		kErrorFlush = 0,
+		kErrorCompaction,
+		kErrorWriteLog
+	};
+
+	class EventListener {
+	public:
+		EventListener() { }
+		virtual ~EventListener();
+
+		virtual void OnFlushBegin(const FlushJobInfo& /*info*/) { }
+		virtual void OnFlushCompleted(const FlushJobInfo& /*info*/) { }
+
+		virtual void OnCompactionBegin(const CompactionJobInfo& /*info*/) { }
+		virtual void OnCompactionCompleted(const CompactionJobInfo& /*info*/) { }
+
+		// Called when a flush or compaction has finished writing a table file,
+		// before the file is installed in the DB.
+		virtual void OnTableFileCreated(const TableFileInfo& /*info*/) { }
+
+		// Called after an obsolete table file has been removed.  Deletions are
+		// reported in batches from a background thread, so the callback may
+		// come some time after the file is gone.
+		virtual void OnTableFileDeleted(const TableFileInfo& /*info*/) { }
+
+		virtual void OnStallConditionsChanged(const WriteStallInfo& /*info*/) { }
+
+		// Called when the DB records its first background error.  All later
+		// writes will fail with "status".
+		virtual void OnBackgroundError(BackgroundErrorReason /*reason*/,
+			const Status& /*status*/) { }
+
+	private:
+		// No copying allowed
+		EventListener(const EventListener&);
+		void operator=(const EventListener&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_LISTENER_H_
@@ -6,15 +6,19 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 namespace leveldb {
 
 	class Cache;
+	class CompactionFilter;
 	class Comparator;
 	class Env;
+	class EventListener;
 	class FilterPolicy;
 	class Logger;
 	class Snapshot;
+	class Statistics;
 
 	// DB contents are stored in a set of blocks, each of which holds a
 	// sequence of key,value pairs.  Each block may be compressed before
@@ -27,6 +31,13 @@ namespace leveldb {
 		kSnappyCompression = 0x1
 	};
 
+	// How background compactions arrange the data (see Options::compaction_style)
+	enum CompactionStyle {
+		kCompactionStyleLevel = 0x0,
+		kCompactionStyleUniversal = 0x1,
+		kCompactionStyleFIFO = 0x2
+	};
+
 	// Options to control the behavior of a database (passed to DB::Open)
 	struct Options {
 		// -------------------
@@ -53,6 +64,8 @@ namespace leveldb {
 		// errors.  This may have unforeseen ramifications: for example, a
 		// corruption of one DB entry may cause a large number of entries to
 		// become unreadable or for the entire DB to become unopenable.
+		// DB::Open also checks the size of every live table file against
+		// the descriptor (see max_file_opening_threads).
 		// Default: false
 		bool paranoid_checks;
 
@@ -128,6 +141,17 @@ namespace leveldb {
 		// efficiently detect that and will switch to uncompressed mode.
 		CompressionType compression;
 
+		// If greater than 1, every table file being written (memtable
+		// flushes and compaction outputs) has up to this many items on
+		// Env::ScheduleWork() compress and checksum its data blocks while
+		// the writer goes on building the next ones.  The Env's pool is
+		// grown to at least this many threads and is shared by all files.
+		// Blocks are still written in order, so the files are the same as
+		// with a single thread.
+		//
+		// Default: 1 (blocks are compressed by the thread writing the table)
+		int compression_threads;
+
 		// If non-NULL, use the specified filter policy to reduce disk reads.
 		// Many applications will benefit from passing the result of
 		// NewBloomFilterPolicy() here.
@@ -146,6 +170,161 @@ namespace leveldb {
 		// Default: false/no.
 		bool manual_garbage_collection;
 
+		// If non-NULL, record tickers and latency histograms for this DB in
+		// the given object (see leveldb/statistics.h).  The object may be
+		// shared between DBs and must outlive all of them.
+		//
+		// Default: NULL
+		Statistics* statistics;
+
+		// If non-NULL, notify this object about flushes, compactions, table
+		// file creation and deletion, write stalls and background errors
+		// (see leveldb/listener.h).  The listener must outlive the DB.
+		//
+		// Default: NULL
+		EventListener* listener;
+
+		// If non-NULL, compactions pass surviving values through this filter,
+		// which may remove or rewrite them (see leveldb/compaction_filter.h).
+		// The filter must outlive the DB.
+		//
+		// Default: NULL
+		const CompactionFilter* compaction_filter;
+
+		// Number of threads used to open and scan table files in bulk: when
+		// RepairDB rebuilds the descriptor from the tables it finds, when
+		// DB::Open verifies table files under paranoid_checks, and when it
+		// warms the table cache.  Values below 1 are treated as 1.
+		//
+		// Default: 16
+		int max_file_opening_threads;
+
+		// Tables are opened lazily, on the first read that needs them.  If
+		// true, DB::Open additionally starts a background thread that opens
+		// the tables of the current version, lowest level first, until the
+		// table cache (max_open_files) is full.  Open returns without
+		// waiting for it.
+		//
+		// Default: false
+		bool warm_table_cache;
+
+		// Once the MANIFEST (descriptor log) grows past this many bytes, the
+		// next change to the set of live files starts a new MANIFEST holding
+		// a snapshot of the current state, and CURRENT is switched to it.
+		// The old MANIFEST is deleted with the other obsolete files.  Zero
+		// means a MANIFEST is only replaced when the DB is opened.
+		//
+		// Default: 64MB
+		size_t max_manifest_file_size;
+
+		// If positive, every table carries a piecewise linear model of its
+		// index block, and every Version one of each level's file list,
+		// fitted to comparator->KeyNum() within this many positions.  Point
+		// lookups and seeks then binary search only the predicted window,
+		// and fall back to the whole range when the window misses.  Only
+		// useful when KeyNum() spreads the keys well, e.g. for the bytewise
+		// comparator over keys that begin with a big-endian number.
+		//
+		// Default: 0 (no models are built or read)
+		int learned_index_max_error;
+
+		// kCompactionStyleLevel keeps levels 1 and up at fixed size targets
+		// and merges files into the next level as a level outgrows its
+		// target.
+		//
+		// kCompactionStyleUniversal (size-tiered) trades read and space
+		// amplification for less write amplification.  Every memtable is
+		// written to a level-0 file; each level-0 file is a sorted run and
+		// level-1 holds the oldest run.  Once there are
+		// config::kL0_CompactionTrigger runs, the newest runs are merged:
+		// all of them if the newer runs add up to more than
+		// universal_max_size_amplification_percent of the oldest one,
+		// otherwise the longest newest-first sequence whose next run is at
+		// most universal_size_ratio percent larger than the runs before it
+		// combined (if it has at least universal_min_merge_width runs),
+		// otherwise just enough runs to get back below the trigger.  A
+		// merge that reaches the oldest run writes level-1; others write
+		// one new level-0 file.  Levels 2 and up are left as they are.
+		//
+		// kCompactionStyleFIFO never merges: every memtable stays a level-0
+		// file, and the oldest files are deleted once the level-0 files add
+		// up to more than fifo_max_table_files_size or are older than
+		// fifo_ttl_seconds.  Meant for time-series data and caches that can
+		// lose old entries.  The limits are checked whenever the background
+		// thread wakes up, i.e. after every memtable flush, so a database
+		// that is not written to keeps its expired files.  CompactRange()
+		// only flushes the memtable.
+		//
+		// Default: kCompactionStyleLevel
+		CompactionStyle compaction_style;
+
+		// Default: 1
+		int universal_size_ratio;
+
+		// Default: 2
+		int universal_min_merge_width;
+
+		// Default: 200
+		int universal_max_size_amplification_percent;
+
+		// Default: 1GB
+		uint64_t fifo_max_table_files_size;
+
+		// Files flushed longer ago than this are deleted; 0 keeps files
+		// regardless of their age.  Files written by versions that did not
+		// record a creation time are only ever deleted for size.
+		//
+		// Default: 0
+		uint64_t fifo_ttl_seconds;
+
+		// If true, the leveled compaction style also compacts a file in
+		// levels 1 to config::kNumLevels-2 into the next level once the
+		// earliest expiry time among its values (see
+		// WriteBatch::PutWithExpiry()) has passed, whenever no level needs a
+		// compaction for its size.  Expired values are dropped at the level
+		// below which no older entry for their key exists, so this moves
+		// them there sooner.  Like fifo_ttl_seconds, checked whenever the
+		// background thread wakes up.
+		//
+		// Default: false
+		bool compact_expired_files;
+
+		// If true, a compaction reads and merges its input tables on one
+		// thread of Env::ScheduleWork() and writes its output files on
+		// another, while
+		// the compaction thread drops obsolete entries and builds the
+		// tables.  A big compaction then finishes sooner, at the cost of a
+		// few more cores and about 8MB of buffers while it runs.
+		//
+		// Default: false
+		bool pipelined_compaction;
+
+		// If positive, memtable flushes and compactions move values of at
+		// least this many bytes out of the tables into blob files, and the
+		// tables hold a small reference to each instead.  Compactions then
+		// copy the references rather than the values, which cuts down write
+		// amplification when values are large.  Reads of such a value cost
+		// one more disk access.  Values written with an expiry stay in the
+		// tables.
+		//
+		// Default: 0 (values are always stored in the tables)
+		size_t min_blob_size;
+
+		// A compaction that keeps a reference into a blob file of which less
+		// than this percentage is still referenced copies the value into a
+		// new blob file, so that the old file can eventually be deleted.
+		// Zero leaves values where they are until their whole file is
+		// unreferenced.
+		//
+		// Default: 50
+		int blob_gc_percent;
+
+		// For a DB opened with DB::OpenAsSecondary(): if non-zero, a
+		// background thread calls TryCatchUpWithPrimary() this often.
+		//
+		// Default: 0 (only explicit calls catch up)
+		uint64_t secondary_catch_up_millis;
+
 		// Create an Options object with default values for all fields.
 		Options();
 	};
@@ -196,8 +375,32 @@ namespace leveldb {
 		// Default: false
 		bool sync;
 
+		// If non-zero, DB::Put() stores the value until this many seconds
+		// from now (see WriteBatch::PutWithExpiry()).
+		//
+		// Default: 0
+		uint64_t ttl_seconds;
+
 		WriteOptions()
-			: sync(false) {
+			: sync(false),
+			ttl_seconds(0) {
+		}
+	};
+
+	// Options that control DB::IngestExternalFile()
+	struct IngestExternalFileOptions {
+		// If true, the file is renamed into the database directory and is
+		// gone from its original path once the call succeeds.  Otherwise
+		// it is hard-linked into the database, or copied where linking is
+		// not possible, and the original is left alone; a linked original
+		// must then not be modified in place (SstFileWriter::Open() removes
+		// the old file before writing a new one).
+		//
+		// Default: false
+		bool move_file;
+
+		IngestExternalFileOptions()
+			: move_file(false) {
 		}
 	};
 
@@ -0,0 +1,76 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PerfContext breaks the cost of individual operations down into the
+// steps the engine took.  Every thread has its own context, so it
+// describes exactly the requests made by the calling thread:
+//
+//      leveldb::SetPerfLevel(leveldb::kEnableTime);
+//      leveldb::GetPerfContext()->Reset();
+//      db->Get(leveldb::ReadOptions(), key, &value);
+//      fprintf(stderr, "%s\n", leveldb::GetPerfContext()->ToString().c_str());
+//
+// Collection is off by default.  While it is off, every instrumentation
+// point costs one thread-local load and a compare.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+#define STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+
+#include <string>
+#include <stdint.h>
+
+namespace leveldb {
+
+	enum PerfLevel {
+		kDisable = 0,       // collect nothing
+		kEnableCount = 1,   // collect counters only
+		kEnableTime = 2     // collect counters and nanosecond timers
+	};
+
+	// Set or read the perf level of the calling thread.
+	extern void SetPerfLevel(PerfLevel level);
+	extern PerfLevel GetPerfLevel();
+
+	// All fields accumulate until Reset() is called.  Timers are in
+	// nanoseconds.
+	struct PerfContext {
+		void Reset();
+
+		// Return the non-zero fields as "name = value" pairs.
+		std::string ToString() const;
+
+		// DB::Get
+		uint64_t get_from_memtable_count;      // memtables probed
+		uint64_t get_from_memtable_time;
+		uint64_t get_from_output_files_time;   // time in Version::Get
+		uint64_t db_mutex_lock_nanos;          // waiting for DBImpl::mutex_
+
+		// Version::Get
+		uint64_t table_probe_count;            // sstables consulted
+		uint64_t find_table_nanos;             // table cache lookup and open
+		uint64_t index_seek_nanos;             // seeking the sstable index
+		uint64_t bloom_sst_miss_count;         // sstables skipped by the filter
+
+		// Table::BlockReader and ReadBlock
+		uint64_t block_cache_hit_count;
+		uint64_t block_read_count;             // blocks read from the file
+		uint64_t block_read_byte;
+		uint64_t block_read_time;
+		uint64_t block_checksum_time;
+		uint64_t block_decompress_time;
+
+		// DBIter
+		uint64_t seek_internal_seek_time;      // positioning the merged iterator
+		uint64_t find_next_user_entry_time;
+		uint64_t internal_key_skipped_count;   // overwritten or hidden entries
+		uint64_t internal_delete_skipped_count;
+	};
+
+	// Return the context of the calling thread.  The result stays valid for
+	// the lifetime of the thread.
+	extern PerfContext* GetPerfContext();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
@@ -32,7 +32,9 @@ class ReplayIterator {
   virtual void SkipToLast() = 0;
 
   // Return true if the current entry points to a key-value pair.  If this
-  // returns false, it means the current entry is a deleted entry.
+  // returns false, it means the current entry is a deleted entry.  A value
+  // written with an expiry time is replayed as a plain value, even once it
+  // has expired.
   virtual bool HasValue() = 0;
 
   // Return the key for the current entry.  The underlying storage for
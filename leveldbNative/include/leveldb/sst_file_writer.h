@@ -0,0 +1,70 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table outside of any database that can later be
+// added to one with DB::IngestExternalFile().  This is the fastest way to
+// load a large amount of sorted data: the entries go straight into a
+// table instead of through the log, the memtable and the compactions.
+//
+// An SstFileWriter may not be used by several threads at once without
+// external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+	class SstFileWriter {
+	public:
+		// The table is written with the comparator, filter policy, block
+		// and compression settings of "options", which must match those
+		// of the database the table is ingested into.  options.env is
+		// used to create the file.
+		explicit SstFileWriter(const Options& options);
+
+		// Abandons the table if Finish() has not been called.
+		~SstFileWriter();
+
+		// Create the file "fname", replacing any existing file, and start
+		// a new table in it.
+		// REQUIRES: Open() has not been called
+		Status Open(const std::string& fname);
+
+		// Add key,value to the table.  Returns InvalidArgument, and adds
+		// nothing, unless "key" is after every key added before it
+		// according to the comparator.
+		// REQUIRES: Open() has succeeded and Finish() has not been called
+		Status Add(const Slice& key, const Slice& value);
+
+		// Finish the table, sync it and close the file.  A table with no
+		// entries cannot be ingested; Finish() returns InvalidArgument for
+		// it and removes the file.
+		// REQUIRES: Open() has succeeded and Finish() has not been called
+		Status Finish();
+
+		// Number of entries added so far.
+		uint64_t NumEntries() const;
+
+		// Size of the file written so far; after a successful Finish(),
+		// the size of the final file.
+		uint64_t FileSize() const;
+
+	private:
+		struct Rep;
+		Rep* rep_;
+
+		// No copying allowed
+		SstFileWriter(const SstFileWriter&);
+		void operator=(const SstFileWriter&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
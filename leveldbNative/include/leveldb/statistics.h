@@ -0,0 +1,140 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Statistics object collects counters ("tickers") and latency
+// histograms from a running database.  Install one in Options::statistics
+// and the engine records into it from every thread; it may be shared by
+// several DBs, in which case it reports their sum.
+//
+// Most people will want to use the builtin implementation (see
+// NewDBStatistics() below).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+#define STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+
+#include <string>
+#include <stdint.h>
+
+namespace leveldb {
+
+	enum Tickers {
+		// Data block lookups in Options::block_cache.  Index and filter
+		// blocks are pinned by the open table and never go through the cache.
+		kBlockCacheDataHit = 0,
+		kBlockCacheDataMiss,
+
+		// Lookups of open sstables in the table cache.
+		kTableCacheHit,
+		kTableCacheMiss,
+
+		// Filter checks made by point lookups.  "Useful" means the filter
+		// ruled the table out and no data block was read.  "Positive" means it
+		// could not; of those, "true positive" counts the lookups that then
+		// found the key in that table.  The difference is the false positives.
+		kBloomFilterUseful,
+		kBloomFilterPositive,
+		kBloomFilterTruePositive,
+
+		// DB::Get calls answered by the memtables, and those that went on to
+		// the sstables.
+		kMemtableHit,
+		kMemtableMiss,
+
+		kKeysWritten,
+		kWalBytes,
+		kWalSyncs,
+
+		// Time writers spent waiting for a memtable to be flushed or sleeping
+		// because level-0 has too many files.
+		kStallMicros,
+
+		// Bytes written by memtable flushes, and bytes read and written by
+		// compactions.  Files that a compaction only moves to the next level
+		// are counted as moved instead.
+		kFlushBytesWritten,
+		kCompactBytesRead,
+		kCompactBytesWritten,
+		kCompactBytesMoved,
+
+		// Entries read by compactions, and those they discarded as
+		// overwritten or deleted.
+		kCompactRecordsIn,
+		kCompactRecordsDropped,
+
+		// Compactions by the reason they were scheduled: too many level-0
+		// files, a level over its size target, a file that used up its
+		// allowed seeks, DB::CompactRange(), or a file holding expired
+		// values (see Options::compact_expired_files).
+		kCompactionsLevel0,
+		kCompactionsSize,
+		kCompactionsSeek,
+		kCompactionsManual,
+		kCompactionsExpiry,
+
+		kTickerEnumMax
+	};
+
+	enum Histograms {
+		kGetMicros = 0,
+		kSeekMicros,
+		kWriteMicros,
+
+		kHistogramEnumMax
+	};
+
+	struct HistogramData {
+		HistogramData()
+			: count(0),
+			average(0),
+			standard_deviation(0),
+			median(0),
+			percentile95(0),
+			percentile99(0),
+			max(0) {
+		}
+
+		double count;
+		double average;
+		double standard_deviation;
+		double median;
+		double percentile95;
+		double percentile99;
+		double max;
+	};
+
+	// Return a printable name for a ticker or histogram, e.g.
+	// "leveldb.block.cache.data.hit".
+	extern const char* TickerName(Tickers ticker);
+	extern const char* HistogramName(Histograms histogram);
+
+	class Statistics {
+	public:
+		virtual ~Statistics();
+
+		// Add "count" to the named ticker.
+		virtual void RecordTick(Tickers ticker, uint64_t count) = 0;
+
+		// Record one sample of "micros" in the named histogram.
+		virtual void MeasureTime(Histograms histogram, uint64_t micros) = 0;
+
+		virtual uint64_t GetTickerCount(Tickers ticker) const = 0;
+		virtual void GetHistogramData(Histograms histogram,
+			HistogramData* data) const = 0;
+
+		// Zero every ticker and histogram.
+		virtual void Reset() = 0;
+
+		// Return a human readable dump of every ticker and histogram.
+		virtual std::string ToString() const = 0;
+	};
+
+	// Return a new Statistics object that spreads its counters over several
+	// cache-line aligned stripes so that concurrent threads rarely share a
+	// line.  Recording never takes a lock.  The caller owns the result and
+	// must keep it alive for as long as any DB using it is open.
+	extern Statistics* NewDBStatistics();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
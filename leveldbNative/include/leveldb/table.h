@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_TABLE_H_
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
+#include <map>
+#include <string>
 #include <stdint.h>
 #include "leveldb/iterator.h"
 
@@ -55,6 +57,15 @@ namespace leveldb {
 		// be close to the file length.
 		uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+		// Return the number of bytes of heap memory held by this table for
+		// its index and filter blocks.  Cached data blocks are not included.
+		size_t ApproximateMemoryUsage() const;
+
+		// Read the properties block of the table into *properties.  Returns
+		// NotFound if the table was written without one (older tables) and
+		// another non-OK status if the block could not be read.
+		Status ReadProperties(std::map<std::string, std::string>* properties) const;
+
 	private:
 		struct Rep;
 		Rep* rep_;
@@ -74,6 +85,7 @@ namespace leveldb {
 
 		void ReadMeta(const Footer& footer);
 		void ReadFilter(const Slice& filter_handle_value);
+		void ReadLearnedIndex(const Slice& handle_value);
 
 		// No copying allowed
 		Table(const Table&);
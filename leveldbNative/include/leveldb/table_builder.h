@@ -52,6 +52,14 @@ namespace leveldb {
 		// REQUIRES: Finish(), Abandon() have not been called
 		void Flush();
 
+		// Record a name/value pair in the properties block of the table.
+		// Adding the same name twice keeps the last value.  Names starting
+		// with "leveldb." are reserved for properties maintained by the
+		// builder itself (entry count, smallest and largest key) and by the
+		// database (e.g. the largest sequence number in the file).
+		// REQUIRES: Finish(), Abandon() have not been called
+		void AddProperty(const Slice& name, const Slice& value);
+
 		// Return non-ok iff some error has been detected.
 		Status status() const;
 
@@ -70,14 +78,19 @@ namespace leveldb {
 		// Number of calls to Add() so far.
 		uint64_t NumEntries() const;
 
-		// Size of the file generated so far.  If invoked after a successful
-		// Finish() call, returns the size of the final generated file.
+		// Size of the file generated so far.  Data blocks still queued for
+		// compression are counted as if they compress as well as the blocks
+		// already written.  If invoked after a successful Finish() call,
+		// returns the size of the final generated file.
 		uint64_t FileSize() const;
 
 	private:
 		bool ok() const { return status().ok(); }
 		void WriteBlock(BlockBuilder* block, BlockHandle* handle);
 		void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+		void AppendBlock(const Slice& data, const char* trailer, BlockHandle* handle);
+		void QueueBlock();
+		void WriteQueuedBlocks(bool all);
 
 		struct Rep;
 		Rep* rep_;
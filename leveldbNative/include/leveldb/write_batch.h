@@ -13,6 +13,10 @@
 //    batch.Put("key", "v2");
 //    batch.Put("key", "v3");
 //
+// The overloads taking a ColumnFamilyHandle write to that column family
+// of the DB instead of the default one.  A batch may write to several
+// column families; it is still applied atomically.
+//
 // Multiple threads can invoke const methods on a WriteBatch without
 // external synchronization, but if any of the threads may call a
 // non-const method, all threads accessing the same WriteBatch must use
@@ -21,11 +25,13 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
+#include <stdint.h>
 #include <string>
 #include "leveldb/status.h"
 
 namespace leveldb {
 
+	class ColumnFamilyHandle;
 	class Slice;
 
 	class WriteBatch {
@@ -36,9 +42,22 @@ namespace leveldb {
 		// Store the mapping "key->value" in the database.
 		void Put(const Slice& key, const Slice& value);
 
+		// Store the mapping "key->value" until "expiry", in seconds since the
+		// epoch as measured by Env::NowMicros().  From then on reads treat
+		// the mapping as deleted, and compactions discard it without a
+		// deletion marker where nothing older can reappear.
+		void PutWithExpiry(const Slice& key, const Slice& value, uint64_t expiry);
+
 		// If the database contains a mapping for "key", erase it.  Else do nothing.
 		void Delete(const Slice& key);
 
+		// Like the above, for the given column family.  A NULL
+		// column_family means the default one.
+		void Put(ColumnFamilyHandle* column_family, const Slice& key, const Slice& value);
+		void PutWithExpiry(ColumnFamilyHandle* column_family, const Slice& key,
+			const Slice& value, uint64_t expiry);
+		void Delete(ColumnFamilyHandle* column_family, const Slice& key);
+
 		// Clear all updates buffered in this batch.
 		void Clear();
 
@@ -48,6 +67,16 @@ namespace leveldb {
 			virtual ~Handler();
 			virtual void Put(const Slice& key, const Slice& value) = 0;
 			virtual void Delete(const Slice& key) = 0;
+			// The default implementation calls Put(key, value).
+			virtual void PutWithExpiry(const Slice& key, const Slice& value, uint64_t expiry);
+
+			// Updates to a column family other than the default one.  The
+			// default implementations ignore them.
+			virtual void PutCF(uint32_t column_family_id, const Slice& key, const Slice& value);
+			virtual void DeleteCF(uint32_t column_family_id, const Slice& key);
+			// The default implementation calls PutCF(column_family_id, key, value).
+			virtual void PutWithExpiryCF(uint32_t column_family_id, const Slice& key,
+				const Slice& value, uint64_t expiry);
 		};
 		Status Iterate(Handler* handler) const;
 
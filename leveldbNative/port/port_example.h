@@ -72,6 +72,11 @@ namespace leveldb {
 #define LEVELDB_ONCE_INIT 0
 		extern void InitOnce(port::OnceType*, void(*initializer)());
 
+		// Storage class specifier for a variable with one instance per thread.
+		// Only plain-old-data types with static initializers may be used.
+		//      static LEVELDB_THREAD_LOCAL int counter = 0;
+#define LEVELDB_THREAD_LOCAL __thread
+
 		// A type that holds a pointer that can be read or written atomically
 		// (i.e., without word-tearing.)
 		class AtomicPointer {
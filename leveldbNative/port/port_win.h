@@ -49,6 +49,8 @@ namespace leveldb {
 #define LEVELDB_ONCE_INIT 0
 		extern void InitOnce(port::OnceType*, void(*initializer)());
 
+#define LEVELDB_THREAD_LOCAL __declspec(thread)
+
 		class CondVar;
 
 		class Mutex {
@@ -11,6 +11,7 @@
 #include "leveldb/comparator.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/learned_index.h"
 #include "util/logging.h"
 
 namespace leveldb {
@@ -82,6 +83,7 @@ namespace leveldb {
 		Iter(const Iter&);
 		Iter& operator = (const Iter&);
 		const Comparator* const comparator_;
+		const LearnedIndex* const model_;  // Restart index predictor, or NULL
 		const char* const data_;      // underlying block contents
 		uint32_t const restarts_;     // Offset of restart array (list of fixed32)
 		uint32_t const num_restarts_; // Number of uint32_t entries in restart array
@@ -107,6 +109,43 @@ namespace leveldb {
 			return DecodeFixed32(data_ + restarts_ + index * sizeof(uint32_t));
 		}
 
+		// Set *key to the key stored at restart point "index".  Returns false
+		// if the entry is corrupt.
+		bool GetRestartKey(uint32_t index, Slice* key) {
+			uint32_t region_offset = GetRestartPoint(index);
+			uint32_t shared, non_shared, value_length;
+			const char* key_ptr = DecodeEntry(data_ + region_offset,
+				data_ + restarts_,
+				&shared, &non_shared, &value_length);
+			if (key_ptr == NULL || (shared != 0)) {
+				return false;
+			}
+			*key = Slice(key_ptr, non_shared);
+			return true;
+		}
+
+		// Narrow [*left, *right] to the model's window for target if the
+		// keys just outside the window show that it holds the answer.
+		void PredictRestartRange(const Slice& target, uint32_t* left, uint32_t* right) {
+			uint32_t lo, hi;
+			model_->Predict(comparator_->KeyNum(target), &lo, &hi);
+			// The model predicts the first entry >= target; Seek wants the
+			// restart before it.
+			lo = (lo > 0) ? lo - 1 : 0;
+			hi = (hi > 0) ? hi - 1 : 0;
+			if (hi >= num_restarts_) hi = num_restarts_ - 1;
+			if (lo > hi) lo = hi;
+			Slice key;
+			if (lo > 0 && (!GetRestartKey(lo, &key) || Compare(key, target) >= 0)) {
+				return;
+			}
+			if (hi + 1 < num_restarts_ && (!GetRestartKey(hi + 1, &key) || Compare(key, target) < 0)) {
+				return;
+			}
+			*left = lo;
+			*right = hi;
+		}
+
 		void SeekToRestartPoint(uint32_t index) {
 			key_.clear();
 			restart_index_ = index;
@@ -119,10 +158,12 @@ namespace leveldb {
 
 	public:
 		Iter(const Comparator* comparator,
+			const LearnedIndex* model,
 			const char* data,
 			uint32_t restarts,
 			uint32_t num_restarts)
 			: comparator_(comparator),
+			model_(model),
 			data_(data),
 			restarts_(restarts),
 			num_restarts_(num_restarts),
@@ -176,18 +217,16 @@ namespace leveldb {
 			// with a key < target
 			uint32_t left = 0;
 			uint32_t right = num_restarts_ - 1;
+			if (model_ != NULL) {
+				PredictRestartRange(target, &left, &right);
+			}
 			while (left < right) {
 				uint32_t mid = (left + right + 1) / 2;
-				uint32_t region_offset = GetRestartPoint(mid);
-				uint32_t shared, non_shared, value_length;
-				const char* key_ptr = DecodeEntry(data_ + region_offset,
-					data_ + restarts_,
-					&shared, &non_shared, &value_length);
-				if (key_ptr == NULL || (shared != 0)) {
+				Slice mid_key;
+				if (!GetRestartKey(mid, &mid_key)) {
 					CorruptionError();
 					return;
 				}
-				Slice mid_key(key_ptr, non_shared);
 				if (Compare(mid_key, target) < 0) {
 					// Key at "mid" is smaller than "target".  Therefore all
 					// blocks before "mid" are uninteresting.
@@ -264,7 +303,7 @@ namespace leveldb {
 		}
 	};
 
-	Iterator* Block::NewIterator(const Comparator* cmp) {
+	Iterator* Block::NewIterator(const Comparator* cmp, const LearnedIndex* model) {
 		if (size_ < sizeof(uint32_t)) {
 			return NewErrorIterator(Status::Corruption("bad block contents"));
 		}
@@ -273,7 +312,11 @@ namespace leveldb {
 			return NewEmptyIterator();
 		}
 		else {
-			return new Iter(cmp, data_, restart_offset_, num_restarts);
+			if (model != NULL && (model->empty() || model->size() != num_restarts)) {
+				// Not a model of this block
+				model = NULL;
+			}
+			return new Iter(cmp, model, data_, restart_offset_, num_restarts);
 		}
 	}
 
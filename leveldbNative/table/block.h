@@ -13,6 +13,7 @@ namespace leveldb {
 
 	struct BlockContents;
 	class Comparator;
+	class LearnedIndex;
 
 	class Block {
 	public:
@@ -22,7 +23,11 @@ namespace leveldb {
 		~Block();
 
 		size_t size() const { return size_; }
-		Iterator* NewIterator(const Comparator* comparator);
+
+		// If "model" is non-NULL and was trained on this block's restart
+		// keys, Seek() uses it to narrow its binary search.
+		Iterator* NewIterator(const Comparator* comparator,
+			const LearnedIndex* model = NULL);
 
 	private:
 		uint32_t NumRestarts() const;
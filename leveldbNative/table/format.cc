@@ -9,6 +9,7 @@
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb {
 
@@ -77,7 +78,11 @@ namespace leveldb {
 		size_t n = static_cast<size_t>(handle.size());
 		char* buf = new char[n + kBlockTrailerSize];
 		Slice contents;
+		PERF_TIMER_GUARD(block_read_time);
 		Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+		PERF_TIMER_STOP(block_read_time);
+		PERF_COUNTER_ADD(block_read_count, 1);
+		PERF_COUNTER_ADD(block_read_byte, n + kBlockTrailerSize);
 		if (!s.ok()) {
 			delete[] buf;
 			return s;
@@ -90,6 +95,7 @@ namespace leveldb {
 		// Check the crc of the type and the block contents
 		const char* data = contents.data();    // Pointer to where Read put the data
 		if (options.verify_checksums) {
+			PERF_TIMER_GUARD(block_checksum_time);
 			const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
 			const uint32_t actual = crc32c::Value(data, n + 1);
 			if (actual != crc) {
@@ -119,6 +125,7 @@ namespace leveldb {
 			// Ok
 			break;
 		case kSnappyCompression: {
+			PERF_TIMER_GUARD(block_decompress_time);
 			size_t ulength = 0;
 			if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
 				delete[] buf;
@@ -86,6 +86,18 @@ namespace leveldb {
 	// 1-byte type + 32-bit crc
 	static const size_t kBlockTrailerSize = 5;
 
+	// Name of the metaindex entry pointing at the properties block, and the
+	// names of the properties every TableBuilder records in it.  Tables
+	// written before the properties block existed simply lack the entry.
+	static const char kPropertiesBlock[] = "leveldb.properties";
+	static const char kPropertyNumEntries[] = "leveldb.num.entries";
+	static const char kPropertySmallestKey[] = "leveldb.smallest.key";
+	static const char kPropertyLargestKey[] = "leveldb.largest.key";
+
+	// Name of the metaindex entry pointing at the learned index over the
+	// index block's keys (see Options::learned_index_max_error).
+	static const char kLearnedIndexBlock[] = "leveldb.learned_index";
+
 	struct BlockContents {
 		BlockContents() : data(), cachable(), heap_allocated() {}
 		Slice data;           // Actual contents of data
@@ -14,6 +14,9 @@
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/learned_index.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
@@ -25,8 +28,10 @@ namespace leveldb {
 			cache_id(),
 			filter(),
 			filter_data(),
+			filter_data_size(0),
 			metaindex_handle(),
-			index_block() {
+			index_block(),
+			learned_index() {
 		}
 		~Rep() {
 			delete filter;
@@ -40,9 +45,11 @@ namespace leveldb {
 		uint64_t cache_id;
 		FilterBlockReader* filter;
 		const char* filter_data;
+		size_t filter_data_size;    // 0 unless filter_data is heap allocated
 
 		BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
 		Block* index_block;
+		LearnedIndex learned_index;  // Empty unless the table has one and it is enabled
 
 	private:
 		Rep(const Rep&);
@@ -100,7 +107,8 @@ namespace leveldb {
 	}
 
 	void Table::ReadMeta(const Footer& footer) {
-		if (rep_->options.filter_policy == NULL) {
+		if (rep_->options.filter_policy == NULL &&
+			rep_->options.learned_index_max_error <= 0) {
 			return;  // Do not need any metadata
 		}
 
@@ -115,11 +123,19 @@ namespace leveldb {
 		Block* meta = new Block(contents);
 
 		Iterator* iter = meta->NewIterator(BytewiseComparator());
-		std::string key = "filter.";
-		key.append(rep_->options.filter_policy->Name());
-		iter->Seek(key);
-		if (iter->Valid() && iter->key() == Slice(key)) {
-			ReadFilter(iter->value());
+		if (rep_->options.filter_policy != NULL) {
+			std::string key = "filter.";
+			key.append(rep_->options.filter_policy->Name());
+			iter->Seek(key);
+			if (iter->Valid() && iter->key() == Slice(key)) {
+				ReadFilter(iter->value());
+			}
+		}
+		if (rep_->options.learned_index_max_error > 0) {
+			iter->Seek(kLearnedIndexBlock);
+			if (iter->Valid() && iter->key() == Slice(kLearnedIndexBlock)) {
+				ReadLearnedIndex(iter->value());
+			}
 		}
 		delete iter;
 		delete meta;
@@ -141,10 +157,66 @@ namespace leveldb {
 		}
 		if (block.heap_allocated) {
 			rep_->filter_data = block.data.data();     // Will need to delete later
+			rep_->filter_data_size = block.data.size();
 		}
 		rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 	}
 
+	void Table::ReadLearnedIndex(const Slice& handle_value) {
+		Slice v = handle_value;
+		BlockHandle handle;
+		if (!handle.DecodeFrom(&v).ok()) {
+			return;
+		}
+		ReadOptions opt;
+		opt.verify_checksums = true;
+		BlockContents block;
+		if (!ReadBlock(rep_->file, opt, handle, &block).ok()) {
+			return;
+		}
+		// A model that fails to decode is left empty and never used
+		rep_->learned_index.DecodeFrom(block.data);
+		if (block.heap_allocated) {
+			delete[] block.data.data();
+		}
+	}
+
+	Status Table::ReadProperties(std::map<std::string, std::string>* properties) const {
+		ReadOptions opt;
+		opt.verify_checksums = true;
+		BlockContents contents;
+		Status s = ReadBlock(rep_->file, opt, rep_->metaindex_handle, &contents);
+		if (!s.ok()) {
+			return s;
+		}
+		Block meta(contents);
+		Iterator* iter = meta.NewIterator(BytewiseComparator());
+		iter->Seek(kPropertiesBlock);
+		if (!iter->Valid() || iter->key() != Slice(kPropertiesBlock)) {
+			s = iter->status();
+			delete iter;
+			return s.ok() ? Status::NotFound("table has no properties block") : s;
+		}
+		BlockHandle handle;
+		Slice v = iter->value();
+		s = handle.DecodeFrom(&v);
+		delete iter;
+		if (s.ok()) {
+			s = ReadBlock(rep_->file, opt, handle, &contents);
+		}
+		if (!s.ok()) {
+			return s;
+		}
+		Block block(contents);
+		iter = block.NewIterator(BytewiseComparator());
+		for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+			(*properties)[iter->key().ToString()] = iter->value().ToString();
+		}
+		s = iter->status();
+		delete iter;
+		return s;
+	}
+
 	Table::~Table() {
 		delete rep_;
 	}
@@ -190,8 +262,11 @@ namespace leveldb {
 				cache_handle = block_cache->Lookup(key);
 				if (cache_handle != NULL) {
 					block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+					RecordTick(table->rep_->options.statistics, kBlockCacheDataHit);
+					PERF_COUNTER_ADD(block_cache_hit_count, 1);
 				}
 				else {
+					RecordTick(table->rep_->options.statistics, kBlockCacheDataMiss);
 					s = ReadBlock(table->rep_->file, options, handle, &contents);
 					if (s.ok()) {
 						block = new Block(contents);
@@ -228,7 +303,7 @@ namespace leveldb {
 
 	Iterator* Table::NewIterator(const ReadOptions& options) const {
 		return NewTwoLevelIterator(
-			rep_->index_block->NewIterator(rep_->options.comparator),
+			rep_->index_block->NewIterator(rep_->options.comparator, &rep_->learned_index),
 			&Table::BlockReader, const_cast<Table*>(this), options);
 	}
 
@@ -236,8 +311,10 @@ namespace leveldb {
 		void* arg,
 		void(*saver)(void*, const Slice&, const Slice&)) {
 		Status s;
-		Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+		Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator, &rep_->learned_index);
+		PERF_TIMER_GUARD(index_seek_nanos);
 		iiter->Seek(k);
+		PERF_TIMER_STOP(index_seek_nanos);
 		if (iiter->Valid()) {
 			Slice handle_value = iiter->value();
 			FilterBlockReader* filter = rep_->filter;
@@ -246,8 +323,13 @@ namespace leveldb {
 				handle.DecodeFrom(&handle_value).ok() &&
 				!filter->KeyMayMatch(handle.offset(), k)) {
 				// Not found
+				RecordTick(rep_->options.statistics, kBloomFilterUseful);
+				PERF_COUNTER_ADD(bloom_sst_miss_count, 1);
 			}
 			else {
+				if (filter != NULL) {
+					RecordTick(rep_->options.statistics, kBloomFilterPositive);
+				}
 				Iterator* block_iter = BlockReader(this, options, iiter->value());
 				block_iter->Seek(k);
 				if (block_iter->Valid()) {
@@ -267,7 +349,7 @@ namespace leveldb {
 
 	uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
 		Iterator* index_iter =
-			rep_->index_block->NewIterator(rep_->options.comparator);
+			rep_->index_block->NewIterator(rep_->options.comparator, &rep_->learned_index);
 		index_iter->Seek(key);
 		uint64_t result;
 		if (index_iter->Valid()) {
@@ -294,4 +376,8 @@ namespace leveldb {
 		return result;
 	}
 
+	size_t Table::ApproximateMemoryUsage() const {
+		return sizeof(Rep) + rep_->index_block->size() + rep_->filter_data_size;
+	}
+
 }  // namespace leveldb
@@ -5,6 +5,9 @@
 #include "leveldb/table_builder.h"
 
 #include <assert.h>
+#include <deque>
+#include <map>
+#include <vector>
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
@@ -12,11 +15,52 @@
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/learned_index.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
+	namespace {
+
+		// Compress raw as "type" asks, using *compressed as scratch space.
+		// Sets *contents to the bytes to store and returns their type.
+		CompressionType CompressBlock(CompressionType type, const Slice& raw,
+			std::string* compressed, Slice* contents) {
+			// TODO(postrelease): Support more compression options: zlib?
+			switch (type) {
+			case kNoCompression:
+				*contents = raw;
+				return kNoCompression;
+
+			case kSnappyCompression:
+				if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
+					compressed->size() < raw.size() - (raw.size() / 8u)) {
+					*contents = *compressed;
+					return kSnappyCompression;
+				}
+				// Snappy not supported, or compressed less than 12.5%, so just
+				// store uncompressed form
+				*contents = raw;
+				return kNoCompression;
+
+			default:
+				abort();
+			}
+		}
+
+		void EncodeBlockTrailer(const Slice& contents, CompressionType type,
+			char* trailer) {
+			trailer[0] = type;
+			uint32_t crc = crc32c::Value(contents.data(), contents.size());
+			crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
+			EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+		}
+
+	}  // namespace
+
 	struct TableBuilder::Rep {
 		Options options;
 		Options index_block_options;
@@ -25,6 +69,7 @@ namespace leveldb {
 		Status status;
 		BlockBuilder data_block;
 		BlockBuilder index_block;
+		std::string first_key;
 		std::string last_key;
 		int64_t num_entries;
 		bool closed;          // Either Finish() or Abandon() has been called.
@@ -44,6 +89,43 @@ namespace leveldb {
 
 		std::string compressed_output;
 
+		// User supplied properties; written in sorted order by Finish()
+		std::map<std::string, std::string> properties;
+
+		// KeyNum() of each index block key when a learned index is built
+		std::vector<uint64_t> index_keys;
+
+		// With options.compression_threads > 1, Flush() queues each data
+		// block as a BlockJob, and up to compression_threads workers on the
+		// Env's work pool compress and checksum it.  The thread calling
+		// Add() appends finished blocks in order and only then learns their
+		// handles, so the filter keys and index key of a queued block travel
+		// with it.
+		struct BlockJob {
+			std::string raw;
+			std::string compressed;
+			Slice contents;
+			CompressionType type;
+			char trailer[kBlockTrailerSize];
+			bool done;                    // Guarded by mu
+			bool has_index_key;
+			std::string index_key;
+			std::string filter_keys;
+			std::vector<size_t> filter_key_sizes;
+		};
+		const int compression_threads;
+		port::Mutex mu;
+		port::CondVar cv;
+		std::deque<BlockJob*> jobs;           // Queued, not yet written
+		std::deque<BlockJob*> to_compress;    // Guarded by mu
+		int running_workers;                  // Scheduled or running; guarded by mu
+		bool stop_workers;                    // Guarded by mu
+		uint64_t queued_bytes;                // Raw size of jobs
+		uint64_t written_raw_bytes;           // Raw size of jobs written so far
+		uint64_t written_stored_bytes;        // ...and the size they took on disk
+		std::string filter_keys;              // Of data_block, when queuing
+		std::vector<size_t> filter_key_sizes;
+
 		Rep(const Options& opt, WritableFile* f)
 			: options(opt),
 			index_block_options(opt),
@@ -52,6 +134,7 @@ namespace leveldb {
 			status(),
 			data_block(&options),
 			index_block(&index_block_options),
+			first_key(),
 			last_key(),
 			num_entries(0),
 			closed(false),
@@ -59,10 +142,70 @@ namespace leveldb {
 				: new FilterBlockBuilder(opt.filter_policy)),
 			pending_index_entry(false),
 			pending_handle(),
-			compressed_output() {
+			compressed_output(),
+			properties(),
+			index_keys(),
+			compression_threads(opt.compression_threads),
+			mu(),
+			cv(&mu),
+			jobs(),
+			to_compress(),
+			running_workers(0),
+			stop_workers(false),
+			queued_bytes(0),
+			written_raw_bytes(0),
+			written_stored_bytes(0),
+			filter_keys(),
+			filter_key_sizes() {
 			index_block_options.block_restart_interval = 1;
 		}
 
+		void AddIndexEntry(const Slice& key, const BlockHandle& handle) {
+			std::string handle_encoding;
+			handle.EncodeTo(&handle_encoding);
+			index_block.Add(key, Slice(handle_encoding));
+			if (options.learned_index_max_error > 0) {
+				index_keys.push_back(options.comparator->KeyNum(key));
+			}
+		}
+
+		// Runs on the Env's work pool until no block is left to compress.
+		static void CompressWorker(void* arg) {
+			Rep* r = reinterpret_cast<Rep*>(arg);
+			MutexLock l(&r->mu);
+			while (!r->to_compress.empty() && !r->stop_workers) {
+				BlockJob* job = r->to_compress.front();
+				r->to_compress.pop_front();
+				r->mu.Unlock();
+				job->type = CompressBlock(job->type, job->raw, &job->compressed, &job->contents);
+				EncodeBlockTrailer(job->contents, job->type, job->trailer);
+				r->mu.Lock();
+				job->done = true;
+				r->cv.SignalAll();
+			}
+			r->running_workers--;
+			r->cv.SignalAll();
+		}
+
+		// Let the workers return once they finish their current block, and
+		// drop every queued block.
+		void StopWorkers() {
+			{
+				MutexLock l(&mu);
+				stop_workers = true;
+				cv.SignalAll();
+				while (running_workers > 0) {
+					cv.Wait();
+				}
+				to_compress.clear();
+			}
+			for (size_t i = 0; i < jobs.size(); i++) {
+				delete jobs[i];
+			}
+			jobs.clear();
+			queued_bytes = 0;
+		}
+
 	private:
 		Rep(const Rep&);
 		Rep& operator = (const Rep&);
@@ -73,10 +216,14 @@ namespace leveldb {
 		if (rep_->filter_block != NULL) {
 			rep_->filter_block->StartBlock(0);
 		}
+		if (rep_->compression_threads > 1) {
+			options.env->ReserveWorkThreads(rep_->compression_threads);
+		}
 	}
 
 	TableBuilder::~TableBuilder() {
 		assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+		rep_->StopWorkers();
 		delete rep_->filter_block;
 		delete rep_;
 	}
@@ -88,6 +235,12 @@ namespace leveldb {
 		if (options.comparator != rep_->options.comparator) {
 			return Status::InvalidArgument("changing comparator while building table");
 		}
+		if (options.learned_index_max_error != rep_->options.learned_index_max_error) {
+			return Status::InvalidArgument("changing learned index while building table");
+		}
+		if (options.compression_threads != rep_->compression_threads) {
+			return Status::InvalidArgument("changing compression threads while building table");
+		}
 
 		// Note that any live BlockBuilders point to rep_->options and therefore
 		// will automatically pick up the updated options.
@@ -110,16 +263,30 @@ namespace leveldb {
 		if (r->pending_index_entry) {
 			assert(r->data_block.empty());
 			r->options.comparator->FindShortestSeparator(&r->last_key, key);
-			std::string handle_encoding;
-			r->pending_handle.EncodeTo(&handle_encoding);
-			r->index_block.Add(r->last_key, Slice(handle_encoding));
+			if (!r->jobs.empty()) {
+				// The previous block is still queued; its handle is not known yet
+				r->jobs.back()->has_index_key = true;
+				r->jobs.back()->index_key = r->last_key;
+			}
+			else {
+				r->AddIndexEntry(r->last_key, r->pending_handle);
+			}
 			r->pending_index_entry = false;
 		}
 
 		if (r->filter_block != NULL) {
-			r->filter_block->AddKey(key);
+			if (r->compression_threads > 1) {
+				r->filter_keys.append(key.data(), key.size());
+				r->filter_key_sizes.push_back(key.size());
+			}
+			else {
+				r->filter_block->AddKey(key);
+			}
 		}
 
+		if (r->num_entries == 0) {
+			r->first_key.assign(key.data(), key.size());
+		}
 		r->last_key.assign(key.data(), key.size());
 		r->num_entries++;
 		r->data_block.Add(key, value);
@@ -136,6 +303,11 @@ namespace leveldb {
 		if (!ok()) return;
 		if (r->data_block.empty()) return;
 		assert(!r->pending_index_entry);
+		if (r->compression_threads > 1) {
+			QueueBlock();
+			r->pending_index_entry = true;
+			return;
+		}
 		WriteBlock(&r->data_block, &r->pending_handle);
 		if (ok()) {
 			r->pending_index_entry = true;
@@ -146,6 +318,81 @@ namespace leveldb {
 		}
 	}
 
+	void TableBuilder::QueueBlock() {
+		Rep* r = rep_;
+		Rep::BlockJob* job = new Rep::BlockJob;
+		job->raw = r->data_block.Finish().ToString();
+		job->type = r->options.compression;
+		job->done = false;
+		job->has_index_key = false;
+		job->filter_keys.swap(r->filter_keys);
+		job->filter_key_sizes.swap(r->filter_key_sizes);
+		r->data_block.Reset();
+		r->jobs.push_back(job);
+		r->queued_bytes += job->raw.size() + kBlockTrailerSize;
+		{
+			MutexLock l(&r->mu);
+			r->to_compress.push_back(job);
+			if (r->running_workers < r->compression_threads) {
+				r->running_workers++;
+				r->options.env->ScheduleWork(&Rep::CompressWorker, r);
+			}
+		}
+		WriteQueuedBlocks(false);
+	}
+
+	void TableBuilder::WriteQueuedBlocks(bool all) {
+		Rep* r = rep_;
+		const size_t max_queued = 2 * static_cast<size_t>(r->compression_threads);
+		bool wrote = false;
+		while (!r->jobs.empty()) {
+			Rep::BlockJob* job = r->jobs.front();
+			{
+				MutexLock l(&r->mu);
+				while (!job->done && (all || r->jobs.size() > max_queued)) {
+					r->cv.Wait();
+				}
+				if (!job->done) {
+					break;
+				}
+			}
+			r->jobs.pop_front();
+			r->queued_bytes -= job->raw.size() + kBlockTrailerSize;
+			if (ok()) {
+				BlockHandle handle;
+				AppendBlock(job->contents, job->trailer, &handle);
+				wrote = true;
+				r->written_raw_bytes += job->raw.size();
+				r->written_stored_bytes += job->contents.size();
+				if (r->filter_block != NULL) {
+					const char* k = job->filter_keys.data();
+					for (size_t i = 0; i < job->filter_key_sizes.size(); i++) {
+						r->filter_block->AddKey(Slice(k, job->filter_key_sizes[i]));
+						k += job->filter_key_sizes[i];
+					}
+					r->filter_block->StartBlock(r->offset);
+				}
+				if (job->has_index_key) {
+					r->AddIndexEntry(job->index_key, handle);
+				}
+				else {
+					// The newest block: Add() or Finish() supplies its index key
+					assert(r->jobs.empty());
+					r->pending_handle = handle;
+				}
+			}
+			delete job;
+		}
+		if (wrote && ok()) {
+			r->status = r->file->Flush();
+		}
+	}
+
+	void TableBuilder::AddProperty(const Slice& name, const Slice& value) {
+		assert(!rep_->closed);
+		rep_->properties[name.ToString()] = value.ToString();
+	}
+
 	void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
 		// File format contains a sequence of blocks where each block has:
 		//    block_data: uint8[n]
@@ -156,30 +403,8 @@ namespace leveldb {
 		Slice raw = block->Finish();
 
 		Slice block_contents;
-		CompressionType type = r->options.compression;
-		// TODO(postrelease): Support more compression options: zlib?
-		switch (type) {
-		case kNoCompression:
-			block_contents = raw;
-			break;
-
-		case kSnappyCompression: {
-			std::string* compressed = &r->compressed_output;
-			if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-				compressed->size() < raw.size() - (raw.size() / 8u)) {
-				block_contents = *compressed;
-			}
-			else {
-				// Snappy not supported, or compressed less than 12.5%, so just
-				// store uncompressed form
-				block_contents = raw;
-				type = kNoCompression;
-			}
-			break;
-		}
-		default:
-			abort();
-		}
+		CompressionType type = CompressBlock(r->options.compression, raw,
+			&r->compressed_output, &block_contents);
 		WriteRawBlock(block_contents, type, handle);
 		r->compressed_output.clear();
 		block->Reset();
@@ -188,16 +413,19 @@ namespace leveldb {
 	void TableBuilder::WriteRawBlock(const Slice& block_contents,
 		CompressionType type,
 		BlockHandle* handle) {
+		char trailer[kBlockTrailerSize];
+		EncodeBlockTrailer(block_contents, type, trailer);
+		AppendBlock(block_contents, trailer, handle);
+	}
+
+	void TableBuilder::AppendBlock(const Slice& block_contents,
+		const char* trailer,
+		BlockHandle* handle) {
 		Rep* r = rep_;
 		handle->set_offset(r->offset);
 		handle->set_size(block_contents.size());
 		r->status = r->file->Append(block_contents);
 		if (r->status.ok()) {
-			char trailer[kBlockTrailerSize];
-			trailer[0] = type;
-			uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-			crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-			EncodeFixed32(trailer + 1, crc32c::Mask(crc));
 			r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
 			if (r->status.ok()) {
 				r->offset += block_contents.size() + kBlockTrailerSize;
@@ -214,8 +442,22 @@ namespace leveldb {
 		Flush();
 		assert(!r->closed);
 		r->closed = true;
+		if (r->compression_threads > 1) {
+			WriteQueuedBlocks(true);
+			r->StopWorkers();
+		}
 
-		BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+		BlockHandle filter_block_handle, properties_block_handle;
+		BlockHandle learned_index_handle, metaindex_block_handle, index_block_handle;
+
+		// Complete the index block up front; the learned index is fitted to
+		// its keys.  last_key is still needed for the properties block.
+		if (ok() && r->pending_index_entry) {
+			std::string successor = r->last_key;
+			r->options.comparator->FindShortSuccessor(&successor);
+			r->AddIndexEntry(successor, r->pending_handle);
+			r->pending_index_entry = false;
+		}
 
 		// Write filter block
 		if (ok() && r->filter_block != NULL) {
@@ -223,9 +465,44 @@ namespace leveldb {
 				&filter_block_handle);
 		}
 
+		// Write properties block.  Meta blocks are keyed by plain strings,
+		// so they are built with the bytewise comparator whatever comparator
+		// the table itself uses.
+		Options meta_options = r->options;
+		meta_options.comparator = BytewiseComparator();
+		meta_options.block_restart_interval = 1;
+		if (ok()) {
+			std::map<std::string, std::string> props = r->properties;
+			std::string num_entries;
+			PutVarint64(&num_entries, r->num_entries);
+			props[kPropertyNumEntries] = num_entries;
+			if (r->num_entries > 0) {
+				props[kPropertySmallestKey] = r->first_key;
+				props[kPropertyLargestKey] = r->last_key;
+			}
+			BlockBuilder properties_block(&meta_options);
+			for (std::map<std::string, std::string>::const_iterator it = props.begin();
+				it != props.end(); ++it) {
+				properties_block.Add(it->first, it->second);
+			}
+			WriteBlock(&properties_block, &properties_block_handle);
+		}
+
+		// Write learned index block
+		LearnedIndex model;
+		if (ok() && !r->index_keys.empty()) {
+			model.Train(&r->index_keys[0], r->index_keys.size(),
+				r->options.learned_index_max_error);
+			if (!model.empty()) {
+				std::string contents;
+				model.EncodeTo(&contents);
+				WriteRawBlock(contents, kNoCompression, &learned_index_handle);
+			}
+		}
+
 		// Write metaindex block
 		if (ok()) {
-			BlockBuilder meta_index_block(&r->options);
+			BlockBuilder meta_index_block(&meta_options);
 			if (r->filter_block != NULL) {
 				// Add mapping from "filter.Name" to location of filter data
 				std::string key = "filter.";
@@ -235,19 +512,22 @@ namespace leveldb {
 				meta_index_block.Add(key, handle_encoding);
 			}
 
-			// TODO(postrelease): Add stats and other meta blocks
+			// "filter.*" sorts before "leveldb.*", and "leveldb.learned_index"
+			// before "leveldb.properties".
+			if (!model.empty()) {
+				std::string handle_encoding;
+				learned_index_handle.EncodeTo(&handle_encoding);
+				meta_index_block.Add(kLearnedIndexBlock, handle_encoding);
+			}
+			std::string handle_encoding;
+			properties_block_handle.EncodeTo(&handle_encoding);
+			meta_index_block.Add(kPropertiesBlock, handle_encoding);
+
 			WriteBlock(&meta_index_block, &metaindex_block_handle);
 		}
 
 		// Write index block
 		if (ok()) {
-			if (r->pending_index_entry) {
-				r->options.comparator->FindShortSuccessor(&r->last_key);
-				std::string handle_encoding;
-				r->pending_handle.EncodeTo(&handle_encoding);
-				r->index_block.Add(r->last_key, Slice(handle_encoding));
-				r->pending_index_entry = false;
-			}
 			WriteBlock(&r->index_block, &index_block_handle);
 		}
 
@@ -270,6 +550,7 @@ namespace leveldb {
 		Rep* r = rep_;
 		assert(!r->closed);
 		r->closed = true;
+		r->StopWorkers();
 	}
 
 	uint64_t TableBuilder::NumEntries() const {
@@ -277,7 +558,13 @@ namespace leveldb {
 	}
 
 	uint64_t TableBuilder::FileSize() const {
-		return rep_->offset;
+		const Rep* r = rep_;
+		if (r->queued_bytes == 0 || r->written_raw_bytes == 0) {
+			return r->offset + r->queued_bytes;
+		}
+		// Assume the queued blocks compress as well as those written so far
+		return r->offset + static_cast<uint64_t>(static_cast<double>(r->queued_bytes) *
+			r->written_stored_bytes / r->written_raw_bytes);
 	}
 
 }  // namespace leveldb
@@ -276,6 +276,7 @@ namespace leveldb {
 			source_ = new StringSource(sink.contents());
 			Options table_options;
 			table_options.comparator = options.comparator;
+			table_options.learned_index_max_error = options.learned_index_max_error;
 			return Table::Open(table_options, source_, sink.contents().size(), &table_);
 		}
 
@@ -896,4 +897,190 @@ namespace leveldb {
 		ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 4000, 6000));
 	}
 
+	TEST(TableTest, Properties) {
+		StringSink sink;
+		Options options;
+		options.block_size = 256;
+		TableBuilder builder(options, &sink);
+		for (int i = 0; i < 100; i++) {
+			char key[20];
+			snprintf(key, sizeof(key), "k%04d", i);
+			builder.Add(key, std::string(50, 'v'));
+		}
+		builder.AddProperty("app.answer", "41");
+		builder.AddProperty("app.answer", "42");
+		ASSERT_OK(builder.Finish());
+
+		StringSource source(sink.contents());
+		Table* table = NULL;
+		ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+		std::map<std::string, std::string> props;
+		ASSERT_OK(table->ReadProperties(&props));
+		delete table;
+
+		ASSERT_EQ("42", props["app.answer"]);
+		ASSERT_EQ("k0000", props[kPropertySmallestKey]);
+		ASSERT_EQ("k0099", props[kPropertyLargestKey]);
+		Slice num_entries(props[kPropertyNumEntries]);
+		uint64_t n = 0;
+		ASSERT_TRUE(GetVarint64(&num_entries, &n));
+		ASSERT_EQ(100, n);
+	}
+
+	TEST(TableTest, ParallelCompression) {
+		const FilterPolicy* policy = NewBloomFilterPolicy(10);
+		Random rnd(304);
+		std::vector<std::string> keys, values;
+		for (int i = 0; i < 2000; i++) {
+			char key[20];
+			snprintf(key, sizeof(key), "k%06d", i);
+			keys.push_back(key);
+			std::string v;
+			values.push_back(rnd.OneIn(3) ? test::RandomString(&rnd, 300, &v).ToString()
+				: std::string(50 + rnd.Uniform(200), 'x'));
+		}
+
+		// Worker threads must not change a single byte of the table
+		std::string contents[2];
+		const int threads[2] = { 1, 4 };
+		for (int t = 0; t < 2; t++) {
+			StringSink sink;
+			Options options;
+			options.block_size = 1024;
+			options.filter_policy = policy;
+			options.learned_index_max_error = 2;
+			options.compression_threads = threads[t];
+			TableBuilder builder(options, &sink);
+			for (int i = 0; i < 2000; i++) {
+				builder.Add(keys[i], values[i]);
+			}
+			ASSERT_OK(builder.Finish());
+			ASSERT_EQ(sink.contents().size(), builder.FileSize());
+			contents[t] = sink.contents();
+		}
+		ASSERT_TRUE(contents[0] == contents[1]);
+
+		StringSource source(contents[1]);
+		Options options;
+		options.filter_policy = policy;
+		Table* table = NULL;
+		ASSERT_OK(Table::Open(options, &source, contents[1].size(), &table));
+		Iterator* iter = table->NewIterator(ReadOptions());
+		iter->SeekToFirst();
+		for (int i = 0; i < 2000; i++) {
+			ASSERT_TRUE(iter->Valid());
+			ASSERT_EQ(values[i], iter->value().ToString());
+			iter->Next();
+		}
+		ASSERT_TRUE(!iter->Valid());
+		delete iter;
+		delete table;
+
+		// Abandoning a table with blocks still queued stops the workers
+		StringSink sink;
+		Options abandoned;
+		abandoned.block_size = 256;
+		abandoned.compression_threads = 4;
+		TableBuilder builder(abandoned, &sink);
+		for (int i = 0; i < 100; i++) {
+			builder.Add(keys[i], values[i]);
+		}
+		builder.Abandon();
+		delete policy;
+	}
+
+	TEST(TableTest, ParallelCompressionFileSize) {
+		if (!SnappyCompressionSupported()) {
+			fprintf(stderr, "skipping compression tests\n");
+			return;
+		}
+
+		// Blocks still queued for compression must not be counted at their
+		// raw size, or compactions would cut files far below max_file_size.
+		Random rnd(305);
+		std::string tmp;
+		Options options;
+		options.block_size = 1024;
+		options.compression = kSnappyCompression;
+		StringSink serial_sink, parallel_sink;
+		TableBuilder serial(options, &serial_sink);
+		options.compression_threads = 4;
+		TableBuilder parallel(options, &parallel_sink);
+		for (int i = 0; i < 2000; i++) {
+			char key[20];
+			snprintf(key, sizeof(key), "k%06d", i);
+			test::CompressibleString(&rnd, 0.25, 200, &tmp);
+			serial.Add(key, tmp);
+			parallel.Add(key, tmp);
+			// Until a first block is written there is no ratio to go by
+			if (i >= 100) {
+				ASSERT_LE(parallel.FileSize(), serial.FileSize() + options.block_size / 4);
+			}
+		}
+		ASSERT_OK(serial.Finish());
+		ASSERT_OK(parallel.Finish());
+		ASSERT_EQ(serial_sink.contents().size(), parallel.FileSize());
+	}
+
+	// Seek every key, and the gaps around them, in a table with a learned
+	// index and compare against the sorted key list.
+	static void CheckLearnedSeeks(const std::vector<std::string>& input) {
+		TableConstructor c(BytewiseComparator());
+		for (size_t i = 0; i < input.size(); i++) {
+			c.Add(input[i], "v" + input[i]);
+		}
+		std::vector<std::string> keys;
+		KVMap kvmap;
+		Options options;
+		options.block_size = 256;
+		options.learned_index_max_error = 2;
+		c.Finish(options, &keys, &kvmap);
+
+		Iterator* iter = c.NewIterator();
+		std::vector<std::string> targets(keys);
+		for (size_t i = 0; i < keys.size(); i++) {
+			targets.push_back(keys[i] + '\0');
+			std::string shorter = keys[i];
+			shorter.resize(shorter.size() - 1);
+			targets.push_back(shorter);
+		}
+		targets.push_back("");
+		targets.push_back("\xff\xff\xff\xff\xff\xff\xff\xff\xff");
+		for (size_t i = 0; i < targets.size(); i++) {
+			iter->Seek(targets[i]);
+			KVMap::const_iterator expected = kvmap.lower_bound(targets[i]);
+			if (expected == kvmap.end()) {
+				ASSERT_TRUE(!iter->Valid());
+			}
+			else {
+				ASSERT_TRUE(iter->Valid());
+				ASSERT_EQ(expected->first, iter->key().ToString());
+			}
+		}
+		ASSERT_OK(iter->status());
+		delete iter;
+	}
+
+	TEST(TableTest, LearnedIndex) {
+		// Big-endian numbers: KeyNum() is linear in the rank of the key
+		std::vector<std::string> input;
+		for (uint64_t i = 0; i < 3000; i++) {
+			std::string key;
+			PutFixed64(&key, 0);
+			for (int b = 0; b < 8; b++) {
+				key[b] = static_cast<char>(((i * 37) >> (56 - 8 * b)) & 0xff);
+			}
+			input.push_back(key);
+		}
+		CheckLearnedSeeks(input);
+
+		// Random keys: many predictions miss and fall back
+		Random rnd(303);
+		input.clear();
+		for (int i = 0; i < 3000; i++) {
+			input.push_back(test::RandomKey(&rnd, 1 + rnd.Skewed(4)));
+		}
+		CheckLearnedSeeks(input);
+	}
+
 }  // namespace leveldb
@@ -30,7 +30,8 @@ namespace leveldb {
 			LRUHandle* prev;
 			size_t charge;      // TODO(opt): Only allow uint32_t?
 			size_t key_length;
-			uint32_t refs;
+			bool in_cache;      // Whether entry is in the cache's hash table.
+			uint32_t refs;      // Includes the cache's own reference, if in_cache
 			uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
 			char key_data[1];   // Beginning of key
 
@@ -150,6 +151,14 @@ namespace leveldb {
 			Cache::Handle* Lookup(const Slice& key, uint32_t hash);
 			void Release(Cache::Handle* handle);
 			void Erase(const Slice& key, uint32_t hash);
+			size_t TotalCharge() const {
+				MutexLock l(&mutex_);
+				return usage_;
+			}
+			size_t PinnedCharge() const {
+				MutexLock l(&mutex_);
+				return pinned_usage_;
+			}
 
 		private:
 			void LRU_Remove(LRUHandle* e);
@@ -160,8 +169,9 @@ namespace leveldb {
 			size_t capacity_;
 
 			// mutex_ protects the following state.
-			port::Mutex mutex_;
+			mutable port::Mutex mutex_;
 			size_t usage_;
+			size_t pinned_usage_;   // charges of entries with outstanding handles
 
 			// Dummy head of LRU list.
 			// lru.prev is newest entry, lru.next is oldest entry.
@@ -174,6 +184,7 @@ namespace leveldb {
 			: capacity_(),
 			mutex_(),
 			usage_(0),
+			pinned_usage_(0),
 			lru_(),
 			table_() {
 			// Make empty circular linked list
@@ -217,6 +228,10 @@ namespace leveldb {
 			MutexLock l(&mutex_);
 			LRUHandle* e = table_.Lookup(key, hash);
 			if (e != NULL) {
+				if (e->refs == 1) {
+					// Only the cache held it so far
+					pinned_usage_ += e->charge;
+				}
 				e->refs++;
 				LRU_Remove(e);
 				LRU_Append(e);
@@ -226,7 +241,12 @@ namespace leveldb {
 
 		void LRUCache::Release(Cache::Handle* handle) {
 			MutexLock l(&mutex_);
-			Unref(reinterpret_cast<LRUHandle*>(handle));
+			LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+			if (e->refs == (e->in_cache ? 2u : 1u)) {
+				// Last outstanding handle
+				pinned_usage_ -= e->charge;
+			}
+			Unref(e);
 		}
 
 		Cache::Handle* LRUCache::Insert(
@@ -241,14 +261,17 @@ namespace leveldb {
 			e->charge = charge;
 			e->key_length = key.size();
 			e->hash = hash;
+			e->in_cache = true;
 			e->refs = 2;  // One from LRUCache, one for the returned handle
 			memcpy(e->key_data, key.data(), key.size());
 			LRU_Append(e);
 			usage_ += charge;
+			pinned_usage_ += charge;
 
 			LRUHandle* old = table_.Insert(e);
 			if (old != NULL) {
 				LRU_Remove(old);
+				old->in_cache = false;
 				Unref(old);
 			}
 
@@ -256,6 +279,7 @@ namespace leveldb {
 				old = lru_.next;
 				LRU_Remove(old);
 				table_.Remove(old->key(), old->hash);
+				old->in_cache = false;
 				Unref(old);
 			}
 
@@ -267,6 +291,7 @@ namespace leveldb {
 			LRUHandle* e = table_.Remove(key, hash);
 			if (e != NULL) {
 				LRU_Remove(e);
+				e->in_cache = false;
 				Unref(e);
 			}
 		}
@@ -322,6 +347,20 @@ namespace leveldb {
 				MutexLock l(&id_mutex_);
 				return ++(last_id_);
 			}
+			virtual size_t TotalCharge() const {
+				size_t total = 0;
+				for (unsigned s = 0; s < kNumShards; s++) {
+					total += shard_[s].TotalCharge();
+				}
+				return total;
+			}
+			virtual size_t PinnedCharge() const {
+				size_t total = 0;
+				for (unsigned s = 0; s < kNumShards; s++) {
+					total += shard_[s].PinnedCharge();
+				}
+				return total;
+			}
 		};
 
 
@@ -189,6 +189,28 @@ namespace leveldb {
 		ASSERT_LE(cached_weight, kCacheSize + kCacheSize / 10);
 	}
 
+	TEST(CacheTest, Charges) {
+		ASSERT_EQ(0, cache_->TotalCharge());
+		Insert(100, 101, 10);
+		Insert(200, 201, 20);
+		ASSERT_EQ(30, cache_->TotalCharge());
+		ASSERT_EQ(0, cache_->PinnedCharge());
+
+		Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+		Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+		ASSERT_EQ(10, cache_->PinnedCharge());
+		cache_->Release(h1);
+		ASSERT_EQ(10, cache_->PinnedCharge());
+
+		// An erased entry stays pinned (and charged) until its handle goes.
+		Erase(100);
+		ASSERT_EQ(30, cache_->TotalCharge());
+		ASSERT_EQ(10, cache_->PinnedCharge());
+		cache_->Release(h2);
+		ASSERT_EQ(20, cache_->TotalCharge());
+		ASSERT_EQ(0, cache_->PinnedCharge());
+	}
+
 	TEST(CacheTest, NewId) {
 		uint64_t a = cache_->NewId();
 		uint64_t b = cache_->NewId();
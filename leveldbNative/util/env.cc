@@ -4,9 +4,26 @@
 
 #include "leveldb/env.h"
 
+#include "util/thread_pool.h"
+
 namespace leveldb {
 
+	// The pool starts no thread until work arrives, so every Env can
+	// afford one.
+	Env::Env()
+		: work_pool_(new ThreadPool(this)) {
+	}
+
 	Env::~Env() {
+		delete work_pool_;
+	}
+
+	void Env::ScheduleWork(void(*function)(void* arg), void* arg) {
+		work_pool_->Schedule(function, arg);
+	}
+
+	void Env::ReserveWorkThreads(int threads) {
+		work_pool_->Reserve(threads);
 	}
 
 	SequentialFile::~SequentialFile() {
@@ -1228,6 +1228,15 @@ namespace leveldb {
 				return (uint64_t)(GetTickCount() * 1000);
 			}
 
+			virtual uint64_t NowNanos() {
+				LARGE_INTEGER now;
+				QueryPerformanceCounter(&now);
+				// Split the conversion so that ticks * 1e9 cannot overflow.
+				const uint64_t ticks = static_cast<uint64_t>(now.QuadPart);
+				return (ticks / perf_frequency_) * 1000000000ull +
+					(ticks % perf_frequency_) * 1000000000ull / perf_frequency_;
+			}
+
 			virtual void SleepForMicroseconds(int micros) {
 				//boost::this_thread::sleep(boost::posix_time::microseconds(micros));
 				::Sleep((micros + 999) / 1000);
@@ -1257,9 +1266,17 @@ namespace leveldb {
 			struct BGItem { void* arg; void(*function)(void*); };
 			typedef std::deque<BGItem> BGQueue;
 			BGQueue queue_;
+
+			uint64_t perf_frequency_;  // QueryPerformanceCounter ticks per second
 		};
 
-		PosixEnv::PosixEnv() { }
+		PosixEnv::PosixEnv()
+			: perf_frequency_(1) {
+			LARGE_INTEGER frequency;
+			if (QueryPerformanceFrequency(&frequency) && frequency.QuadPart > 0) {
+				perf_frequency_ = static_cast<uint64_t>(frequency.QuadPart);
+			}
+		}
 
 		WorkItemWrapper::WorkItemWrapper(ScheduleProc proc_, void* content_) :
 			proc(proc_), pContent(content_)
@@ -114,5 +114,50 @@ namespace leveldb {
 		ASSERT_EQ(state.val, 3);
 	}
 
+	// Each item waits until every item has started, which can only happen
+	// when the pool runs them on separate threads.
+	static void MeetBody(void* arg) {
+		State* s = reinterpret_cast<State*>(arg);
+		s->mu.Lock();
+		s->val += 1;
+		s->mu.Unlock();
+		for (int i = 0; i < 500; i++) {
+			s->mu.Lock();
+			bool all_started = (s->val == 3);
+			s->mu.Unlock();
+			if (all_started) {
+				break;
+			}
+			Env::Default()->SleepForMicroseconds(kDelayMicros / 10);
+		}
+		s->mu.Lock();
+		s->num_running -= 1;
+		s->mu.Unlock();
+	}
+
+	TEST(EnvPosixTest, ScheduleWork) {
+		State state;
+		state.val = 0;
+		state.num_running = 3;
+		env_->ReserveWorkThreads(3);
+		for (int i = 0; i < 3; i++) {
+			env_->ScheduleWork(&MeetBody, &state);
+		}
+		uint64_t start = env_->NowMicros();
+		while (true) {
+			state.mu.Lock();
+			int num = state.num_running;
+			state.mu.Unlock();
+			if (num == 0) {
+				break;
+			}
+			Env::Default()->SleepForMicroseconds(kDelayMicros / 10);
+		}
+		ASSERT_EQ(state.val, 3);
+		// Run one after another, the first two items would give up waiting
+		// only after 5s each
+		ASSERT_LT(env_->NowMicros() - start, 5000000);
+	}
+
 }  // namespace leveldb
 
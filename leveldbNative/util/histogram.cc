@@ -2,9 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <algorithm>
 #include <math.h>
 #include <stdio.h>
 #include "port/port.h"
+#include "util/atomic.h"
 #include "util/histogram.h"
 
 namespace leveldb {
@@ -136,4 +138,61 @@ namespace leveldb {
 		return r;
 	}
 
+	void ConcurrentHistogram::Clear() {
+		using namespace atomic;
+		store_64_nobarrier(&min_, ~static_cast<uint64_t>(0));
+		store_64_nobarrier(&max_, 0);
+		store_64_nobarrier(&num_, 0);
+		store_64_nobarrier(&sum_, 0);
+		store_64_nobarrier(&sum_squares_, 0);
+		for (int b = 0; b < Histogram::kNumBuckets; b++) {
+			store_64_nobarrier(&buckets_[b], 0);
+		}
+		memory_barrier();
+	}
+
+	void ConcurrentHistogram::Add(uint64_t value) {
+		using namespace atomic;
+		// Unlike Histogram::Add this sits on the read and write paths, so
+		// find the bucket with a binary search.
+		const double* limits = Histogram::kBucketLimit;
+		const double* b = std::upper_bound(limits, limits + Histogram::kNumBuckets - 1,
+			static_cast<double>(value));
+		increment_64_nobarrier(&buckets_[b - limits], 1);
+		increment_64_nobarrier(&num_, 1);
+		increment_64_nobarrier(&sum_, value);
+		increment_64_nobarrier(&sum_squares_, value * value);
+
+		uint64_t cur = load_64_nobarrier(&min_);
+		while (value < cur) {
+			uint64_t witness = compare_and_swap_64_nobarrier(&min_, cur, value);
+			if (witness == cur) break;
+			cur = witness;
+		}
+		cur = load_64_nobarrier(&max_);
+		while (value > cur) {
+			uint64_t witness = compare_and_swap_64_nobarrier(&max_, cur, value);
+			if (witness == cur) break;
+			cur = witness;
+		}
+	}
+
+	void ConcurrentHistogram::MergeInto(Histogram* h) const {
+		using namespace atomic;
+		const uint64_t num = load_64_nobarrier(&num_);
+		if (num == 0) {
+			return;
+		}
+		const double mn = static_cast<double>(load_64_nobarrier(&min_));
+		const double mx = static_cast<double>(load_64_nobarrier(&max_));
+		if (mn < h->min_) h->min_ = mn;
+		if (mx > h->max_) h->max_ = mx;
+		h->num_ += static_cast<double>(num);
+		h->sum_ += static_cast<double>(load_64_nobarrier(&sum_));
+		h->sum_squares_ += static_cast<double>(load_64_nobarrier(&sum_squares_));
+		for (int b = 0; b < Histogram::kNumBuckets; b++) {
+			h->buckets_[b] += static_cast<double>(load_64_nobarrier(&buckets_[b]));
+		}
+	}
+
 }  // namespace leveldb
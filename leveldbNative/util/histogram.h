@@ -6,9 +6,12 @@
 #define STORAGE_LEVELDB_UTIL_HISTOGRAM_H_
 
 #include <string>
+#include <stdint.h>
 
 namespace leveldb {
 
+	class ConcurrentHistogram;
+
 	class Histogram {
 	public:
 		Histogram()
@@ -25,7 +28,17 @@ namespace leveldb {
 
 		std::string ToString() const;
 
+		double Count() const { return num_; }
+		double Min() const { return num_ <= 0.0 ? 0.0 : min_; }
+		double Max() const { return max_; }
+		double Median() const;
+		double Percentile(double p) const;
+		double Average() const;
+		double StandardDeviation() const;
+
 	private:
+		friend class ConcurrentHistogram;
+
 		double min_;
 		double max_;
 		double num_;
@@ -35,11 +48,34 @@ namespace leveldb {
 		enum { kNumBuckets = 154 };
 		static const double kBucketLimit[kNumBuckets];
 		double buckets_[kNumBuckets];
+	};
 
-		double Median() const;
-		double Percentile(double p) const;
-		double Average() const;
-		double StandardDeviation() const;
+	// A histogram with the same buckets as Histogram that many threads may
+	// Add() to concurrently without locking.  Each field is updated with an
+	// atomic instruction, so a snapshot taken while writers are active may
+	// be off by the samples in flight, but never torn.
+	class ConcurrentHistogram {
+	public:
+		ConcurrentHistogram() { Clear(); }
+		~ConcurrentHistogram() throw () { }
+
+		void Clear();
+		void Add(uint64_t value);
+
+		// Add the samples recorded so far into *h.
+		void MergeInto(Histogram* h) const;
+
+	private:
+		uint64_t min_;
+		uint64_t max_;
+		uint64_t num_;
+		uint64_t sum_;
+		uint64_t sum_squares_;
+		uint64_t buckets_[Histogram::kNumBuckets];
+
+		// No copying allowed
+		ConcurrentHistogram(const ConcurrentHistogram&);
+		void operator=(const ConcurrentHistogram&);
 	};
 
 }  // namespace leveldb
@@ -0,0 +1,134 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/learned_index.h"
+
+#include <string.h>
+#include "util/coding.h"
+
+namespace leveldb {
+
+	LearnedIndex::LearnedIndex()
+		: segments_(),
+		max_error_(0),
+		size_(0) {
+	}
+
+	void LearnedIndex::Train(const uint64_t* keys, size_t n, uint32_t max_error) {
+		segments_.clear();
+		max_error_ = max_error;
+		size_ = static_cast<uint32_t>(n);
+		if (n < 2 || keys[0] == keys[n - 1]) {
+			return;
+		}
+
+		// Greedy "shrinking cone": grow a segment from its first point for as
+		// long as some line through that point stays within max_error of
+		// every point added so far.  [lo, hi] is the range of such slopes.
+		const double e = max_error;
+		size_t start = 0;
+		double lo = 0;
+		double hi = 1e300;
+		for (size_t i = 1; i <= n; i++) {
+			bool fits = false;
+			if (i < n) {
+				const double dy = static_cast<double>(i - start);
+				if (keys[i] == keys[start]) {
+					fits = (dy <= e);
+				}
+				else {
+					const double dx = static_cast<double>(keys[i] - keys[start]);
+					double new_lo = (dy - e) / dx;
+					double new_hi = (dy + e) / dx;
+					if (new_lo < lo) new_lo = lo;
+					if (new_hi > hi) new_hi = hi;
+					if (new_lo <= new_hi) {
+						lo = new_lo;
+						hi = new_hi;
+						fits = true;
+					}
+				}
+			}
+			if (!fits) {
+				Segment s;
+				s.first_key = keys[start];
+				s.first_position = static_cast<uint32_t>(start);
+				s.slope = (hi == 1e300) ? lo : (lo + hi) / 2;
+				segments_.push_back(s);
+				start = i;
+				lo = 0;
+				hi = 1e300;
+			}
+		}
+	}
+
+	void LearnedIndex::Predict(uint64_t key, uint32_t* left, uint32_t* right) const {
+		// Last segment starting at or before key
+		uint32_t l = 0;
+		uint32_t r = static_cast<uint32_t>(segments_.size()) - 1;
+		while (l < r) {
+			uint32_t mid = (l + r + 1) / 2;
+			if (segments_[mid].first_key <= key) {
+				l = mid;
+			}
+			else {
+				r = mid - 1;
+			}
+		}
+		const Segment& s = segments_[l];
+		double position = s.first_position;
+		if (key > s.first_key) {
+			position += s.slope * static_cast<double>(key - s.first_key);
+		}
+		if (position > size_) {
+			position = size_;   // Far past the last trained key
+		}
+		const double slack = static_cast<double>(max_error_) + 1;
+		*left = (position - slack <= 0) ? 0 : static_cast<uint32_t>(position - slack);
+		*right = (position + slack >= size_) ? size_ : static_cast<uint32_t>(position + slack) + 1;
+	}
+
+	void LearnedIndex::EncodeTo(std::string* dst) const {
+		PutVarint32(dst, size_);
+		PutVarint32(dst, max_error_);
+		PutVarint32(dst, static_cast<uint32_t>(segments_.size()));
+		for (size_t i = 0; i < segments_.size(); i++) {
+			uint64_t slope_bits;
+			memcpy(&slope_bits, &segments_[i].slope, sizeof(slope_bits));
+			PutFixed64(dst, segments_[i].first_key);
+			PutFixed64(dst, slope_bits);
+			PutVarint32(dst, segments_[i].first_position);
+		}
+	}
+
+	bool LearnedIndex::DecodeFrom(const Slice& src) {
+		Slice input = src;
+		uint32_t count;
+		segments_.clear();
+		if (!GetVarint32(&input, &size_) ||
+			!GetVarint32(&input, &max_error_) ||
+			!GetVarint32(&input, &count)) {
+			return false;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			if (input.size() < 16) {
+				segments_.clear();
+				return false;
+			}
+			Segment s;
+			uint64_t slope_bits;
+			s.first_key = DecodeFixed64(input.data());
+			slope_bits = DecodeFixed64(input.data() + 8);
+			memcpy(&s.slope, &slope_bits, sizeof(slope_bits));
+			input.remove_prefix(16);
+			if (!GetVarint32(&input, &s.first_position)) {
+				segments_.clear();
+				return false;
+			}
+			segments_.push_back(s);
+		}
+		return true;
+	}
+
+}  // namespace leveldb
@@ -0,0 +1,62 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// LearnedIndex approximates the position of a key in a sorted array from
+// the key's Comparator::KeyNum() value.  It is a piecewise linear function
+// fitted so that every trained key is predicted within max_error
+// positions of where it actually is.  For keys that are numbers (ids,
+// timestamps) a handful of segments usually covers a whole table or level.
+//
+// A prediction is only a hint: callers search the predicted window and
+// must confirm the answer lies inside it, falling back to a full binary
+// search when it does not.
+
+#ifndef STORAGE_LEVELDB_UTIL_LEARNED_INDEX_H_
+#define STORAGE_LEVELDB_UTIL_LEARNED_INDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+	class LearnedIndex {
+	public:
+		LearnedIndex();
+
+		// Fit the model to keys[i] -> i for i in [0, n).  Leaves the model
+		// empty if the keys carry no information (e.g. all KeyNum()s equal).
+		// REQUIRES: keys[] is non-decreasing
+		void Train(const uint64_t* keys, size_t n, uint32_t max_error);
+
+		bool empty() const { return segments_.empty(); }
+		size_t NumSegments() const { return segments_.size(); }
+		uint32_t size() const { return size_; }   // Number of trained keys
+		uint32_t max_error() const { return max_error_; }
+
+		// Set [*left, *right] to the positions within max_error + 1 of the
+		// predicted position of key, clipped to [0, n] where n is the number
+		// of trained keys.
+		// REQUIRES: !empty()
+		void Predict(uint64_t key, uint32_t* left, uint32_t* right) const;
+
+		void EncodeTo(std::string* dst) const;
+		bool DecodeFrom(const Slice& src);
+
+	private:
+		struct Segment {
+			uint64_t first_key;
+			double slope;
+			uint32_t first_position;
+		};
+
+		std::vector<Segment> segments_;
+		uint32_t max_error_;
+		uint32_t size_;
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_LEARNED_INDEX_H_
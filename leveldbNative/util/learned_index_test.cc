@@ -0,0 +1,119 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/learned_index.h"
+
+#include <vector>
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+	class LearnedIndexTest {
+	public:
+		std::vector<uint64_t> keys_;
+
+		// Every trained key must land inside its predicted window, and
+		// every window must be clipped to [0, n].
+		void CheckWindows(const LearnedIndex& model, uint32_t max_error) {
+			for (size_t i = 0; i < keys_.size(); i++) {
+				uint32_t left, right;
+				model.Predict(keys_[i], &left, &right);
+				ASSERT_LE(left, right);
+				ASSERT_LE(right, keys_.size());
+				ASSERT_LE(right - left, 2 * max_error + 4);
+				// With duplicates, the first occurrence must be covered
+				size_t first = i;
+				while (first > 0 && keys_[first - 1] == keys_[i]) {
+					first--;
+				}
+				ASSERT_LE(left, first);
+				ASSERT_GE(right, i);
+			}
+		}
+	};
+
+	TEST(LearnedIndexTest, Linear) {
+		for (uint64_t i = 0; i < 10000; i++) {
+			keys_.push_back(1000 + i * 7);
+		}
+		LearnedIndex model;
+		model.Train(&keys_[0], keys_.size(), 0);
+		ASSERT_EQ(1, model.NumSegments());
+		CheckWindows(model, 0);
+	}
+
+	TEST(LearnedIndexTest, Random) {
+		Random rnd(301);
+		uint64_t k = 0;
+		for (int i = 0; i < 10000; i++) {
+			// Mostly small gaps, occasionally a huge one, some duplicates
+			k += rnd.OneIn(100) ? (uint64_t(1) << 40) : rnd.Uniform(1000);
+			keys_.push_back(k);
+		}
+		const uint32_t errors[] = { 0, 1, 4, 32 };
+		for (size_t e = 0; e < sizeof(errors) / sizeof(errors[0]); e++) {
+			LearnedIndex model;
+			model.Train(&keys_[0], keys_.size(), errors[e]);
+			ASSERT_TRUE(!model.empty());
+			ASSERT_EQ(keys_.size(), model.size());
+			CheckWindows(model, errors[e]);
+		}
+	}
+
+	TEST(LearnedIndexTest, OutOfRange) {
+		for (uint64_t i = 0; i < 100; i++) {
+			keys_.push_back(1000 + i * 10);
+		}
+		LearnedIndex model;
+		model.Train(&keys_[0], keys_.size(), 2);
+		uint32_t left, right;
+		model.Predict(0, &left, &right);
+		ASSERT_EQ(0, left);
+		model.Predict(~uint64_t(0), &left, &right);
+		ASSERT_EQ(100, right);
+		ASSERT_LE(left, right);
+	}
+
+	TEST(LearnedIndexTest, Degenerate) {
+		LearnedIndex model;
+		uint64_t one = 5;
+		model.Train(&one, 1, 4);
+		ASSERT_TRUE(model.empty());
+
+		keys_.assign(50, 42);
+		model.Train(&keys_[0], keys_.size(), 4);
+		ASSERT_TRUE(model.empty());
+	}
+
+	TEST(LearnedIndexTest, EncodeDecode) {
+		Random rnd(302);
+		uint64_t k = 0;
+		for (int i = 0; i < 5000; i++) {
+			k += rnd.Skewed(20);
+			keys_.push_back(k);
+		}
+		LearnedIndex model;
+		model.Train(&keys_[0], keys_.size(), 3);
+		std::string encoded;
+		model.EncodeTo(&encoded);
+
+		LearnedIndex decoded;
+		ASSERT_TRUE(decoded.DecodeFrom(encoded));
+		ASSERT_EQ(model.NumSegments(), decoded.NumSegments());
+		ASSERT_EQ(model.size(), decoded.size());
+		for (size_t i = 0; i < keys_.size(); i++) {
+			uint32_t l1, r1, l2, r2;
+			model.Predict(keys_[i], &l1, &r1);
+			decoded.Predict(keys_[i], &l2, &r2);
+			ASSERT_EQ(l1, l2);
+			ASSERT_EQ(r1, r2);
+		}
+
+		// Truncated input is rejected and leaves the model empty
+		ASSERT_TRUE(!decoded.DecodeFrom(Slice(encoded.data(), encoded.size() - 3)));
+		ASSERT_TRUE(decoded.empty());
+	}
+
+}  // namespace leveldb
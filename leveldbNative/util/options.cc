@@ -22,8 +22,27 @@ namespace leveldb {
 		block_size(4096),
 		block_restart_interval(16),
 		compression(kSnappyCompression),
+		compression_threads(1),
 		filter_policy(NULL),
-		manual_garbage_collection(false) {
+		manual_garbage_collection(false),
+		statistics(NULL),
+		listener(NULL),
+		compaction_filter(NULL),
+		max_file_opening_threads(16),
+		warm_table_cache(false),
+		max_manifest_file_size(64 << 20),
+		learned_index_max_error(0),
+		compaction_style(kCompactionStyleLevel),
+		universal_size_ratio(1),
+		universal_min_merge_width(2),
+		universal_max_size_amplification_percent(200),
+		fifo_max_table_files_size(1 << 30),
+		fifo_ttl_seconds(0),
+		compact_expired_files(false),
+		pipelined_compaction(false),
+		min_blob_size(0),
+		blob_gc_percent(50),
+		secondary_catch_up_millis(0) {
 	}
 
 
@@ -0,0 +1,86 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/parallel.h"
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+	namespace {
+
+		struct ParallelState {
+			ParallelState(int count, void(*f)(void*, int), void* a)
+				: mu(),
+				cv(&mu),
+				n(count),
+				next(0),
+				running(0),
+				function(f),
+				arg(a) {
+			}
+
+			port::Mutex mu;
+			port::CondVar cv;
+			const int n;
+			int next;         // Next index to hand out; guarded by mu
+			int running;      // Started workers that have not exited; guarded by mu
+			void(*function)(void*, int);
+			void* arg;
+
+		private:
+			ParallelState(const ParallelState&);
+			ParallelState& operator = (const ParallelState&);
+		};
+
+		void RunIndices(ParallelState* state) {
+			while (true) {
+				int i;
+				{
+					MutexLock l(&state->mu);
+					if (state->next >= state->n) {
+						return;
+					}
+					i = state->next++;
+				}
+				(*state->function)(state->arg, i);
+			}
+		}
+
+		void ParallelWorker(void* arg) {
+			ParallelState* state = reinterpret_cast<ParallelState*>(arg);
+			RunIndices(state);
+			MutexLock l(&state->mu);
+			state->running--;
+			state->cv.SignalAll();
+		}
+
+	}  // namespace
+
+	void ParallelFor(Env* env, int threads, int n,
+		void(*function)(void* arg, int i), void* arg) {
+		if (threads > n) {
+			threads = n;
+		}
+		ParallelState state(n, function, arg);
+		if (threads > 1) {
+			MutexLock l(&state.mu);
+			state.running = threads - 1;
+		}
+		for (int t = 1; t < threads; t++) {
+			env->StartThread(&ParallelWorker, &state);
+		}
+
+		// The caller takes a share of the work instead of idling.
+		RunIndices(&state);
+
+		MutexLock l(&state.mu);
+		while (state.running > 0) {
+			state.cv.Wait();
+		}
+	}
+
+}  // namespace leveldb
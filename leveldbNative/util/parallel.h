@@ -0,0 +1,24 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Run a loop body over a range of indices on a few Env threads.
+
+#ifndef STORAGE_LEVELDB_UTIL_PARALLEL_H_
+#define STORAGE_LEVELDB_UTIL_PARALLEL_H_
+
+namespace leveldb {
+
+	class Env;
+
+	// Call (*function)(arg, i) once for every i in [0, n), using up to
+	// "threads" threads including the calling one.  Indices are handed out
+	// in increasing order but may complete in any order.  Returns once every
+	// call has returned.  "function" must be safe to run concurrently with
+	// itself.
+	extern void ParallelFor(Env* env, int threads, int n,
+		void(*function)(void* arg, int i), void* arg);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_PARALLEL_H_
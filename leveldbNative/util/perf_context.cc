@@ -0,0 +1,82 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/perf_context.h"
+
+#include <stdio.h>
+#include "util/perf_context_imp.h"
+
+namespace leveldb {
+
+	LEVELDB_THREAD_LOCAL PerfContext tls_perf_context;
+	LEVELDB_THREAD_LOCAL int tls_perf_level = kDisable;
+
+	void SetPerfLevel(PerfLevel level) {
+		tls_perf_level = level;
+	}
+
+	PerfLevel GetPerfLevel() {
+		return static_cast<PerfLevel>(tls_perf_level);
+	}
+
+	PerfContext* GetPerfContext() {
+		return &tls_perf_context;
+	}
+
+	void PerfContext::Reset() {
+		get_from_memtable_count = 0;
+		get_from_memtable_time = 0;
+		get_from_output_files_time = 0;
+		db_mutex_lock_nanos = 0;
+		table_probe_count = 0;
+		find_table_nanos = 0;
+		index_seek_nanos = 0;
+		bloom_sst_miss_count = 0;
+		block_cache_hit_count = 0;
+		block_read_count = 0;
+		block_read_byte = 0;
+		block_read_time = 0;
+		block_checksum_time = 0;
+		block_decompress_time = 0;
+		seek_internal_seek_time = 0;
+		find_next_user_entry_time = 0;
+		internal_key_skipped_count = 0;
+		internal_delete_skipped_count = 0;
+	}
+
+	std::string PerfContext::ToString() const {
+		std::string r;
+		char buf[100];
+#define PERF_CONTEXT_OUTPUT(field) \
+		if (field > 0) { \
+			snprintf(buf, sizeof(buf), "%s = %llu, ", #field, \
+				static_cast<unsigned long long>(field)); \
+			r.append(buf); \
+		}
+		PERF_CONTEXT_OUTPUT(get_from_memtable_count);
+		PERF_CONTEXT_OUTPUT(get_from_memtable_time);
+		PERF_CONTEXT_OUTPUT(get_from_output_files_time);
+		PERF_CONTEXT_OUTPUT(db_mutex_lock_nanos);
+		PERF_CONTEXT_OUTPUT(table_probe_count);
+		PERF_CONTEXT_OUTPUT(find_table_nanos);
+		PERF_CONTEXT_OUTPUT(index_seek_nanos);
+		PERF_CONTEXT_OUTPUT(bloom_sst_miss_count);
+		PERF_CONTEXT_OUTPUT(block_cache_hit_count);
+		PERF_CONTEXT_OUTPUT(block_read_count);
+		PERF_CONTEXT_OUTPUT(block_read_byte);
+		PERF_CONTEXT_OUTPUT(block_read_time);
+		PERF_CONTEXT_OUTPUT(block_checksum_time);
+		PERF_CONTEXT_OUTPUT(block_decompress_time);
+		PERF_CONTEXT_OUTPUT(seek_internal_seek_time);
+		PERF_CONTEXT_OUTPUT(find_next_user_entry_time);
+		PERF_CONTEXT_OUTPUT(internal_key_skipped_count);
+		PERF_CONTEXT_OUTPUT(internal_delete_skipped_count);
+#undef PERF_CONTEXT_OUTPUT
+		if (r.size() >= 2) {
+			r.resize(r.size() - 2);
+		}
+		return r;
+	}
+
+}  // namespace leveldb
@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+#define STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+
+#include "leveldb/env.h"
+#include "leveldb/perf_context.h"
+#include "port/port.h"
+
+namespace leveldb {
+
+	// The calling thread's context and level; see leveldb/perf_context.h.
+	extern LEVELDB_THREAD_LOCAL PerfContext tls_perf_context;
+	extern LEVELDB_THREAD_LOCAL int tls_perf_level;
+
+	// Accumulates elapsed nanoseconds into one PerfContext field.  The clock
+	// is only read when the thread's level is kEnableTime.  Start() and
+	// Stop() may be called repeatedly to time disjoint sections; the
+	// destructor stops a running timer.
+	class PerfStepTimer {
+	public:
+		explicit PerfStepTimer(uint64_t* metric)
+			: enabled_(tls_perf_level >= kEnableTime),
+			metric_(metric),
+			start_(0) {
+			Start();
+		}
+		~PerfStepTimer() {
+			Stop();
+		}
+
+		void Start() {
+			if (enabled_) {
+				start_ = Env::Default()->NowNanos();
+			}
+		}
+
+		void Stop() {
+			if (start_ != 0) {
+				*metric_ += Env::Default()->NowNanos() - start_;
+				start_ = 0;
+			}
+		}
+
+	private:
+		const bool enabled_;
+		uint64_t* const metric_;
+		uint64_t start_;
+
+		// No copying allowed
+		PerfStepTimer(const PerfStepTimer&);
+		void operator=(const PerfStepTimer&);
+	};
+
+#define PERF_TIMER_GUARD(metric) \
+	PerfStepTimer perf_step_timer_ ## metric(&(tls_perf_context.metric))
+#define PERF_TIMER_START(metric) perf_step_timer_ ## metric.Start()
+#define PERF_TIMER_STOP(metric) perf_step_timer_ ## metric.Stop()
+
+#define PERF_COUNTER_ADD(metric, value) \
+	do { \
+		if (tls_perf_level >= kEnableCount) { \
+			tls_perf_context.metric += (value); \
+		} \
+	} while (0)
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
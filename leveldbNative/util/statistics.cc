@@ -0,0 +1,172 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/statistics.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include "port/port.h"
+#include "util/atomic.h"
+#include "util/histogram.h"
+
+namespace leveldb {
+
+	Statistics::~Statistics() {
+	}
+
+	const char* TickerName(Tickers ticker) {
+		switch (ticker) {
+		case kBlockCacheDataHit: return "leveldb.block.cache.data.hit";
+		case kBlockCacheDataMiss: return "leveldb.block.cache.data.miss";
+		case kTableCacheHit: return "leveldb.table.cache.hit";
+		case kTableCacheMiss: return "leveldb.table.cache.miss";
+		case kBloomFilterUseful: return "leveldb.bloom.filter.useful";
+		case kBloomFilterPositive: return "leveldb.bloom.filter.positive";
+		case kBloomFilterTruePositive: return "leveldb.bloom.filter.true.positive";
+		case kMemtableHit: return "leveldb.memtable.hit";
+		case kMemtableMiss: return "leveldb.memtable.miss";
+		case kKeysWritten: return "leveldb.keys.written";
+		case kWalBytes: return "leveldb.wal.bytes";
+		case kWalSyncs: return "leveldb.wal.synced";
+		case kStallMicros: return "leveldb.stall.micros";
+		case kFlushBytesWritten: return "leveldb.flush.write.bytes";
+		case kCompactBytesRead: return "leveldb.compact.read.bytes";
+		case kCompactBytesWritten: return "leveldb.compact.write.bytes";
+		case kCompactBytesMoved: return "leveldb.compact.move.bytes";
+		case kCompactRecordsIn: return "leveldb.compact.records.in";
+		case kCompactRecordsDropped: return "leveldb.compact.records.dropped";
+		case kCompactionsLevel0: return "leveldb.compactions.level0";
+		case kCompactionsSize: return "leveldb.compactions.size";
+		case kCompactionsSeek: return "leveldb.compactions.seek";
+		case kCompactionsManual: return "leveldb.compactions.manual";
+		case kCompactionsExpiry: return "leveldb.compactions.expiry";
+		default: return "leveldb.unknown";
+		}
+	}
+
+	const char* HistogramName(Histograms histogram) {
+		switch (histogram) {
+		case kGetMicros: return "leveldb.db.get.micros";
+		case kSeekMicros: return "leveldb.db.seek.micros";
+		case kWriteMicros: return "leveldb.db.write.micros";
+		default: return "leveldb.unknown";
+		}
+	}
+
+	namespace {
+
+		class StripedStatistics : public Statistics {
+		public:
+			StripedStatistics() { Reset(); }
+			virtual ~StripedStatistics() { }
+
+			virtual void RecordTick(Tickers ticker, uint64_t count) {
+				assert(ticker < kTickerEnumMax);
+				atomic::increment_64_nobarrier(&Local()->tickers[ticker], count);
+			}
+
+			virtual void MeasureTime(Histograms histogram, uint64_t micros) {
+				assert(histogram < kHistogramEnumMax);
+				Local()->histograms[histogram].Add(micros);
+			}
+
+			virtual uint64_t GetTickerCount(Tickers ticker) const {
+				assert(ticker < kTickerEnumMax);
+				uint64_t sum = 0;
+				for (int i = 0; i < kNumStripes; i++) {
+					sum += atomic::load_64_nobarrier(&stripes_[i].tickers[ticker]);
+				}
+				return sum;
+			}
+
+			virtual void GetHistogramData(Histograms histogram,
+				HistogramData* data) const {
+				Histogram h;
+				Merged(histogram, &h);
+				data->count = h.Count();
+				data->average = h.Average();
+				data->standard_deviation = h.StandardDeviation();
+				data->median = h.Median();
+				data->percentile95 = h.Percentile(95);
+				data->percentile99 = h.Percentile(99);
+				data->max = h.Max();
+			}
+
+			virtual void Reset() {
+				for (int i = 0; i < kNumStripes; i++) {
+					for (int t = 0; t < kTickerEnumMax; t++) {
+						atomic::store_64_nobarrier(&stripes_[i].tickers[t], 0);
+					}
+					for (int h = 0; h < kHistogramEnumMax; h++) {
+						stripes_[i].histograms[h].Clear();
+					}
+				}
+			}
+
+			virtual std::string ToString() const {
+				std::string r;
+				char buf[300];
+				for (int t = 0; t < kTickerEnumMax; t++) {
+					Tickers ticker = static_cast<Tickers>(t);
+					snprintf(buf, sizeof(buf), "%s COUNT : %llu\n",
+						TickerName(ticker),
+						static_cast<unsigned long long>(GetTickerCount(ticker)));
+					r.append(buf);
+				}
+				for (int i = 0; i < kHistogramEnumMax; i++) {
+					Histograms histogram = static_cast<Histograms>(i);
+					HistogramData d;
+					GetHistogramData(histogram, &d);
+					snprintf(buf, sizeof(buf),
+						"%s P50 : %.2f P95 : %.2f P99 : %.2f MAX : %.0f COUNT : %.0f\n",
+						HistogramName(histogram),
+						d.median, d.percentile95, d.percentile99, d.max, d.count);
+					r.append(buf);
+				}
+				return r;
+			}
+
+		private:
+			enum { kNumStripes = 16 };
+
+			struct Stripe {
+				uint64_t tickers[kTickerEnumMax];
+				ConcurrentHistogram histograms[kHistogramEnumMax];
+				// Keep the hot tickers of neighbouring stripes off one cache line.
+				char padding[64];
+			};
+
+			Stripe stripes_[kNumStripes];
+
+			// Pick a stripe for the calling thread.  Every thread runs on its
+			// own stack, so the address of a local is a cheap stand-in for a
+			// thread id that needs no thread-local storage from the port.
+			Stripe* Local() {
+				int marker;
+				uintptr_t x = reinterpret_cast<uintptr_t>(&marker) >> 16;
+				x ^= x >> 7;
+				x *= 0x9e3779b1u;
+				return &stripes_[(x >> 16) % kNumStripes];
+			}
+
+			void Merged(Histograms histogram, Histogram* h) const {
+				assert(histogram < kHistogramEnumMax);
+				h->Clear();
+				for (int i = 0; i < kNumStripes; i++) {
+					stripes_[i].histograms[histogram].MergeInto(h);
+				}
+			}
+
+			// No copying allowed
+			StripedStatistics(const StripedStatistics&);
+			void operator=(const StripedStatistics&);
+		};
+
+	}  // namespace
+
+	Statistics* NewDBStatistics() {
+		return new StripedStatistics;
+	}
+
+}  // namespace leveldb
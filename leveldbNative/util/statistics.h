@@ -0,0 +1,60 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_STATISTICS_H_
+#define STORAGE_LEVELDB_UTIL_STATISTICS_H_
+
+#include "leveldb/env.h"
+#include "leveldb/statistics.h"
+
+namespace leveldb {
+
+	// Options::statistics is optional; these helpers are no-ops when it is
+	// NULL so that call sites stay one line.
+	inline void RecordTick(Statistics* statistics, Tickers ticker,
+		uint64_t count = 1) {
+		if (statistics != NULL) {
+			statistics->RecordTick(ticker, count);
+		}
+	}
+
+	// Helper class that records the time between its construction and
+	// destruction into a histogram.  The clock is not read at all when
+	// "statistics" is NULL.  NowNanos() is used because NowMicros() has only
+	// millisecond resolution on Windows.
+	//
+	// Typical usage:
+	//
+	//   Status DBImpl::Get(...) {
+	//     StopWatch sw(env_, options_.statistics, kGetMicros);
+	//     ...
+	//   }
+	class StopWatch {
+	public:
+		StopWatch(Env* env, Statistics* statistics, Histograms histogram)
+			: env_(env),
+			statistics_(statistics),
+			histogram_(histogram),
+			start_(statistics != NULL ? env->NowNanos() : 0) {
+		}
+		~StopWatch() {
+			if (statistics_ != NULL) {
+				statistics_->MeasureTime(histogram_, (env_->NowNanos() - start_) / 1000);
+			}
+		}
+
+	private:
+		Env* const env_;
+		Statistics* const statistics_;
+		const Histograms histogram_;
+		const uint64_t start_;
+
+		// No copying allowed
+		StopWatch(const StopWatch&);
+		void operator=(const StopWatch&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_STATISTICS_H_
@@ -0,0 +1,125 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "port/port_win.h"
+#include "leveldb/env.h"
+#include "leveldb/statistics.h"
+#include "util/histogram.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+	class StatisticsTest { };
+
+	TEST(StatisticsTest, Empty) {
+		Statistics* stats = NewDBStatistics();
+		for (int t = 0; t < kTickerEnumMax; t++) {
+			ASSERT_EQ(0, stats->GetTickerCount(static_cast<Tickers>(t)));
+		}
+		HistogramData data;
+		stats->GetHistogramData(kGetMicros, &data);
+		ASSERT_EQ(0, data.count);
+		ASSERT_EQ(0, data.max);
+		delete stats;
+	}
+
+	TEST(StatisticsTest, TickersAndHistograms) {
+		Statistics* stats = NewDBStatistics();
+		stats->RecordTick(kWalBytes, 100);
+		stats->RecordTick(kWalBytes, 23);
+		stats->RecordTick(kMemtableHit, 1);
+		ASSERT_EQ(123, stats->GetTickerCount(kWalBytes));
+		ASSERT_EQ(1, stats->GetTickerCount(kMemtableHit));
+		ASSERT_EQ(0, stats->GetTickerCount(kMemtableMiss));
+
+		for (uint64_t i = 1; i <= 100; i++) {
+			stats->MeasureTime(kWriteMicros, i);
+		}
+		HistogramData data;
+		stats->GetHistogramData(kWriteMicros, &data);
+		ASSERT_EQ(100, data.count);
+		ASSERT_EQ(100, data.max);
+		ASSERT_TRUE(data.average > 50 && data.average < 51);
+		ASSERT_TRUE(data.median >= 45 && data.median <= 55);
+		ASSERT_TRUE(data.percentile99 >= 95 && data.percentile99 <= 100);
+		stats->GetHistogramData(kGetMicros, &data);
+		ASSERT_EQ(0, data.count);
+
+		std::string dump = stats->ToString();
+		ASSERT_TRUE(dump.find("leveldb.wal.bytes COUNT : 123\n") != std::string::npos);
+		ASSERT_TRUE(dump.find("leveldb.db.write.micros") != std::string::npos);
+
+		stats->Reset();
+		ASSERT_EQ(0, stats->GetTickerCount(kWalBytes));
+		stats->GetHistogramData(kWriteMicros, &data);
+		ASSERT_EQ(0, data.count);
+		delete stats;
+	}
+
+	TEST(StatisticsTest, ConcurrentHistogramMatchesHistogram) {
+		ConcurrentHistogram concurrent;
+		Histogram plain;
+		plain.Clear();
+		for (uint64_t v = 0; v < 5000; v += 7) {
+			concurrent.Add(v * v);
+			plain.Add(static_cast<double>(v * v));
+		}
+		Histogram merged;
+		merged.Clear();
+		concurrent.MergeInto(&merged);
+		ASSERT_EQ(plain.ToString(), merged.ToString());
+	}
+
+	namespace {
+
+		struct ThreadState {
+			Statistics* stats;
+			port::Mutex mu;
+			int remaining;
+			port::CondVar cv;
+
+			ThreadState() : stats(NULL), mu(), remaining(0), cv(&mu) { }
+		};
+
+		static const int kThreads = 8;
+		static const int kOpsPerThread = 10000;
+
+		static void RecordThread(void* arg) {
+			ThreadState* state = reinterpret_cast<ThreadState*>(arg);
+			for (int i = 0; i < kOpsPerThread; i++) {
+				state->stats->RecordTick(kKeysWritten, 1);
+				state->stats->MeasureTime(kGetMicros, i % 100);
+			}
+			MutexLock l(&state->mu);
+			state->remaining--;
+			state->cv.Signal();
+		}
+
+	}  // namespace
+
+	TEST(StatisticsTest, MultiThreaded) {
+		ThreadState state;
+		state.stats = NewDBStatistics();
+		state.remaining = kThreads;
+		for (int i = 0; i < kThreads; i++) {
+			Env::Default()->StartThread(&RecordThread, &state);
+		}
+		{
+			MutexLock l(&state.mu);
+			while (state.remaining > 0) {
+				state.cv.Wait();
+			}
+		}
+		ASSERT_EQ(kThreads * kOpsPerThread, state.stats->GetTickerCount(kKeysWritten));
+		HistogramData data;
+		state.stats->GetHistogramData(kGetMicros, &data);
+		ASSERT_EQ(kThreads * kOpsPerThread, data.count);
+		ASSERT_EQ(99, data.max);
+		delete state.stats;
+	}
+
+}  // namespace leveldb
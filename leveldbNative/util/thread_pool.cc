@@ -0,0 +1,84 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_pool.h"
+
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+	ThreadPool::ThreadPool(Env* env)
+		: env_(env),
+		mu_(),
+		cv_(&mu_),
+		queue_(),
+		threads_(0),
+		stop_(false) {
+	}
+
+	ThreadPool::~ThreadPool() {
+		MutexLock l(&mu_);
+		stop_ = true;
+		cv_.SignalAll();
+		while (threads_ > 0) {
+			cv_.Wait();
+		}
+		// Items queued with no thread left to run them
+		while (!queue_.empty()) {
+			Item item = queue_.front();
+			queue_.pop_front();
+			mu_.Unlock();
+			(*item.function)(item.arg);
+			mu_.Lock();
+		}
+	}
+
+	void ThreadPool::Reserve(int threads) {
+		MutexLock l(&mu_);
+		StartThreads(threads);
+	}
+
+	void ThreadPool::Schedule(void(*function)(void* arg), void* arg) {
+		MutexLock l(&mu_);
+		StartThreads(1);
+		Item item;
+		item.function = function;
+		item.arg = arg;
+		queue_.push_back(item);
+		cv_.Signal();
+	}
+
+	void ThreadPool::StartThreads(int threads) {
+		mu_.AssertHeld();
+		while (!stop_ && threads_ < threads) {
+			threads_++;
+			env_->StartThread(&ThreadPool::WorkerWrapper, this);
+		}
+	}
+
+	void ThreadPool::WorkerWrapper(void* pool) {
+		reinterpret_cast<ThreadPool*>(pool)->Worker();
+	}
+
+	void ThreadPool::Worker() {
+		MutexLock l(&mu_);
+		while (true) {
+			while (queue_.empty() && !stop_) {
+				cv_.Wait();
+			}
+			if (queue_.empty()) {
+				break;
+			}
+			Item item = queue_.front();
+			queue_.pop_front();
+			mu_.Unlock();
+			(*item.function)(item.arg);
+			mu_.Lock();
+		}
+		threads_--;
+		cv_.SignalAll();
+	}
+
+}  // namespace leveldb
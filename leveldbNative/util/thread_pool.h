@@ -0,0 +1,61 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A set of long-lived threads that run queued work items.  This backs
+// Env::ScheduleWork().
+
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+
+#include <deque>
+#include "port/port.h"
+
+namespace leveldb {
+
+	class Env;
+
+	class ThreadPool {
+	public:
+		// Threads are started with env->StartThread(), and only once
+		// Reserve() asks for them.
+		explicit ThreadPool(Env* env);
+
+		// Runs the items still queued, then waits for every thread to exit.
+		~ThreadPool();
+
+		// Start threads until there are at least "threads" of them.  The
+		// pool never shrinks.
+		void Reserve(int threads);
+
+		// Queue "(*function)(arg)" to run on one of the threads.  Starts a
+		// first thread if there is none yet.
+		void Schedule(void(*function)(void* arg), void* arg);
+
+	private:
+		struct Item {
+			void(*function)(void*);
+			void* arg;
+		};
+
+		static void WorkerWrapper(void* pool);
+		void Worker();
+
+		// REQUIRES: mu_ held
+		void StartThreads(int threads);
+
+		Env* const env_;
+		port::Mutex mu_;
+		port::CondVar cv_;
+		std::deque<Item> queue_;      // Guarded by mu_
+		int threads_;                 // Started and not exited; guarded by mu_
+		bool stop_;                   // Guarded by mu_
+
+		// No copying allowed
+		ThreadPool(const ThreadPool&);
+		void operator=(const ThreadPool&);
+	};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_POOL_H_